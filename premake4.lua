@@ -165,6 +165,10 @@ solution "VDrift"
 		files {"vdrift-win/bullet/**.h", "vdrift-win/bullet/**.cpp"}
 		postbuildcommands {"xcopy /d /y /f .\\vdrift-win\\lib\\*.dll .\\"}
 
+	configuration {"not windows"}
+		buildoptions {"-pthread"}
+		linkoptions {"-pthread"}
+
 	configuration {"linux"}
 		gen_definitions_h()
 		includedirs {"/usr/local/include/bullet/", "/usr/include/bullet"}
@@ -0,0 +1,208 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "aabbbvh.h"
+#include "aabbtree.h"
+#include "frustumcull.h"
+#include "microbench.h"
+#include "unittest.h"
+
+#include <algorithm>
+#include <random>
+
+// boxes scattered along a closed loop, similar to road patches and track objects
+static std::vector<Aabb<float> > GenerateBoxes(unsigned count, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> offset(-20, 20);
+	std::uniform_real_distribution<float> size(0.5f, 8);
+	std::vector<Aabb<float> > boxes(count);
+	for (unsigned i = 0; i < count; ++i)
+	{
+		const float a = 6.2831853f * i / count;
+		const Vec3 center(1000 * std::cos(a) + offset(rng), 600 * std::sin(a) + offset(rng), offset(rng) * 0.25f);
+		boxes[i].SetFromSphere(center, size(rng));
+	}
+	return boxes;
+}
+
+// downward rays along the loop, like wheel contact rays
+static std::vector<Aabb<float>::Ray> GenerateRays(unsigned count, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> angle(0, 6.2831853f);
+	std::uniform_real_distribution<float> offset(-20, 20);
+	std::vector<Aabb<float>::Ray> rays;
+	rays.reserve(count);
+	for (unsigned i = 0; i < count; ++i)
+	{
+		const float a = angle(rng);
+		const Vec3 origin(1000 * std::cos(a) + offset(rng), 600 * std::sin(a) + offset(rng), 10);
+		rays.push_back(Aabb<float>::Ray(origin, Vec3(0, 0, -1), 20));
+	}
+	return rays;
+}
+
+// view frustum planes looking along x from origin, normals pointing inwards
+static void GenerateFrustum(const Vec3 & origin, float frustum[6][4])
+{
+	const float planes[6][4] = {
+		{0.7071f, 0.7071f, 0, 0},
+		{0.7071f, -0.7071f, 0, 0},
+		{0.7071f, 0, 0.7071f, 0},
+		{0.7071f, 0, -0.7071f, 0},
+		{1, 0, 0, -0.1f},
+		{-1, 0, 0, 500}};
+	for (int i = 0; i < 6; ++i)
+	{
+		for (int k = 0; k < 3; ++k)
+			frustum[i][k] = planes[i][k];
+		frustum[i][3] = planes[i][3] - (planes[i][0] * origin[0] + planes[i][1] * origin[1] + planes[i][2] * origin[2]);
+	}
+}
+
+template <typename Tree>
+static void FillTree(Tree & tree, const std::vector<Aabb<float> > & boxes)
+{
+	for (unsigned i = 0; i < boxes.size(); ++i)
+		tree.Add(i, boxes[i]);
+	tree.Optimize();
+}
+
+QT_TEST(aabb_bvh_test)
+{
+	AabbBvh<unsigned> empty;
+	std::vector<unsigned> found;
+	empty.Optimize();
+	empty.Query(Aabb<float>::IntersectAlways(), found);
+	QT_CHECK(found.empty());
+
+	const std::vector<Aabb<float> > boxes = GenerateBoxes(2000, 1);
+	AabbBvh<unsigned> bvh;
+	AabbBvh<unsigned, 8> bvh8;
+	AabbTreeNode<unsigned> tree;
+	FillTree(bvh, boxes);
+	FillTree(bvh8, boxes);
+	FillTree(tree, boxes);
+	QT_CHECK_EQUAL(bvh.size(), 2000);
+	QT_CHECK_EQUAL(bvh.GetNodeCount(), 2 * 2000 - 1);
+
+	// every object reported
+	found.clear();
+	bvh.Query(Aabb<float>::IntersectAlways(), found);
+	std::sort(found.begin(), found.end());
+	QT_CHECK_EQUAL(found.size(), 2000);
+	QT_CHECK(std::unique(found.begin(), found.end()) == found.end());
+
+	// ray queries match the recursive tree and brute force
+	const std::vector<Aabb<float>::Ray> rays = GenerateRays(200, 2);
+	std::vector<unsigned> expected, result8;
+	for (const auto & ray : rays)
+	{
+		expected.clear();
+		for (unsigned i = 0; i < boxes.size(); ++i)
+		{
+			if (boxes[i].Intersect(ray) != Aabb<float>::OUT)
+				expected.push_back(i);
+		}
+
+		found.clear();
+		bvh.Query(ray, found);
+		std::sort(found.begin(), found.end());
+		QT_CHECK(found == expected);
+
+		result8.clear();
+		bvh8.Query(ray, result8);
+		std::sort(result8.begin(), result8.end());
+		QT_CHECK(result8 == expected);
+
+		found.clear();
+		tree.Query(ray, found);
+		std::sort(found.begin(), found.end());
+		QT_CHECK(found == expected);
+	}
+
+	// aabb query into a fixed buffer
+	Aabb<float> region;
+	region.SetFromSphere(Vec3(1000, 0, 0), 50);
+	expected.clear();
+	for (unsigned i = 0; i < boxes.size(); ++i)
+	{
+		if (boxes[i].Intersect(region) != Aabb<float>::OUT)
+			expected.push_back(i);
+	}
+	unsigned buffer[4];
+	const unsigned count = bvh.Query(region, buffer, 4);
+	QT_CHECK_EQUAL(count, expected.size());
+	for (unsigned i = 0; i < std::min(count, 4u); ++i)
+		QT_CHECK(std::find(expected.begin(), expected.end(), buffer[i]) != expected.end());
+
+	// frustum query matches brute force
+	float frustum[6][4];
+	GenerateFrustum(Vec3(600, 0, 0), frustum);
+	auto cull = MakeFrustumCuller(frustum);
+	expected.clear();
+	for (unsigned i = 0; i < boxes.size(); ++i)
+	{
+		if (boxes[i].Intersect(cull) != Aabb<float>::OUT)
+			expected.push_back(i);
+	}
+	found.clear();
+	bvh8.Query(cull, found);
+	std::sort(found.begin(), found.end());
+	QT_CHECK(!expected.empty());
+	QT_CHECK(found == expected);
+}
+
+MB_BENCHMARK(aabb_bvh_benchmark)
+{
+	const std::vector<Aabb<float> > boxes = GenerateBoxes(4000, 1);
+	const std::vector<Aabb<float>::Ray> rays = GenerateRays(1024, 2);
+	float frustum[6][4];
+	GenerateFrustum(Vec3(600, 0, 0), frustum);
+	auto cull = MakeFrustumCuller(frustum);
+
+	AabbTreeNode<unsigned> tree;
+	AabbTreeNode<unsigned, 64> tree64;
+	AabbBvh<unsigned> bvh;
+	AabbBvh<unsigned, 8> bvh8;
+	AabbBvh<unsigned, 64> bvh64;
+	FillTree(tree, boxes);
+	FillTree(tree64, boxes);
+	FillTree(bvh, boxes);
+	FillTree(bvh8, boxes);
+	FillTree(bvh64, boxes);
+
+	std::vector<unsigned> result;
+	result.reserve(boxes.size());
+	unsigned buffer[256];
+	unsigned ray_index = 0;
+
+	auto ray_tree = [&] { result.clear(); tree.Query(rays[ray_index++ % rays.size()], result); };
+	auto ray_bvh = [&] { microbench::keep(bvh.Query(rays[ray_index++ % rays.size()], buffer, 256)); };
+	auto frustum_tree = [&] { result.clear(); tree64.Query(cull, result); };
+	auto frustum_bvh8 = [&] { result.clear(); bvh8.Query(cull, result); };
+	auto frustum_bvh64 = [&] { result.clear(); bvh64.Query(cull, result); };
+
+	out << "ray query AabbTreeNode: " << microbench::measure(ray_tree) << " ns" << std::endl;
+	out << "ray query AabbBvh: " << microbench::measure(ray_bvh) << " ns" << std::endl;
+	out << "frustum query AabbTreeNode<64>: " << microbench::measure(frustum_tree) << " ns" << std::endl;
+	out << "frustum query AabbBvh<8>: " << microbench::measure(frustum_bvh8) << " ns" << std::endl;
+	out << "frustum query AabbBvh<64>: " << microbench::measure(frustum_bvh64) << " ns" << std::endl;
+}
@@ -0,0 +1,361 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _AABBBVH_H
+#define _AABBBVH_H
+
+#include "aabb.h"
+#include "mathvector.h"
+
+#include <algorithm>
+#include <vector>
+
+/// Bounding volume hierarchy stored as one array of nodes in depth first order.
+/// Objects of a subtree are stored contiguously, every node knows its object
+/// range and the index of the node following its subtree, so the traversal
+/// needs no stack. Built with a binned surface area heuristic.
+template <typename DataType, unsigned int max_leaf_objects = 1>
+class AabbBvh
+{
+public:
+	/// Add object, Optimize has to be called before the object is queried efficiently.
+	void Add(const DataType & object, const Aabb<float> & box)
+	{
+		objects.push_back(object);
+		boxes.push_back(box);
+		nodes.clear();
+	}
+
+	/// Build the hierarchy from the added objects.
+	void Optimize();
+
+	void Clear()
+	{
+		objects.clear();
+		boxes.clear();
+		nodes.clear();
+	}
+
+	bool Empty() const { return objects.empty(); }
+
+	unsigned int size() const { return objects.size(); }
+
+	unsigned int GetNodeCount() const { return nodes.size(); }
+
+	/// Append objects intersecting shape to output.
+	/// Shape is any type supported by Aabb<float>::Intersect: ray, aabb, culler, IntersectAlways.
+	template <typename T, typename U>
+	void Query(const T & shape, U & output) const
+	{
+		Traverse(shape, [&output](const DataType & object) { output.push_back(object); });
+	}
+
+	/// Write up to capacity objects intersecting shape into output.
+	/// Returns the number of intersecting objects, which might be larger than capacity.
+	template <typename T>
+	unsigned int Query(const T & shape, DataType * output, unsigned int capacity) const
+	{
+		unsigned int count = 0;
+		Traverse(shape, [output, capacity, &count](const DataType & object)
+		{
+			if (count < capacity)
+				output[count] = object;
+			count++;
+		});
+		return count;
+	}
+
+private:
+	struct Node
+	{
+		Aabb<float> box;
+		unsigned int begin; ///< first object of the subtree
+		unsigned int end; ///< one past the last object of the subtree
+		unsigned int skip; ///< next node after the subtree, index + 1 for leaves
+	};
+
+	std::vector<Node> nodes;
+	std::vector<DataType> objects;
+	std::vector<Aabb<float> > boxes;
+
+	template <typename T, typename Visitor>
+	void Traverse(const T & shape, Visitor visit) const;
+
+	unsigned int Build(std::vector<unsigned int> & order, unsigned int begin, unsigned int end);
+
+	unsigned int Split(std::vector<unsigned int> & order, unsigned int begin, unsigned int end, const Vec3 & cmin, const Vec3 & cmax) const;
+
+	static Vec3 GetMin(const Aabb<float> & box) { return box.GetCenter() - box.GetExtent(); }
+
+	static Vec3 GetMax(const Aabb<float> & box) { return box.GetCenter() + box.GetExtent(); }
+
+	static float GetArea(const Vec3 & min, const Vec3 & max)
+	{
+		Vec3 d = max - min;
+		return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+	}
+};
+
+template <typename DataType, unsigned int max_leaf_objects>
+template <typename T, typename Visitor>
+inline void AabbBvh<DataType, max_leaf_objects>::Traverse(const T & shape, Visitor visit) const
+{
+	// not optimized, test all objects
+	if (nodes.empty())
+	{
+		for (unsigned int i = 0; i < objects.size(); ++i)
+		{
+			if (boxes[i].Intersect(shape) != Aabb<float>::OUT)
+				visit(objects[i]);
+		}
+		return;
+	}
+
+	const unsigned int node_count = nodes.size();
+	unsigned int i = 0;
+	while (i < node_count)
+	{
+		const Node & node = nodes[i];
+		const Aabb<float>::IntersectionEnum intersection = node.box.Intersect(shape);
+		if (intersection == Aabb<float>::OUT)
+		{
+			i = node.skip;
+			continue;
+		}
+
+		if (intersection == Aabb<float>::IN)
+		{
+			// subtree fully inside
+			for (unsigned int n = node.begin; n < node.end; ++n)
+				visit(objects[n]);
+			i = node.skip;
+			continue;
+		}
+
+		if (node.skip == i + 1)
+		{
+			// leaf, a single object box equals the node box
+			if (node.end - node.begin == 1)
+			{
+				visit(objects[node.begin]);
+			}
+			else
+			{
+				for (unsigned int n = node.begin; n < node.end; ++n)
+				{
+					if (boxes[n].Intersect(shape) != Aabb<float>::OUT)
+						visit(objects[n]);
+				}
+			}
+		}
+		++i;
+	}
+}
+
+template <typename DataType, unsigned int max_leaf_objects>
+inline void AabbBvh<DataType, max_leaf_objects>::Optimize()
+{
+	nodes.clear();
+	if (objects.empty())
+		return;
+
+	std::vector<unsigned int> order(objects.size());
+	for (unsigned int i = 0; i < order.size(); ++i)
+		order[i] = i;
+
+	nodes.reserve(2 * objects.size());
+	Build(order, 0, order.size());
+
+	// store objects in leaf order
+	std::vector<DataType> sorted_objects;
+	std::vector<Aabb<float> > sorted_boxes;
+	sorted_objects.reserve(objects.size());
+	sorted_boxes.reserve(boxes.size());
+	for (unsigned int i : order)
+	{
+		sorted_objects.push_back(objects[i]);
+		sorted_boxes.push_back(boxes[i]);
+	}
+	objects.swap(sorted_objects);
+	boxes.swap(sorted_boxes);
+}
+
+template <typename DataType, unsigned int max_leaf_objects>
+inline unsigned int AabbBvh<DataType, max_leaf_objects>::Build(
+	std::vector<unsigned int> & order,
+	unsigned int begin,
+	unsigned int end)
+{
+	Vec3 bmin = GetMin(boxes[order[begin]]);
+	Vec3 bmax = GetMax(boxes[order[begin]]);
+	Vec3 cmin = boxes[order[begin]].GetCenter();
+	Vec3 cmax = cmin;
+	for (unsigned int i = begin + 1; i < end; ++i)
+	{
+		const Aabb<float> & box = boxes[order[i]];
+		const Vec3 omin = GetMin(box);
+		const Vec3 omax = GetMax(box);
+		const Vec3 & c = box.GetCenter();
+		for (int k = 0; k < 3; ++k)
+		{
+			bmin[k] = std::min(bmin[k], omin[k]);
+			bmax[k] = std::max(bmax[k], omax[k]);
+			cmin[k] = std::min(cmin[k], c[k]);
+			cmax[k] = std::max(cmax[k], c[k]);
+		}
+	}
+
+	const unsigned int index = nodes.size();
+	nodes.push_back(Node());
+	nodes[index].box = Aabb<float>(bmin, bmax);
+	nodes[index].begin = begin;
+	nodes[index].end = end;
+
+	if (end - begin > max_leaf_objects)
+	{
+		const unsigned int mid = Split(order, begin, end, cmin, cmax);
+		if (mid > begin && mid < end)
+		{
+			Build(order, begin, mid);
+			Build(order, mid, end);
+		}
+	}
+
+	nodes[index].skip = nodes.size();
+	return index;
+}
+
+template <typename DataType, unsigned int max_leaf_objects>
+inline unsigned int AabbBvh<DataType, max_leaf_objects>::Split(
+	std::vector<unsigned int> & order,
+	unsigned int begin,
+	unsigned int end,
+	const Vec3 & cmin,
+	const Vec3 & cmax) const
+{
+	// split axis of largest centroid extent
+	const Vec3 extent = cmax - cmin;
+	int axis = 0;
+	if (extent[1] > extent[axis]) axis = 1;
+	if (extent[2] > extent[axis]) axis = 2;
+	if (!(extent[axis] > 0))
+		return begin;
+
+	// bin object centers, evaluate surface area cost of all bin boundaries
+	const int bin_count = 16;
+	const float bin_scale = bin_count / extent[axis] * 0.9999f;
+	unsigned int bin_size[bin_count] = {};
+	Vec3 bin_min[bin_count];
+	Vec3 bin_max[bin_count];
+	for (unsigned int i = begin; i < end; ++i)
+	{
+		const Aabb<float> & box = boxes[order[i]];
+		const int b = int((box.GetCenter()[axis] - cmin[axis]) * bin_scale);
+		const Vec3 omin = GetMin(box);
+		const Vec3 omax = GetMax(box);
+		if (bin_size[b] == 0)
+		{
+			bin_min[b] = omin;
+			bin_max[b] = omax;
+		}
+		for (int k = 0; k < 3; ++k)
+		{
+			bin_min[b][k] = std::min(bin_min[b][k], omin[k]);
+			bin_max[b][k] = std::max(bin_max[b][k], omax[k]);
+		}
+		bin_size[b]++;
+	}
+
+	// sweep from the right to get the cost of the upper sides
+	float right_cost[bin_count] = {};
+	unsigned int right_size = 0;
+	Vec3 rmin, rmax;
+	for (int b = bin_count - 1; b > 0; --b)
+	{
+		if (bin_size[b])
+		{
+			if (right_size == 0)
+			{
+				rmin = bin_min[b];
+				rmax = bin_max[b];
+			}
+			for (int k = 0; k < 3; ++k)
+			{
+				rmin[k] = std::min(rmin[k], bin_min[b][k]);
+				rmax[k] = std::max(rmax[k], bin_max[b][k]);
+			}
+			right_size += bin_size[b];
+		}
+		right_cost[b] = right_size ? right_size * GetArea(rmin, rmax) : 0;
+	}
+
+	int best_bin = 0;
+	float best_cost = 0;
+	unsigned int left_size = 0;
+	Vec3 lmin, lmax;
+	for (int b = 0; b < bin_count - 1; ++b)
+	{
+		if (bin_size[b])
+		{
+			if (left_size == 0)
+			{
+				lmin = bin_min[b];
+				lmax = bin_max[b];
+			}
+			for (int k = 0; k < 3; ++k)
+			{
+				lmin[k] = std::min(lmin[k], bin_min[b][k]);
+				lmax[k] = std::max(lmax[k], bin_max[b][k]);
+			}
+			left_size += bin_size[b];
+		}
+		if (left_size == 0 || left_size == end - begin)
+			continue;
+
+		const float cost = left_size * GetArea(lmin, lmax) + right_cost[b + 1];
+		if (best_bin == 0 || cost < best_cost)
+		{
+			best_bin = b + 1;
+			best_cost = cost;
+		}
+	}
+
+	if (best_bin > 0)
+	{
+		auto mid = std::partition(
+			order.begin() + begin, order.begin() + end,
+			[this, axis, &cmin, bin_scale, best_bin](unsigned int i)
+			{
+				return int((boxes[i].GetCenter()[axis] - cmin[axis]) * bin_scale) < best_bin;
+			});
+		return mid - order.begin();
+	}
+
+	// all centers in one bin, fall back to median split
+	const unsigned int mid = (begin + end) / 2;
+	std::nth_element(
+		order.begin() + begin, order.begin() + mid, order.begin() + end,
+		[this, axis](unsigned int a, unsigned int b)
+		{
+			return boxes[a].GetCenter()[axis] < boxes[b].GetCenter()[axis];
+		});
+	return mid;
+}
+
+#endif // _AABBBVH_H
@@ -0,0 +1,168 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+#include "benchmarkstats.h"
+#include "profiler.h"
+#include "unittest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+static std::string JsonString(const std::string & str)
+{
+	std::string result = "\"";
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+			result += '\\';
+		result += (c >= 0 && c < ' ') ? ' ' : c;
+	}
+	return result + "\"";
+}
+
+static void WriteSeries(std::ostream & out, const std::string & name, std::vector<float> samples)
+{
+	std::sort(samples.begin(), samples.end());
+	double sum = 0;
+	for (float s : samples)
+		sum += s;
+
+	out << JsonString(name) << ":{";
+	out << "\"mean\":" << (samples.empty() ? 0 : sum / samples.size());
+	out << ",\"p50\":" << BenchmarkStats::Percentile(samples, 0.5f);
+	out << ",\"p90\":" << BenchmarkStats::Percentile(samples, 0.9f);
+	out << ",\"p95\":" << BenchmarkStats::Percentile(samples, 0.95f);
+	out << ",\"p99\":" << BenchmarkStats::Percentile(samples, 0.99f);
+	out << ",\"max\":" << (samples.empty() ? 0 : samples.back());
+	out << "}";
+}
+
+void BenchmarkStats::Init(const std::vector<Zone> & zones, unsigned warmup_frames)
+{
+	series.clear();
+	for (const auto & zone : zones)
+		series.push_back(Series{zone.first, Profiler::RegisterZone(zone.second.c_str()), std::vector<float>()});
+	frame_times.clear();
+	warmup = warmup_frames;
+	frames = 0;
+	start = end = std::chrono::steady_clock::now();
+}
+
+void BenchmarkStats::AddFrame()
+{
+	end = std::chrono::steady_clock::now();
+	if (warmup > 0)
+	{
+		warmup--;
+		start = end;
+		return;
+	}
+
+	frames++;
+	frame_times.push_back(Profiler::GetFrameTime());
+	for (auto & s : series)
+		s.samples.push_back(Profiler::GetZoneTime(s.zone));
+}
+
+unsigned BenchmarkStats::GetFrames() const
+{
+	return frames;
+}
+
+double BenchmarkStats::GetWallTime() const
+{
+	return std::chrono::duration<double>(end - start).count();
+}
+
+void BenchmarkStats::SetInfo(const std::string & key, const std::string & value)
+{
+	info.push_back(std::make_pair(key, JsonString(value)));
+}
+
+void BenchmarkStats::SetInfo(const std::string & key, double value)
+{
+	std::ostringstream s;
+	s << value;
+	info.push_back(std::make_pair(key, s.str()));
+}
+
+bool BenchmarkStats::WriteJson(std::ostream & out) const
+{
+	out << "{\n\"info\":{";
+	for (unsigned i = 0; i < info.size(); ++i)
+		out << (i ? "," : "") << JsonString(info[i].first) << ":" << info[i].second;
+	out << "},\n\"frames\":" << frames;
+	out << ",\n\"walltime\":" << GetWallTime();
+	out << ",\n\"unit\":\"us\"";
+	out << ",\n\"zones\":{\n";
+	WriteSeries(out, "frame", frame_times);
+	for (const auto & s : series)
+	{
+		out << ",\n";
+		WriteSeries(out, s.name, s.samples);
+	}
+	out << "\n}\n}\n";
+	return bool(out);
+}
+
+float BenchmarkStats::Percentile(const std::vector<float> & sorted, float p)
+{
+	if (sorted.empty())
+		return 0;
+
+	const int rank = int(std::ceil(p * sorted.size()));
+	return sorted[std::min(std::max(rank, 1), int(sorted.size())) - 1];
+}
+
+QT_TEST(benchmarkstats_test)
+{
+	std::vector<float> values;
+	QT_CHECK_EQUAL(BenchmarkStats::Percentile(values, 0.5f), 0);
+	for (int i = 1; i <= 100; ++i)
+		values.push_back(i);
+	QT_CHECK_EQUAL(BenchmarkStats::Percentile(values, 0.5f), 50);
+	QT_CHECK_EQUAL(BenchmarkStats::Percentile(values, 0.99f), 99);
+	QT_CHECK_EQUAL(BenchmarkStats::Percentile(values, 1.0f), 100);
+	QT_CHECK_EQUAL(BenchmarkStats::Percentile(values, 0.0f), 1);
+
+	Profiler::Enable(true);
+	BenchmarkStats stats;
+	stats.Init({{"test", "benchmarkstats_test"}}, 2);
+	for (int i = 0; i < 5; ++i)
+	{
+		{
+			PROFILE_ZONE("benchmarkstats_test");
+		}
+		Profiler::EndFrame();
+		stats.AddFrame();
+	}
+	Profiler::Enable(false);
+	QT_CHECK_EQUAL(stats.GetFrames(), 3u);
+	QT_CHECK(stats.GetWallTime() > 0);
+
+	stats.SetInfo("track", "ruudskogen");
+	stats.SetInfo("cars", 4);
+	std::ostringstream out;
+	QT_CHECK(stats.WriteJson(out));
+	const std::string json = out.str();
+	QT_CHECK(json.find("\"info\":{\"track\":\"ruudskogen\",\"cars\":4}") != std::string::npos);
+	QT_CHECK(json.find("\"frames\":3") != std::string::npos);
+	QT_CHECK(json.find("\"frame\":{\"mean\":") != std::string::npos);
+	QT_CHECK(json.find("\"test\":{\"mean\":") != std::string::npos);
+}
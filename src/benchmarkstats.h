@@ -0,0 +1,74 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+#ifndef _BENCHMARKSTATS_H
+#define _BENCHMARKSTATS_H
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// Per frame times of a benchmark run. Samples the frame time and the
+/// times of a set of profiler zones once per frame, reports percentiles
+/// in microseconds as JSON for regression tracking.
+class BenchmarkStats
+{
+public:
+	typedef std::pair<std::string, std::string> Zone; ///< report name, profiler zone name
+
+	/// Reset samples, the first warmup_frames frames are not sampled.
+	void Init(const std::vector<Zone> & zones, unsigned warmup_frames);
+
+	/// Sample times of the last frame, called after Profiler::EndFrame.
+	void AddFrame();
+
+	/// Number of sampled frames.
+	unsigned GetFrames() const;
+
+	/// Wall clock time of the sampled frames in seconds.
+	double GetWallTime() const;
+
+	/// Describe the run, written to the info object.
+	void SetInfo(const std::string & key, const std::string & value);
+	void SetInfo(const std::string & key, double value);
+
+	/// Write info, frame count and per zone mean, percentiles and max.
+	bool WriteJson(std::ostream & out) const;
+
+	/// Value below which the fraction p of the samples lie, nearest rank.
+	static float Percentile(const std::vector<float> & sorted, float p);
+
+private:
+	struct Series
+	{
+		std::string name;
+		unsigned zone;
+		std::vector<float> samples;
+	};
+	std::vector<Series> series;
+	std::vector<float> frame_times;
+	std::vector<std::pair<std::string, std::string> > info; ///< key, json value
+	std::chrono::steady_clock::time_point start;
+	std::chrono::steady_clock::time_point end;
+	unsigned warmup = 0;
+	unsigned frames = 0;
+};
+
+#endif // _BENCHMARKSTATS_H
@@ -0,0 +1,411 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "bvhcache.h"
+#include "datahash.h"
+#include "unittest.h"
+
+#include "BulletCollision/CollisionShapes/btBvhTriangleMeshShape.h"
+#include "BulletCollision/CollisionShapes/btOptimizedBvh.h"
+#include "BulletCollision/CollisionShapes/btStridingMeshInterface.h"
+#include "BulletCollision/CollisionShapes/btTriangleIndexVertexArray.h"
+#include "BulletCollision/NarrowPhaseCollision/btRaycastCallback.h"
+#include "LinearMath/btAlignedAllocator.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+// file layout: header, entry table, serialized hierarchies at aligned offsets
+struct BvhCacheHeader
+{
+	unsigned magic;
+	unsigned version;
+	unsigned bullet_version;
+	unsigned bvh_size;
+	unsigned scalar_size;
+	unsigned count;
+};
+
+struct BvhCacheEntry
+{
+	unsigned long long hash;
+	unsigned long long offset;
+	unsigned long long size;
+};
+
+// serialized hierarchies are only valid for the same bullet build and byte order
+static BvhCacheHeader GetHeader(unsigned count)
+{
+	BvhCacheHeader header;
+	header.magic = 0x48564256; // "VBVH"
+	header.version = 1;
+	header.bullet_version = BT_BULLET_VERSION;
+	header.bvh_size = sizeof(btQuantizedBvh);
+	header.scalar_size = sizeof(btScalar);
+	header.count = count;
+	return header;
+}
+
+// a cache written while the previous file was mapped, see Write
+static std::string GetPendingPath(const std::string & path)
+{
+	return path + ".tmp";
+}
+
+// rename doesn't replace existing files on windows
+static bool Replace(const std::string & from, const std::string & to)
+{
+	if (std::rename(from.c_str(), to.c_str()) == 0)
+		return true;
+	std::remove(to.c_str());
+	return std::rename(from.c_str(), to.c_str()) == 0;
+}
+
+// bullet requires 16 byte aligned hierarchies
+static size_t Align(size_t offset)
+{
+	return (offset + 15) & ~size_t(15);
+}
+
+static unsigned long long HashMesh(const btStridingMeshInterface & mesh)
+{
+	const btVector3 & s = mesh.getScaling();
+	const btScalar scaling[] = {s.x(), s.y(), s.z()};
+	unsigned long long hash = DataHash(scaling, sizeof(scaling));
+	for (int i = 0; i < mesh.getNumSubParts(); ++i)
+	{
+		const unsigned char * vertices;
+		const unsigned char * indices;
+		int vcount, vstride, istride, fcount;
+		PHY_ScalarType vtype, itype;
+		mesh.getLockedReadOnlyVertexIndexBase(&vertices, vcount, vtype, vstride, &indices, istride, fcount, itype, i);
+
+		const int layout[] = {vcount, vtype, vstride, fcount, itype, istride};
+		hash = DataHash(layout, sizeof(layout), hash);
+		hash = DataHash(vertices, size_t(vcount) * vstride, hash);
+		hash = DataHash(indices, size_t(fcount) * istride, hash);
+
+		mesh.unLockReadOnlyVertexBase(i);
+	}
+	return hash;
+}
+
+BvhCache::BvhCache() :
+	hits(0),
+	misses(0)
+{
+	// ctor
+}
+
+bool BvhCache::Open(const std::string & filepath)
+{
+	Close();
+
+	path = filepath;
+	if (path.empty())
+		return false;
+
+	const std::string pending = GetPendingPath(path);
+	if (std::ifstream(pending.c_str()))
+		Replace(pending, path);
+
+	if (!file.Open(path, true))
+		return false;
+
+	BvhCacheHeader header;
+	const char * data = file.GetData();
+	const size_t size = file.GetSize();
+	if (size < sizeof(header))
+	{
+		file.Close();
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(header));
+
+	const BvhCacheHeader expected = GetHeader(header.count);
+	if (std::memcmp(&header, &expected, sizeof(header)) != 0 ||
+		(size - sizeof(header)) / sizeof(BvhCacheEntry) < header.count)
+	{
+		file.Close();
+		return false;
+	}
+
+	for (unsigned i = 0; i < header.count; ++i)
+	{
+		BvhCacheEntry entry;
+		std::memcpy(&entry, data + sizeof(header) + i * sizeof(entry), sizeof(entry));
+		if (entry.offset == Align(entry.offset) && entry.offset <= size && entry.size <= size - entry.offset)
+			cached[entry.hash] = std::make_pair(size_t(entry.offset), size_t(entry.size));
+	}
+	return true;
+}
+
+void BvhCache::Close()
+{
+	path.clear();
+	file.Close();
+	cached.clear();
+	bvhs.clear();
+	hits = 0;
+	misses = 0;
+}
+
+btBvhTriangleMeshShape * BvhCache::CreateShape(btStridingMeshInterface * mesh)
+{
+	if (path.empty())
+		return new btBvhTriangleMeshShape(mesh, true);
+
+	const unsigned long long hash = HashMesh(*mesh);
+	auto ib = bvhs.find(hash);
+	if (ib == bvhs.end())
+	{
+		btOptimizedBvh * bvh = 0;
+		auto ic = cached.find(hash);
+		if (ic != cached.end())
+		{
+			char * data = file.GetWritableData() + ic->second.first;
+			bvh = btOptimizedBvh::deSerializeInPlace(data, ic->second.second, false);
+		}
+		if (!bvh)
+		{
+			btBvhTriangleMeshShape * shape = new btBvhTriangleMeshShape(mesh, true);
+			bvhs[hash] = shape->getOptimizedBvh();
+			misses++;
+			return shape;
+		}
+		ib = bvhs.insert(std::make_pair(hash, bvh)).first;
+	}
+
+	// the shape doesn't own a cached or shared hierarchy
+	btBvhTriangleMeshShape * shape = new btBvhTriangleMeshShape(mesh, true, false);
+	shape->setOptimizedBvh(ib->second);
+	hits++;
+	return shape;
+}
+
+bool BvhCache::Write(std::ostream & error)
+{
+	if (path.empty() || !misses)
+		return true;
+
+	std::vector<BvhCacheEntry> entries;
+	entries.reserve(bvhs.size());
+	size_t offset = Align(sizeof(BvhCacheHeader) + bvhs.size() * sizeof(BvhCacheEntry));
+	for (const auto & b : bvhs)
+	{
+		BvhCacheEntry entry;
+		entry.hash = b.first;
+		entry.offset = offset;
+		entry.size = b.second->calculateSerializeBufferSize();
+		entries.push_back(entry);
+		offset = Align(offset + entry.size);
+	}
+
+	// write to a temporary file first, the current file might still be mapped
+	const std::string temp = GetPendingPath(path);
+	{
+		std::ofstream f(temp.c_str(), std::ios::binary);
+		const BvhCacheHeader header = GetHeader(entries.size());
+		f.write((const char *)&header, sizeof(header));
+		f.write((const char *)entries.data(), entries.size() * sizeof(BvhCacheEntry));
+
+		const char zeros[16] = {0};
+		size_t pos = sizeof(header) + entries.size() * sizeof(BvhCacheEntry);
+		auto ie = entries.begin();
+		for (const auto & b : bvhs)
+		{
+			const size_t size = ie->size;
+			void * buffer = btAlignedAlloc(size, 16);
+
+			// cached hierarchies are constructed as btQuantizedBvh by deSerializeInPlace,
+			// don't dispatch to btOptimizedBvh::serializeInPlace
+			b.second->btQuantizedBvh::serialize(buffer, size, false);
+
+			f.write(zeros, ie->offset - pos);
+			f.write((const char *)buffer, size);
+			btAlignedFree(buffer);
+			pos = ie->offset + size;
+			++ie;
+		}
+
+		if (!f)
+		{
+			f.close();
+			std::remove(temp.c_str());
+			error << "Failed to write collision cache file " << temp << std::endl;
+			return false;
+		}
+	}
+
+	// a mapped file can't be replaced on windows, the cached hierarchies of
+	// the live shapes point into it. Keep the new file pending until Open.
+	Replace(temp, path);
+	return true;
+}
+
+struct BvhCacheTestMesh
+{
+	std::vector<btScalar> vertices;
+	std::vector<int> indices;
+	btTriangleIndexVertexArray * mesh;
+
+	// bumpy n by n grid of quads
+	BvhCacheTestMesh(int n, btScalar bump)
+	{
+		for (int y = 0; y <= n; ++y)
+		{
+			for (int x = 0; x <= n; ++x)
+			{
+				vertices.push_back(x);
+				vertices.push_back(y);
+				vertices.push_back(bump * std::sin(x * 0.7f) * std::cos(y * 0.4f));
+			}
+		}
+		for (int y = 0; y < n; ++y)
+		{
+			for (int x = 0; x < n; ++x)
+			{
+				const int i = y * (n + 1) + x;
+				const int quad[] = {i, i + 1, i + n + 2, i, i + n + 2, i + n + 1};
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+		mesh = new btTriangleIndexVertexArray(
+			indices.size() / 3, indices.data(), 3 * sizeof(int),
+			vertices.size() / 3, vertices.data(), 3 * sizeof(btScalar));
+	}
+
+	~BvhCacheTestMesh()
+	{
+		delete mesh;
+	}
+};
+
+struct BvhCacheTestRay : public btTriangleRaycastCallback
+{
+	int triangle;
+
+	BvhCacheTestRay(const btVector3 & from, const btVector3 & to) :
+		btTriangleRaycastCallback(from, to),
+		triangle(-1)
+	{
+		// ctor
+	}
+
+	btScalar reportHit(const btVector3 & /*normal*/, btScalar fraction, int /*part*/, int index) override
+	{
+		// only called for hits closer than m_hitFraction, which is set to fraction
+		triangle = index;
+		return fraction;
+	}
+};
+
+// number of rays cast down onto the grid that hit the same triangle
+// at the same fraction on both shapes
+static int BvhCacheTestRays(btBvhTriangleMeshShape & a, btBvhTriangleMeshShape & b, int n)
+{
+	int matches = 0;
+	for (int y = 0; y < n; ++y)
+	{
+		for (int x = 0; x < n; ++x)
+		{
+			const btVector3 from(x + 0.37f, y + 0.61f, 10);
+			const btVector3 to(x + 0.37f, y + 0.61f, -10);
+			BvhCacheTestRay ra(from, to), rb(from, to);
+			a.performRaycast(&ra, from, to);
+			b.performRaycast(&rb, from, to);
+			if (ra.triangle >= 0 && ra.triangle == rb.triangle && ra.m_hitFraction == rb.m_hitFraction)
+				matches++;
+		}
+	}
+	return matches;
+}
+
+QT_TEST(bvhcache_test)
+{
+	const std::string path = "bvhcache_test.bvh";
+	std::remove(path.c_str());
+	std::remove(GetPendingPath(path).c_str());
+
+	const int n = 16;
+	BvhCacheTestMesh mesh(n, 1), changed(n, 1);
+	changed.vertices[2] += 0.5f;
+
+	std::ostringstream error;
+	BvhCache cache;
+
+	// missing file, build and write the hierarchy
+	QT_CHECK(!cache.Open(path));
+	btBvhTriangleMeshShape * built = cache.CreateShape(mesh.mesh);
+	QT_CHECK_EQUAL(cache.GetMisses(), 1u);
+	QT_CHECK(cache.Write(error));
+	QT_CHECK(std::ifstream(path.c_str()));
+	QT_CHECK(!std::ifstream(GetPendingPath(path).c_str()));
+	delete built;
+
+	// reopened file, the cached hierarchy is used in place
+	QT_CHECK(cache.Open(path));
+	btBvhTriangleMeshShape * cached = cache.CreateShape(mesh.mesh);
+	QT_CHECK_EQUAL(cache.GetHits(), 1u);
+	QT_CHECK_EQUAL(cache.GetMisses(), 0u);
+
+	btBvhTriangleMeshShape fresh(mesh.mesh, true);
+	QT_CHECK_EQUAL(BvhCacheTestRays(*cached, fresh, n), n * n);
+
+	// changed geometry
+	btBvhTriangleMeshShape * rebuilt = cache.CreateShape(changed.mesh);
+	QT_CHECK_EQUAL(cache.GetHits(), 1u);
+	QT_CHECK_EQUAL(cache.GetMisses(), 1u);
+	QT_CHECK(BvhCacheTestRays(*rebuilt, fresh, n) < n * n);
+	QT_CHECK(cache.Write(error));
+	delete rebuilt;
+	delete cached;
+
+	// file written while the previous one was mapped replaces it on open
+	QT_CHECK(std::rename(path.c_str(), GetPendingPath(path).c_str()) == 0);
+	QT_CHECK(cache.Open(path));
+	QT_CHECK(!std::ifstream(GetPendingPath(path).c_str()));
+	delete cache.CreateShape(changed.mesh);
+	QT_CHECK_EQUAL(cache.GetHits(), 1u);
+	cache.Close();
+
+	// changed version header
+	std::string data;
+	{
+		std::ifstream f(path.c_str(), std::ios::binary);
+		data.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+	}
+	QT_CHECK(data.size() > sizeof(BvhCacheHeader));
+	data[offsetof(BvhCacheHeader, version)]++;
+	std::ofstream(path.c_str(), std::ios::binary).write(data.data(), data.size());
+	QT_CHECK(!cache.Open(path));
+	delete cache.CreateShape(mesh.mesh);
+	QT_CHECK_EQUAL(cache.GetHits(), 0u);
+	QT_CHECK_EQUAL(cache.GetMisses(), 1u);
+	cache.Close();
+
+	QT_CHECK(error.str().empty());
+	std::remove(path.c_str());
+}
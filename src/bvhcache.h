@@ -0,0 +1,75 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _BVHCACHE_H
+#define _BVHCACHE_H
+
+#include "mappedfile.h"
+
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <utility>
+
+class btBvhTriangleMeshShape;
+class btOptimizedBvh;
+class btStridingMeshInterface;
+
+/// File cache of the bounding volume hierarchies of static triangle mesh shapes.
+/// Hierarchies are looked up by a hash of the mesh geometry and used in place
+/// from a copy on write mapping of the file, so cached meshes skip the build.
+/// Meshes with equal geometry share their hierarchy. The file stays mapped
+/// until Close, which must not be called before the shapes are deleted.
+class BvhCache
+{
+public:
+	BvhCache();
+
+	/// Map the cache file at path, an empty path disables caching. Returns
+	/// false if the file is missing or has been written by an incompatible build.
+	bool Open(const std::string & path);
+
+	/// Unmap the cache file and forget the hierarchies of the created shapes.
+	void Close();
+
+	/// Create a quantized triangle mesh shape, from the cache if possible.
+	btBvhTriangleMeshShape * CreateShape(btStridingMeshInterface * mesh);
+
+	/// Replace the cache file by the hierarchies of the shapes created since
+	/// Open, if any of them had to be built. The shapes have to be alive.
+	/// Where the mapped file can't be replaced, the new file replaces it
+	/// by the next Open instead.
+	bool Write(std::ostream & error);
+
+	/// number of created shapes with a cached or shared hierarchy
+	unsigned GetHits() const { return hits; }
+
+	/// number of created shapes with a newly built hierarchy
+	unsigned GetMisses() const { return misses; }
+
+private:
+	std::string path;
+	MappedFile file;
+	std::map<unsigned long long, std::pair<size_t, size_t> > cached; // offset and size in file
+	std::map<unsigned long long, btOptimizedBvh *> bvhs;
+	unsigned hits;
+	unsigned misses;
+};
+
+#endif // _BVHCACHE_H
@@ -652,6 +652,20 @@ const std::vector <float> & CarControlMap::ProcessInput(
 	return inputs;
 }
 
+std::vector<bool> CarControlMap::GetOneTimeInputs() const
+{
+	std::vector<bool> onetime(GameInput::INVALID, false);
+	for (size_t n = 0; n < controls.size(); ++n)
+	{
+		for (const auto & control : controls[n])
+		{
+			if (!control.analog && control.onetime)
+				onetime[n] = true;
+		}
+	}
+	return onetime;
+}
+
 void CarControlMap::GetControlsInfo(std::map<std::string, std::string> & info) const
 {
 	for (size_t n = 0; n < GameInput::INVALID; ++n)
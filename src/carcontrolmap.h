@@ -52,6 +52,9 @@ public:
 
 	float GetInput(GameInput::Enum inputid) const {assert((unsigned)inputid < inputs.size()); return inputs[inputid];}
 
+	/// flags inputs that are set for a single frame when a button is pressed or released
+	std::vector<bool> GetOneTimeInputs() const;
+
 	void GetControlsInfo(std::map<std::string, std::string> & info) const;
 
 	struct Control
@@ -407,6 +407,20 @@ void CarGraphics::Update(const CarDynamics & dynamics)
 	}
 }
 
+void CarGraphics::Update(const SimState::Body prev[], const SimState::Body cur[], unsigned count, float t)
+{
+	if (!bodynode.valid()) return;
+
+	unsigned i = 0;
+	for (auto & node : topnode.GetNodeList())
+	{
+		if (i == count) break;
+		node.GetTransform().SetTranslation(SimSnapshot::Interpolate(prev[i].position, cur[i].position, t));
+		node.GetTransform().SetRotation(SimSnapshot::Interpolate(prev[i].orientation, cur[i].orientation, t));
+		i++;
+	}
+}
+
 void CarGraphics::SetColor(float r, float g, float b)
 {
 	SceneNode & bodynoderef = topnode.GetNode(bodynode);
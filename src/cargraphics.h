@@ -23,6 +23,7 @@
 #include "graphics/scenenode.h"
 #include "mathvector.h"
 #include "quaternion.h"
+#include "simstate.h"
 
 #include <memory>
 #include <iosfwd>
@@ -65,6 +66,9 @@ public:
 	/// update graphics from car dynamics state
 	void Update(const CarDynamics & dynamics);
 
+	/// set body transforms interpolated between two simulation states by t
+	void Update(const SimState::Body prev[], const SimState::Body cur[], unsigned count, float t);
+
 	void SetColor(float r, float g, float b);
 
 	void EnableInteriorView(bool value);
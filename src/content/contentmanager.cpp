@@ -18,10 +18,15 @@
 /************************************************************************/
 
 #include "contentmanager.h"
+#include "graphics/model.h"
+#include "graphics/vertexarray.h"
+#include "unittest.h"
 
+#include <algorithm>
 #include <ostream>
 
 ContentManager::ContentManager(std::ostream & error) :
+	jobs(0),
 	error(error)
 {
 	// ctor
@@ -29,10 +34,37 @@ ContentManager::ContentManager(std::ostream & error) :
 
 ContentManager::~ContentManager()
 {
+	finish(true);
 	sweep();
 	_logleaks();
 }
 
+unsigned ContentManager::finish(bool wait)
+{
+	for (auto & request : requests)
+	{
+		if (wait)
+			jobs->Wait(request->decoded);
+
+		if (request->decoded.Done())
+			request->complete(*this);
+	}
+
+	requests.erase(
+		std::remove_if(requests.begin(), requests.end(),
+			[](const std::shared_ptr<Request> & request) { return request->completed; }),
+		requests.end());
+
+	return unsigned(requests.size());
+}
+
+void ContentManager::setJobSystem(JobSystem * value)
+{
+	finish(true);
+	jobs = value;
+	getFactory<Texture>().setJobSystem(value);
+}
+
 void ContentManager::addSharedPath(const std::string & path)
 {
 	sharedpaths.push_back(path);
@@ -85,3 +117,41 @@ void ContentManager::_logerror(
 	}
 	error << std::endl;
 }
+
+QT_TEST(contentmanager_async_test)
+{
+	std::ostringstream error;
+	JobSystem jobs;
+	jobs.Init(4);
+
+	ContentManager content(error);
+	content.addPath("");
+	content.setJobSystem(&jobs);
+
+	VertexArray va;
+	va.SetToUnitCube();
+
+	// concurrent requests share the load
+	auto a = content.loadAsync<Model>("test/", "cube", va);
+	auto b = content.loadAsync<Model>("test/", "cube", va);
+	QT_CHECK_EQUAL(content.finish(true), 0);
+	QT_CHECK(a.get() && a.get() == b.get());
+	QT_CHECK(a.get() != content.getFactory<Model>().getDefault());
+
+	// completed loads are cached
+	std::shared_ptr<Model> model;
+	QT_CHECK(content.get(model, "test/", "cube"));
+	QT_CHECK(model == a.get());
+	QT_CHECK(content.loadAsync<Model>("test/", "cube").get() == model);
+
+	// synchronous load completes the load in flight
+	auto c = content.loadAsync<Model>("test/", "cube2", va);
+	QT_CHECK(content.load(model, "test/", "cube2", va));
+	QT_CHECK(model == c.get());
+	QT_CHECK_EQUAL(content.finish(), 0);
+
+	content.setJobSystem(0);
+	model.reset();
+	a = b = c = std::shared_future<std::shared_ptr<Model> >();
+	content.sweep();
+}
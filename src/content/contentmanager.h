@@ -24,6 +24,11 @@
 #include "texturefactory.h"
 #include "modelfactory.h"
 #include "configfactory.h"
+#include "jobsystem.h"
+#include <functional>
+#include <future>
+#include <sstream>
+#include <type_traits>
 #include <vector>
 #include <map>
 
@@ -56,6 +61,31 @@ public:
 		const std::string & name,
 		const P & param);
 
+	/// Retrieve shared object, load asynchronously if not in cache.
+	/// Content is decoded by a job and completed by finish, textures are uploaded then.
+	/// Requests for content already in flight share its future, load waits for it.
+	/// Loads complete immediately without job system and for configs, which
+	/// load their includes through the content manager.
+	template <class T>
+	std::shared_future<std::shared_ptr<T> > loadAsync(
+		const std::string & path,
+		const std::string & name);
+
+	/// support additional optional parameters, copied if possible,
+	/// referenced otherwise (e.g. JoePack), to be kept valid until completion
+	template <class T, class P>
+	std::shared_future<std::shared_ptr<T> > loadAsync(
+		const std::string & path,
+		const std::string & name,
+		const P & param);
+
+	/// Complete decoded asynchronous loads, wait for all of them if requested.
+	/// Returns the number of loads still pending.
+	unsigned finish(bool wait = false);
+
+	/// set job system used by loadAsync, completes pending loads
+	void setJobSystem(JobSystem * value);
+
 	/// add shared content directory path
 	void addSharedPath(const std::string & path);
 
@@ -77,9 +107,59 @@ private:
 		virtual void sweep() = 0;
 	};
 
+	/// asynchronous load
+	struct Request
+	{
+		JobSystem::Counter decoded;
+		bool completed;
+		Request() : completed(false) {}
+		virtual ~Request() {}
+		virtual void complete(ContentManager & content) = 0;
+	};
+
+	template <class T>
+	struct RequestShared : Request
+	{
+		const std::string path;
+		const std::string name;
+		std::string key; ///< cache key of the decoded object
+		std::shared_ptr<T> sptr;
+		std::ostringstream error;
+		std::promise<std::shared_ptr<T> > promise;
+		std::shared_future<std::shared_ptr<T> > future;
+		bool loaded;
+
+		RequestShared(const std::string & path, const std::string & name) :
+			path(path), name(name), future(promise.get_future().share()), loaded(false) {}
+
+		void complete(ContentManager & content) override { content._complete(*this); }
+	};
+
+	template <class T, class P>
+	struct RequestParam : RequestShared<T>
+	{
+		typename std::conditional<std::is_copy_constructible<P>::value,
+			P, std::reference_wrapper<const P> >::type param;
+		const std::vector<std::string> basepaths;
+		const std::vector<std::string> sharedpaths;
+
+		RequestParam(const ContentManager & content,
+			const std::string & path, const std::string & name, const P & param) :
+			RequestShared<T>(path, name), param(param),
+			basepaths(content.basepaths), sharedpaths(content.sharedpaths) {}
+
+		/// called by a job, touches the request only
+		void decode(Factory<T> & factory);
+	};
+
 	template <class T>
 	class CacheShared : public Cache, public std::map<std::string, std::shared_ptr<T> >
 	{
+	public:
+		/// loads in flight by requested path + name
+		std::map<std::string, std::shared_ptr<RequestShared<T> > > pending;
+
+	private:
 		void log(std::ostream & log) const override;
 		size_t size() const override;
 		void sweep() override;
@@ -114,6 +194,10 @@ private:
 
 	} factory_cached;
 
+	/// asynchronous loads in flight
+	std::vector<std::shared_ptr<Request> > requests;
+	JobSystem * jobs;
+
 	/// content paths
 	std::vector<std::string> sharedpaths;
 	std::vector<std::string> basepaths;
@@ -147,6 +231,50 @@ private:
 	/// get default object instance
 	template <class T>
 	void _getdefault(std::shared_ptr<T> & sptr);
+
+	/// asynchronous load completion, main thread
+	template <class T>
+	void _complete(RequestShared<T> & request);
+
+	/// content that can be decoded by a job
+	template <class T>
+	static bool _async(const T *) { return true; }
+	static bool _async(const PTree *) { return false; }
+
+	/// decode without main thread work, create by default
+	template <class T, class P>
+	static bool _decode(
+		Factory<T> & factory,
+		std::shared_ptr<T> & sptr,
+		std::ostream & error,
+		const std::string & basepath,
+		const std::string & relpath,
+		const std::string & name,
+		const P & param)
+	{
+		return factory.create(sptr, error, basepath, relpath, name, param);
+	}
+
+	template <class P>
+	static bool _decode(
+		Factory<Texture> & factory,
+		std::shared_ptr<Texture> & sptr,
+		std::ostream & error,
+		const std::string & basepath,
+		const std::string & relpath,
+		const std::string & name,
+		const P & param)
+	{
+		return factory.decode(sptr, error, basepath, relpath, name, param);
+	}
+
+	/// main thread part of decoded content loading
+	template <class T>
+	static bool _upload(Factory<T> &, T &, std::ostream &) { return true; }
+	static bool _upload(Factory<Texture> & factory, Texture & texture, std::ostream & error)
+	{
+		return factory.upload(texture, error);
+	}
 };
 
 template <class T>
@@ -179,6 +307,18 @@ inline bool ContentManager::load(
 	const std::string & name,
 	const P & param)
 {
+	// complete the load in flight
+	CacheShared<T> & cache = factory_cached;
+	auto i = cache.pending.find(path + name);
+	if (i != cache.pending.end())
+	{
+		std::shared_ptr<RequestShared<T> > request = i->second;
+		jobs->Wait(request->decoded);
+		_complete(*request);
+		sptr = request->future.get();
+		return request->loaded;
+	}
+
 	// check for the specialised version in basepaths
 	if (_load(sptr, basepaths, path, name, param))
 		return true;
@@ -192,6 +332,49 @@ inline bool ContentManager::load(
 	return false;
 }
 
+template <class T>
+inline std::shared_future<std::shared_ptr<T> > ContentManager::loadAsync(
+	const std::string & path,
+	const std::string & name)
+{
+	return loadAsync<T>(path, name, typename Factory<T>::empty());
+}
+
+template <class T, class P>
+inline std::shared_future<std::shared_ptr<T> > ContentManager::loadAsync(
+	const std::string & path,
+	const std::string & name,
+	const P & param)
+{
+	// join the load in flight
+	CacheShared<T> & cache = factory_cached;
+	auto i = cache.pending.find(path + name);
+	if (i != cache.pending.end())
+		return i->second->future;
+
+	// cached content or synchronous load
+	std::shared_ptr<T> sptr;
+	if (get(sptr, path, name) ||
+		!jobs || jobs->GetThreadCount() < 2 ||
+		!_async(static_cast<const T *>(0)))
+	{
+		if (!sptr)
+			load(sptr, path, name, param);
+
+		std::promise<std::shared_ptr<T> > promise;
+		promise.set_value(sptr);
+		return promise.get_future().share();
+	}
+
+	std::shared_ptr<RequestParam<T, P> > request(new RequestParam<T, P>(*this, path, name, param));
+	cache.pending[path + name] = request;
+	requests.push_back(request);
+
+	Factory<T> & factory = factory_cached;
+	jobs->Submit([request, &factory] { request->decode(factory); }, request->decoded);
+	return request->future;
+}
+
 template <class T>
 inline bool ContentManager::_get(
 	std::shared_ptr<T> & sptr,
@@ -244,6 +427,62 @@ inline void ContentManager::_getdefault(std::shared_ptr<T> & sptr)
 	sptr = Factory<T>(factory_cached).getDefault();
 }
 
+template <class T>
+inline void ContentManager::_complete(RequestShared<T> & request)
+{
+	if (request.completed)
+		return;
+
+	request.completed = true;
+	CacheShared<T> & cache = factory_cached;
+	cache.pending.erase(request.path + request.name);
+
+	const std::string decode_error = request.error.str();
+	if (!decode_error.empty())
+		error << decode_error;
+
+	Factory<T> & factory = factory_cached;
+	request.loaded = request.sptr && _upload(factory, *request.sptr, error);
+	if (request.loaded)
+	{
+		// keep content cached in the meantime
+		request.sptr = cache.emplace(request.key, request.sptr).first->second;
+	}
+	else
+	{
+		_getdefault(request.sptr);
+		_logerror(request.path, request.name);
+	}
+	request.promise.set_value(request.sptr);
+	request.sptr.reset();
+}
+
+template <class T, class P>
+inline void ContentManager::RequestParam<T, P>::decode(Factory<T> & factory)
+{
+	const P & p = param;
+
+	// check for the specialised version in basepaths
+	for (const auto & basepath : basepaths)
+	{
+		if (_decode(factory, this->sptr, this->error, basepath, this->path, this->name, p))
+		{
+			this->key = this->path + this->name;
+			return;
+		}
+	}
+
+	// fall back to the generic one in shared paths
+	for (const auto & sharedpath : sharedpaths)
+	{
+		if (_decode(factory, this->sptr, this->error, sharedpath, "", this->name, p))
+		{
+			this->key = this->name;
+			return;
+		}
+	}
+}
+
 template <class T>
 inline void ContentManager::CacheShared<T>::log(std::ostream & log) const
 {
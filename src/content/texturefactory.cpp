@@ -25,9 +25,11 @@
 Factory<Texture>::Factory() :
 	m_default(new Texture()),
 	m_zero(new Texture()),
+	m_jobs(0),
 	m_size(TextureInfo::LARGE),
 	m_compress(true),
-	m_srgb(false)
+	m_srgb(false),
+	m_headless(false)
 {
 	// ctor
 }
@@ -38,6 +40,8 @@ void Factory<Texture>::init(int max_size, bool use_srgb, bool compress)
 	m_srgb = use_srgb;
 	m_compress = compress;
 
+	Texture::InitDecoders();
+
 	// init default texture
 	std::ostringstream error;
 	unsigned char one[] = {255u, 255u, 255u, 255u};
@@ -58,8 +62,18 @@ void Factory<Texture>::init(int max_size, bool use_srgb, bool compress)
 	m_zero->Load("", info, error);
 }
 
+void Factory<Texture>::initCache(const std::string & path)
+{
+	m_cache.SetPath(path);
+}
+
+void Factory<Texture>::initHeadless()
+{
+	m_headless = true;
+}
+
 template <>
-bool Factory<Texture>::create(
+bool Factory<Texture>::decode(
 	std::shared_ptr<Texture> & sptr,
 	std::ostream & error,
 	const std::string & basepath,
@@ -67,6 +81,12 @@ bool Factory<Texture>::create(
 	const std::string & name,
 	const TextureInfo& info)
 {
+	if (m_headless)
+	{
+		sptr = m_default;
+		return true;
+	}
+
 	const std::string abspath = basepath + "/" + path + "/" + name;
 	if (info.data || std::ifstream(abspath.c_str()))
 	{
@@ -75,15 +95,56 @@ bool Factory<Texture>::create(
 		info_temp.compress = info.compress && m_compress;	// allow to disable compression
 		info_temp.maxsize = TextureInfo::Size(m_size);
 		std::shared_ptr<Texture> temp(new Texture());
-		if (temp->Load(abspath, info_temp, error))
+
+		// load converted image from the cache, convert it on a miss
+		const std::string cachepath = m_cache.GetFile(abspath, info_temp);
+		if (!cachepath.empty() && std::ifstream(cachepath.c_str()) &&
+			temp->Decode(cachepath, info_temp, error))
 		{
 			sptr = temp;
 			return true;
 		}
+
+		if (temp->Decode(abspath, info_temp, error))
+		{
+			if (!cachepath.empty())
+				temp->WriteCache(cachepath, error);
+
+			sptr = temp;
+			return true;
+		}
+	}
+	return false;
+}
+
+template <>
+bool Factory<Texture>::create(
+	std::shared_ptr<Texture> & sptr,
+	std::ostream & error,
+	const std::string & basepath,
+	const std::string & path,
+	const std::string & name,
+	const TextureInfo& info)
+{
+	std::shared_ptr<Texture> temp;
+	if (decode(temp, error, basepath, path, name, info) && upload(*temp, error))
+	{
+		sptr = temp;
+		return true;
 	}
 	return false;
 }
 
+bool Factory<Texture>::upload(Texture & texture, std::ostream & error)
+{
+	return texture.Upload(error, m_jobs);
+}
+
+void Factory<Texture>::setJobSystem(JobSystem * value)
+{
+	m_jobs = value;
+}
+
 const std::shared_ptr<Texture> & Factory<Texture>::getDefault() const
 {
 	return m_default;
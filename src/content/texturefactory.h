@@ -22,8 +22,10 @@
 
 #include "contentfactory.h"
 #include "graphics/textureinfo.h"
+#include "graphics/texturecache.h"
 
 class Texture;
+class JobSystem;
 
 template <>
 class Factory<Texture>
@@ -38,6 +40,13 @@ public:
 	/// limit texture size to max size
 	void init(int max_size, bool use_srgb, bool compress);
 
+	/// convert image files into dds files cached in path, disabled if path is empty
+	void initCache(const std::string & path);
+
+	/// headless mode: no gpu textures are created, all requests resolve to the default texture
+	void initHeadless();
+
+	/// decode and upload
 	template <class P>
 	bool create(
 		std::shared_ptr<Texture> & sptr,
@@ -47,6 +56,23 @@ public:
 		const std::string & name,
 		const P & param);
 
+	/// Decode texture without uploading it, can be called from a worker thread.
+	/// Raw param data has to stay valid until the texture has been uploaded.
+	template <class P>
+	bool decode(
+		std::shared_ptr<Texture> & sptr,
+		std::ostream & error,
+		const std::string & basepath,
+		const std::string & path,
+		const std::string & name,
+		const P & param);
+
+	/// upload decoded texture, main thread only
+	bool upload(Texture & texture, std::ostream & error);
+
+	/// job system used by the upload to decode compressed textures without driver support
+	void setJobSystem(JobSystem * value);
+
 	/// default texture is white: rgba (1, 1, 1, 1)
 	const std::shared_ptr<Texture> & getDefault() const;
 
@@ -56,9 +82,12 @@ public:
 private:
 	std::shared_ptr<Texture> m_default;
 	std::shared_ptr<Texture> m_zero;
+	TextureCache m_cache;
+	JobSystem * m_jobs;
 	int m_size;
 	bool m_compress;
 	bool m_srgb;
+	bool m_headless;
 };
 
 #endif // _TEXTUREFACTORY_H
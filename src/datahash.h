@@ -0,0 +1,47 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _DATAHASH_H
+#define _DATAHASH_H
+
+#include <cstddef>
+#include <cstring>
+
+/// 64 bit FNV-1a variant over 8 byte words, sensitive to any change of the data.
+/// Used to detect modified sources of cached files, not for hash tables.
+/// Hashes of consecutive blocks can be chained by passing the previous hash.
+inline unsigned long long DataHash(const void * data, size_t size, unsigned long long h = 0xcbf29ce484222325ULL)
+{
+	const unsigned long long prime = 0x100000001b3ULL;
+	const char * bytes = (const char *)data;
+	h ^= size;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		unsigned long long word;
+		std::memcpy(&word, bytes + i, 8);
+		h = (h ^ word) * prime;
+		h ^= h >> 29;
+	}
+	for (; i < size; ++i)
+		h = (h ^ (unsigned char)bytes[i]) * prime;
+	return h;
+}
+
+#endif // _DATAHASH_H
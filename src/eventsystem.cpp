@@ -33,9 +33,7 @@ using std::list;
 using std::endl;
 
 EventSystem::EventSystem() :
-	lasttick(0),
 	dt(0),
-	desired_dt(0),
 	quit(false),
 	mousex(0),
 	mousey(0),
@@ -51,11 +49,11 @@ EventSystem::~EventSystem()
 	// dtor
 }
 
-void EventSystem::Init(std::ostream & info_output, double desired_fps)
+void EventSystem::Init(std::ostream & info_output, double max_fps)
 {
-	assert(desired_fps > 0.0);
-	desired_dt = 1.0 / desired_fps;
-	dt = desired_dt;
+	assert(max_fps >= 0.0);
+	pacer.SetTargetPeriod(max_fps > 0.0 ? 1.0 / max_fps : 0.0);
+	dt = pacer.GetTargetPeriod();
 
 	const int num_joysticks = SDL_NumJoysticks();
 
@@ -87,29 +85,12 @@ void EventSystem::Init(std::ostream & info_output, double desired_fps)
 
 void EventSystem::BeginFrame()
 {
-	if (lasttick == 0)
-		lasttick = SDL_GetTicks();
-	else
-	{
-		const double delay = (desired_dt > dt) ? (desired_dt - dt) : 0.0;
-		SDL_Delay(static_cast<unsigned int>(delay * 1000.0));
-
-		double thistick = SDL_GetTicks();
-
-		dt = (thistick-lasttick)*1E-3;
-
-		/*if (throttle && dt < game.TickPeriod())
-		{
-			//cout << "throttling: " << lasttick.data << "," << thistick << endl;
-			SDL_Delay(10);
-			thistick = SDL_GetTicks();
-			dt = (thistick-lasttick)*1E-3;
-		}*/
-
-		lasttick = thistick;
-	}
+	const double frame_time = pacer.BeginFrame();
+	if (frame_time > 0.0)
+		dt = frame_time;
 
-	RecordFPS(1/dt);
+	if (dt > 0.0)
+		RecordFPS(1/dt);
 }
 
 template <class Joystick>
@@ -354,7 +335,7 @@ void EventSystem::RecordFPS(const float fps)
 
 float EventSystem::GetFPS() const
 {
-	float avg = std::accumulate(fps_memory.begin(), fps_memory.end(), 0);
+	float avg = std::accumulate(fps_memory.begin(), fps_memory.end(), 0.0f);
 
 	if (!fps_memory.empty())
 		avg = avg / fps_memory.size();
@@ -20,6 +20,7 @@
 #ifndef _EVENTSYSTEM_H
 #define _EVENTSYSTEM_H
 
+#include "framepacer.h"
 #include "toggle.h"
 
 #include <SDL2/SDL.h>
@@ -108,7 +109,8 @@ public:
 
 	~EventSystem();
 
-	void Init(std::ostream & info_output, double desired_fps);
+	/// Frames are paced to max_fps, 0 disables pacing.
+	void Init(std::ostream & info_output, double max_fps);
 
 	void BeginFrame();
 
@@ -136,6 +138,11 @@ public:
 
 	float GetFPS() const;
 
+	/// Frame pacing and frame time histogram.
+	FramePacer & GetFramePacer() {return pacer;}
+
+	const FramePacer & GetFramePacer() const {return pacer;}
+
 	enum StimEnum
 	{
 		STIM_AGE_KEYS,
@@ -191,9 +198,8 @@ public:
 	}
 
 private:
-	double lasttick;
+	FramePacer pacer;
 	double dt;
-    double desired_dt;
 	bool quit;
 
 	std::vector <Joystick> joysticks;
@@ -61,15 +61,17 @@ T Atan1(T x)
     return p;
 }
 
+// selects instead of branching, lets the compiler vectorize loops calling it
 template <typename T>
 T Atan(T x)
 {
     // |x| < 1
-    if (x * x < 1)
-        return Atan1(x);
+    bool small = x * x < 1;
+    T r = 1 / x;
+    T p = Atan1(small ? x : r);
 
     // |x| > 1
-    return std::copysign(T(M_PI_2), x) - Atan1(1 / x);
+    return small ? p : std::copysign(T(M_PI_2), x) - p;
 }
 
 // |x| <= pi/2
@@ -0,0 +1,225 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "framepacer.h"
+#include "unittest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <thread>
+
+const unsigned FrameTimeHistogram::bin_count;
+constexpr double FrameTimeHistogram::bin_width;
+
+FrameTimeHistogram::FrameTimeHistogram(unsigned window)
+{
+	Reset(window);
+}
+
+void FrameTimeHistogram::Reset(unsigned new_window)
+{
+	bins.assign(bin_count + 1, 0);
+	times.clear();
+	times.reserve(new_window);
+	window = new_window;
+	next = 0;
+	count = 0;
+	sum = 0;
+	max = 0;
+}
+
+void FrameTimeHistogram::Add(double time)
+{
+	if (window > 0)
+	{
+		if (times.size() < window)
+		{
+			times.push_back(time);
+		}
+		else
+		{
+			// drop the oldest frame
+			bins[GetBin(times[next])]--;
+			sum -= times[next];
+			count--;
+			times[next] = time;
+		}
+		next = (next + 1) % window;
+	}
+	bins[GetBin(time)]++;
+	sum += time;
+	count++;
+	max = std::max(max, time);
+}
+
+unsigned FrameTimeHistogram::GetCount() const
+{
+	return count;
+}
+
+double FrameTimeHistogram::GetPercentile(double p) const
+{
+	if (count == 0)
+		return 0;
+
+	const unsigned rank = std::max(unsigned(std::ceil(p * count)), 1u);
+	unsigned n = 0;
+	for (unsigned i = 0; i < bin_count; ++i)
+	{
+		n += bins[i];
+		if (n >= rank)
+			return std::min((i + 1) * bin_width, GetMax());
+	}
+	return GetMax();
+}
+
+double FrameTimeHistogram::GetMean() const
+{
+	return count ? sum / count : 0;
+}
+
+double FrameTimeHistogram::GetMax() const
+{
+	if (window == 0)
+		return max;
+	return times.empty() ? 0 : *std::max_element(times.begin(), times.end());
+}
+
+void FrameTimeHistogram::Print(std::ostream & out) const
+{
+	// keep the format flags of out
+	std::ostringstream s;
+	s << std::fixed << std::setprecision(1);
+	s << "p50 " << GetPercentile(0.5) * 1E3;
+	s << " p95 " << GetPercentile(0.95) * 1E3;
+	s << " p99 " << GetPercentile(0.99) * 1E3;
+	s << " max " << GetMax() * 1E3 << " ms";
+	out << s.str();
+}
+
+unsigned FrameTimeHistogram::GetBin(double time)
+{
+	const double bin = time / bin_width;
+	return (bin > 0) ? unsigned(std::min(bin, double(bin_count))) : 0;
+}
+
+FramePacer::FramePacer() :
+	period(Clock::duration::zero()),
+	spin_margin(std::chrono::milliseconds(2)),
+	started(false)
+{
+	// ctor
+}
+
+void FramePacer::SetTargetPeriod(double value)
+{
+	period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(std::max(value, 0.0)));
+}
+
+double FramePacer::GetTargetPeriod() const
+{
+	return std::chrono::duration<double>(period).count();
+}
+
+double FramePacer::BeginFrame()
+{
+	if (!started)
+	{
+		started = true;
+		last = Clock::now();
+		return 0;
+	}
+
+	if (period > Clock::duration::zero())
+		WaitUntil(last + period);
+
+	const Clock::time_point now = Clock::now();
+	const double time = std::chrono::duration<double>(now - last).count();
+	last = now;
+	histogram.Add(time);
+	return time;
+}
+
+void FramePacer::WaitUntil(Clock::time_point deadline)
+{
+	const Clock::time_point wake = deadline - spin_margin;
+	if (Clock::now() < wake)
+	{
+		std::this_thread::sleep_until(wake);
+
+		// grow the margin to cover the oversleep at once, shrink it slowly
+		const Clock::duration oversleep = Clock::now() - wake;
+		const Clock::duration target = oversleep + std::chrono::microseconds(500);
+		if (target > spin_margin)
+			spin_margin = std::min(target, period / 2);
+		else
+			spin_margin -= (spin_margin - target) / 16;
+	}
+
+	while (Clock::now() < deadline)
+		std::this_thread::yield();
+}
+
+QT_TEST(framepacer_test)
+{
+	FrameTimeHistogram empty;
+	QT_CHECK_EQUAL(empty.GetCount(), 0u);
+	QT_CHECK_EQUAL(empty.GetPercentile(0.5), 0);
+	QT_CHECK_EQUAL(empty.GetMax(), 0);
+
+	// frame times 1 to 100 ms, the first 50 fall out of the window,
+	// percentiles are the upper edge of a 0.1 ms bin
+	FrameTimeHistogram histogram(50);
+	for (int i = 1; i <= 100; ++i)
+		histogram.Add(i * 1E-3);
+	QT_CHECK_EQUAL(histogram.GetCount(), 50u);
+	QT_CHECK_CLOSE(histogram.GetPercentile(0.0), 0.051, 2E-4);
+	QT_CHECK_CLOSE(histogram.GetPercentile(0.5), 0.075, 2E-4);
+	QT_CHECK_CLOSE(histogram.GetPercentile(0.99), 0.1, 2E-4);
+	QT_CHECK_CLOSE(histogram.GetMean(), 0.0755, 1E-6);
+	QT_CHECK_CLOSE(histogram.GetMax(), 0.1, 1E-6);
+
+	// frame times beyond the last bin
+	histogram.Add(0.25);
+	QT_CHECK_CLOSE(histogram.GetPercentile(1.0), 0.25, 1E-6);
+	QT_CHECK_CLOSE(histogram.GetMax(), 0.25, 1E-6);
+
+	// unbounded window
+	histogram.Reset(0);
+	for (int i = 0; i < 1000; ++i)
+		histogram.Add((i % 2) ? 0.02013 : 0.01005);
+	QT_CHECK_EQUAL(histogram.GetCount(), 1000u);
+	QT_CHECK_CLOSE(histogram.GetPercentile(0.5), 0.0101, 1E-6);
+	QT_CHECK_CLOSE(histogram.GetPercentile(0.51), 0.02013, 1E-6);
+
+	std::ostringstream out;
+	histogram.Print(out);
+	QT_CHECK_EQUAL(out.str(), "p50 10.1 p95 20.1 p99 20.1 max 20.1 ms");
+
+	// paced frames take at least the target period
+	FramePacer pacer;
+	pacer.SetTargetPeriod(0.005);
+	QT_CHECK_EQUAL(pacer.BeginFrame(), 0);
+	for (int i = 0; i < 4; ++i)
+		QT_CHECK(pacer.BeginFrame() >= 0.005);
+	QT_CHECK_EQUAL(pacer.GetHistogram().GetCount(), 4u);
+}
@@ -0,0 +1,105 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _FRAMEPACER_H
+#define _FRAMEPACER_H
+
+#include <chrono>
+#include <iosfwd>
+#include <vector>
+
+/// Frame times of the last window frames sorted into fixed width bins.
+/// Adding a frame is constant time, percentiles are resolved to the bin
+/// width, frame times beyond the last bin are reported as the max.
+class FrameTimeHistogram
+{
+public:
+	static const unsigned bin_count = 1000;
+	static constexpr double bin_width = 1E-4; ///< seconds
+
+	/// Keep the last window frames, 0 keeps all frames.
+	FrameTimeHistogram(unsigned window = 600);
+
+	/// Drop all frames and set the window.
+	void Reset(unsigned window);
+
+	/// Add frame time in seconds.
+	void Add(double time);
+
+	/// Number of frames in the window.
+	unsigned GetCount() const;
+
+	/// Frame time below which the fraction p of the frames lie, nearest rank.
+	double GetPercentile(double p) const;
+
+	double GetMean() const;
+
+	double GetMax() const;
+
+	/// Write p50, p95, p99 and max in milliseconds.
+	void Print(std::ostream & out) const;
+
+private:
+	std::vector<unsigned> bins; ///< bin_count bins and the overflow bin
+	std::vector<double> times; ///< frame times of the window, ring buffer
+	unsigned window;
+	unsigned next;
+	unsigned count;
+	double sum;
+	double max; ///< max of all frames, valid if window is 0
+
+	static unsigned GetBin(double time);
+};
+
+/// Paces frames to a target period with steady_clock. Sleeps until shortly
+/// before the frame is due, then spins the rest of the way, the spin margin
+/// adapts to the observed oversleep of the system scheduler. Records the
+/// time between frames in a histogram.
+class FramePacer
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	FramePacer();
+
+	/// Target frame period in seconds, 0 disables pacing.
+	void SetTargetPeriod(double value);
+
+	double GetTargetPeriod() const;
+
+	/// Wait until the target period has passed since the previous frame began.
+	/// Returns the time since the previous frame began in seconds, 0 for the first frame.
+	double BeginFrame();
+
+	FrameTimeHistogram & GetHistogram() { return histogram; }
+
+	const FrameTimeHistogram & GetHistogram() const { return histogram; }
+
+private:
+	Clock::duration period;
+	Clock::duration spin_margin;
+	Clock::time_point last;
+	bool started;
+	FrameTimeHistogram histogram;
+
+	/// sleep until the deadline minus the spin margin, spin until the deadline
+	void WaitUntil(Clock::time_point deadline);
+};
+
+#endif // _FRAMEPACER_H
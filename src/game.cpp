@@ -19,13 +19,14 @@
 
 #include "game.h"
 #include "unittest.h"
+#include "microbench.h"
 #include "definitions.h"
 #include "matrix4.h"
 #include "physics/carwheelposition.h"
 #include "physics/tracksurface.h"
 #include "numprocessors.h"
 #include "performance_testing.h"
-#include "quickprof.h"
+#include "profiler.h"
 #include "utils.h"
 #include "graphics/graphics_gl2.h"
 #include "graphics/graphics_gl3v.h"
@@ -47,6 +48,7 @@
 #include <sstream>
 #include <algorithm>
 #include <cstdio>
+#include <chrono>
 
 #ifdef _WIN32
 	#define OS_NAME "Windows"
@@ -100,13 +102,25 @@ Game::Game(std::ostream & info_out, std::ostream & error_out) :
 	trackupdater(autoupdate, info_out, error_out),
 	fps_track(10, 0),
 	fps_position(0),
-	fps_min(0),
-	fps_max(0),
+	maxfps(60),
 	multithreaded(false),
+	simthread(false),
 	profilingmode(false),
 	benchmode(false),
+	replayseek(0),
+	headless(false),
+	headless_time(0),
+	headless_cars(1),
 	dumpfps(false),
 	pause(true),
+	render_alpha(1),
+	sim_ticks(0),
+	sim_pending(0),
+	sim_sync_time(0),
+	mouse_click(false),
+	player_speed(0),
+	race_over(false),
+	hud_inputs(CarInput::INVALID, 0.0f),
 	controlgrab_id(0),
 	controlgrab(false),
 	garage_camera("garagecam"),
@@ -138,7 +152,8 @@ Game::Game(std::ostream & info_out, std::ostream & error_out) :
 
 Game::~Game()
 {
-	// dtor
+	// complete pending content loads while the job system is alive
+	content.setJobSystem(0);
 }
 
 /* Start the game with the given arguments... */
@@ -151,6 +166,29 @@ void Game::Start(std::list <std::string> & args)
 
 	info_output << "Starting VDrift: " << VERSION << ", Revision: " << REVISION << ", O/S: " << OS_NAME << std::endl;
 
+	InitThreading();
+
+	if (headless)
+	{
+		if (!InitHeadless())
+		{
+			return;
+		}
+
+		int num_laps = std::max(settings.GetNumberOfLaps(), 1);
+		if (!NewBenchmarkGame(true, num_laps))
+		{
+			error_output << "Error loading headless simulation" << std::endl;
+			return;
+		}
+
+		RunHeadless();
+
+		End();
+
+		return;
+	}
+
 	if (!InitCoreSubsystems())
 	{
 		return;
@@ -232,10 +270,13 @@ void Game::Start(std::list <std::string> & args)
 
 	if (benchmode)
 	{
+		// the player car and the opponents are driven by the ai
 		assert(!car_info.empty());
 		car_info[player_car_id].driver = Ai::default_type;
+		const CarInfo info = car_info[player_car_id];
+		car_info.resize(headless_cars, info);
 
-		if (!NewGame(false, false, 1))
+		if (!NewBenchmarkGame(headless_cars > 1, 1))
 		{
 			error_output << "Error loading benchmark" << std::endl;
 			return;
@@ -256,26 +297,76 @@ void Game::Start(std::list <std::string> & args)
 /* Do any necessary cleanup... */
 void Game::End()
 {
+	// finish the running batch of simulation ticks
+	sim_thread.Deinit();
+
 	if (benchmode)
 	{
-		float mean_fps = displayframe / clocktime;
-		info_output << "Elapsed time: " << clocktime << " seconds\n";
-		info_output << "Average frame-rate: " << mean_fps << " frames per second\n";
-		info_output << "Min / Max frame-rate: " << fps_min << " / " << fps_max << " frames per second" << std::endl;
+		const double walltime = benchmark.GetWallTime();
+		if (!headless)
+			info_output << "Simulated time: " << clocktime << " seconds\n";
+		info_output << "Benchmark frames: " << benchmark.GetFrames() << " in " << walltime << " seconds\n";
+		if (walltime > 0)
+			info_output << "Average frame-rate: " << benchmark.GetFrames() / walltime << " frames per second\n";
+		if (!headless)
+		{
+			info_output << "Frame time ";
+			eventsystem.GetFramePacer().GetHistogram().Print(info_output);
+			info_output << "\n";
+		}
+		info_output.flush();
+
+		if (benchout.empty())
+		{
+			benchmark.WriteJson(info_output);
+		}
+		else
+		{
+			std::ofstream out(benchout.c_str());
+			if (benchmark.WriteJson(out))
+				info_output << "Benchmark results written to " << benchout << std::endl;
+			else
+				error_output << "Failed to write benchmark results to " << benchout << std::endl;
+		}
+	}
+
+	if (headless)
+	{
+		for (int i = 0; i < car_dynamics.size(); ++i)
+		{
+			info_output << "Car " << i << " " << car_info[i].name << ": lap " << timer.GetCurrentLap(i);
+			info_output << ", best lap " << GetTimeString(timer.GetBestLap(i)) << "\n";
+		}
+		info_output.flush();
 	}
 
 	if (profilingmode)
-		info_output << "Profiling summary:\n" << PROFILER.getSummary(quickprof::PERCENT) << std::endl;
+		info_output << "Profiling summary:\n" << Profiler::GetSummary() << std::endl;
+
+	if (!profiletrace.empty())
+	{
+		std::ofstream trace(profiletrace.c_str());
+		if (Profiler::WriteTrace(trace))
+			info_output << "Profiling trace written to " << profiletrace << " (" << Profiler::GetTraceEvents() << " zones)" << std::endl;
+		else
+			error_output << "Failed to write profiling trace to " << profiletrace << std::endl;
+	}
 
 	info_output << "Shutting down..." << std::endl;
 
 	LeaveGame();
 
 	// Save settings first incase later deinits cause crashes.
-	settings.Save(pathmanager.GetSettingsFile(), error_output);
+	// Command line runs don't keep their track and replay overrides.
+	if (!headless && !benchmode)
+		settings.Save(pathmanager.GetSettingsFile(), error_output);
 
-	graphics->Deinit();
-	delete graphics;
+	if (graphics)
+	{
+		graphics->Deinit();
+		delete graphics;
+		graphics = NULL;
+	}
 }
 
 /* Initialize the most important, basic subsystems... */
@@ -388,11 +479,17 @@ bool Game::InitCoreSubsystems()
 		return false;
 	}
 
+	// scene culling, the job system is only running if multithreaded
+	if (multithreaded)
+		graphics->SetJobSystem(&jobs);
+
 	//graphics->SetLocalTime(settings.GetSkyTime());
 	//graphics->SetLocalTimeSpeed(settings.GetSkyTimeSpeed());
 
 	// Init content factories
 	content.getFactory<Texture>().init(texture_size, using_gl3, settings.GetTextureCompress());
+	if (settings.GetTextureCache())
+		content.getFactory<Texture>().initCache(pathmanager.GetTextureCachePath());
 	content.getFactory<PTree>().init(read_ini, write_ini, content);
 
 	// Init content paths
@@ -402,11 +499,120 @@ bool Game::InitCoreSubsystems()
 	content.addSharedPath(pathmanager.GetCarPartsPath());
 	content.addSharedPath(pathmanager.GetTrackPartsPath());
 
-	eventsystem.Init(info_output, 30);
+	// benchmarks run as fast as possible
+	eventsystem.Init(info_output, benchmode ? 0 : maxfps);
+
+	return true;
+}
+
+bool Game::InitHeadless()
+{
+	pathmanager.Init(info_output, error_output);
+
+	settings.Load(pathmanager.GetSettingsFile(), error_output);
+
+	// No window, renderer or sound device, textures resolve to a placeholder.
+	sound.Disable();
+	content.getFactory<Texture>().initHeadless();
+	content.getFactory<PTree>().init(read_ini, write_ini, content);
+
+	content.addPath(pathmanager.GetWriteableDataPath());
+	content.addPath(pathmanager.GetDataPath());
+	content.addSharedPath(pathmanager.GetCarPartsPath());
+	content.addSharedPath(pathmanager.GetTrackPartsPath());
+
+	// All cars are driven by the ai.
+	InitPlayerCar();
+	car_info[player_car_id].driver = Ai::default_type;
+	const CarInfo info = car_info[player_car_id];
+	car_info.resize(headless_cars, info);
+
+	info_output << "Headless simulation: " << settings.GetTrack() << ", " << car_info.size() << " cars" << std::endl;
 
 	return true;
 }
 
+void Game::RunHeadless()
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	while (!eventsystem.GetQuit() && !race_over && (headless_time <= 0 || clocktime < headless_time))
+	{
+		frame++;
+
+		AdvanceGameLogic();
+
+		clocktime += timestep;
+
+		Profiler::EndFrame();
+
+		if (benchmode)
+			benchmark.AddFrame();
+	}
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	const double walltime = elapsed.count();
+	info_output << "Simulated time: " << clocktime << " seconds\n";
+	info_output << "Wall clock time: " << walltime << " seconds\n";
+	if (walltime > 0)
+		info_output << "Simulation speed: " << clocktime / walltime << " x real time\n";
+	info_output.flush();
+}
+
+bool Game::NewBenchmarkGame(bool addopponents, int num_laps)
+{
+	if (!benchtrack.empty())
+		settings.SetTrack(benchtrack);
+
+	if (!benchreplay.empty())
+		settings.SetSelectedReplay(benchreplay);
+
+	if (!NewGame(!benchreplay.empty(), addopponents, num_laps))
+		return false;
+
+	if (benchmode)
+	{
+		const std::vector<BenchmarkStats::Zone> zones = {
+			{"physics", "physics"},
+			{"ai", "ai"},
+			{"cars", "car"},
+			{"scene", "scenegraph"},
+			{"cull", "cull"},
+			{"draw", "render draw"},
+			{"sound", "sound"}};
+
+		// the first frames include loading and shader compilation
+		benchmark.Init(zones, 10);
+		benchmark.SetInfo("version", VERSION);
+		benchmark.SetInfo("mode", headless ? "headless" : "render");
+		benchmark.SetInfo("track", replay.GetPlaying() ? replay.GetTrack() : settings.GetTrack());
+		benchmark.SetInfo("replay", benchreplay);
+		benchmark.SetInfo("cars", car_dynamics.size());
+		benchmark.SetInfo("simtime", headless_time);
+		benchmark.SetInfo("timestep", timestep);
+		benchmark.SetInfo("threads", jobs.GetThreadCount());
+	}
+
+	return true;
+}
+
+void Game::InitThreading()
+{
+	if (!multithreaded)
+		return;
+
+	jobs.Init(NUMPROCESSORS::GetNumProcessors());
+
+	// car updates are scheduled to give the same results as a serial update
+	dynamics.setJobSystem(&jobs);
+
+	// content decoding, textures are uploaded by the main thread
+	content.setJobSystem(&jobs);
+
+	if (simthread)
+		sim_thread.Init("simulation");
+}
+
 void Game::InitPlayerCar()
 {
 	Vec3 hsv;
@@ -542,6 +748,13 @@ bool Game::ParseArguments(std::list <std::string> & args)
 	}
 	arghelp["-test"] = "Run unit tests.";
 
+	if (argmap.find("-microbench") != argmap.end())
+	{
+		MB_RUN_BENCHMARKS(info_output);
+		continue_game = false;
+	}
+	arghelp["-microbench"] = "Run micro benchmarks.";
+
 	if (!argmap["-cartest"].empty())
 	{
 		pathmanager.Init(info_output, error_output);
@@ -566,9 +779,16 @@ bool Game::ParseArguments(std::list <std::string> & args)
 	}
 	arghelp["-profile NAME"] = "Store settings, controls, and records under a separate profile.";
 
-	if (argmap.find("-profiling") != argmap.end() || argmap.find("-benchmark") != argmap.end())
+	if (!argmap["-profiletrace"].empty())
+	{
+		profiletrace = argmap["-profiletrace"];
+	}
+	arghelp["-profiletrace FILE"] = "Profile and write a Chrome trace (chrome://tracing) of the profiled zones to FILE on exit.";
+
+	if (argmap.find("-profiling") != argmap.end() || argmap.find("-benchmark") != argmap.end() || !profiletrace.empty())
 	{
-		PROFILER.init(20);
+		Profiler::Enable(true, profiletrace.empty() ? 0 : max_trace_zones);
+		Profiler::SetThreadName("main");
 		profilingmode = true;
 	}
 	arghelp["-profiling"] = "Display game performance data.";
@@ -622,6 +842,14 @@ bool Game::ParseArguments(std::list <std::string> & args)
 			info_output << "Multi-processor system detected.  Run with -multithreaded argument to enable multithreading (EXPERIMENTAL)." << std::endl;
 	}
 	arghelp["-multithreaded"] = "Use multithreading where possible.";
+
+	if (argmap.find("-simthread") != argmap.end())
+	{
+		info_output << "Simulating in parallel with rendering." << std::endl;
+		multithreaded = true;
+		simthread = true;
+	}
+	arghelp["-simthread"] = "Run the simulation on its own thread, decoupled from the frame rate, implies -multithreaded (EXPERIMENTAL).";
 	#endif
 
 	if (argmap.find("-nosound") != argmap.end())
@@ -633,7 +861,60 @@ bool Game::ParseArguments(std::list <std::string> & args)
 		info_output << "Entering benchmark mode." << std::endl;
 		benchmode = true;
 	}
-	arghelp["-benchmark"] = "Run in benchmark mode.";
+	arghelp["-benchmark"] = "Run a benchmark race with fixed time steps, one per frame, and report frame and subsystem times.";
+
+	if (argmap.find("-headless") != argmap.end())
+	{
+		info_output << "Entering headless mode." << std::endl;
+		headless = true;
+	}
+	arghelp["-headless"] = "Run the simulation without display, sound or user input.";
+
+	if (!argmap["-simtime"].empty())
+	{
+		headless_time = cast<float>(argmap["-simtime"]);
+	}
+	else if (benchmode)
+	{
+		headless_time = 60;
+	}
+	arghelp["-simtime SECONDS"] = "Stop the headless simulation or benchmark after the given simulated time, benchmarks default to 60 seconds.";
+
+	if (!argmap["-cars"].empty())
+	{
+		headless_cars = std::max(cast<int>(argmap["-cars"]), 1);
+	}
+	arghelp["-cars NUM"] = "Number of ai cars in the headless simulation or benchmark.";
+
+	if (!argmap["-track"].empty())
+	{
+		benchtrack = argmap["-track"];
+	}
+	arghelp["-track NAME"] = "Track of the headless simulation or benchmark.";
+
+	if (!argmap["-benchreplay"].empty())
+	{
+		benchreplay = argmap["-benchreplay"];
+	}
+	arghelp["-benchreplay FILE"] = "Play the given replay from the replay folder instead of racing ai cars in the headless simulation or benchmark.";
+
+	if (!argmap["-benchout"].empty())
+	{
+		benchout = argmap["-benchout"];
+	}
+	arghelp["-benchout FILE"] = "Write benchmark results as JSON to FILE instead of the log.";
+
+	if (!argmap["-replayseek"].empty())
+	{
+		replayseek = cast<float>(argmap["-replayseek"]);
+	}
+	arghelp["-replayseek SECONDS"] = "Start replays at the given replay time.";
+
+	if (!argmap["-maxfps"].empty())
+	{
+		maxfps = std::max(cast<float>(argmap["-maxfps"]), 0.0f);
+	}
+	arghelp["-maxfps FPS"] = "Limit the frame rate, 0 disables the limit, defaults to 60.";
 
 	arghelp["-render FILE"] = "Load the specified render configuration file instead of the default gl3/deferred.conf.";
 	if (!argmap["-render"].empty())
@@ -691,86 +972,114 @@ void Game::Test()
 	info_output << std::endl;
 }
 
-void Game::Draw(float dt)
+void Game::SetupDraw(float dt)
 {
-	PROFILER.beginBlock("scenegraph");
+	// Interpolate between the last two states of the latest snapshot.
+	while (sim_snapshots.swap_front()) {}
+	const SimSnapshot & snapshot = sim_snapshots.front();
+	if (snapshot.Interpolatable() && snapshot.cur.cars.size() == car_graphics.size())
+	{
+		for (unsigned i = 0; i < snapshot.cur.cars.size(); ++i)
+		{
+			const unsigned first = snapshot.cur.cars[i];
+			car_graphics[i].Update(
+				&snapshot.prev.bodies[first], &snapshot.cur.bodies[first],
+				snapshot.cur.GetBodyCount(i), render_alpha);
+		}
+	}
 
-	std::vector<SceneNode*> nodes;
-	nodes.reserve(6);
+	// The camera is simulation state, only its snapshot is used here.
+	const SimState & state = snapshot.cur;
+	Vec3 campos = state.camera_position;
+	Quat camrot = state.camera_orientation;
+	if (state.camera && snapshot.prev.camera == state.camera)
+	{
+		campos = SimSnapshot::Interpolate(snapshot.prev.camera_position, state.camera_position, render_alpha);
+		camrot = SimSnapshot::Interpolate(snapshot.prev.camera_orientation, state.camera_orientation, render_alpha);
+	}
 
-	nodes.push_back(&dynamicsdraw.getNode());
-	nodes.push_back(&trackmap.GetNode());
-	nodes.push_back(&skid_marks.GetNode());
-	nodes.push_back(&tire_smoke.GetNode());
+	{
+		PROFILE_ZONE("scenegraph");
 
-	if (gui.GetNodes().first)
-		nodes.push_back(gui.GetNodes().first);
+		std::vector<SceneNode*> nodes;
+		nodes.reserve(6);
 
-	if (gui.GetNodes().second)
-		nodes.push_back(gui.GetNodes().second);
+		nodes.push_back(&dynamicsdraw.getNode());
+		nodes.push_back(&trackmap.GetNode());
+		nodes.push_back(&skid_marks.GetNode());
+		nodes.push_back(&tire_smoke.GetNode());
 
-	graphics->BindDynamicVertexData(nodes);
+		if (gui.GetNodes().first)
+			nodes.push_back(gui.GetNodes().first);
 
-	graphics->ClearDynamicDrawables();
-	graphics->AddDynamicNode(dynamicsdraw.getNode());
-	graphics->AddDynamicNode(track.GetBodyNode());
-	graphics->AddDynamicNode(track.GetRacinglineNode());
-	graphics->AddDynamicNode(trackmap.GetNode());
-	graphics->AddDynamicNode(skid_marks.GetNode());
-	graphics->AddDynamicNode(tire_smoke.GetNode());
+		if (gui.GetNodes().second)
+			nodes.push_back(gui.GetNodes().second);
 
-	for (auto & car : car_graphics)
-		graphics->AddDynamicNode(car.GetNode());
+		graphics->BindDynamicVertexData(nodes);
 
-	if (gui.GetNodes().first)
-		graphics->AddDynamicNode(*gui.GetNodes().first);
+		graphics->ClearDynamicDrawables();
+		graphics->AddDynamicNode(dynamicsdraw.getNode());
+		graphics->AddDynamicNode(track.GetBodyNode());
+		graphics->AddDynamicNode(track.GetRacinglineNode());
+		graphics->AddDynamicNode(trackmap.GetNode());
+		graphics->AddDynamicNode(skid_marks.GetNode());
+		graphics->AddDynamicNode(tire_smoke.GetNode());
 
-	if (gui.GetNodes().second)
-		graphics->AddDynamicNode(*gui.GetNodes().second);
+		for (auto & car : car_graphics)
+			graphics->AddDynamicNode(car.GetNode());
 
-	PROFILER.endBlock("scenegraph");
+		if (gui.GetNodes().first)
+			graphics->AddDynamicNode(*gui.GetNodes().first);
+
+		if (gui.GetNodes().second)
+			graphics->AddDynamicNode(*gui.GetNodes().second);
+	}
 
 	// Send scene information to the graphics subsystem.
-	PROFILER.beginBlock("render setup");
-	graphics->SetContrast(settings.GetContrast());
-	graphics->SetSunDirection(track.GetSunDirection());
-	if (active_camera)
 	{
-		float fov = active_camera->GetFOV() > 0 ? active_camera->GetFOV() : settings.GetFOV();
+		PROFILE_ZONE("render setup");
+		graphics->SetContrast(settings.GetContrast());
+		graphics->SetSunDirection(track.GetSunDirection());
+		if (state.camera)
+		{
+			float fov = state.camera_fov > 0 ? state.camera_fov : settings.GetFOV();
 
-		Vec3 reflection_location = active_camera->GetPosition();
-		if (camera_car_id < unsigned(car_dynamics.size()))
-			reflection_location = ToMathVector<float>(car_dynamics[camera_car_id].GetCenterOfMass());
+			Vec3 reflection_location = state.reflection_location;
 
-		Quat camlook;
-		camlook.Rotate(M_PI_2, 1, 0, 0);
-		Quat cam_orientation = -(active_camera->GetOrientation() * camlook);
+			Quat camlook;
+			camlook.Rotate(M_PI_2, 1, 0, 0);
+			Quat cam_orientation = -(camrot * camlook);
 
-		graphics->SetupScene(
-			fov, settings.GetViewDistance(),
-			active_camera->GetPosition(),
-			cam_orientation,
-			reflection_location,
-			error_output);
-	}
-	else
-	{
-		graphics->SetupScene(
-			settings.GetFOV(), settings.GetViewDistance(),
-			Vec3(), Quat(), Vec3(),
-			error_output);
+			graphics->SetupScene(
+				fov, settings.GetViewDistance(),
+				campos,
+				cam_orientation,
+				reflection_location,
+				error_output);
+		}
+		else
+		{
+			graphics->SetupScene(
+				settings.GetFOV(), settings.GetViewDistance(),
+				Vec3(), Quat(), Vec3(),
+				error_output);
+		}
+		graphics->UpdateScene(dt);
 	}
-	graphics->UpdateScene(dt);
-	PROFILER.endBlock("render setup");
+}
 
+void Game::Draw()
+{
 	// Sync CPU and GPU (flip the page).
-	PROFILER.beginBlock("render sync");
-	window.SwapBuffers();
-	PROFILER.endBlock("render sync");
+	{
+		PROFILE_ZONE("render sync");
+		window.SwapBuffers();
+	}
 
-	PROFILER.beginBlock("render draw");
-	graphics->DrawScene(error_output);
-	PROFILER.endBlock("render draw");
+	{
+		PROFILE_ZONE("render draw");
+		graphics->DrawScene(error_output);
+	}
 }
 
 void Game::Run()
@@ -783,24 +1092,74 @@ void Game::Advance()
 {
 	CalculateFPS();
 
-	clocktime += eventsystem.Get_dt();
+	// benchmarks step the simulation once per frame, independent of the frame rate
+	const float dt = benchmode ? timestep : eventsystem.Get_dt();
 
-	eventsystem.BeginFrame();
+	clocktime += dt;
 
-	// Do CPU intensive stuff in parallel with the GPU...
-	Tick(eventsystem.Get_dt());
+	eventsystem.BeginFrame();
 
-	Draw(eventsystem.Get_dt());
+	if (simthread)
+	{
+		// The simulation thread runs batches of ticks. The main thread does
+		// not wait for a batch, it draws the latest published snapshot and
+		// touches simulation state only between batches. Ticks scheduled
+		// while a batch runs make up the next batch.
+		const unsigned ticks = ScheduleTicks(dt, sim_pending);
+		sim_pending += ticks;
+		sim_sync_time += eventsystem.Get_dt();
+		render_alpha = GetTickAlpha();
+		ProcessInput(ticks * timestep);
+		if (sim_thread.Done())
+		{
+			EndTicks(sim_ticks, sim_sync_time);
+			DispatchInputs();
+			sim_ticks = sim_pending;
+			sim_pending = 0;
+			sim_sync_time = 0;
+			if (sim_ticks > 0)
+			{
+				const unsigned batch = sim_ticks;
+				sim_thread.Run([this, batch] { AdvanceTicks(batch); });
+			}
+		}
+		SetupDraw(eventsystem.Get_dt());
+		Draw();
+	}
+	else
+	{
+		// Do CPU intensive stuff in parallel with the GPU...
+		const unsigned ticks = ScheduleTicks(dt);
+		render_alpha = GetTickAlpha();
+		ProcessInput(ticks * timestep);
+		DispatchInputs();
+		AdvanceTicks(ticks);
+		EndTicks(ticks, eventsystem.Get_dt());
+		SetupDraw(eventsystem.Get_dt());
+		Draw();
+	}
 
 	eventsystem.EndFrame();
 
-	PROFILER.endCycle();
+	Profiler::EndFrame();
+
+	if (benchmode)
+	{
+		benchmark.AddFrame();
+
+		// frame time histogram of the whole run after the warmup frames
+		if (benchmark.GetFrames() == 0)
+			eventsystem.GetFramePacer().GetHistogram().Reset(0);
+
+		if (headless_time > 0 && clocktime >= headless_time)
+			eventsystem.Quit();
+	}
 
 	displayframe++;
 }
 
 /* Deltat is in seconds... */
-void Game::Tick(float deltat)
+unsigned Game::ScheduleTicks(float deltat, unsigned pending)
 {
 	// This is the minimum fps the game will run at before it starts slowing down time.
 	const float minfps = 10;
@@ -810,20 +1169,150 @@ void Game::Tick(float deltat)
 	const float maxtime = 1 / minfps;
 	unsigned int curticks = 0;
 
-	// Throw away wall clock time if necessary to keep the framerate above the minimum.
-	if (deltat > maxtime)
-		deltat = maxtime;
-
-	target_time += deltat;
-
-	// Increment game logic by however many tick periods have passed since the last GAME::Tick...
-	while (target_time - timestep * frame > timestep && curticks < maxticks)
+	if (benchmode)
 	{
+		// Lockstep, one tick per frame.
 		frame++;
 
+		curticks++;
+	}
+	else
+	{
+		// Throw away wall clock time if necessary to keep the framerate above the minimum.
+		if (deltat > maxtime)
+			deltat = maxtime;
+
+		target_time += deltat;
+
+		// Increment game logic by however many tick periods have passed since the last GAME::Tick...
+		while (target_time - timestep * frame > timestep && curticks + pending < maxticks)
+		{
+			frame++;
+
+			curticks++;
+		}
+
+		// Throw away time the simulation can't catch up with.
+		if (curticks + pending >= maxticks)
+			target_time = std::min(target_time, double(timestep) * (frame + 1));
+	}
+
+	return curticks;
+}
+
+float Game::GetTickAlpha() const
+{
+	if (benchmode)
+		return 1;
+
+	// the simulation is a tick ahead of the rendered time
+	return Clamp(float((target_time - timestep * frame) / timestep), 0.0f, 1.0f);
+}
+
+void Game::AdvanceTicks(unsigned ticks)
+{
+	for (unsigned i = 0; i < ticks; ++i)
+	{
 		AdvanceGameLogic();
 
-		curticks++;
+		// one-shot inputs act on a single tick
+		tick_inputs.Consume();
+
+		std::swap(sim_snapshot.prev, sim_snapshot.cur);
+		CaptureSimState(sim_snapshot.cur);
+	}
+
+	if (ticks > 0)
+	{
+		sim_snapshots.back() = sim_snapshot;
+		sim_snapshots.swap_back();
+	}
+}
+
+void Game::PublishSimState()
+{
+	CaptureSimState(sim_snapshot.cur);
+	sim_snapshot.prev = sim_snapshot.cur;
+	sim_snapshots.back() = sim_snapshot;
+	sim_snapshots.swap_back();
+}
+
+void Game::CaptureSimState(SimState & state) const
+{
+	state.bodies.clear();
+	state.cars.clear();
+	for (int i = 0; i < car_dynamics.size(); ++i)
+	{
+		const CarDynamics & car = car_dynamics[i];
+		state.cars.push_back(state.bodies.size());
+		for (unsigned j = 0; j < car.GetNumBodies(); ++j)
+		{
+			SimState::Body body;
+			body.position = ToMathVector<float>(car.GetPosition(j));
+			body.orientation = ToQuaternion<float>(car.GetOrientation(j));
+			state.bodies.push_back(body);
+		}
+	}
+
+	state.camera = active_camera;
+	if (active_camera)
+	{
+		state.camera_position = active_camera->GetPosition();
+		state.camera_orientation = active_camera->GetOrientation();
+		state.camera_fov = active_camera->GetFOV();
+		state.reflection_location = state.camera_position;
+		if (camera_car_id < unsigned(car_dynamics.size()))
+			state.reflection_location = ToMathVector<float>(car_dynamics[camera_car_id].GetCenterOfMass());
+	}
+}
+
+void Game::EndTicks(unsigned curticks, float dt)
+{
+	player_speed = 0;
+	if (!pause)
+	{
+		PROFILE_ZONE("car-graphics");
+
+		player_speed = car_dynamics[player_car_id].GetSpeed();
+
+		ai.Visualize();
+
+		for (int i = 0; i < car_dynamics.size(); ++i)
+			car_graphics[i].Update(car_dynamics[i]);
+
+		UpdateCameraView();
+
+		// Update dynamic track objects.
+		track.Update();
+
+		if (camera_car_id < unsigned(car_dynamics.size()) && settings.GetHUD() != "NoHud")
+			UpdateHUD(camera_car_id, hud_inputs);
+
+		{
+			PROFILE_ZONE("trackmap-update");
+			UpdateTrackMap();
+		}
+	}
+
+	if (sound.Enabled())
+	{
+		PROFILE_ZONE("sound");
+		Vec3 pos;
+		Quat rot;
+		if (active_camera)
+		{
+			pos = active_camera->GetPosition();
+			rot = active_camera->GetOrientation();
+		}
+		sound.SetListenerPosition(pos[0], pos[1], pos[2]);
+		sound.SetListenerRotation(rot[0], rot[1], rot[2], rot[3]);
+		sound.Update(pause);
+	}
+
+	if (forcefeedback && curticks > 0)
+	{
+		PROFILE_ZONE("force-feedback");
+		UpdateForceFeedback(curticks * timestep);
 	}
 
 	// Debug draw dynamics
@@ -838,102 +1327,94 @@ void Game::Tick(float deltat)
 		info_output << "Current FPS: " << eventsystem.GetFPS() << std::endl;
 	}
 
+	if (benchmode && race_over)
+		eventsystem.Quit();
+
 	UpdateParticleGraphics();
 
-	gui.Update(eventsystem.Get_dt());
+	gui.Update(dt);
 }
 
-/* Increment game logic by one frame... */
-void Game::AdvanceGameLogic()
+void Game::ProcessInput(float dt)
 {
-	//PROFILER.beginBlock("input-processing");
-
+	PROFILE_ZONE("input-processing");
 	eventsystem.ProcessEvents();
 
-	float car_speed = !pause ? car_dynamics[player_car_id].GetSpeed() : 0;
 	car_controls_local.ProcessInput(
 			settings.GetJoyType(),
 			eventsystem,
-			timestep,
+			dt,
 			settings.GetJoy200(),
-			car_speed,
+			player_speed,
 			settings.GetSpeedSensitivity(),
 			window.GetW(),
 			window.GetH(),
 			settings.GetButtonRamp(),
 			settings.GetHGateShifter());
 
+	// keep one-shot inputs of frames without ticks or hand over
+	frame_inputs.Sample(car_controls_local.GetInputs(), car_controls_local.GetOneTimeInputs());
+	mouse_click = mouse_click || eventsystem.GetMouseButtonState(1).GetImpulseFalling();
+}
+
+void Game::DispatchInputs()
+{
 	ProcessGUIInputs();
 
 	ProcessGameInputs();
 
-	//PROFILER.endBlock("input-processing");
+	tick_inputs.Take(frame_inputs);
+	mouse_click = false;
+}
+
+/* Increment game logic by one frame... */
+void Game::AdvanceGameLogic()
+{
+	if (pause)
+		return;
 
-	if (!pause)
 	{
-		PROFILER.beginBlock("ai");
-		ai.Visualize();
+		PROFILE_ZONE("ai");
 		ai.Update(timestep, &car_dynamics[0], car_dynamics.size());
-		PROFILER.endBlock("ai");
+	}
 
-		// Autopilot script
-        autopilot.Update(timestep, car_dynamics[player_car_id]);
+	// Autopilot script
+	autopilot.Update(timestep, car_dynamics[player_car_id]);
 
-		//PROFILER.beginBlock("input");
+	{
+		PROFILE_ZONE("input");
 		ProcessCarInputs();
-		//PROFILER.endBlock("input");
+	}
 
-		PROFILER.beginBlock("physics");
+	{
+		PROFILE_ZONE("physics");
 		dynamics.update(timestep);
-		PROFILER.endBlock("physics");
+	}
 
-		PROFILER.beginBlock("car");
-		ProcessCameraInputs();
+	{
+		PROFILE_ZONE("car");
+		if (!headless)
+			ProcessCameraInputs();
 		UpdateCars(timestep);
-		PROFILER.endBlock("car");
-
-		// Update dynamic track objects.
-		track.Update();
+	}
 
-		//PROFILER.beginBlock("timer");
+	{
+		PROFILE_ZONE("timer");
 		UpdateTimer();
-		//PROFILER.endBlock("timer");
-
-		//PROFILER.beginBlock("particles");
-		UpdateParticles(timestep);
-		//PROFILER.endBlock("particles");
-
-		//PROFILER.beginBlock("trackmap-update");
-		UpdateTrackMap();
-		//PROFILER.endBlock("trackmap-update");
 	}
 
-	if (sound.Enabled())
+	if (!headless)
 	{
-		PROFILER.beginBlock("sound");
-		Vec3 pos;
-		Quat rot;
-		if (active_camera)
-		{
-			pos = active_camera->GetPosition();
-			rot = active_camera->GetOrientation();
-		}
-		sound.SetListenerPosition(pos[0], pos[1], pos[2]);
-		sound.SetListenerRotation(rot[0], rot[1], rot[2], rot[3]);
-		sound.Update(pause);
-		PROFILER.endBlock("sound");
+		PROFILE_ZONE("particles");
+		UpdateParticles(timestep);
 	}
-
-	//PROFILER.beginBlock("force-feedback");
-	UpdateForceFeedback(timestep);
-	//PROFILER.endBlock("force-feedback");
 }
 
 /* Process inputs used only for higher level game functions... */
 void Game::ProcessGameInputs()
 {
 	// Most game inputs are allowed whether or not there's a car in the game.
-	if (car_controls_local.GetInput(GameInput::SCREENSHOT) == 1)
+	if (frame_inputs.GetInput(GameInput::SCREENSHOT) == 1)
 	{
 		// Determine filename.
 		std::string shotfile;
@@ -959,7 +1440,7 @@ void Game::ProcessGameInputs()
 			error_output << "Couldn't find a file to which to save the captured screenshot" << std::endl;
 	}
 
-	if (car_controls_local.GetInput(GameInput::RELOAD_SHADERS) == 1)
+	if (frame_inputs.GetInput(GameInput::RELOAD_SHADERS) == 1)
 	{
 		info_output << "Reloading shaders" << std::endl;
 		if (!graphics->ReloadShaders(info_output, error_output))
@@ -968,7 +1449,7 @@ void Game::ProcessGameInputs()
 		}
 	}
 
-	if (car_controls_local.GetInput(GameInput::RELOAD_GUI) == 1)
+	if (frame_inputs.GetInput(GameInput::RELOAD_GUI) == 1)
 	{
 		info_output << "Reloading GUI" << std::endl;
 
@@ -983,6 +1464,18 @@ void Game::ProcessGameInputs()
 
 		gui.ActivatePage(currentPage, 0.5, error_output);
 	}
+
+	// Engage autopilot
+	static bool button_pressed = false;
+	if (button_pressed != eventsystem.GetKeyState(SDLK_F10).GetState())
+	{
+		button_pressed = !button_pressed;
+		if (button_pressed)
+		{
+			autopilot.Engage(!autopilot.IsEngaged());
+			info_output << std::string("Autopilot ") + (autopilot.IsEngaged() ? "on" : "off") << std::endl;
+		}
+	}
 }
 
 void Game::UpdateTimer()
@@ -1073,13 +1566,13 @@ void Game::ProcessGUIInputs()
 		eventsystem.GetMousePosition()[0] / (float)window.GetW(),
 		eventsystem.GetMousePosition()[1] / (float)window.GetH(),
 		eventsystem.GetMouseButtonState(1).GetState(),
-		eventsystem.GetMouseButtonState(1).GetImpulseFalling(),
-		car_controls_local.GetInput(GameInput::GUI_LEFT),
-		car_controls_local.GetInput(GameInput::GUI_RIGHT),
-		car_controls_local.GetInput(GameInput::GUI_UP),
-		car_controls_local.GetInput(GameInput::GUI_DOWN),
-		car_controls_local.GetInput(GameInput::GUI_SELECT),
-		car_controls_local.GetInput(GameInput::GUI_CANCEL));
+		mouse_click,
+		frame_inputs.GetInput(GameInput::GUI_LEFT),
+		frame_inputs.GetInput(GameInput::GUI_RIGHT),
+		frame_inputs.GetInput(GameInput::GUI_UP),
+		frame_inputs.GetInput(GameInput::GUI_DOWN),
+		frame_inputs.GetInput(GameInput::GUI_SELECT),
+		frame_inputs.GetInput(GameInput::GUI_CANCEL));
 
 	if (controlgrab && AssignControl())
 	{
@@ -1290,11 +1783,13 @@ void Game::UpdateCars(float dt)
 {
 	for (int i = 0; i < car_dynamics.size(); ++i)
 	{
-		car_graphics[i].Update(car_dynamics[i]);
 		car_sounds[i].Update(car_dynamics[i], dt);
 		UpdateDriftScore(i, dt);
 	}
 
+	if (headless)
+		return;
+
 	if (settings.GetParticles())
 		for (int i = 0; i < car_dynamics.size(); ++i)
 			AddTireSmokeParticles(car_dynamics[i], dt);
@@ -1331,18 +1826,6 @@ void Game::ProcessCarInputs()
 	}
 	#endif
 
-	// Engage autopilot
-    static bool button_pressed = false;
-    if (button_pressed != eventsystem.GetKeyState(SDLK_F10).GetState())
-    {
-        button_pressed = !button_pressed;
-        if (button_pressed)
-        {
-            autopilot.Engage(!autopilot.IsEngaged());
-            info_output << std::string("Autopilot ") + (autopilot.IsEngaged() ? "on" : "off") << std::endl;
-        }
-    }
-
 	for (unsigned carid = 0, aiid = 0; carid < unsigned(car_dynamics.size()); ++carid)
 	{
 		CarDynamics & car = car_dynamics[carid];
@@ -1356,7 +1839,7 @@ void Game::ProcessCarInputs()
             if (autopilot.IsEngaged())
                 carinputs = autopilot.GetInputs();
             else
-                carinputs = car_controls_local.GetInputs();
+                carinputs = tick_inputs.GetInputs();
         }
 		else
 			carinputs = ai.GetInputs(aiid++);
@@ -1375,8 +1858,7 @@ void Game::ProcessCarInputs()
 			carinputs[CarInput::CLUTCH] = 1.0;
 			carinputs[CarInput::THROTTLE] = 0.0;
 
-			if (benchmode)
-				eventsystem.Quit();
+			race_over = true;
 		}
 
 		car.Update(carinputs);
@@ -1386,14 +1868,14 @@ void Game::ProcessCarInputs()
 		if (replay.GetRecording())
 			replay.RecordFrame(carid, carinputs, car);
 
-		if (carid == camera_car_id && settings.GetHUD() != "NoHud")
-			UpdateHUD(carid, carinputs);
+		if (carid == camera_car_id)
+			hud_inputs = carinputs;
 	}
 }
 
 void Game::ProcessCameraInputs()
 {
-	CarControlMap & carcontrol = car_controls_local;
+	const TickInputs & carcontrol = tick_inputs;
 
 	// Handle camera focus
 	unsigned car_count = car_dynamics.size();
@@ -1404,7 +1886,6 @@ void Game::ProcessCameraInputs()
 
 	CarDynamics & car = car_dynamics[camera_car_id];
 	CarGraphics & car_gfx = car_graphics[camera_car_id];
-	CarSound & car_snd = car_sounds[camera_car_id];
 
 	// Handle camera mode change inputs.
 	unsigned camera_id = settings.GetCamera();
@@ -1456,11 +1937,18 @@ void Game::ProcessCameraInputs()
 	Vec3 zoom(Direction::Forward * 4 * dy);
 	active_camera->Rotate(up, left);
 	active_camera->Move(zoom[0], zoom[1], zoom[2]);
+}
+
+void Game::UpdateCameraView()
+{
+	if (camera_car_id >= car_graphics.size())
+		return;
 
 	// Hide glass if we're inside the car, adjust sounds.
+	const unsigned camera_id = settings.GetCamera();
 	bool incar = (camera_id == 0 || camera_id == 1);
-	car_gfx.EnableInteriorView(incar);
-	car_snd.EnableInteriorSound(incar);
+	car_graphics[camera_car_id].EnableInteriorView(incar);
+	car_sounds[camera_car_id].EnableInteriorSound(incar);
 
 	// Move up the close shadow distance if we're in the cockpit.
 	graphics->SetCloseShadow(incar ? 1.0 : 5.0);
@@ -1491,13 +1979,18 @@ void Game::UpdateHUD(const size_t carid, const std::vector<float> & carinputs)
 			signals[DEBUG2](debug_info[2].str());
 			signals[DEBUG3](debug_info[3].str());
 		}
-		else if (frame % 10 == 0)
+		else if (displayframe % 10 == 0)
 		{
 			std::ostringstream gpu_profile;
 			graphics->printProfilingInfo(gpu_profile);
 
-			signals[DEBUG0](PROFILER.getAvgSummary(quickprof::MICROSECONDS));
+			std::ostringstream frame_profile;
+			frame_profile << "frame time ";
+			eventsystem.GetFramePacer().GetHistogram().Print(frame_profile);
+
+			signals[DEBUG0](Profiler::GetAvgSummary());
 			signals[DEBUG1](gpu_profile.str());
+			signals[DEBUG2](frame_profile.str());
 		}
 	}
 
@@ -1615,6 +2108,7 @@ bool Game::NewGame(bool playreplay, bool addopponents, int num_laps)
 
 	// Cache number of laps for gui.
 	race_laps = num_laps;
+	race_over = false;
 
 	// Start out with no camera.
 	camera_car_id = player_car_id;
@@ -1673,15 +2167,18 @@ bool Game::NewGame(bool playreplay, bool addopponents, int num_laps)
 		car_info[player_car_id].driver.empty() ? player_car_id : car_info.size());
 
 	// Bind vertex data.
-	std::vector<SceneNode *> nodes;
-	nodes.push_back(&track.GetRacinglineNode());
-	nodes.push_back(&track.GetTrackNode());
-	nodes.push_back(&track.GetBodyNode());
-	for (auto & car : car_graphics)
+	if (!headless)
 	{
-		nodes.push_back(&car.GetNode());
+		std::vector<SceneNode *> nodes;
+		nodes.push_back(&track.GetRacinglineNode());
+		nodes.push_back(&track.GetTrackNode());
+		nodes.push_back(&track.GetBodyNode());
+		for (auto & car : car_graphics)
+		{
+			nodes.push_back(&car.GetNode());
+		}
+		graphics->BindStaticVertexData(nodes);
 	}
-	graphics->BindStaticVertexData(nodes);
 
 	// Record a replay.
 	if (settings.GetRecordReplay() && !playreplay)
@@ -1709,7 +2206,8 @@ bool Game::NewGame(bool playreplay, bool addopponents, int num_laps)
 			}
 		}
 
-		replay.StartRecording(car_info, settings.GetTrack(), error_output);
+		const std::string tempfilename = pathmanager.GetReplayPath() + "/recording.tmp";
+		replay.StartRecording(car_info, settings.GetTrack(), tempfilename, error_output);
 	}
 
 	if (settings.GetRecordReplay() || playreplay)
@@ -1722,11 +2220,17 @@ bool Game::NewGame(bool playreplay, bool addopponents, int num_laps)
 	// Clean up asset cache.
 	content.sweep();
 
+	if (playreplay && replayseek > 0 && !SeekReplay(replayseek))
+		error_output << "Replay is shorter than " << replayseek << " seconds." << std::endl;
+
 	skid_marks.Reset(cars_num * 4, settings.GetSkidMarks());
 
+	PublishSimState();
+
 	// Set up GUI.
 	gui.SetInGame(true);
-	gui.ActivatePage(settings.GetHUD(), 0.25, error_output);
+	if (!headless)
+		gui.ActivatePage(settings.GetHUD(), 0.25, error_output);
 
 	// not strictly needed, is expected to be called by Hud page onfocus event
 	ContinueGame();
@@ -1734,6 +2238,23 @@ bool Game::NewGame(bool playreplay, bool addopponents, int num_laps)
 	return true;
 }
 
+bool Game::SeekReplay(float time)
+{
+	const unsigned frame = unsigned(time / timestep);
+	unsigned keyframe;
+	if (!replay.Seek(frame, keyframe))
+		return false;
+
+	// restore the keyframe car states and simulate the frames up to the requested one
+	for (unsigned i = keyframe; i <= frame && replay.GetPlaying(); ++i)
+	{
+		ProcessCarInputs();
+		dynamics.update(timestep);
+		UpdateCars(timestep);
+	}
+	return true;
+}
+
 std::string Game::GetReplayRecordingFilename()
 {
 	// Get time.
@@ -1781,7 +2302,7 @@ bool Game::LoadCar(
 
 	car_graphics.push_back(CarGraphics());
 	CarGraphics & car_gfx = car_graphics.back();
-	if (!car_gfx.Load(
+	if (!headless && !car_gfx.Load(
 		*carconf, cardir, info.wheel, info.paint, color,
 		settings.GetAnisotropy(), settings.GetCameraBounce(),
 		content, error_output))
@@ -1838,6 +2359,13 @@ bool Game::LoadCar(
 		car.SetTCS(settings.GetTCS());
 	}
 
+	if (settings.GetTireLUT() && car.InitTireLUT(error_output))
+	{
+		const CarTireSet & tires = car.GetTires();
+		info_output << "Tire force lookup tables: " << tires.GetForceLUTSize() / 1024 << " KB, error force "
+			<< tires.GetForceLUTError() * 100 << "% torque " << tires.GetTorqueLUTError() * 100 << "%" << std::endl;
+	}
+
 	info_output << "Car loading was successful: " << info.name << std::endl;
 
 	return true;
@@ -1845,7 +2373,11 @@ bool Game::LoadCar(
 
 bool Game::LoadTrack(const std::string & trackname)
 {
-	gui.ActivatePage("Loading", 0.5, error_output);
+	if (!headless)
+		gui.ActivatePage("Loading", 0.5, error_output);
+
+	const std::string cachepath = pathmanager.GetTrackCachePath(trackname);
+	PathManager::MakeDir(cachepath);
 
 	if (!track.DeferredLoad(
 		content, dynamics,
@@ -1854,10 +2386,11 @@ bool Game::LoadTrack(const std::string & trackname)
 		pathmanager.GetTracksDir()+"/"+trackname,
 		pathmanager.GetEffectsTextureDir(),
 		pathmanager.GetTrackPartsPath(),
+		cachepath,
 		settings.GetAnisotropy(),
 		settings.GetTrackReverse(),
 		settings.GetTrackDynamic(),
-		graphics->GetShadows()))
+		!headless && graphics->GetShadows()))
 	{
 		error_output << "Error loading track: " << trackname << std::endl;
 		return false;
@@ -1869,7 +2402,7 @@ bool Game::LoadTrack(const std::string & trackname)
 	int displayevery = count_max / 50;
 	while (!track.Loaded() && success)
 	{
-		if (displayevery == 0 || count % displayevery == 0)
+		if (!headless && (displayevery == 0 || count % displayevery == 0))
 			ShowLoadingScreen(count, count_max, "");
 
 		success = track.ContinueDeferredLoad();
@@ -1882,6 +2415,10 @@ bool Game::LoadTrack(const std::string & trackname)
 		return false;
 	}
 
+	// Nothing to draw in headless mode.
+	if (headless)
+		return true;
+
 	// Set racing line visibility.
 	track.SetRacingLineVisibility(settings.GetRacingline());
 
@@ -1929,6 +2466,9 @@ void Game::LoadGarage()
 
 	bool track_reverse = false;
 	bool track_dynamic = false;
+	const std::string cachepath = pathmanager.GetTrackCachePath(settings.GetMenuRoom());
+	PathManager::MakeDir(cachepath);
+
 	if (!track.DeferredLoad(
 		content, dynamics,
 		info_output, error_output,
@@ -1936,6 +2476,7 @@ void Game::LoadGarage()
 		pathmanager.GetTracksDir()+"/"+settings.GetMenuRoom(),
 		pathmanager.GetEffectsTextureDir(),
 		pathmanager.GetTrackPartsPath(),
+		cachepath,
 		settings.GetAnisotropy(),
 		track_reverse, track_dynamic,
 		graphics->GetShadows()))
@@ -2006,6 +2547,8 @@ void Game::SetGarageCar()
 	garage_camera.Reset(car_pos, cam_rot);
 	active_camera = &garage_camera;
 
+	PublishSimState();
+
 	UpdateCarSpecs();
 }
 
@@ -2050,21 +2593,6 @@ void Game::CalculateFPS()
 	}
 	fps_avg *= 0.1f;
 
-	// Don't start looking an min/max until we've put out a few frames.
-	if (fps_min == 0 && frame > 20)
-	{
-		fps_max = fps_avg;
-		fps_min = fps_avg;
-	}
-	else if (fps_avg > fps_max)
-	{
-		fps_max = fps_avg;
-	}
-	else if (fps_avg < fps_min)
-	{
-		fps_min = fps_avg;
-	}
-
 	if (settings.GetShowFps())
 	{
 		std::ostringstream fpsstr;
@@ -2588,7 +3116,7 @@ void Game::UpdateParticleGraphics()
 		float rx2 = rx * rx;
 		float ry2 = ry * ry;
 		float s = sy * std::sqrt((rx2 + ry2) / (sy * sy * rx2 + ry2));
-		tire_smoke.UpdateGraphics(camorient, campos, znear, zfar);
+		tire_smoke.UpdateGraphics(camorient, campos, znear, zfar, fovy, rx / ry);
 		skid_marks.UpdateGraphics(active_camera->GetOrientation(), campos, znear, zfar, s);
 	}
 }
@@ -2688,15 +3216,19 @@ void Game::LeaveGame()
 		info_output << "Saving replay to " << replayname << std::endl;
 		replay.StopRecording(replayname);
 
-		GuiOption::List replaylist;
-		PopulateReplayList(replaylist);
-		gui.SetOptionValues("game.selected_replay", "", replaylist, error_output);
+		if (!headless)
+		{
+			GuiOption::List replaylist;
+			PopulateReplayList(replaylist);
+			gui.SetOptionValues("game.selected_replay", "", replaylist, error_output);
+		}
 	}
 
 	if (replay.GetPlaying())
 		replay.Reset();
 
-	graphics->ClearStaticDrawables();
+	if (graphics)
+		graphics->ClearStaticDrawables();
 
 	skid_marks.Clear();
 	tire_smoke.Clear();
@@ -2725,22 +3257,28 @@ void Game::StartRace()
 
 void Game::PauseGame()
 {
+	pause = true;
+
+	if (headless)
+		return;
+
 	if (settings.GetMouseGrab())
 		window.ShowMouseCursor(true);
 
 	gui.ActivatePage("Main", 0.25, error_output);
-
-	pause = true;
 }
 
 void Game::ContinueGame()
 {
+	pause = false;
+
+	if (headless)
+		return;
+
 	if (settings.GetMouseGrab())
 		window.ShowMouseCursor(false);
 
 	gui.ActivatePage(settings.GetHUD(), 0.25, error_output);
-
-	pause = false;
 }
 
 void Game::RestartGame()
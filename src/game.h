@@ -34,6 +34,7 @@
 #include "gui/text_draw.h"
 #include "gui/font.h"
 #include "physics/dynamicsworld.h"
+#include "jobsystem.h"
 #include "physics/cardynamics.h"
 #include "dynamicsdraw.h"
 #include "carcontrolmap.h"
@@ -54,6 +55,10 @@
 #include "updatemanager.h"
 #include "game_downloader.h"
 #include "carautopilot.h"
+#include "benchmarkstats.h"
+#include "simstate.h"
+#include "tickinputs.h"
+#include "tripplebuffer.h"
 
 #include "BulletCollision/CollisionDispatch/btDefaultCollisionConfiguration.h"
 #include "BulletCollision/BroadphaseCollision/btDbvtBroadphase.h"
@@ -89,6 +94,16 @@ private:
 
 	bool InitCoreSubsystems();
 
+	/// Initialize paths, settings and content for a display-free simulation
+	bool InitHeadless();
+
+	/// Step game logic at simulation rate, unbound by wall clock
+	void RunHeadless();
+
+	/// Start the race of a headless or benchmark run, applies the command
+	/// line track and replay.
+	bool NewBenchmarkGame(bool addopponents, int num_laps);
+
 	void InitThreading();
 
 	void InitPlayerCar();
@@ -99,19 +114,55 @@ private:
 
 	void Test();
 
-	void Tick(float dt);
+	/// Number of simulation ticks due after dt seconds, advances the tick counter.
+	/// Pending ticks have been scheduled but not run yet, they count toward
+	/// the tick limit of a frame.
+	unsigned ScheduleTicks(float dt, unsigned pending = 0);
+
+	/// Interpolation factor between the last two simulation states at the scheduled time
+	float GetTickAlpha() const;
+
+	/// Process events and sample the car controls once per frame, dt is the simulated time of the frame
+	void ProcessInput(float dt);
+
+	/// Act on the gui and game inputs sampled since the last call and hand
+	/// the car inputs to the next ticks, the simulation must not run
+	void DispatchInputs();
+
+	/// Run the simulation ticks and publish the resulting states for drawing
+	void AdvanceTicks(unsigned ticks);
+
+	void CaptureSimState(SimState & state) const;
 
+	/// Restart interpolation from the current state, after loading cars
+	void PublishSimState();
+
+	/// Update graphics, sound and gui from the simulation state after the ticks,
+	/// dt is the frame time since the last call
+	void EndTicks(unsigned ticks, float dt);
+
+	/// Collect the scene and set up the renderer, the simulation must not run
+	void SetupDraw(float dt);
+
+	/// Submit the scene, may run in parallel with the simulation
 	void Draw();
 
+	/// Simulation step, touches no graphics or gui state
 	void AdvanceGameLogic();
 
 	void UpdateCars(float dt);
 
+	/// Continue replay playback at the given replay time in seconds.
+	bool SeekReplay(float time);
+
 	void ProcessCarInputs();
 
 	/// Updates camera, call after physics update
 	void ProcessCameraInputs();
 
+	/// Update interior view and close shadow distance for the active camera
+	void UpdateCameraView();
+
 	void UpdateHUD(const size_t carid, const std::vector<float> & carinputs);
 
 	void UpdateTimer();
@@ -208,8 +259,6 @@ private:
 
 	std::string GetReplayRecordingFilename();
 
-	void Draw(float dt);
-
 	void BeginStartingUp();
 
 	void DoneStartingUp();
@@ -330,15 +379,38 @@ private:
 
 	std::vector <float> fps_track;
 	int fps_position;
-	float fps_min;
-	float fps_max;
+	float maxfps; ///< frame rate limit, 0 if unlimited
 
 	bool multithreaded;
+	bool simthread; ///< run the simulation on its own thread
 	bool profilingmode;
+	std::string profiletrace; ///< chrome trace output file, empty if not tracing
 	bool benchmode;
+	std::string benchtrack; ///< track of headless and benchmark runs, settings track if empty
+	std::string benchreplay; ///< replay played by headless and benchmark runs, ai cars race if empty
+	std::string benchout; ///< benchmark json output file, written to the log if empty
+	float replayseek; ///< replay start time in seconds
+	BenchmarkStats benchmark;
+	bool headless;
+	float headless_time; ///< simulated time limit of headless and benchmark runs in seconds, 0 if unbound
+	size_t headless_cars;
 	bool dumpfps;
 	bool pause;
 
+	float render_alpha; ///< interpolation factor between the last two simulation states
+	SimSnapshot sim_snapshot; ///< simulation side state history
+	TrippleBuffer<SimSnapshot> sim_snapshots; ///< states published to rendering
+	JobThread sim_thread;
+	unsigned sim_ticks; ///< ticks of the batch given to the simulation thread
+	unsigned sim_pending; ///< ticks scheduled while the simulation thread was busy
+	float sim_sync_time; ///< frame time since the last batch was given to the simulation thread
+	TickInputs frame_inputs; ///< inputs sampled since the last hand over to the ticks
+	TickInputs tick_inputs; ///< inputs of the simulation ticks
+	bool mouse_click; ///< gui mouse button released since the last hand over
+	float player_speed; ///< player car speed after the last ticks
+	bool race_over; ///< a car has finished the race
+	std::vector<float> hud_inputs; ///< last inputs of the camera car
+
 	std::vector <EventSystem::Joystick> controlgrab_joystick_state;
 	std::pair <int,int> controlgrab_mouse_coords;
 	CarControlMap::Control controlgrab_control;
@@ -361,6 +433,7 @@ private:
 	int race_laps;
 	bool practice;
 
+	JobSystem jobs;
 	btDefaultCollisionConfiguration collisionconfig;
 	btCollisionDispatcher collisiondispatch;
 	btDbvtBroadphase collisionbroadphase;
@@ -20,7 +20,7 @@
 #ifndef _AABB_TREE_ADAPTER_H
 #define _AABB_TREE_ADAPTER_H
 
-#include "aabbtree.h"
+#include "aabbbvh.h"
 #include <vector>
 
 #define OBJECTS_PER_NODE 64
@@ -29,8 +29,6 @@ template <typename T>
 class AabbTreeNodeAdapter
 {
 public:
-	AabbTreeNodeAdapter() : count(0) {}
-
 	void push_back(T * drawable)
 	{
 		Aabb<float> box;
@@ -43,7 +41,7 @@ public:
 
 	unsigned int size() const
 	{
-		return count;
+		return spacetree.size();
 	}
 
 	void clear()
@@ -54,7 +52,6 @@ public:
 	void Optimize()
 	{
 		spacetree.Optimize();
-		count = spacetree.size();
 	}
 
 	template <typename U>
@@ -64,8 +61,7 @@ public:
 	}
 
 private:
-	AabbTreeNode <T*,OBJECTS_PER_NODE> spacetree;
-	unsigned int count; ///< cached from spacetree.size()
+	AabbBvh <T*,OBJECTS_PER_NODE> spacetree;
 };
 
 /// adapter helper functor
@@ -0,0 +1,481 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "bcndecodeparallel.h"
+#include "bcndecode.h"
+#include "bcnencode.h"
+#include "jobsystem.h"
+#include "microbench.h"
+#include "unittest.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BCN_SSE2
+#endif
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define BCN_SSSE3
+#endif
+
+// blocks decoded per job
+static const int job_blocks = 1024;
+
+static inline void Expand565(unsigned v, int c[3])
+{
+	c[0] = (v & 0xf800) >> 8;
+	c[0] |= c[0] >> 5;
+	c[1] = (v & 0x7e0) >> 3;
+	c[1] |= c[1] >> 6;
+	c[2] = (v & 0x1f) << 3;
+	c[2] |= c[2] >> 5;
+}
+
+// four rgba colors, c0 > c1 selects four color mode, three colors and transparent black otherwise
+static inline void ColorPalette(const uint8_t * src, uint8_t pal[16])
+{
+	const unsigned c0 = src[0] | (src[1] << 8);
+	const unsigned c1 = src[2] | (src[3] << 8);
+	int p0[3], p1[3];
+	Expand565(c0, p0);
+	Expand565(c1, p1);
+#ifdef BCN_SSE2
+	// interpolate both colors at once, lanes p0 | p1 and p1 | p0, x / 3 = x * 21846 >> 16 for x < 768
+	const __m128i a = _mm_setr_epi16(p0[0], p0[1], p0[2], 0, p1[0], p1[1], p1[2], 0);
+	const __m128i b = _mm_shuffle_epi32(a, _MM_SHUFFLE(1, 0, 3, 2));
+	__m128i p;
+	if (c0 > c1)
+	{
+		p = _mm_mulhi_epu16(_mm_add_epi16(_mm_add_epi16(a, a), b), _mm_set1_epi16(21846));
+		p = _mm_or_si128(p, _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255));
+	}
+	else
+	{
+		p = _mm_srli_epi16(_mm_add_epi16(a, b), 1);
+		p = _mm_and_si128(p, _mm_setr_epi16(-1, -1, -1, 0, 0, 0, 0, 0));
+		p = _mm_or_si128(p, _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 0));
+	}
+	const __m128i e = _mm_or_si128(a, _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255));
+	_mm_storeu_si128((__m128i *)pal, _mm_packus_epi16(e, p));
+#else
+	for (int c = 0; c < 3; ++c)
+	{
+		pal[c] = p0[c];
+		pal[4 + c] = p1[c];
+		if (c0 > c1)
+		{
+			pal[8 + c] = (2 * p0[c] + p1[c]) / 3;
+			pal[12 + c] = (p0[c] + 2 * p1[c]) / 3;
+		}
+		else
+		{
+			pal[8 + c] = (p0[c] + p1[c]) / 2;
+			pal[12 + c] = 0;
+		}
+	}
+	pal[3] = pal[7] = pal[11] = 255;
+	pal[15] = (c0 > c1) ? 255 : 0;
+#endif
+}
+
+// eight alpha values, a0 > a1 selects eight value mode, six values, 0 and 255 otherwise
+static inline void AlphaPalette(const uint8_t * src, uint8_t pal[16])
+{
+	const int a0 = src[0];
+	const int a1 = src[1];
+#ifdef BCN_SSE2
+	// x / 7 = x * 9363 >> 16 for x < 1792, x / 5 = x * 13108 >> 16 for x < 1280
+	const __m128i v0 = _mm_set1_epi16(a0);
+	const __m128i v1 = _mm_set1_epi16(a1);
+	__m128i p;
+	if (a0 > a1)
+	{
+		p = _mm_add_epi16(
+			_mm_mullo_epi16(v0, _mm_setr_epi16(7, 0, 6, 5, 4, 3, 2, 1)),
+			_mm_mullo_epi16(v1, _mm_setr_epi16(0, 7, 1, 2, 3, 4, 5, 6)));
+		p = _mm_mulhi_epu16(p, _mm_set1_epi16(9363));
+	}
+	else
+	{
+		p = _mm_add_epi16(
+			_mm_mullo_epi16(v0, _mm_setr_epi16(5, 0, 4, 3, 2, 1, 0, 0)),
+			_mm_mullo_epi16(v1, _mm_setr_epi16(0, 5, 1, 2, 3, 4, 0, 0)));
+		p = _mm_mulhi_epu16(p, _mm_set1_epi16(13108));
+		p = _mm_or_si128(p, _mm_setr_epi16(0, 0, 0, 0, 0, 0, 0, 255));
+	}
+	_mm_storeu_si128((__m128i *)pal, _mm_packus_epi16(p, p));
+#else
+	pal[0] = a0;
+	pal[1] = a1;
+	if (a0 > a1)
+	{
+		for (int k = 2; k < 8; ++k)
+			pal[k] = ((8 - k) * a0 + (k - 1) * a1) / 7;
+	}
+	else
+	{
+		for (int k = 2; k < 6; ++k)
+			pal[k] = ((6 - k) * a0 + (k - 1) * a1) / 5;
+		pal[6] = 0;
+		pal[7] = 255;
+	}
+#endif
+}
+
+// sixteen alpha values of a bc3 alpha block
+static inline void DecodeAlpha(const uint8_t * src, uint8_t values[16])
+{
+	uint8_t pal[16];
+	AlphaPalette(src, pal);
+
+	uint8_t index[16];
+	for (int h = 0; h < 2; ++h)
+	{
+		const uint8_t * s = src + 2 + 3 * h;
+		const unsigned bits = s[0] | (s[1] << 8) | (s[2] << 16);
+		for (int n = 0; n < 8; ++n)
+			index[8 * h + n] = (bits >> (3 * n)) & 7;
+	}
+#ifdef BCN_SSSE3
+	const __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)pal), _mm_loadu_si128((const __m128i *)index));
+	_mm_storeu_si128((__m128i *)values, v);
+#else
+	for (int n = 0; n < 16; ++n)
+		values[n] = pal[index[n]];
+#endif
+}
+
+// sixteen alpha values of a bc2 alpha block
+static inline void DecodeExplicitAlpha(const uint8_t * src, uint8_t values[16])
+{
+	for (int n = 0; n < 16; ++n)
+	{
+		const int a = (src[n >> 1] >> ((n & 1) * 4)) & 0xf;
+		values[n] = (a << 4) | a;
+	}
+}
+
+#ifdef BCN_SSSE3
+struct ShuffleMasks
+{
+	// palette lookup of four pixels by a byte of color indices
+	__m128i color[256];
+
+	// place value byte of pixels 4 * row .. 4 * row + 3 into channel c of the row
+	__m128i channel[4][4];
+
+	ShuffleMasks()
+	{
+		for (int bits = 0; bits < 256; ++bits)
+		{
+			alignas(16) int8_t m[16];
+			for (int i = 0; i < 4; ++i)
+			{
+				for (int c = 0; c < 4; ++c)
+					m[i * 4 + c] = ((bits >> (2 * i)) & 3) * 4 + c;
+			}
+			color[bits] = _mm_load_si128((const __m128i *)m);
+		}
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int ch = 0; ch < 4; ++ch)
+			{
+				alignas(16) int8_t m[16];
+				for (int i = 0; i < 16; ++i)
+					m[i] = (i % 4 == ch) ? int8_t(row * 4 + i / 4) : int8_t(-128);
+				channel[row][ch] = _mm_load_si128((const __m128i *)m);
+			}
+		}
+	}
+};
+
+static const ShuffleMasks & GetShuffleMasks()
+{
+	static const ShuffleMasks masks;
+	return masks;
+}
+#endif
+
+// decode block at src into 4 rows of 4 rgba pixels, rows pitch bytes apart
+template <int bcn>
+static inline void DecodeBlock(const uint8_t * src, uint8_t * dst, int pitch)
+{
+	uint8_t alpha[2][16];
+	if (bcn == 2)
+		DecodeExplicitAlpha(src, alpha[0]);
+	else if (bcn == 3)
+		DecodeAlpha(src, alpha[0]);
+	else if (bcn == 5)
+	{
+		DecodeAlpha(src, alpha[0]);
+		DecodeAlpha(src + 8, alpha[1]);
+	}
+
+	uint8_t pal[16];
+	const uint8_t * color = (bcn == 1) ? src : src + 8;
+	if (bcn != 5)
+		ColorPalette(color, pal);
+
+#ifdef BCN_SSSE3
+	const ShuffleMasks & masks = GetShuffleMasks();
+	const __m128i p = _mm_loadu_si128((const __m128i *)pal);
+	const __m128i a0 = _mm_loadu_si128((const __m128i *)alpha[0]);
+	const __m128i a1 = _mm_loadu_si128((const __m128i *)alpha[1]);
+	const __m128i rgb_mask = _mm_set1_epi32(0x00ffffff);
+	for (int row = 0; row < 4; ++row, dst += pitch)
+	{
+		__m128i v;
+		if (bcn == 5)
+		{
+			v = _mm_or_si128(
+				_mm_shuffle_epi8(a0, masks.channel[row][0]),
+				_mm_shuffle_epi8(a1, masks.channel[row][1]));
+		}
+		else
+		{
+			v = _mm_shuffle_epi8(p, masks.color[color[4 + row]]);
+			if (bcn != 1)
+				v = _mm_or_si128(_mm_and_si128(v, rgb_mask), _mm_shuffle_epi8(a0, masks.channel[row][3]));
+		}
+		_mm_storeu_si128((__m128i *)dst, v);
+	}
+#else
+	for (int row = 0; row < 4; ++row, dst += pitch)
+	{
+		const unsigned bits = color[4 + row];
+		for (int i = 0; i < 4; ++i)
+		{
+			uint8_t * px = dst + i * 4;
+			const int n = row * 4 + i;
+			if (bcn == 5)
+			{
+				px[0] = alpha[0][n];
+				px[1] = alpha[1][n];
+				px[2] = 0;
+				px[3] = 0;
+			}
+			else
+			{
+				std::memcpy(px, pal + ((bits >> (2 * i)) & 3) * 4, 4);
+				if (bcn != 1)
+					px[3] = alpha[0][n];
+			}
+		}
+	}
+#endif
+}
+
+// decode block rows [row_begin, row_end)
+template <int bcn>
+static void DecodeRows(
+	uint8_t * dst, const uint8_t * src,
+	int width, int height,
+	int row_begin, int row_end)
+{
+	const int block_size = (bcn == 1) ? 8 : 16;
+	const int blocks_x = (width + 3) / 4;
+	const int pitch = width * 4;
+	src += row_begin * blocks_x * block_size;
+	for (int by = row_begin; by < row_end; ++by)
+	{
+		const int rows = std::min(4, height - by * 4);
+		uint8_t * row_dst = dst + by * 4 * pitch;
+		for (int bx = 0; bx < blocks_x; ++bx, src += block_size)
+		{
+			const int cols = std::min(4, width - bx * 4);
+			uint8_t * block_dst = row_dst + bx * 16;
+			if (rows == 4 && cols == 4)
+			{
+				DecodeBlock<bcn>(src, block_dst, pitch);
+				continue;
+			}
+
+			// partial block at the image edge
+			uint8_t block[64];
+			DecodeBlock<bcn>(src, block, 16);
+			for (int y = 0; y < rows; ++y)
+				std::memcpy(block_dst + y * pitch, block + y * 16, cols * 4);
+		}
+	}
+}
+
+static void DecodeRows(
+	uint8_t * dst, const uint8_t * src,
+	int width, int height, int bcn,
+	int row_begin, int row_end)
+{
+	switch (bcn)
+	{
+		case 1: DecodeRows<1>(dst, src, width, height, row_begin, row_end); break;
+		case 2: DecodeRows<2>(dst, src, width, height, row_begin, row_end); break;
+		case 3: DecodeRows<3>(dst, src, width, height, row_begin, row_end); break;
+		case 5: DecodeRows<5>(dst, src, width, height, row_begin, row_end); break;
+	}
+}
+
+int BcnDecodeParallel(
+	void *dst, int dst_size,
+	const void *src, int src_size,
+	int width, int height,
+	int bcn, JobSystem *jobs)
+{
+	if (bcn != 1 && bcn != 2 && bcn != 3 && bcn != 5)
+		return -1;
+
+	if (width <= 0 || height <= 0)
+		return 0;
+
+	const int block_size = (bcn == 1) ? 8 : 16;
+	const int blocks_x = (width + 3) / 4;
+	const int blocks_y = (height + 3) / 4;
+	const int size = blocks_x * blocks_y * block_size;
+	if (src_size < size || dst_size < width * height * 4)
+		return -1;
+
+	uint8_t * out = (uint8_t *)dst;
+	const uint8_t * in = (const uint8_t *)src;
+	if (jobs && jobs->GetThreadCount() > 1)
+	{
+		const int grain = std::max(1, job_blocks / blocks_x);
+		jobs->ParallelFor(0, blocks_y, grain, [=](int begin, int end)
+		{
+			DecodeRows(out, in, width, height, bcn, begin, end);
+		});
+	}
+	else
+	{
+		DecodeRows(out, in, width, height, bcn, 0, blocks_y);
+	}
+	return size;
+}
+
+static std::vector<uint8_t> RandomBlocks(int count, int block_size, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	std::vector<uint8_t> data(count * block_size);
+	for (auto & v : data)
+		v = rng();
+
+	// cover equal endpoints and both palette modes
+	for (int i = 0; i < count; i += 7)
+	{
+		uint8_t * block = &data[i * block_size];
+		block[1] = block[0];
+		block[block_size - 7] = block[block_size - 8];
+	}
+	return data;
+}
+
+QT_TEST(bcndecodeparallel_test)
+{
+	JobSystem jobs;
+	jobs.Init(4);
+
+	// sizes with partial blocks and with enough block rows to be split into jobs
+	const int sizes[][2] = {{1, 1}, {2, 3}, {13, 7}, {64, 64}, {256, 300}};
+	for (int bcn : {1, 2, 3, 5})
+	{
+		const int block_size = (bcn == 1) ? 8 : 16;
+		for (const auto & size : sizes)
+		{
+			const int w = size[0], h = size[1];
+			const int blocks = ((w + 3) / 4) * ((h + 3) / 4);
+			const std::vector<uint8_t> src = RandomBlocks(blocks, block_size, bcn * 1000 + w);
+
+			std::vector<uint8_t> expected(w * h * 4), serial(w * h * 4), parallel(w * h * 4);
+			BcnDecode(expected.data(), expected.size(), src.data(), src.size(), w, h, bcn, 0, 0);
+			QT_CHECK_EQUAL(BcnDecodeParallel(serial.data(), serial.size(), src.data(), src.size(), w, h, bcn, 0), int(src.size()));
+			QT_CHECK_EQUAL(BcnDecodeParallel(parallel.data(), parallel.size(), src.data(), src.size(), w, h, bcn, &jobs), int(src.size()));
+			QT_CHECK(serial == expected);
+			QT_CHECK(parallel == expected);
+		}
+	}
+
+	// palette interpolation of all endpoint pairs
+	for (int e0 = 0; e0 < 256; ++e0)
+	{
+		for (int e1 = 0; e1 < 256; ++e1)
+		{
+			uint8_t block[16] = {uint8_t(e0), uint8_t(e1), 0x88, 0xc6, 0xfa, 0xff, 0x24, 0x92};
+			block[8] = e0;
+			block[9] = e1;
+			block[10] = e1;
+			block[11] = e0;
+			uint8_t a[64], b[64];
+			BcnDecode(a, 64, block, 16, 4, 4, 3, 0, 0);
+			BcnDecodeParallel(b, 64, block, 16, 4, 4, 3, 0);
+			if (std::memcmp(a, b, 64) != 0)
+			{
+				QT_CHECK(false);
+				e0 = 256;
+				break;
+			}
+		}
+	}
+
+	std::vector<uint8_t> dst(16 * 4);
+	QT_CHECK_EQUAL(BcnDecodeParallel(dst.data(), dst.size(), dst.data(), 7, 4, 4, 1, 0), -1);
+	QT_CHECK_EQUAL(BcnDecodeParallel(dst.data(), dst.size() - 1, dst.data(), 8, 4, 4, 1, 0), -1);
+	QT_CHECK_EQUAL(BcnDecodeParallel(dst.data(), dst.size(), dst.data(), 16, 4, 4, 4, 0), -1);
+}
+
+MB_BENCHMARK(bcndecodeparallel_benchmark)
+{
+	// 1024 x 1024 mip 0 of a typical track texture
+	const int w = 1024, h = 1024;
+	std::vector<uint8_t> image(w * h * 4);
+	std::mt19937 rng(1);
+	for (int y = 0; y < h; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			uint8_t * px = &image[(y * w + x) * 4];
+			const int noise = rng() % 32;
+			px[0] = (x / 4 + noise) & 255;
+			px[1] = (y / 4 + noise) & 255;
+			px[2] = ((x + y) / 8) & 255;
+			px[3] = (x * y / 64 + noise) & 255;
+		}
+	}
+
+	JobSystem jobs;
+	jobs.Init(std::max(2u, std::thread::hardware_concurrency()));
+
+	std::vector<uint8_t> decoded(w * h * 4);
+	for (int bcn : {1, 3})
+	{
+		std::vector<uint8_t> encoded(BcnEncodedSize(w, h, bcn));
+		BcnEncode(encoded.data(), encoded.size(), image.data(), w, h, bcn);
+
+		auto reference = [&] { BcnDecode(decoded.data(), decoded.size(), encoded.data(), encoded.size(), w, h, bcn, 0, 0); };
+		auto serial = [&] { BcnDecodeParallel(decoded.data(), decoded.size(), encoded.data(), encoded.size(), w, h, bcn, 0); };
+		auto parallel = [&] { BcnDecodeParallel(decoded.data(), decoded.size(), encoded.data(), encoded.size(), w, h, bcn, &jobs); };
+
+		out << "bc" << bcn << " 1024x1024 BcnDecode: " << microbench::measure(reference) / 1e6 << " ms" << std::endl;
+		out << "bc" << bcn << " 1024x1024 BcnDecodeParallel 1 thread: " << microbench::measure(serial) / 1e6 << " ms" << std::endl;
+		out << "bc" << bcn << " 1024x1024 BcnDecodeParallel " << jobs.GetThreadCount() << " threads: " << microbench::measure(parallel) / 1e6 << " ms" << std::endl;
+	}
+}
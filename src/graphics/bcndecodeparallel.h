@@ -0,0 +1,36 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _BCN_DECODE_PARALLEL_H
+#define _BCN_DECODE_PARALLEL_H
+
+class JobSystem;
+
+// Block compression decoder for the software fallback, output matches BcnDecode.
+// Rows of blocks are decoded in parallel if a job system with workers is passed.
+// Palette lookups use ssse3 shuffles where available.
+// bcn = 1, 2, 3, 5: 4 bytes-per-pixel rgba, rows of width pixels
+// returns number of bytes read from src, -1 if src or dst are too small or bcn not supported
+int BcnDecodeParallel(
+	void *dst, int dst_size,
+	const void *src, int src_size,
+	int width, int height,
+	int bcn, JobSystem *jobs);
+
+#endif //_BCN_DECODE_PARALLEL_H
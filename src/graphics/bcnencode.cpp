@@ -0,0 +1,268 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "bcnencode.h"
+#include "bcndecode.h"
+#include "unittest.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+static unsigned short Pack565(const int c[3])
+{
+	return ((c[0] * 31 + 127) / 255 << 11) | ((c[1] * 63 + 127) / 255 << 5) | ((c[2] * 31 + 127) / 255);
+}
+
+static void Unpack565(unsigned short v, int c[3])
+{
+	const int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+	c[0] = (r << 3) | (r >> 2);
+	c[1] = (g << 2) | (g >> 4);
+	c[2] = (b << 3) | (b >> 2);
+}
+
+// block[16 * 4] rgba pixels, out[8]
+static void EncodeColorBlock(const unsigned char block[], unsigned char out[])
+{
+	int cmin[3] = {255, 255, 255};
+	int cmax[3] = {0, 0, 0};
+	int mean[3] = {0, 0, 0};
+	for (int i = 0; i < 16; ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			const int v = block[i * 4 + c];
+			cmin[c] = std::min(cmin[c], v);
+			cmax[c] = std::max(cmax[c], v);
+			mean[c] += v;
+		}
+	}
+
+	// use the bounding box diagonal the colors vary along:
+	// flip channels correlating negatively with the widest one
+	int ref = 0;
+	for (int c = 1; c < 3; ++c)
+	{
+		if (cmax[c] - cmin[c] > cmax[ref] - cmin[ref])
+			ref = c;
+	}
+	for (int c = 0; c < 3; ++c)
+	{
+		if (c == ref)
+			continue;
+
+		int cov = 0;
+		for (int i = 0; i < 16; ++i)
+			cov += (block[i * 4 + ref] * 16 - mean[ref]) * (block[i * 4 + c] * 16 - mean[c]);
+
+		if (cov < 0)
+			std::swap(cmin[c], cmax[c]);
+	}
+
+	// inset the endpoints to reduce the error of the inner colors
+	for (int c = 0; c < 3; ++c)
+	{
+		const int inset = (cmax[c] - cmin[c]) / 16;
+		cmax[c] -= inset;
+		cmin[c] += inset;
+	}
+
+	unsigned short c0 = Pack565(cmax);
+	unsigned short c1 = Pack565(cmin);
+	if (c0 < c1)
+		std::swap(c0, c1);
+
+	out[0] = c0 & 0xff;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xff;
+	out[3] = c1 >> 8;
+
+	// c0 > c1 selects four color mode
+	unsigned indices = 0;
+	if (c0 != c1)
+	{
+		int p[4][3];
+		Unpack565(c0, p[0]);
+		Unpack565(c1, p[1]);
+		for (int c = 0; c < 3; ++c)
+		{
+			p[2][c] = (2 * p[0][c] + p[1][c]) / 3;
+			p[3][c] = (p[0][c] + 2 * p[1][c]) / 3;
+		}
+
+		for (int i = 15; i >= 0; --i)
+		{
+			const unsigned char * px = block + i * 4;
+			int best = 0, best_dist = 0x7fffffff;
+			for (int k = 0; k < 4; ++k)
+			{
+				const int dr = px[0] - p[k][0], dg = px[1] - p[k][1], db = px[2] - p[k][2];
+				const int dist = dr * dr + dg * dg + db * db;
+				if (dist < best_dist)
+				{
+					best_dist = dist;
+					best = k;
+				}
+			}
+			indices = (indices << 2) | best;
+		}
+	}
+	out[4] = indices & 0xff;
+	out[5] = (indices >> 8) & 0xff;
+	out[6] = (indices >> 16) & 0xff;
+	out[7] = indices >> 24;
+}
+
+// block[16 * 4] rgba pixels, out[8]
+static void EncodeAlphaBlock(const unsigned char block[], unsigned char out[])
+{
+	int amin = 255, amax = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		amin = std::min(amin, int(block[i * 4 + 3]));
+		amax = std::max(amax, int(block[i * 4 + 3]));
+	}
+
+	// a0 > a1 selects eight value mode, a0 == a1 decodes index 0 as a0
+	out[0] = amax;
+	out[1] = amin;
+
+	int p[8];
+	p[0] = amax;
+	p[1] = amin;
+	for (int k = 2; k < 8; ++k)
+		p[k] = ((8 - k) * amax + (k - 1) * amin) / 7;
+
+	unsigned long long indices = 0;
+	for (int i = 15; i >= 0 && amax != amin; --i)
+	{
+		const int a = block[i * 4 + 3];
+		int best = 0, best_dist = 256;
+		for (int k = 0; k < 8; ++k)
+		{
+			const int dist = std::abs(a - p[k]);
+			if (dist < best_dist)
+			{
+				best_dist = dist;
+				best = k;
+			}
+		}
+		indices = (indices << 3) | best;
+	}
+	for (int i = 0; i < 6; ++i)
+		out[2 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+int BcnEncodedSize(int width, int height, int bcn)
+{
+	const int block_size = (bcn == 1) ? 8 : 16;
+	return ((width + 3) / 4) * ((height + 3) / 4) * block_size;
+}
+
+int BcnEncode(
+	void *dst, int dst_size,
+	const void *src,
+	int width, int height,
+	int bcn)
+{
+	if ((bcn != 1 && bcn != 3) || dst_size < BcnEncodedSize(width, height, bcn))
+		return -1;
+
+	const unsigned char * pixels = (const unsigned char *)src;
+	unsigned char * out = (unsigned char *)dst;
+	unsigned char block[16 * 4];
+	for (int by = 0; by < height; by += 4)
+	{
+		for (int bx = 0; bx < width; bx += 4)
+		{
+			for (int y = 0; y < 4; ++y)
+			{
+				const int sy = std::min(by + y, height - 1);
+				for (int x = 0; x < 4; ++x)
+				{
+					const int sx = std::min(bx + x, width - 1);
+					const unsigned char * px = pixels + (sy * width + sx) * 4;
+					std::copy(px, px + 4, block + (y * 4 + x) * 4);
+				}
+			}
+
+			if (bcn == 3)
+			{
+				EncodeAlphaBlock(block, out);
+				out += 8;
+			}
+			EncodeColorBlock(block, out);
+			out += 8;
+		}
+	}
+	return int(out - (unsigned char *)dst);
+}
+
+QT_TEST(bcnencode_test)
+{
+	// smooth gradients with an alpha ramp, size not a multiple of the block size
+	const int w = 37, h = 22;
+	std::vector<unsigned char> image(w * h * 4);
+	for (int y = 0; y < h; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			unsigned char * px = &image[(y * w + x) * 4];
+			px[0] = x * 255 / (w - 1);
+			px[1] = 255 - y * 255 / (h - 1);
+			px[2] = (x + y) * 255 / (w + h - 2);
+			px[3] = y * 255 / (h - 1);
+		}
+	}
+
+	std::vector<unsigned char> encoded(BcnEncodedSize(w, h, 3));
+	std::vector<unsigned char> decoded(w * h * 4);
+	QT_CHECK_EQUAL(BcnEncode(encoded.data(), encoded.size() - 1, image.data(), w, h, 3), -1);
+	QT_CHECK_EQUAL(BcnEncode(encoded.data(), encoded.size(), image.data(), w, h, 2), -1);
+
+	for (int bcn : {1, 3})
+	{
+		const int size = BcnEncodedSize(w, h, bcn);
+		QT_CHECK_EQUAL(BcnEncode(encoded.data(), encoded.size(), image.data(), w, h, bcn), size);
+		BcnDecode(decoded.data(), decoded.size(), encoded.data(), size, w, h, bcn, 0, 0);
+
+		int max_error = 0;
+		for (int i = 0; i < w * h * 4; ++i)
+		{
+			if (bcn == 1 && i % 4 == 3)
+			{
+				QT_CHECK_EQUAL(int(decoded[i]), 255);
+			}
+			else
+			{
+				max_error = std::max(max_error, std::abs(decoded[i] - image[i]));
+			}
+		}
+		QT_CHECK(max_error < 24);
+	}
+
+	// solid colors representable in 565 are exact
+	const unsigned char solid[4] = {255, 0, 132, 0};
+	for (int i = 0; i < w * h; ++i)
+		std::copy(solid, solid + 4, &image[i * 4]);
+	QT_CHECK(BcnEncode(encoded.data(), encoded.size(), image.data(), w, h, 3) > 0);
+	BcnDecode(decoded.data(), decoded.size(), encoded.data(), encoded.size(), w, h, 3, 0, 0);
+	QT_CHECK(decoded == image);
+}
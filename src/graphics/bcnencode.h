@@ -17,10 +17,21 @@
 /*                                                                      */
 /************************************************************************/
 
-#include "parallel_task.h"
+#ifndef _BCN_ENCODE_H
+#define _BCN_ENCODE_H
 
-int Parallel::Dispatch(void * data)
-{
-	((Task *) data)->Run();
-	return 0;
-}
+// Block compression encoder, endpoints from the bounding box of the block colors.
+// src is rgba, 4 bytes per pixel, partial blocks at the edges repeat the edge pixels
+// bcn = 1: dxt1, 8 bytes per block, alpha ignored
+// bcn = 3: dxt5, 16 bytes per block
+// returns number of bytes written, -1 if dst_size is too small or bcn not supported
+int BcnEncode(
+	void *dst, int dst_size,
+	const void *src,
+	int width, int height,
+	int bcn);
+
+// size of the encoded image in bytes
+int BcnEncodedSize(int width, int height, int bcn);
+
+#endif //_BCN_ENCODE_H
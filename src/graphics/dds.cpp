@@ -315,4 +315,18 @@ int ReadDDS(
     return 1;
 } // readDDS
 
+unsigned long DDSLevelSize(unsigned int _glfmt, unsigned int _w, unsigned int _h)
+{
+    const unsigned long blocks = (unsigned long) ((_w + 3) / 4) * ((_h + 3) / 4);
+    switch (_glfmt)
+    {
+        case GL_BGR: return (unsigned long) _w * _h * 3;
+        case GL_BGRA: return (unsigned long) _w * _h * 4;
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: return blocks * 8;
+        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT: return blocks * 16;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return blocks * 16;
+    } // switch
+    return 0;
+} // DDSLevelSize
+
 // end of dds.cpp
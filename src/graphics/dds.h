@@ -10,4 +10,8 @@ int ReadDDS(
 	unsigned int &_w, unsigned int &_h,
 	unsigned int &_miplevels);
 
+// Bytes of a mip level of ReadDDS format _glfmt, 0 if unsupported.
+// Block compressed levels are rounded up to whole 4x4 blocks.
+unsigned long DDSLevelSize(unsigned int _glfmt, unsigned int _w, unsigned int _h);
+
 #endif //_DDS_H
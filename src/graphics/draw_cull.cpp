@@ -0,0 +1,206 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "draw_cull.h"
+#include "drawable.h"
+#include "quaternion.h"
+#include "graphics_camera.h"
+#include "model.h"
+#include "frustumcull.h"
+#include "jobsystem.h"
+#include "unittest.h"
+
+#include <cmath>
+#include <sstream>
+
+void DrawCull::Run(const Task & task)
+{
+	const auto cam = task.camera;
+	auto & drawables = task.list->drawables;
+	if (task.cull)
+	{
+		if (cam->fov > 0)
+		{
+			float fov = cam->fov * float(M_PI/180);
+			float ct = ContributionCullThreshold(task.height, fov);
+			auto cull = MakeFrustumCullerPersp(task.frustum.frustum, cam->pos, ct);
+
+			// cull static drawlist
+			task.static_drawables->Query(cull, drawables);
+
+			// cull dynamic drawlist
+			for (const auto & drawable : *task.dynamic_drawables)
+			{
+				if (!cull(drawable->GetCenter(), drawable->GetRadius()))
+					drawables.push_back(drawable);
+			}
+		}
+		else
+		{
+			auto cull = MakeFrustumCuller(task.frustum.frustum);
+
+			// cull static drawlist
+			task.static_drawables->Query(cull, drawables);
+
+			// cull dynamic drawlist
+			for (const auto & drawable : *task.dynamic_drawables)
+			{
+				if (!cull(drawable->GetCenter(), drawable->GetRadius()))
+					drawables.push_back(drawable);
+			}
+		}
+	}
+	else
+	{
+		// copy static drawlist
+		task.static_drawables->Query(
+			Aabb<float>::IntersectAlways(),
+			drawables);
+
+		// copy dynamic drawlist
+		drawables.insert(
+			drawables.end(),
+			task.dynamic_drawables->begin(),
+			task.dynamic_drawables->end());
+	}
+
+	if (task.sort)
+	{
+		DrawSort::Sort(
+			drawables, cam->pos, cam->view_distance,
+			task.list->sort_items, task.list->sort_temp);
+	}
+}
+
+void DrawCull::Run(const std::vector<Task> & tasks, JobSystem * jobs)
+{
+	if (jobs)
+	{
+		jobs->ParallelFor(0, int(tasks.size()), 1, [&tasks](int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+				Run(tasks[i]);
+		});
+	}
+	else
+	{
+		for (const auto & task : tasks)
+			Run(task);
+	}
+}
+
+QT_TEST(draw_cull_test)
+{
+	// fixed scene of unit cubes, static ones on a grid, dynamic ones on a ring
+	VertexArray cube;
+	cube.SetToUnitCube();
+	Model model;
+	std::ostringstream error;
+	QT_CHECK(model.Load(cube, error));
+
+	std::vector<Drawable> static_drawables(32 * 32), dynamic_drawables(64);
+	AabbTreeNodeAdapter<Drawable> static_tree;
+	for (unsigned i = 0; i < static_drawables.size(); ++i)
+	{
+		Drawable & d = static_drawables[i];
+		Mat4 transform;
+		transform.Translate(float(i % 32) * 10 - 160, float(i / 32) * 10 - 160, 0);
+		d.SetModel(model);
+		d.SetTransform(transform);
+		d.SetTextures(1 + i % 5);
+		static_tree.push_back(&d);
+	}
+	static_tree.Optimize();
+
+	std::vector<Drawable*> dynamic_list;
+	for (unsigned i = 0; i < dynamic_drawables.size(); ++i)
+	{
+		Drawable & d = dynamic_drawables[i];
+		Mat4 transform;
+		const float angle = i * float(2 * M_PI) / dynamic_drawables.size();
+		transform.Translate(std::cos(angle) * 100, std::sin(angle) * 100, 5);
+		d.SetModel(model);
+		d.SetTransform(transform);
+		dynamic_list.push_back(&d);
+	}
+
+	// perspective cameras looking down on parts of the scene,
+	// a high one seeing most of it, an orthographic one
+	std::vector<GraphicsCamera> cameras(10);
+	for (unsigned i = 0; i < 8; ++i)
+	{
+		cameras[i].fov = 60;
+		cameras[i].view_distance = 200;
+		cameras[i].pos.Set(float(i) * 20 - 70, float(i) * -15 + 50, float(i) * 10 + 40);
+		cameras[i].rot.Rotate(i * M_PI / 4, 0, 0, 1);
+	}
+	cameras[8].pos.Set(0, 0, 300);
+	cameras[8].view_distance = 1000;
+	cameras[9].fov = 0;
+	cameras[9].orthomin.Set(-50, -50, -1000);
+	cameras[9].orthomax.Set(50, 50, 1000);
+
+	// tasks for all cameras, with and without culling and sorting
+	std::vector<DrawCull::List> serial_lists(cameras.size() * 2), parallel_lists(serial_lists.size());
+	std::vector<DrawCull::Task> serial_tasks, parallel_tasks;
+	for (unsigned i = 0; i < serial_lists.size(); ++i)
+	{
+		const GraphicsCamera & cam = cameras[i / 2];
+		DrawCull::Task task;
+		task.static_drawables = &static_tree;
+		task.dynamic_drawables = &dynamic_list;
+		task.camera = &cam;
+		task.frustum.Extract(GetProjMatrix(cam).GetArray(), GetViewMatrix(cam).GetArray());
+		task.height = 720;
+		task.cull = (i != 1);
+		task.sort = (i % 2 == 1);
+		task.list = &serial_lists[i];
+		serial_tasks.push_back(task);
+		task.list = &parallel_lists[i];
+		parallel_tasks.push_back(task);
+	}
+	DrawCull::Run(serial_tasks, 0);
+
+	// culling removes drawables, not all of them
+	const size_t total = static_drawables.size() + dynamic_drawables.size();
+	QT_CHECK_EQUAL(serial_lists[1].drawables.size(), total);
+	size_t culled = 0;
+	for (unsigned i = 2; i < serial_lists.size(); ++i)
+	{
+		const size_t size = serial_lists[i].drawables.size();
+		QT_CHECK(size > 0);
+		if (size < total)
+			culled++;
+	}
+	QT_CHECK(culled > serial_lists.size() / 2);
+
+	// job system output matches serial culling, for any schedule
+	JobSystem jobs;
+	jobs.Init(4);
+	bool equal = true;
+	for (unsigned n = 0; n < 20; ++n)
+	{
+		for (auto & list : parallel_lists)
+			list.drawables.clear();
+		DrawCull::Run(parallel_tasks, &jobs);
+		for (unsigned i = 0; i < serial_lists.size(); ++i)
+			equal = equal && parallel_lists[i].drawables == serial_lists[i].drawables;
+	}
+	QT_CHECK(equal);
+}
@@ -0,0 +1,68 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _DRAW_CULL_H
+#define _DRAW_CULL_H
+
+#include "aabb_tree_adapter.h"
+#include "draw_sort.h"
+#include "frustum.h"
+
+#include <vector>
+
+struct GraphicsCamera;
+class Drawable;
+class JobSystem;
+
+/// Culls scene draw layers for cameras into draw lists. Each task writes to
+/// its own list only, so tasks can run concurrently in any order and the
+/// lists don't depend on the schedule.
+namespace DrawCull
+{
+	/// Culled drawables, with sort scratch space.
+	struct List
+	{
+		List() : valid(false) {}
+		std::vector <Drawable*> drawables;
+		std::vector <DrawSort::Item> sort_items;
+		std::vector <DrawSort::Item> sort_temp;
+		bool valid;
+	};
+
+	/// Culling of a draw layer for a camera.
+	struct Task
+	{
+		const AabbTreeNodeAdapter<Drawable> * static_drawables;
+		const std::vector<Drawable*> * dynamic_drawables;
+		const GraphicsCamera * camera;
+		Frustum frustum;
+		float height; ///< output height in pixels, used for contribution culling
+		bool cull; ///< copy all drawables if not set
+		bool sort; ///< sort the list by render state
+		List * list;
+	};
+
+	/// Append the drawables of the task to its list.
+	void Run(const Task & task);
+
+	/// Run the tasks on the job system, serially if jobs is null.
+	void Run(const std::vector<Task> & tasks, JobSystem * jobs);
+}
+
+#endif // _DRAW_CULL_H
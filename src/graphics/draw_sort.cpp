@@ -0,0 +1,230 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "draw_sort.h"
+#include "drawable.h"
+#include "graphicsstate.h"
+#include "render_input_scene.h"
+#include "microbench.h"
+#include "unittest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+uint64_t DrawSort::GetKey(const Drawable & drawable, const Vec3 & view_position, float view_distance)
+{
+	const VertexBuffer::Segment & segment = drawable.GetVertexBufferSegment();
+	const uint64_t buffer = (uint64_t(segment.vformat & 0x7u) << 16) | (segment.vbuffer & 0xFFFFu);
+	const uint64_t textures =
+		(uint64_t(drawable.GetTexture0() & 0xFFFFu) << 16) |
+		((drawable.GetTexture1() ^ (drawable.GetTexture2() << 8)) & 0xFFFFu);
+
+	// buckets get finer close to the viewer
+	const float distance = (drawable.GetCenter() - view_position).Magnitude();
+	float depth = (view_distance > 0) ? std::sqrt(distance / view_distance) : 0;
+	depth = std::min(depth, 1.0f);
+
+	return (uint64_t(drawable.GetDecal()) << 63) |
+		(buffer << 44) |
+		(textures << 12) |
+		(uint64_t(drawable.GetCull()) << 11) |
+		(uint64_t(depth * 1023) << 1);
+}
+
+void DrawSort::RadixSort(std::vector<Item> & items, std::vector<Item> & temp)
+{
+	const unsigned n = items.size();
+	if (n < 2)
+		return;
+
+	// histograms of all eight digits in one pass
+	unsigned count[8][256] = {};
+	for (const auto & item : items)
+	{
+		for (unsigned d = 0; d < 8; ++d)
+			count[d][(item.key >> (d * 8)) & 0xFF]++;
+	}
+
+	temp.resize(n);
+	for (unsigned d = 0; d < 8; ++d)
+	{
+		// skip digits shared by all keys
+		const unsigned shift = d * 8;
+		if (count[d][(items[0].key >> shift) & 0xFF] == n)
+			continue;
+
+		unsigned offset = 0;
+		for (unsigned i = 0; i < 256; ++i)
+		{
+			const unsigned c = count[d][i];
+			count[d][i] = offset;
+			offset += c;
+		}
+
+		for (const auto & item : items)
+			temp[count[d][(item.key >> shift) & 0xFF]++] = item;
+
+		items.swap(temp);
+	}
+}
+
+void DrawSort::Sort(
+	std::vector<Drawable*> & drawables,
+	const Vec3 & view_position, float view_distance,
+	std::vector<Item> & items, std::vector<Item> & temp)
+{
+	if (drawables.size() < 2)
+		return;
+
+	items.clear();
+	for (auto drawable : drawables)
+		items.push_back(Item{GetKey(*drawable, view_position, view_distance), drawable});
+
+	// short lists are cheaper to sort by comparison
+	if (items.size() < 64)
+		std::stable_sort(items.begin(), items.end(), [](const Item & a, const Item & b) { return a.key < b.key; });
+	else
+		RadixSort(items, temp);
+
+	for (unsigned i = 0; i < items.size(); ++i)
+		drawables[i] = items[i].drawable;
+}
+
+// drawables sharing a few buffers and materials, in random order
+static std::vector<Drawable> GenerateDrawables(unsigned count, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<unsigned> buffer(1, 4);
+	std::uniform_int_distribution<unsigned> material(1, 16);
+	std::uniform_real_distribution<float> position(-500, 500);
+	std::vector<Drawable> drawables(count);
+	for (auto & d : drawables)
+	{
+		VertexBuffer::Segment segment;
+		segment.vbuffer = buffer(rng);
+		segment.vformat = VertexFormat::PNT332;
+		d.SetVertexBufferSegment(segment);
+
+		const unsigned m = material(rng);
+		d.SetTextures(10 + m, 100 + m, 200 + m);
+		d.SetCull(m % 3 != 0);
+		d.SetDecal(m == 16);
+
+		Mat4 transform;
+		transform.Translate(position(rng), position(rng), 0);
+		d.SetTransform(transform);
+	}
+	return drawables;
+}
+
+// submit drawables through RenderInputScene::Draw, returns vertex buffer binds,
+// binding is left to VertexBuffer::Draw there, it binds on vertex object changes
+template <class State>
+static unsigned Submit(State & glstate, const std::vector<Drawable*> & drawables)
+{
+	unsigned buffer_binds = 0;
+	RenderInputScene::Draw(glstate, drawables, [&glstate, &buffer_binds](const Drawable & d)
+	{
+		if (glstate.VertexObject() != d.GetVertexBufferSegment().vbuffer)
+		{
+			glstate.VertexObject() = d.GetVertexBufferSegment().vbuffer;
+			buffer_binds++;
+		}
+	});
+	return buffer_binds;
+}
+
+QT_TEST(draw_sort_test)
+{
+	// radix sort is stable and matches a comparison sort
+	std::mt19937_64 rng(1);
+	std::vector<DrawSort::Item> items(1000), temp, expected;
+	for (unsigned i = 0; i < items.size(); ++i)
+		items[i] = DrawSort::Item{(rng() % 50) << (i % 7) * 8, reinterpret_cast<Drawable*>(uintptr_t(i + 1))};
+	expected = items;
+	std::stable_sort(expected.begin(), expected.end(), [](const DrawSort::Item & a, const DrawSort::Item & b) { return a.key < b.key; });
+	DrawSort::RadixSort(items, temp);
+	bool equal = true;
+	for (unsigned i = 0; i < items.size(); ++i)
+		equal = equal && items[i].key == expected[i].key && items[i].drawable == expected[i].drawable;
+	QT_CHECK(equal);
+
+	// drawables with equal state are drawn front to back
+	std::vector<Drawable> pair(2);
+	Mat4 transform;
+	transform.Translate(100, 0, 0);
+	pair[0].SetTransform(transform);
+	transform.Translate(-90, 0, 0);
+	pair[1].SetTransform(transform);
+	std::vector<Drawable*> list = {&pair[0], &pair[1]};
+	DrawSort::Sort(list, Vec3(0), 1000, items, temp);
+	QT_CHECK(list[0] == &pair[1] && list[1] == &pair[0]);
+
+	// sorted list is a permutation with decals last and fewer state changes
+	std::vector<Drawable> drawables = GenerateDrawables(512, 2);
+	std::vector<Drawable*> unsorted, sorted;
+	for (auto & d : drawables)
+		unsorted.push_back(&d);
+	sorted = unsorted;
+	DrawSort::Sort(sorted, Vec3(0), 1000, items, temp);
+
+	std::vector<Drawable*> a = unsorted, b = sorted;
+	std::sort(a.begin(), a.end());
+	std::sort(b.begin(), b.end());
+	QT_CHECK(a == b);
+
+	const auto first_decal = std::find_if(sorted.begin(), sorted.end(), [](const Drawable * d) { return d->GetDecal(); });
+	QT_CHECK(std::all_of(first_decal, sorted.end(), [](const Drawable * d) { return d->GetDecal(); }));
+
+	GraphicsStateBase<GraphicsDeviceCounter> unsorted_state, sorted_state;
+	const unsigned unsorted_binds = Submit(unsorted_state, unsorted);
+	const unsigned sorted_binds = Submit(sorted_state, sorted);
+	const auto & u = unsorted_state.GetDevice();
+	const auto & s = sorted_state.GetDevice();
+	QT_CHECK(sorted_binds <= 8);
+	QT_CHECK(sorted_binds * 10 < unsorted_binds);
+	QT_CHECK(s.texture_binds * 2 < u.texture_binds);
+	QT_CHECK(s.state_changes * 2 < u.state_changes);
+}
+
+MB_BENCHMARK(draw_sort_benchmark)
+{
+	std::vector<Drawable> drawables = GenerateDrawables(4096, 2);
+	std::vector<Drawable*> unsorted, list;
+	std::vector<DrawSort::Item> items, temp;
+	for (auto & d : drawables)
+		unsorted.push_back(&d);
+
+	auto draw_sort = [&]
+	{
+		list = unsorted;
+		DrawSort::Sort(list, Vec3(0), 1000, items, temp);
+	};
+	auto comparison_sort = [&]
+	{
+		items.clear();
+		for (auto d : unsorted)
+			items.push_back(DrawSort::Item{DrawSort::GetKey(*d, Vec3(0), 1000), d});
+		std::stable_sort(items.begin(), items.end(), [](const DrawSort::Item & a, const DrawSort::Item & b) { return a.key < b.key; });
+	};
+
+	out << "draw sort 4096 drawables radix: " << microbench::measure(draw_sort) << " ns" << std::endl;
+	out << "draw sort 4096 drawables std::stable_sort: " << microbench::measure(comparison_sort) << " ns" << std::endl;
+}
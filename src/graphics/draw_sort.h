@@ -0,0 +1,60 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _DRAW_SORT_H
+#define _DRAW_SORT_H
+
+#include "mathvector.h"
+
+#include <cstdint>
+#include <vector>
+
+class Drawable;
+
+/// Orders draw lists by 64 bit render state keys, so drawables sharing
+/// state are drawn together and GraphicsState skips the redundant changes.
+/// Drawables with equal state are drawn front to back.
+namespace DrawSort
+{
+	/// Key layout from the most significant bit: decal flag (1 bit),
+	/// vertex format (3 bits), vertex buffer (16 bits), texture 0 (16 bits),
+	/// textures 1 and 2 xor folded (16 bits), face culling (1 bit), view
+	/// distance bucket (10 bits), unused (1 bit). Names are truncated to
+	/// 16 bits. Drawables whose names collide share a key and may be
+	/// interleaved, which costs state changes but not correctness, state
+	/// is still set for every drawable.
+	uint64_t GetKey(const Drawable & drawable, const Vec3 & view_position, float view_distance);
+
+	struct Item
+	{
+		uint64_t key;
+		Drawable * drawable;
+	};
+
+	/// Stable radix sort by key, temp is scratch space.
+	void RadixSort(std::vector<Item> & items, std::vector<Item> & temp);
+
+	/// Sort drawables by key, items and temp are scratch space.
+	void Sort(
+		std::vector<Drawable*> & drawables,
+		const Vec3 & view_position, float view_distance,
+		std::vector<Item> & items, std::vector<Item> & temp);
+}
+
+#endif // _DRAW_SORT_H
@@ -27,6 +27,7 @@
 #include <string>
 #include <vector>
 
+class JobSystem;
 class SceneNode;
 
 /// an abstract base class that defines the graphics interface
@@ -103,6 +104,9 @@ public:
 	/// set scene local time speedup relative to real time: 0, 1, ..., 32
 	virtual void SetLocalTimeSpeed(float /*value*/) {};
 
+	/// optional job system to run scene setup on, null runs it on the calling thread
+	virtual void SetJobSystem(JobSystem * /*jobs*/) {};
+
 	virtual void printProfilingInfo(std::ostream & /*out*/) const { }
 
 	virtual ~Graphics() {}
@@ -24,7 +24,7 @@
 #include "shader.h"
 #include "uniforms.h"
 #include "vertexattrib.h"
-#include "frustumcull.h"
+#include "profiler.h"
 #include "model.h"
 #include "sky.h"
 #include "tokenize.h"
@@ -104,9 +104,9 @@ static bool SortDraworder(Drawable * d1, Drawable * d2)
 	return (d1->GetDrawOrder() < d2->GetDrawOrder());
 }
 
-static std::string BuildKey(const std::string & camera, const std::string & draw)
+static std::string BuildKey(const std::string & camera, const std::string & draw, bool sort)
 {
-	return camera + ";" + draw;
+	return camera + ";" + draw + (sort ? ";sorted" : "");
 }
 
 static Quat GetCubeSideOrientation(int i, const Quat & origorient, std::ostream & error_output)
@@ -186,6 +186,7 @@ static void AttachCubeSide(int i, FrameBufferObject & reflection_fbo, std::ostre
 }
 
 GraphicsGL2::GraphicsGL2() :
+	jobs(NULL),
 	initialized(false),
 	max_anisotropy(0),
 	closeshadow(5.0),
@@ -422,10 +423,17 @@ void GraphicsGL2::SetupScene(
 	std::sort(dynamic_draw_lists.twodim.begin(), dynamic_draw_lists.twodim.end(), &SortDraworder);
 
 	// do fast culling queries for static geometry per pass
-	ClearCulledDrawLists();
-	for (const auto & pass : passes)
 	{
-		CullScenePass(pass, error_output);
+		PROFILE_ZONE("cull");
+		ClearCulledDrawLists();
+		cull_tasks.clear();
+		for (const auto & pass : passes)
+		{
+			CullScenePass(pass, error_output);
+		}
+
+		// tasks write to separate draw lists, the output doesn't depend on the schedule
+		DrawCull::Run(cull_tasks, jobs);
 	}
 
 	renderscene.SetFSAA(fsaa);
@@ -516,6 +524,11 @@ void GraphicsGL2::SetLocalTimeSpeed(float value)
 		sky->SetTimeSpeed(value);
 }
 
+void GraphicsGL2::SetJobSystem(JobSystem * value)
+{
+	jobs = value;
+}
+
 GraphicsState & GraphicsGL2::GetState()
 {
 	return glstate;
@@ -973,6 +986,11 @@ bool GraphicsGL2::InitScenePass(
 	pass.postprocess = (pass_config.draw.back() == "postprocess");
 	pass.cull = pass_config.cull;
 
+	// opaque passes writing depth or testing against a depth prepass produce
+	// the same image in any draw order, other passes keep the submission order
+	pass.sort = pass.blend_mode == BlendMode::DISABLED && pass.depth_test != GL_ALWAYS &&
+		(pass.write_depth || pass.depth_test == GL_EQUAL);
+
 	// set textures
 	GetScenePassInputTextures(pass_config.inputs, pass.textures);
 
@@ -1031,7 +1049,7 @@ bool GraphicsGL2::InitScenePass(
 
 		for (const auto & draw_layer : pass_config.draw)
 		{
-			const std::string & draw_list_name = BuildKey(camera_name, draw_layer);
+			const std::string & draw_list_name = BuildKey(camera_name, draw_layer, pass.sort);
 			pass.draw_lists.push_back(&culled_draw_lists[draw_list_name]);
 		}
 	}
@@ -1094,53 +1112,17 @@ void GraphicsGL2::CullScenePass(
 				continue;
 
 			draw_list.valid = true;
-			if (pass.cull)
-			{
-				if (cam->fov > 0)
-				{
-					float height = output.GetHeight();
-					float fov = cam->fov * float(M_PI/180);
-					float ct = ContributionCullThreshold(height, fov);
-					auto cull = MakeFrustumCullerPersp(frustum.frustum, cam->pos, ct);
-
-					// cull static drawlist
-					pass.static_draw_lists[i]->Query(cull, draw_list.drawables);
-
-					// cull dynamic drawlist
-					for (const auto & drawable : *pass.dynamic_draw_lists[i])
-					{
-						if (!cull(drawable->GetCenter(), drawable->GetRadius()))
-							draw_list.drawables.push_back(drawable);
-					}
-				}
-				else
-				{
-					auto cull = MakeFrustumCuller(frustum.frustum);
-
-					// cull static drawlist
-					pass.static_draw_lists[i]->Query(cull, draw_list.drawables);
 
-					// cull dynamic drawlist
-					for (const auto & drawable : *pass.dynamic_draw_lists[i])
-					{
-						if (!cull(drawable->GetCenter(), drawable->GetRadius()))
-							draw_list.drawables.push_back(drawable);
-					}
-				}
-			}
-			else
-			{
-				// copy static drawlist
-				pass.static_draw_lists[i]->Query(
-					Aabb<float>::IntersectAlways(),
-					draw_list.drawables);
-
-				// copy dynamic drawlist
-				draw_list.drawables.insert(
-					draw_list.drawables.end(),
-					pass.dynamic_draw_lists[i]->begin(),
-					pass.dynamic_draw_lists[i]->end());
-			}
+			DrawCull::Task task;
+			task.static_drawables = pass.static_draw_lists[i];
+			task.dynamic_drawables = pass.dynamic_draw_lists[i];
+			task.camera = cam;
+			task.frustum = frustum;
+			task.height = pass.output->GetHeight();
+			task.cull = pass.cull;
+			task.sort = pass.sort;
+			task.list = &draw_list;
+			cull_tasks.push_back(task);
 		}
 	}
 }
@@ -26,6 +26,8 @@
 #include "texture.h"
 #include "aabb_tree_adapter.h"
 #include "drawable_container.h"
+#include "draw_cull.h"
+#include "frustum.h"
 #include "render_input_postprocess.h"
 #include "render_input_scene.h"
 #include "render_output.h"
@@ -35,6 +37,7 @@
 #include <memory>
 
 struct GraphicsCamera;
+class JobSystem;
 class Shader;
 class Sky;
 
@@ -103,6 +106,8 @@ public:
 
 	void SetLocalTimeSpeed(float value) override;
 
+	void SetJobSystem(JobSystem * value) override;
+
 	// Allow external code to use gl state manager.
 	GraphicsState & GetState();
 
@@ -122,6 +127,9 @@ private:
 	// avoids sending excessive state changes to OpenGL
 	GraphicsState glstate;
 
+	// culls draw lists in parallel if set
+	JobSystem * jobs;
+
 	// configuration variables, internal data
 	int w, h;
 	bool initialized;
@@ -169,12 +177,7 @@ private:
 	typedef DrawableContainer<AabbTreeNodeAdapter> StaticDrawables;
 	StaticDrawables static_draw_lists; //used for objects that will never change
 
-	struct CulledDrawList
-	{
-		CulledDrawList() : valid(false) {};
-		PtrVector <Drawable> drawables;
-		bool valid;
-	};
+	typedef DrawCull::List CulledDrawList;
 	typedef std::map <std::string, CulledDrawList> CulledDrawListMap;
 	CulledDrawListMap culled_draw_lists;
 
@@ -216,9 +219,13 @@ private:
 		bool clear_color;
 		bool postprocess;
 		bool cull;
+		bool sort; ///< draw order doesn't affect the output, sort draw lists by state
 	};
 	std::vector<GraphicsPass> passes;
 
+	// culling of the draw lists of the scene passes
+	std::vector<DrawCull::Task> cull_tasks;
+
 	Vec3 light_direction;
 	std::shared_ptr<Sky> sky;
 	bool sky_dynamic;
@@ -264,6 +271,7 @@ private:
 		GraphicsPass & pass,
 		std::ostream & error_output);
 
+	/// add cull tasks for the draw lists of the pass not culled yet
 	void CullScenePass(
 		const GraphicsPass & pass,
 		std::ostream & error_output);
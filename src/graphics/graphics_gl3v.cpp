@@ -22,6 +22,7 @@
 #include "joeserialize.h"
 #include "frustumcull.h"
 #include "model.h"
+#include "profiler.h"
 #include "utils.h"
 
 #include <unordered_map>
@@ -467,6 +468,8 @@ void GraphicsGL3::AssembleDrawList(const AabbTreeNodeAdapter <Drawable> & adapte
 
 void GraphicsGL3::AssembleDrawMap(std::ostream & /*error_output*/)
 {
+	PROFILE_ZONE("cull");
+
 	//sort the two dimentional drawlist so we get correct ordering
 	std::sort(dynamic_drawlist.twodim.begin(),dynamic_drawlist.twodim.end(),&SortDraworder);
 
@@ -23,10 +23,53 @@
 #include "glcore.h"
 #include <cassert>
 
-class GraphicsState
+/// Issues the OpenGL calls of GraphicsState.
+struct GraphicsDeviceGL
+{
+	void ColorMask(GLboolean color, GLboolean alpha) { glColorMask(color, color, color, alpha); }
+	void DepthMask(GLboolean flag) { glDepthMask(flag); }
+	void DepthFunc(GLenum func) { glDepthFunc(func); }
+	void Enable(GLenum cap) { glEnable(cap); }
+	void Disable(GLenum cap) { glDisable(cap); }
+	void BlendFunc(GLenum s, GLenum d) { glBlendFunc(s, d); }
+	void ActiveTexture(GLenum texture) { glActiveTexture(texture); }
+	void BindTexture(GLenum target, GLuint texture) { glBindTexture(target, texture); }
+	void BindFramebuffer(GLenum target, GLuint framebuffer) { glBindFramebuffer(target, framebuffer); }
+	void BindVertexArray(GLuint array) { if (GLC_ARB_vertex_array_object) glBindVertexArray(array); }
+	void BindBuffer(GLenum target, GLuint buffer) { glBindBuffer(target, buffer); }
+	void Viewport(int width, int height) { glViewport(0, 0, width, height); }
+	void Clear(GLbitfield mask) { glClear(mask); }
+};
+
+/// Counts the calls instead of issuing them, used to measure state changes without a GL context.
+struct GraphicsDeviceCounter
+{
+	unsigned state_changes = 0; ///< write masks, depth and blend functions, capabilities
+	unsigned texture_binds = 0; ///< texture binds and active texture unit changes
+	unsigned buffer_binds = 0; ///< framebuffer, vertex array and buffer binds
+	unsigned clears = 0;
+
+	void ColorMask(GLboolean, GLboolean) { state_changes++; }
+	void DepthMask(GLboolean) { state_changes++; }
+	void DepthFunc(GLenum) { state_changes++; }
+	void Enable(GLenum) { state_changes++; }
+	void Disable(GLenum) { state_changes++; }
+	void BlendFunc(GLenum, GLenum) { state_changes++; }
+	void ActiveTexture(GLenum) { texture_binds++; }
+	void BindTexture(GLenum, GLuint) { texture_binds++; }
+	void BindFramebuffer(GLenum, GLuint) { buffer_binds++; }
+	void BindVertexArray(GLuint) { buffer_binds++; }
+	void BindBuffer(GLenum, GLuint) { buffer_binds++; }
+	void Viewport(int, int) { state_changes++; }
+	void Clear(GLbitfield) { clears++; }
+};
+
+/// Caches OpenGL state to skip redundant state changes, Device issues the calls.
+template <class Device>
+class GraphicsStateBase
 {
 public:
-	GraphicsState() :
+	GraphicsStateBase() :
 		tutex(),
 		tuactive(0),
 		fbread(0),
@@ -54,36 +97,36 @@ public:
 		if (color && depth)
 		{
 			if (!colormask || !alphamask)
-				glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+				device.ColorMask(GL_TRUE, GL_TRUE);
 			if (!depthmask)
-				glDepthMask(GL_TRUE);
+				device.DepthMask(GL_TRUE);
 
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			device.Clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 			if (!colormask || !alphamask)
-				glColorMask(colormask, colormask, colormask, alphamask);
+				device.ColorMask(colormask, alphamask);
 			if (!depthmask)
-				glDepthMask(GL_FALSE);
+				device.DepthMask(GL_FALSE);
 		}
 		else if (color)
 		{
 			if (!colormask || !alphamask)
-				glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+				device.ColorMask(GL_TRUE, GL_TRUE);
 
-			glClear(GL_COLOR_BUFFER_BIT);
+			device.Clear(GL_COLOR_BUFFER_BIT);
 
 			if (!colormask || !alphamask)
-				glColorMask(colormask, colormask, colormask, alphamask);
+				device.ColorMask(colormask, alphamask);
 		}
 		else if (depth)
 		{
 			if (!depthmask)
-				glDepthMask(GL_TRUE);
+				device.DepthMask(GL_TRUE);
 
-			glClear(GL_DEPTH_BUFFER_BIT);
+			device.Clear(GL_DEPTH_BUFFER_BIT);
 
 			if (!depthmask)
-				glDepthMask(GL_FALSE);
+				device.DepthMask(GL_FALSE);
 		}
 	}
 
@@ -93,7 +136,7 @@ public:
 		{
 			colormask = writecolor;
 			alphamask = writealpha;
-			glColorMask(colormask, colormask, colormask, alphamask);
+			device.ColorMask(colormask, alphamask);
 		}
 	}
 
@@ -103,17 +146,17 @@ public:
 		if (writedepth != depthmask)
 		{
 			depthmask = writedepth;
-			glDepthMask(depthmask);
+			device.DepthMask(depthmask);
 		}
 		if (testdepth != depthmode)
 		{
 			depthmode = testdepth;
-			glDepthFunc(depthmode);
+			device.DepthFunc(depthmode);
 		}
 		if (test != depthtest)
 		{
 			depthtest = test;
-			depthtest ? glEnable(GL_DEPTH_TEST) : glDisable(GL_DEPTH_TEST);
+			depthtest ? device.Enable(GL_DEPTH_TEST) : device.Disable(GL_DEPTH_TEST);
 		}
 	}
 
@@ -122,8 +165,8 @@ public:
 		if (enable != depthoffset)
 		{
 			depthoffset = enable;
-			depthoffset ? glEnable(GL_POLYGON_OFFSET_FILL) :
-				glDisable(GL_POLYGON_OFFSET_FILL);
+			depthoffset ? device.Enable(GL_POLYGON_OFFSET_FILL) :
+				device.Disable(GL_POLYGON_OFFSET_FILL);
 		}
 	}
 
@@ -132,7 +175,7 @@ public:
 		if (enable != blend)
 		{
 			blend = enable;
-			blend ? glEnable(GL_BLEND) : glDisable(GL_BLEND);
+			blend ? device.Enable(GL_BLEND) : device.Disable(GL_BLEND);
 		}
 	}
 
@@ -141,7 +184,7 @@ public:
 		if (enable != cull)
 		{
 			cull = enable;
-			cull ? glEnable(GL_CULL_FACE) :	glDisable(GL_CULL_FACE);
+			cull ? device.Enable(GL_CULL_FACE) :	device.Disable(GL_CULL_FACE);
 		}
 	}
 
@@ -151,7 +194,7 @@ public:
 		{
 			blendsource = s;
 			blenddest = d;
-			glBlendFunc(s, d);
+			device.BlendFunc(s, d);
 		}
 	}
 
@@ -161,7 +204,7 @@ public:
 		if (tuactive != texunit)
 		{
 			tuactive = texunit;
-			glActiveTexture(GL_TEXTURE0 + tuactive);
+			device.ActiveTexture(GL_TEXTURE0 + tuactive);
 		}
 	}
 
@@ -176,7 +219,7 @@ public:
 			tutex[texunit] = texture;
 		}
 		ActiveTexture(texunit);
-		glBindTexture(target, texture);
+		device.BindTexture(target, texture);
 	}
 
 	void BindFramebuffer(GLenum target, GLuint framebuffer)
@@ -184,18 +227,18 @@ public:
 		if (target == GL_READ_FRAMEBUFFER && fbread != framebuffer)
 		{
 			fbread = framebuffer;
-			glBindFramebuffer(target, framebuffer);
+			device.BindFramebuffer(target, framebuffer);
 		}
 		else if (target == GL_DRAW_FRAMEBUFFER && fbdraw != framebuffer)
 		{
 			fbdraw = framebuffer;
-			glBindFramebuffer(target, framebuffer);
+			device.BindFramebuffer(target, framebuffer);
 		}
 		else if (target == GL_FRAMEBUFFER && (fbread != framebuffer || fbdraw != framebuffer))
 		{
 			fbread = framebuffer;
 			fbdraw = framebuffer;
-			glBindFramebuffer(target, framebuffer);
+			device.BindFramebuffer(target, framebuffer);
 		}
 	}
 
@@ -205,7 +248,7 @@ public:
 		{
 			vpwidth = width;
 			vpheight = height;
-			glViewport(0, 0, vpwidth, vpheight);
+			device.Viewport(vpwidth, vpheight);
 		}
 	}
 
@@ -214,17 +257,22 @@ public:
 		return vobject;
 	}
 
+	const Device & GetDevice() const
+	{
+		return device;
+	}
+
 	// reset vao/vbo/ibo state and clear vobject
 	void ResetVertexObject()
 	{
-		if (GLC_ARB_vertex_array_object)
-			glBindVertexArray(0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		device.BindVertexArray(0);
+		device.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		device.BindBuffer(GL_ARRAY_BUFFER, 0);
 		vobject = 0;
 	}
 
 private:
+	Device device;
 	GLuint tutex[32];	// cache bound 2d textures
 	GLuint tuactive;	// cache active texture unit
 	GLuint fbread;
@@ -244,5 +292,10 @@ private:
 	bool cull;
 };
 
+/// State cache of the OpenGL context.
+class GraphicsState : public GraphicsStateBase<GraphicsDeviceGL>
+{
+};
+
 #endif // _GRAPHICS_STATE_H
 
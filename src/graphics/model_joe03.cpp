@@ -19,6 +19,7 @@
 
 #include "model_joe03.h"
 #include "joepack.h"
+#include "mappedfile.h"
 #include "mathvector.h"
 #include "endian_utility.h"
 
@@ -26,6 +27,7 @@
 #include <functional>
 #include <vector>
 #include <cassert>
+#include <cstring>
 
 using std::vector;
 
@@ -145,23 +147,39 @@ static void CorrectEndian(std::vector<JoeTexCoord> & p)
 	}
 }
 
-static int BinaryRead ( void * buffer, unsigned int size, unsigned int count, FILE * f, const JoePack * pack )
+// Sequential reader of the model file data in memory
+struct JoeReader
 {
-	unsigned int bytesread = 0;
+	const char * data;
+	unsigned int size;
+	unsigned int pos;
 
-	if ( pack == NULL )
+	JoeReader(const char * data, unsigned int size) : data(data), size(size), pos(0) {}
+
+	// returns false if past the end of the data
+	template <typename T>
+	bool Read(T & value)
 	{
-		bytesread = fread ( buffer, size, count, f );
+		if (size - pos < sizeof(T))
+			return false;
+		std::memcpy(&value, data + pos, sizeof(T));
+		pos += sizeof(T);
+		return true;
 	}
-	else
+
+	// resize v to count and read its elements, returns false if past the end of the data
+	template <typename T>
+	bool Read(std::vector<T> & v, unsigned int count)
 	{
-		bytesread = pack->fread ( buffer, size, count );
+		if ((size - pos) / sizeof(T) < count)
+			return false;
+		v.resize(count);
+		if (count > 0)
+			std::memcpy(v.data(), data + pos, count * sizeof(T));
+		pos += count * sizeof(T);
+		return true;
 	}
-
-	assert(bytesread == count);
-
-	return bytesread;
-}
+};
 
 ///fix invalid normals (my own fault, i suspect.  the DOF converter i wrote may have flipped Y & Z normals)
 static bool NeedsNormalSwap(JoeObject & object)
@@ -208,34 +226,30 @@ bool ModelJoe03::Load ( const std::string & filename, std::ostream & err_output,
 {
 	Clear();
 
-	FILE * m_FilePointer = NULL;
-
-	//open file
+	//read straight from the file mapping or the pack view
+	MappedFile file;
+	const char * data = NULL;
+	unsigned int size = 0;
 	if ( pack == NULL )
 	{
-		m_FilePointer = fopen(filename.c_str(), "rb");
-		if (!m_FilePointer)
+		if (!file.Open(filename))
 		{
 			err_output << "MODEL_JOE03: Failed to open file " << filename << std::endl;
 			return false;
 		}
+		data = file.GetData();
+		size = file.GetSize();
 	}
 	else
 	{
-		if (!pack->fopen(filename))
+		if (!pack->GetFile(filename, data, size))
 		{
 			err_output << "MODEL_JOE03: Failed to open file " << filename << " in " << pack->GetPath() << std::endl;
 			return false;
 		}
 	}
 
-	bool loaded = LoadFromHandle ( m_FilePointer, pack, err_output );
-
-	// Clean up after everything
-	if ( pack == NULL )
-		fclose ( m_FilePointer );
-	else
-		pack->fclose();
+	bool loaded = LoadFromMemory ( data, size, err_output );
 
 	if (!loaded)
 		err_output << "in " << filename << std::endl;
@@ -243,12 +257,17 @@ bool ModelJoe03::Load ( const std::string & filename, std::ostream & err_output,
 	return loaded;
 }
 
-bool ModelJoe03::LoadFromHandle ( FILE * m_FilePointer, const JoePack * pack, std::ostream & err_output )
+bool ModelJoe03::LoadFromMemory ( const char * data, unsigned int size, std::ostream & err_output )
 {
 	JoeObject object;
+	JoeReader reader ( data, size );
 
 	// Read the header data and store it in our variable
-	BinaryRead ( &object.info, sizeof ( JoeHeader ), 1, m_FilePointer, pack );
+	if ( !reader.Read ( object.info ) )
+	{
+		err_output << "Unexpected end of file. ";
+		return false;
+	}
 
 	object.info.magic = ENDIAN_SWAP_32 ( object.info.magic );
 	object.info.version = ENDIAN_SWAP_32 ( object.info.version );
@@ -270,7 +289,11 @@ bool ModelJoe03::LoadFromHandle ( FILE * m_FilePointer, const JoePack * pack, st
 	}
 
 	// Read in the model data
-	ReadData ( m_FilePointer, pack, object );
+	if ( !ReadData ( reader, object ) )
+	{
+		err_output << "Unexpected end of file. ";
+		return false;
+	}
 
 	//generate metrics such as bounding box, etc
 	GenMeshMetrics();
@@ -279,7 +302,7 @@ bool ModelJoe03::LoadFromHandle ( FILE * m_FilePointer, const JoePack * pack, st
 	return true;
 }
 
-void ModelJoe03::ReadData ( FILE * m_FilePointer, const JoePack * pack, JoeObject & object )
+bool ModelJoe03::ReadData ( JoeReader & reader, JoeObject & object )
 {
 	unsigned int num_frames = object.info.num_frames;
 	unsigned int num_faces = object.info.num_faces;
@@ -290,27 +313,26 @@ void ModelJoe03::ReadData ( FILE * m_FilePointer, const JoePack * pack, JoeObjec
 	{
 		JoeFrame & frame = object.frames[i];
 
-		frame.faces.resize(num_faces);
-
-		BinaryRead ( frame.faces.data(), sizeof ( JoeFace ), num_faces, m_FilePointer, pack );
+		if ( !reader.Read ( frame.faces, num_faces ) )
+			return false;
 		CorrectEndian ( frame.faces );
 
-		BinaryRead ( &frame.num_verts, sizeof ( unsigned int ), 1, m_FilePointer, pack );
+		if ( !reader.Read ( frame.num_verts ) ||
+			!reader.Read ( frame.num_texcoords ) ||
+			!reader.Read ( frame.num_normals ) )
+			return false;
 		frame.num_verts = ENDIAN_SWAP_32 ( frame.num_verts );
-		BinaryRead ( &frame.num_texcoords, sizeof ( unsigned int ), 1, m_FilePointer, pack );
 		frame.num_texcoords = ENDIAN_SWAP_32 ( frame.num_texcoords );
-		BinaryRead ( &frame.num_normals, sizeof ( unsigned int ), 1, m_FilePointer, pack );
 		frame.num_normals = ENDIAN_SWAP_32 ( frame.num_normals );
 
-		frame.verts.resize(frame.num_verts);
-		frame.normals.resize(frame.num_normals);
-		frame.texcoords.resize(frame.num_texcoords);
-
-		BinaryRead ( frame.verts.data(), sizeof ( JoeVertex ), frame.num_verts, m_FilePointer, pack );
+		if ( !reader.Read ( frame.verts, frame.num_verts ) )
+			return false;
 		CorrectEndian ( frame.verts );
-		BinaryRead ( frame.normals.data(), sizeof ( JoeVertex ), frame.num_normals, m_FilePointer, pack );
+		if ( !reader.Read ( frame.normals, frame.num_normals ) )
+			return false;
 		CorrectEndian ( frame.normals );
-		BinaryRead ( frame.texcoords.data(), sizeof ( JoeTexCoord ), frame.num_texcoords, m_FilePointer, pack );
+		if ( !reader.Read ( frame.texcoords, frame.num_texcoords ) )
+			return false;
 		CorrectEndian ( frame.texcoords );
 
 		// there seem to be models without texcoords like ct/glass.joe, why???
@@ -423,5 +445,7 @@ void ModelJoe03::ReadData ( FILE * m_FilePointer, const JoePack * pack, JoeObjec
 		v_vertices.data(), v_vertices.size(),
 		v_texcoords.data(), v_texcoords.size(),
 		v_normals.data(), v_normals.size());
+
+	return true;
 }
 
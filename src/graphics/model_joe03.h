@@ -27,6 +27,7 @@
 
 class JoePack;
 struct JoeObject;
+struct JoeReader;
 
 // This class handles all of the loading code
 class ModelJoe03 : public Model
@@ -44,14 +45,16 @@ public:
 
 	bool Load(const std::string & strFileName, std::ostream & error_output, const JoePack * pack);
 
+	// Load from the model file data in memory
+	bool LoadFromMemory(const char * data, unsigned int size, std::ostream & error_output);
+
 	static const unsigned int JOE_MAX_FACES;
 	static const unsigned int JOE_VERSION;
 
 private:
 	// This reads in the data from the MD2 file and stores it in the member variable
-	void ReadData(FILE * m_FilePointer, const JoePack * pack, JoeObject & Object);
-
-	bool LoadFromHandle(FILE * f, const JoePack * pack, std::ostream & error_output);
+	// returns false if the data ends early
+	bool ReadData(JoeReader & reader, JoeObject & Object);
 };
 
 #endif
@@ -188,24 +188,16 @@ void RenderInputScene::Render(GraphicsState & glstate, std::ostream & /*error_ou
 	shader->SetUniform3f(Uniforms::LightDirection, lightvec[0], lightvec[1], lightvec[2]);
 	shader->SetUniform1f(Uniforms::Contrast, contrast);
 
-	Draw(glstate, *drawlist_ptr);
-}
-
-void RenderInputScene::Draw(GraphicsState & glstate, const std::vector <Drawable*> & drawlist)
-{
-	for (auto d : drawlist)
+	Draw(glstate, *drawlist_ptr, [this, &glstate](const Drawable & d)
 	{
-		SetFlags(*d, glstate);
-		SetTextures(*d, glstate);
-		SetTransform(*d);
-		vertex_buffer.Draw(glstate.VertexObject(), d->GetVertexBufferSegment());
-	}
+		SetColor(d);
+		SetTransform(d);
+		vertex_buffer.Draw(glstate.VertexObject(), d.GetVertexBufferSegment());
+	});
 }
 
-void RenderInputScene::SetFlags(const Drawable & d, GraphicsState & glstate)
+void RenderInputScene::SetColor(const Drawable & d)
 {
-	glstate.DepthOffset(d.GetDecal());
-	glstate.CullFace(d.GetCull());
 	if (drawable_color != d.GetColor())
 	{
 		drawable_color = d.GetColor();
@@ -213,13 +205,6 @@ void RenderInputScene::SetFlags(const Drawable & d, GraphicsState & glstate)
 	}
 }
 
-void RenderInputScene::SetTextures(const Drawable & d, GraphicsState & glstate)
-{
-	glstate.BindTexture(0, GL_TEXTURE_2D, d.GetTexture0());
-	glstate.BindTexture(1, GL_TEXTURE_2D, d.GetTexture1());
-	glstate.BindTexture(2, GL_TEXTURE_2D, d.GetTexture2());
-}
-
 void RenderInputScene::SetTransform(const Drawable & d)
 {
 	if (!drawable_transform.Equals(d.GetTransform()))
@@ -21,6 +21,8 @@
 #define _RENDER_INPUT_SCENE_H
 
 #include "render_input.h"
+#include "drawable.h"
+#include "glcore.h"
 #include "mathvector.h"
 #include "quaternion.h"
 #include "matrix4.h"
@@ -29,7 +31,6 @@
 #include <vector>
 
 struct GraphicsCamera;
-class Drawable;
 class Shader;
 class TextureInterface;
 class VertexBuffer;
@@ -71,6 +72,11 @@ public:
 
 	void Render(GraphicsState & glstate, std::ostream & error_output) override;
 
+	/// Set the render state of each drawable through glstate and call draw for it.
+	/// Render passes GraphicsState, other states can count the state changes.
+	template <class State, class DrawFunc>
+	static void Draw(State & glstate, const std::vector <Drawable*> & drawlist, DrawFunc && draw);
+
 private:
 	VertexBuffer & vertex_buffer;
 	reseatable_reference <const std::vector <Drawable*> > drawlist_ptr;
@@ -89,13 +95,23 @@ private:
 	unsigned fsaa;
 	float contrast;
 
-	void Draw(GraphicsState & glstate, const std::vector <Drawable*> & drawlist);
-
-	void SetFlags(const Drawable & d, GraphicsState & glstate);
-
-	void SetTextures(const Drawable & d, GraphicsState & glstate);
+	void SetColor(const Drawable & d);
 
 	void SetTransform(const Drawable & d);
 };
 
+template <class State, class DrawFunc>
+inline void RenderInputScene::Draw(State & glstate, const std::vector <Drawable*> & drawlist, DrawFunc && draw)
+{
+	for (auto d : drawlist)
+	{
+		glstate.DepthOffset(d->GetDecal());
+		glstate.CullFace(d->GetCull());
+		glstate.BindTexture(0, GL_TEXTURE_2D, d->GetTexture0());
+		glstate.BindTexture(1, GL_TEXTURE_2D, d->GetTexture1());
+		glstate.BindTexture(2, GL_TEXTURE_2D, d->GetTexture2());
+		draw(*d);
+	}
+}
+
 #endif // _RENDER_INPUT_SCENE_H
@@ -0,0 +1,111 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "scenenode.h"
+#include "microbench.h"
+#include "unittest.h"
+
+namespace
+{
+	template <typename T> class PtrVector : public std::vector<T*> {};
+}
+
+static Vec3 GetPosition(const Drawable & d)
+{
+	const Mat4 & m = d.GetTransform();
+	return Vec3(m[12], m[13], m[14]);
+}
+
+QT_TEST(scenenode_test)
+{
+	SceneNode root;
+	SceneNode::Handle a = root.AddNode();
+	SceneNode::Handle b = root.GetNode(a).AddNode();
+	SceneNode & node_a = root.GetNode(a);
+	SceneNode & node_b = node_a.GetNode(b);
+	node_a.GetTransform().SetTranslation(Vec3(1, 0, 0));
+	node_b.GetTransform().SetTranslation(Vec3(0, 2, 0));
+	SceneNode::DrawableHandle da = node_a.GetDrawList().normal_noblend.insert(Drawable());
+	SceneNode::DrawableHandle db = node_b.GetDrawList().normal_noblend.insert(Drawable());
+	Drawable & drawable_a = node_a.GetDrawList().normal_noblend.get(da);
+	Drawable & drawable_b = node_b.GetDrawList().normal_noblend.get(db);
+
+	DrawableContainer<PtrVector> output;
+	const Mat4 identity;
+	root.Traverse(output, identity);
+	QT_CHECK_EQUAL(output.normal_noblend.size(), 2);
+	QT_CHECK(GetPosition(drawable_a) == Vec3(1, 0, 0));
+	QT_CHECK(GetPosition(drawable_b) == Vec3(1, 2, 0));
+	QT_CHECK(node_b.TransformIntoWorldSpace(Vec3(0, 0, 1)) == Vec3(1, 2, 1));
+
+	// clean subtrees keep their drawable transforms
+	drawable_b.SetTransform(identity);
+	output.clear();
+	root.Traverse(output, identity);
+	QT_CHECK_EQUAL(output.normal_noblend.size(), 2);
+	QT_CHECK(GetPosition(drawable_b) == Vec3(0, 0, 0));
+
+	// moving a node updates its subtree
+	node_a.GetTransform().SetTranslation(Vec3(5, 0, 0));
+	output.clear();
+	root.Traverse(output, identity);
+	QT_CHECK(GetPosition(drawable_a) == Vec3(5, 0, 0));
+	QT_CHECK(GetPosition(drawable_b) == Vec3(5, 2, 0));
+
+	// setting the same transform doesn't touch the drawables
+	drawable_b.SetTransform(identity);
+	node_a.GetTransform().SetTranslation(Vec3(5, 0, 0));
+	output.clear();
+	root.Traverse(output, identity);
+	QT_CHECK(GetPosition(drawable_b) == Vec3(0, 0, 0));
+	QT_CHECK(!node_a.GetTransform().GetChanged());
+}
+
+MB_BENCHMARK(scenenode_benchmark)
+{
+	// a track like tree of static objects and a few moving cars
+	SceneNode root;
+	std::vector<SceneNode::Handle> objects;
+	for (int i = 0; i < 1000; ++i)
+	{
+		SceneNode::Handle h = root.AddNode();
+		SceneNode & node = root.GetNode(h);
+		node.GetTransform().SetTranslation(Vec3(i, 0, 0));
+		for (int j = 0; j < 4; ++j)
+			node.GetDrawList().normal_noblend.insert(Drawable());
+		objects.push_back(h);
+	}
+
+	DrawableContainer<PtrVector> output;
+	const Mat4 identity;
+	Quat rotation;
+	float angle = 0;
+	auto traverse = [&](int moving)
+	{
+		angle += 0.01f;
+		rotation.Rotate(angle, 0, 0, 1);
+		for (int i = 0; i < moving; ++i)
+			root.GetNode(objects[i]).GetTransform().SetRotation(rotation);
+		output.clear();
+		root.Traverse(output, identity);
+	};
+
+	out << "scene traversal 1000 nodes, 8 moving: " << microbench::measure([&] { traverse(8); }) << " ns" << std::endl;
+	out << "scene traversal 1000 nodes, all moving: " << microbench::measure([&] { traverse(1000); }) << " ns" << std::endl;
+}
@@ -58,6 +58,9 @@ public:
 	template <class Stream>
 	void DebugPrint(Stream & out, int curdepth = 0) const;
 
+	/// Append the enabled drawables of the subtree to drawlist_output. World transforms
+	/// are only recomputed for nodes whose transform or parent changed since the last
+	/// traversal, drawables of clean subtrees keep their transforms.
 	template <template <typename U> class T>
 	void Traverse(DrawableContainer <T> & drawlist_output, const Mat4 & prev_transform);
 
@@ -77,7 +80,10 @@ private:
 	List childlist;
 	DrawableList drawlist;
 	Transform transform;
-	Mat4 cached_transform;
+	Mat4 cached_transform; ///< world transform of the last traversal
+
+	template <template <typename U> class T>
+	void Traverse(DrawableContainer <T> & drawlist_output, const Mat4 & parent_transform, bool parent_changed);
 };
 
 
@@ -189,27 +195,40 @@ inline void SceneNode::DebugPrint(Stream & out, int curdepth) const
 template <template <typename U> class T>
 inline void SceneNode::Traverse(DrawableContainer <T> & drawlist_output, const Mat4 & prev_transform)
 {
-	Mat4 this_transform(prev_transform);
+	// prev_transform isn't tracked, always update the root
+	Traverse(drawlist_output, prev_transform, true);
+}
 
-	bool identitytransform = transform.IsIdentityTransform();
-	if (!identitytransform)
+template <template <typename U> class T>
+inline void SceneNode::Traverse(DrawableContainer <T> & drawlist_output, const Mat4 & parent_transform, bool parent_changed)
+{
+	bool changed = false;
+	if (parent_changed || transform.GetChanged())
 	{
-		transform.GetRotation().GetMatrix4(this_transform);
-		this_transform.Translate(transform.GetTranslation()[0], transform.GetTranslation()[1], transform.GetTranslation()[2]);
-		this_transform = this_transform.Multiply(prev_transform);
+		Mat4 this_transform(parent_transform);
+
+		bool identitytransform = transform.IsIdentityTransform();
+		if (!identitytransform)
+		{
+			transform.GetRotation().GetMatrix4(this_transform);
+			this_transform.Translate(transform.GetTranslation()[0], transform.GetTranslation()[1], transform.GetTranslation()[2]);
+			this_transform = this_transform.Multiply(parent_transform);
+		}
+
+		changed = (this_transform != cached_transform);
+		cached_transform = this_transform;
+		transform.ClearChanged();
 	}
 
-	if (this_transform != cached_transform)
-		drawlist.AppendTo<T,true>(drawlist_output, this_transform);
+	if (changed)
+		drawlist.AppendTo<T,true>(drawlist_output, cached_transform);
 	else
-		drawlist.AppendTo<T,false>(drawlist_output, this_transform);
+		drawlist.AppendTo<T,false>(drawlist_output, cached_transform);
 
 	for (auto & child : childlist)
 	{
-		child.Traverse(drawlist_output, this_transform);
+		child.Traverse(drawlist_output, cached_transform, changed);
 	}
-
-	cached_transform = this_transform;
 }
 
 template <typename T>
@@ -20,8 +20,10 @@
 #include "texture.h"
 #include "glcore.h"
 #include "glutil.h"
-#include "bcndecode.h"
+#include "bcndecodeparallel.h"
 #include "dds.h"
+#include "mappedfile.h"
+#include "texturecache.h"
 
 #ifdef __APPLE__
 #include <SDL2_image/SDL_image.h>
@@ -31,7 +33,6 @@
 
 #include <string>
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <cassert>
 
@@ -244,6 +245,33 @@ static char * GetCubeVerticalCrossFace(
 	return cubeface;
 }
 
+// image decoded by Texture::Decode, waiting for upload
+struct Texture::Image
+{
+	std::string path;
+	TextureInfo info;
+
+	// sdl image, pixels point into surface or downsampled
+	SDL_Surface * surface;
+	std::vector<unsigned char> downsampled;
+	const unsigned char * pixels;
+
+	// dds image, data points into the file mapping
+	MappedFile file;
+	const char * data;
+	unsigned long length;
+	unsigned format;
+	unsigned levels;
+
+	Image() : surface(0), pixels(0), data(0), length(0), format(0), levels(0) {}
+
+	~Image()
+	{
+		if (surface)
+			SDL_FreeSurface(surface);
+	}
+};
+
 Texture::Texture()
 {
 	// ctor
@@ -254,9 +282,19 @@ Texture::~Texture()
 	Unload();
 }
 
+void Texture::InitDecoders()
+{
+	IMG_Init(IMG_INIT_JPG | IMG_INIT_PNG);
+}
+
 bool Texture::Load(const std::string & path, const TextureInfo & info, std::ostream & error)
 {
-	if (texid)
+	return Decode(path, info, error) && Upload(error);
+}
+
+bool Texture::Decode(const std::string & path, const TextureInfo & info, std::ostream & error)
+{
+	if (texid || image)
 	{
 		error << "Tried to double load texture " << path << std::endl;
 		return false;
@@ -268,14 +306,23 @@ bool Texture::Load(const std::string & path, const TextureInfo & info, std::ostr
 		return false;
 	}
 
-	if (!info.data && LoadDDS(path, info, error))
+	std::unique_ptr<Image> img(new Image());
+	img->path = path;
+	img->info = info;
+
+	if (!info.data && DecodeDDS(*img, error))
 	{
+		image = std::move(img);
 		return true;
 	}
 
 	if (info.cube)
 	{
-		return LoadCube(path, info, error);
+		if (!DecodeCube(*img, error))
+			return false;
+
+		image = std::move(img);
+		return true;
 	}
 
 	SDL_Surface * surface = 0;
@@ -309,6 +356,7 @@ bool Texture::Load(const std::string & path, const TextureInfo & info, std::ostr
 		error << IMG_GetError() << std::endl;
 		return false;
 	}
+	img->surface = surface;
 
 	const unsigned char * pixels = (const unsigned char *)surface->pixels;
 	const unsigned bytespp = surface->format->BytesPerPixel;
@@ -317,7 +365,6 @@ bool Texture::Load(const std::string & path, const TextureInfo & info, std::ostr
 	unsigned h = surface->h;
 
 	// downsample if requested by application
-	std::vector<unsigned char> pixelsd;
 	unsigned wd = w;
 	unsigned hd = h;
 	if (info.maxsize == TextureInfo::SMALL)
@@ -342,17 +389,17 @@ bool Texture::Load(const std::string & path, const TextureInfo & info, std::ostr
 	}
 	if (wd < w || hd < h)
 	{
-		pixelsd.resize(wd * hd * bytespp);
+		img->downsampled.resize(wd * hd * bytespp);
 
 		SampleDownAvg(
 			bytespp, w, h, pitch, pixels,
-			wd, hd, wd * bytespp, pixelsd.data());
+			wd, hd, wd * bytespp, img->downsampled.data());
 
-		pixels = pixelsd.data();
-		pitch = wd * bytespp;
+		pixels = img->downsampled.data();
 		w = wd;
 		h = hd;
 	}
+	img->pixels = pixels;
 
 	// store dimensions
 	width = w;
@@ -360,19 +407,93 @@ bool Texture::Load(const std::string & path, const TextureInfo & info, std::ostr
 
 	target = GL_TEXTURE_2D;
 
+	image = std::move(img);
+	return true;
+}
+
+bool Texture::WriteCache(const std::string & file, std::ostream & error) const
+{
+	if (!image || !image->surface || target != GL_TEXTURE_2D)
+		return false;
+
+	// byte offsets of the color channels
+	const SDL_PixelFormat * pf = image->surface->format;
+	const unsigned bytespp = pf->BytesPerPixel;
+	if (bytespp != 3 && bytespp != 4)
+		return false;
+
+	unsigned offset[4];
+	const unsigned shift[4] = {pf->Rshift, pf->Gshift, pf->Bshift, pf->Ashift};
+	for (int c = 0; c < 4; ++c)
+	{
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+		offset[c] = bytespp - 1 - shift[c] / 8;
+#else
+		offset[c] = shift[c] / 8;
+#endif
+	}
+
+	const unsigned pitch = image->downsampled.empty() ? image->surface->pitch : width * bytespp;
+	std::vector<unsigned char> rgba(width * height * 4);
+	for (unsigned y = 0; y < height; ++y)
+	{
+		const unsigned char * src = image->pixels + y * pitch;
+		unsigned char * dst = &rgba[y * width * 4];
+		for (unsigned x = 0; x < width; ++x, src += bytespp, dst += 4)
+		{
+			dst[0] = src[offset[0]];
+			dst[1] = src[offset[1]];
+			dst[2] = src[offset[2]];
+			dst[3] = pf->Amask ? src[offset[3]] : 255;
+		}
+	}
+
+	// same policy as GetTextureFormat, block compression needs whole blocks
+	const bool compress = image->info.compress &&
+		(image->surface->w > 512 || image->surface->h > 512) &&
+		width % 4 == 0 && height % 4 == 0;
+
+	return TextureCache::Write(file, rgba.data(), width, height, compress, error);
+}
+
+bool Texture::Upload(std::ostream & error, JobSystem * jobs)
+{
+	if (!image)
+		return true;
+
+	std::unique_ptr<Image> img = std::move(image);
+	if (img->data)
+		return UploadDDS(*img, error, jobs);
+
+	if (target == GL_TEXTURE_CUBE_MAP)
+		return UploadCube(*img, error);
+
+	return Upload2D(*img, error);
+}
+
+void Texture::Unload()
+{
+	image.reset();
+	if (texid)
+		glDeleteTextures(1, &texid);
+	texid = 0;
+}
+
+bool Texture::Upload2D(const Image & img, std::ostream & error)
+{
 	// gen texture
 	glGenTextures(1, &texid);
 	CheckForOpenGLErrors("Texture ID generation", error);
 
 	// setup texture
 	glBindTexture(target, texid);
-	SetSampler(info);
+	SetSampler(img.info);
 
 	int iformat, format;
-	GetTextureFormat(surface, info, iformat, format);
+	GetTextureFormat(img.surface, img.info, iformat, format);
 
 	// upload texture data
-	glTexImage2D(target, 0, iformat, w, h, 0, format, GL_UNSIGNED_BYTE, pixels);
+	glTexImage2D(target, 0, iformat, width, height, 0, format, GL_UNSIGNED_BYTE, img.pixels);
 	CheckForOpenGLErrors("Texture creation", error);
 
 	// If we support generatemipmap, go ahead and do it regardless of the info.mipmap setting.
@@ -381,32 +502,24 @@ bool Texture::Load(const std::string & path, const TextureInfo & info, std::ostr
 	if (GLC_ARB_framebuffer_object)
 		glGenerateMipmap(target);
 
-	SDL_FreeSurface(surface);
-
 	return true;
 }
 
-void Texture::Unload()
-{
-	if (texid)
-		glDeleteTextures(1, &texid);
-	texid = 0;
-}
-
-bool Texture::LoadCube(const std::string & path, const TextureInfo & info, std::ostream & error)
+bool Texture::DecodeCube(Image & img, std::ostream & error)
 {
-	SDL_Surface * surface = IMG_Load(path.c_str());
+	SDL_Surface * surface = IMG_Load(img.path.c_str());
 	if (!surface)
 	{
-		error << "Error loading texture file: " << path << std::endl;
+		error << "Error loading texture file: " << img.path << std::endl;
 		error << IMG_GetError() << std::endl;
 		return false;
 	}
+	img.surface = surface;
 
 	// get dimensions
 	unsigned wtiles = 1;
 	unsigned htiles = 6;
-	if (info.verticalcross)
+	if (img.info.verticalcross)
 	{
 		wtiles = 3;
 		htiles = 4;
@@ -422,23 +535,29 @@ bool Texture::LoadCube(const std::string & path, const TextureInfo & info, std::
 	}
 
 	target = GL_TEXTURE_CUBE_MAP;
+	return true;
+}
+
+bool Texture::UploadCube(const Image & img, std::ostream & error)
+{
+	const SDL_Surface * surface = img.surface;
 
 	glGenTextures(1, &texid);
 	CheckForOpenGLErrors("Cubemap texture ID generation", error);
 
 	glBindTexture(target, texid);
-	SetSampler(info);
+	SetSampler(img.info);
 
 	int iformat, format;
-	GetTextureFormat(surface, info, iformat, format);
+	GetTextureFormat(surface, img.info, iformat, format);
 
 	const unsigned itarget = GL_TEXTURE_CUBE_MAP_POSITIVE_X;
 	const unsigned ilen = width * height * surface->format->BytesPerPixel;
-	std::vector<char> face(info.verticalcross ? ilen : 0); // verticalcross face buffer
+	std::vector<char> face(img.info.verticalcross ? ilen : 0); // verticalcross face buffer
 	for (int i = 0; i < 6; ++i)
 	{
 		const char * idata;
-		if (info.verticalcross)
+		if (img.info.verticalcross)
 			idata = GetCubeVerticalCrossFace(i, surface, face.data(), width, height);
 		else
 			idata = (const char *)surface->pixels + ilen * i;
@@ -447,46 +566,46 @@ bool Texture::LoadCube(const std::string & path, const TextureInfo & info, std::
 	}
 	CheckForOpenGLErrors("Cubemap creation", error);
 
-	SDL_FreeSurface(surface);
 	return true;
 }
 
-bool Texture::LoadDDS(const std::string & path, const TextureInfo & info, std::ostream & error)
+bool Texture::DecodeDDS(Image & img, std::ostream & error)
 {
-	std::ifstream file(path.c_str(), std::ifstream::in | std::ifstream::binary);
-	if (!file)
+	// decode straight from the file mapping
+	MappedFile & file = img.file;
+	if (!file.Open(img.path))
 		return false;
 
 	// test for dds magic value
-	char magic[4];
-	file.read(magic, 4);
-	if (!IsDDS(magic, 4))
+	const unsigned long length = file.GetSize();
+	if (length < 4 || !IsDDS(file.GetData(), 4))
+	{
+		file.Close();
 		return false;
-
-	// get length of file:
-	file.seekg (0, file.end);
-	const unsigned long length = file.tellg();
-	file.seekg (0, file.beg);
-
-	// read file into memory
-	std::vector<char> data(length);
-	file.read(data.data(), length);
+	}
 
 	// load dds
-	const char * texdata(0);
-	unsigned long texlen(0);
-	unsigned format(0);
-	unsigned levels(0);
 	if (!ReadDDS(
-		(void*)data.data(), length,
-		(const void*&)texdata, texlen,
-		format, target,
-		width, height, levels))
+		file.GetData(), length,
+		(const void*&)img.data, img.length,
+		img.format, target,
+		width, height, img.levels))
 	{
-		error << "Failed ReadDDS " << path << std::endl;
+		error << "Failed ReadDDS " << img.path << std::endl;
+		img.data = 0;
+		file.Close();
 		return false;
 	}
 
+	return true;
+}
+
+bool Texture::UploadDDS(const Image & img, std::ostream & error, JobSystem * jobs)
+{
+	const TextureInfo & info = img.info;
+	const unsigned format = img.format;
+	const unsigned levels = img.levels;
+
 	// load texture
 	assert(!texid);
 	glGenTextures(1, &texid);
@@ -495,8 +614,12 @@ bool Texture::LoadDDS(const std::string & path, const TextureInfo & info, std::o
 	glBindTexture(target, texid);
 	SetSampler(info, levels > 1);
 
-	// gl3 renderer expects srgb
+	// gl3 renderer expects srgb, uncompressed data needs a sized internal format
 	unsigned iformat = format;
+	if (format == GL_BGR)
+		iformat = GL_RGB8;
+	else if (format == GL_BGRA)
+		iformat = GL_RGBA8;
 	if (info.srgb)
 	{
 		if (format == GL_BGR)
@@ -528,23 +651,25 @@ bool Texture::LoadDDS(const std::string & path, const TextureInfo & info, std::o
 		faces = 6;
 		itarget = GL_TEXTURE_CUBE_MAP_POSITIVE_X;
 	}
-	const char * idata = texdata;
-	const unsigned blocklen = 16 * texlen / (width * height);
+	// bgr mip levels are tightly packed, rows are not 4 byte aligned
+	if (format == GL_BGR)
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	const char * idata = img.data;
 	for (unsigned j = 0; j < faces; ++j)
 	{
 		unsigned iw = width;
 		unsigned ih = height;
 		for (unsigned i = 0; i < levels; ++i)
 		{
-			unsigned ilen;
+			// partial blocks of levels not a multiple of 4 are stored whole
+			const unsigned ilen = DDSLevelSize(format, iw, ih);
 			if (format == GL_BGR || format == GL_BGRA)
 			{
-				ilen = iw * ih * blocklen / 16;
 				glTexImage2D(itarget, i, iformat, iw, ih, 0, format, GL_UNSIGNED_BYTE, idata);
 			}
 			else
 			{
-				ilen = std::max(1u, iw / 4) * std::max(1u, ih / 4) * blocklen;
 				if (GLC_EXT_texture_compression_s3tc)
 				{
 					glCompressedTexImage2D(itarget, i, iformat, iw, ih, 0, ilen, idata);
@@ -552,9 +677,9 @@ bool Texture::LoadDDS(const std::string & path, const TextureInfo & info, std::o
 				else
 				{
 					cdata.resize(iw * ih * 4);
-					if (BcnDecode(cdata.data(), cdata.size(), idata, ilen, iw, ih, ctype, 0, 0) < 0)
+					if (BcnDecodeParallel(cdata.data(), cdata.size(), idata, ilen, iw, ih, ctype, jobs) < 0)
 					{
-						error << "Failed BcnDecode " << path << std::endl;
+						error << "Failed to decode " << img.path << std::endl;
 						glBindTexture(target, 0);
 						Unload();
 						return false;
@@ -571,6 +696,9 @@ bool Texture::LoadDDS(const std::string & path, const TextureInfo & info, std::o
 		itarget++;
 	}
 
+	if (format == GL_BGR)
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
 	// force mipmaps for GL3
 	if (levels == 1 && GLC_ARB_framebuffer_object)
 		glGenerateMipmap(target);
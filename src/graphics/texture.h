@@ -24,8 +24,11 @@
 #include "textureinfo.h"
 
 #include <iosfwd>
+#include <memory>
 #include <string>
 
+class JobSystem;
+
 class Texture : public TextureInterface
 {
 public:
@@ -33,14 +36,41 @@ public:
 
 	virtual ~Texture();
 
+	/// Initialize the image decoders, has to be called on the main thread
+	/// before textures are decoded on other threads.
+	static void InitDecoders();
+
+	/// Decode and upload.
 	bool Load(const std::string & path, const TextureInfo & info, std::ostream & error);
 
+	/// Decode image into memory. Doesn't call OpenGL, safe to call on a worker thread.
+	/// The texture can not be used before Upload has been called.
+	bool Decode(const std::string & path, const TextureInfo & info, std::ostream & error);
+
+	/// Write the decoded image to a texture cache file, has to be called before Upload.
+	/// The image is compressed if it would be compressed by the upload.
+	bool WriteCache(const std::string & file, std::ostream & error) const;
+
+	/// Create the OpenGL texture from the decoded image and release the image.
+	/// Main thread only, returns true if there is nothing to upload.
+	/// Compressed images are decoded on jobs if not supported by the driver.
+	bool Upload(std::ostream & error, JobSystem * jobs = 0);
+
 	void Unload();
 
 private:
-	bool LoadCube(const std::string & path, const TextureInfo & info, std::ostream & error);
+	struct Image;
+	std::unique_ptr<Image> image;
+
+	bool DecodeCube(Image & img, std::ostream & error);
+
+	bool DecodeDDS(Image & img, std::ostream & error);
+
+	bool Upload2D(const Image & img, std::ostream & error);
+
+	bool UploadCube(const Image & img, std::ostream & error);
 
-	bool LoadDDS(const std::string & path, const TextureInfo & info, std::ostream & error);
+	bool UploadDDS(const Image & img, std::ostream & error, JobSystem * jobs);
 };
 
 #endif //_TEXTURE_H
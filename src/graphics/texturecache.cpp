@@ -0,0 +1,375 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "texturecache.h"
+#include "textureinfo.h"
+#include "bcndecode.h"
+#include "bcnencode.h"
+#include "dds.h"
+#include "mappedfile.h"
+#include "datahash.h"
+#include "unittest.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// bump to invalidate cache files written by older versions
+static const char cache_version = '1';
+
+static void PutU32(std::vector<unsigned char> & out, unsigned value)
+{
+	for (int i = 0; i < 4; ++i)
+		out.push_back((value >> (8 * i)) & 0xff);
+}
+
+// rgba 2x2 box filter, odd sizes repeat the last row/column
+static void Downsample(
+	const unsigned char * src, unsigned w, unsigned h,
+	unsigned char * dst, unsigned wd, unsigned hd)
+{
+	for (unsigned y = 0; y < hd; ++y)
+	{
+		const unsigned y0 = std::min(2 * y, h - 1), y1 = std::min(2 * y + 1, h - 1);
+		for (unsigned x = 0; x < wd; ++x)
+		{
+			const unsigned x0 = std::min(2 * x, w - 1), x1 = std::min(2 * x + 1, w - 1);
+			const unsigned char * p00 = src + (y0 * w + x0) * 4;
+			const unsigned char * p01 = src + (y0 * w + x1) * 4;
+			const unsigned char * p10 = src + (y1 * w + x0) * 4;
+			const unsigned char * p11 = src + (y1 * w + x1) * 4;
+			for (unsigned c = 0; c < 4; ++c)
+				*dst++ = (p00[c] + p01[c] + p10[c] + p11[c] + 2) / 4;
+		}
+	}
+}
+
+std::string TextureCache::GetFile(const std::string & source, const TextureInfo & info) const
+{
+	if (path.empty() || info.data || info.cube)
+		return std::string();
+
+	MappedFile file;
+	if (!file.Open(source) || file.GetSize() < 4 || IsDDS(file.GetData(), 4))
+		return std::string();
+
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx", DataHash(file.GetData(), file.GetSize()));
+
+	std::ostringstream s;
+	s << path << "/" << name << "-" << cache_version << int(info.maxsize) << (info.compress ? "c" : "u") << ".dds";
+	return s.str();
+}
+
+bool TextureCache::Write(
+	const std::string & file,
+	const unsigned char * rgba,
+	unsigned width,
+	unsigned height,
+	bool compress,
+	std::ostream & error)
+{
+	if (!width || !height)
+		return false;
+
+	// opaque images don't need an alpha block
+	int bcn = 1;
+	for (unsigned i = 0; i < width * height && bcn == 1; ++i)
+	{
+		if (rgba[i * 4 + 3] != 255)
+			bcn = 3;
+	}
+
+	unsigned levels = 1;
+	while ((width >> levels) || (height >> levels))
+		levels++;
+
+	// uncompressed opaque images are stored as 24 bit bgr
+	const unsigned bytespp = (bcn == 1) ? 3 : 4;
+
+	// header, see dds.cpp for the layout
+	const unsigned ddsd_flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | (compress ? 0x80000 : 0x8);
+	const unsigned pitch = compress ? BcnEncodedSize(width, height, bcn) : width * bytespp;
+	std::vector<unsigned char> out;
+	PutU32(out, 0x20534444); // magic
+	PutU32(out, 124);
+	PutU32(out, ddsd_flags);
+	PutU32(out, height);
+	PutU32(out, width);
+	PutU32(out, pitch);
+	PutU32(out, 0);
+	PutU32(out, levels);
+	for (int i = 0; i < 11; ++i)
+		PutU32(out, 0);
+	PutU32(out, 32);
+	if (compress)
+	{
+		PutU32(out, 0x4); // fourcc
+		PutU32(out, (bcn == 1) ? 0x31545844 : 0x35545844); // DXT1, DXT5
+		for (int i = 0; i < 5; ++i)
+			PutU32(out, 0);
+	}
+	else
+	{
+		PutU32(out, (bytespp == 4) ? (0x40 | 0x1) : 0x40); // rgb, alpha
+		PutU32(out, 0);
+		PutU32(out, bytespp * 8);
+		PutU32(out, 0x00ff0000);
+		PutU32(out, 0x0000ff00);
+		PutU32(out, 0x000000ff);
+		PutU32(out, (bytespp == 4) ? 0xff000000 : 0);
+	}
+	PutU32(out, 0x1000 | ((levels > 1) ? 0x400008 : 0)); // texture, mipmap, complex
+	for (int i = 0; i < 4; ++i)
+		PutU32(out, 0);
+
+	// mip chain
+	std::vector<unsigned char> level(rgba, rgba + width * height * 4), next;
+	unsigned w = width, h = height;
+	for (unsigned i = 0; i < levels; ++i)
+	{
+		const size_t offset = out.size();
+		if (compress)
+		{
+			const int size = BcnEncodedSize(w, h, bcn);
+			out.resize(offset + size);
+			BcnEncode(&out[offset], size, level.data(), w, h, bcn);
+		}
+		else
+		{
+			out.resize(offset + w * h * bytespp);
+			for (unsigned j = 0; j < w * h; ++j)
+			{
+				unsigned char * dst = &out[offset + j * bytespp];
+				dst[0] = level[j * 4 + 2];
+				dst[1] = level[j * 4 + 1];
+				dst[2] = level[j * 4 + 0];
+				if (bytespp == 4)
+					dst[3] = level[j * 4 + 3];
+			}
+		}
+
+		const unsigned wd = std::max(1u, w / 2), hd = std::max(1u, h / 2);
+		if (i + 1 < levels)
+		{
+			next.resize(wd * hd * 4);
+			Downsample(level.data(), w, h, next.data(), wd, hd);
+			level.swap(next);
+		}
+		w = wd;
+		h = hd;
+	}
+
+	// write to a temporary file first, readers only ever see complete files
+	std::ostringstream s;
+	s << file << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+	const std::string temp = s.str();
+	{
+		std::ofstream f(temp.c_str(), std::ios::binary);
+		if (!f.write((const char *)out.data(), out.size()))
+		{
+			error << "Failed to write texture cache file " << temp << std::endl;
+			return false;
+		}
+	}
+	if (std::rename(temp.c_str(), file.c_str()) != 0)
+	{
+		std::remove(temp.c_str());
+		if (!std::ifstream(file.c_str()))
+		{
+			error << "Failed to write texture cache file " << file << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+QT_TEST(texturecache_test)
+{
+	const unsigned w = 64, h = 32;
+	std::vector<unsigned char> image(w * h * 4);
+	for (unsigned i = 0; i < w * h; ++i)
+	{
+		image[i * 4 + 0] = i % w * 4;
+		image[i * 4 + 1] = i / w * 8;
+		image[i * 4 + 2] = 128;
+		image[i * 4 + 3] = 255;
+	}
+
+	// cache file names depend on the source contents and options
+	const std::string source = "texturecache_test.png";
+	std::ofstream(source.c_str(), std::ios::binary).write((const char *)image.data(), image.size());
+
+	TextureCache cache;
+	TextureInfo info;
+	QT_CHECK(cache.GetFile(source, info).empty());
+
+	cache.SetPath(".");
+	const std::string file = cache.GetFile(source, info);
+	QT_CHECK(!file.empty());
+	QT_CHECK_EQUAL(cache.GetFile(source, info), file);
+
+	info.maxsize = TextureInfo::SMALL;
+	QT_CHECK(cache.GetFile(source, info) != file);
+	info.maxsize = TextureInfo::LARGE;
+
+	image[0]++;
+	std::ofstream(source.c_str(), std::ios::binary).write((const char *)image.data(), image.size());
+	QT_CHECK(cache.GetFile(source, info) != file);
+	image[0]--;
+
+	// written files read back as dds with full mip chains,
+	// opaque images are stored without alpha
+	std::ostringstream error;
+	for (int alpha : {255, 128})
+	{
+		for (unsigned i = 0; i < w * h; ++i)
+			image[i * 4 + 3] = alpha;
+
+		for (bool compress : {true, false})
+		{
+			QT_CHECK(TextureCache::Write(file, image.data(), w, h, compress, error));
+
+			MappedFile mapped;
+			QT_CHECK(mapped.Open(file));
+
+			const void * data = 0;
+			unsigned long length = 0;
+			unsigned format = 0, target = 0, width = 0, height = 0, levels = 0;
+			QT_CHECK(ReadDDS(mapped.GetData(), mapped.GetSize(), data, length, format, target, width, height, levels));
+			QT_CHECK_EQUAL(width, w);
+			QT_CHECK_EQUAL(height, h);
+			QT_CHECK_EQUAL(levels, 7);
+
+			const int bytespp = (alpha == 255) ? 3 : 4;
+			if (compress)
+			{
+				QT_CHECK_EQUAL(format, (alpha == 255) ? 0x83F1u : 0x83F3u); // DXT1, DXT5
+				QT_CHECK_EQUAL(length, (alpha == 255) ? w * h / 2 : w * h);
+			}
+			else
+			{
+				QT_CHECK_EQUAL(format, (alpha == 255) ? 0x80E0u : 0x80E1u); // BGR, BGRA
+				QT_CHECK_EQUAL(length, w * h * bytespp);
+			}
+
+			// mip chain fills the file, 1x1 level is the image average
+			const unsigned char * end = (const unsigned char *)mapped.GetData() + mapped.GetSize();
+			if (!compress)
+			{
+				QT_CHECK_EQUAL(end - (const unsigned char *)data, (w * h + 32 * 16 + 16 * 8 + 8 * 4 + 4 * 2 + 2 + 1) * bytespp);
+				QT_CHECK_EQUAL(int(end[-bytespp]), 128);
+				if (alpha != 255)
+					QT_CHECK_EQUAL(int(end[-1]), alpha);
+			}
+			mapped.Close();
+			std::remove(file.c_str());
+		}
+	}
+	QT_CHECK(error.str().empty());
+
+	// levels of sizes that are no multiple of 4, 600 x 360 has a 75 x 45
+	// level, are stored and read back as whole blocks
+	const unsigned nw = 600, nh = 360;
+	std::vector<unsigned char> npot(nw * nh * 4);
+	for (unsigned i = 0; i < nw * nh; ++i)
+	{
+		npot[i * 4 + 0] = i % nw * 255 / nw;
+		npot[i * 4 + 1] = i / nw * 255 / nh;
+		npot[i * 4 + 2] = 64;
+	}
+	for (int alpha : {255, 128})
+	{
+		for (unsigned i = 0; i < nw * nh; ++i)
+			npot[i * 4 + 3] = alpha;
+
+		// 1x1 level
+		std::vector<unsigned char> average(npot), next;
+		for (unsigned lw = nw, lh = nh; lw > 1 || lh > 1; lw = std::max(1u, lw / 2), lh = std::max(1u, lh / 2))
+		{
+			next.resize(std::max(1u, lw / 2) * std::max(1u, lh / 2) * 4);
+			Downsample(average.data(), lw, lh, next.data(), std::max(1u, lw / 2), std::max(1u, lh / 2));
+			average.swap(next);
+		}
+
+		for (bool compress : {true, false})
+		{
+			QT_CHECK(TextureCache::Write(file, npot.data(), nw, nh, compress, error));
+
+			MappedFile mapped;
+			QT_CHECK(mapped.Open(file));
+
+			const void * data = 0;
+			unsigned long length = 0;
+			unsigned format = 0, target = 0, width = 0, height = 0, levels = 0;
+			QT_CHECK(ReadDDS(mapped.GetData(), mapped.GetSize(), data, length, format, target, width, height, levels));
+			QT_CHECK_EQUAL(levels, 10);
+			QT_CHECK_EQUAL(length, DDSLevelSize(format, nw, nh));
+
+			// level sizes add up to the file size
+			const int bcn = (alpha == 255) ? 1 : 3;
+			const unsigned char * level = (const unsigned char *)data;
+			const unsigned char * end = (const unsigned char *)mapped.GetData() + mapped.GetSize();
+			unsigned lw = nw, lh = nh;
+			for (unsigned i = 0; i < levels; ++i)
+			{
+				const unsigned long size = DDSLevelSize(format, lw, lh);
+				if (compress)
+					QT_CHECK_EQUAL(size, (unsigned long)BcnEncodedSize(lw, lh, bcn));
+				if (i + 1 < levels)
+				{
+					level += size;
+					lw = std::max(1u, lw / 2);
+					lh = std::max(1u, lh / 2);
+				}
+			}
+			QT_CHECK_EQUAL(lw, 1u);
+			QT_CHECK_EQUAL(lh, 1u);
+			QT_CHECK_EQUAL(end - level, long(DDSLevelSize(format, 1, 1)));
+
+			// last level is read from where it was written
+			unsigned char rgba[4] = {0, 0, 0, 255};
+			if (compress)
+			{
+				BcnDecode(rgba, 4, level, end - level, 1, 1, bcn, 0, 0);
+			}
+			else
+			{
+				rgba[0] = level[2];
+				rgba[1] = level[1];
+				rgba[2] = level[0];
+				if (alpha != 255)
+					rgba[3] = level[3];
+			}
+			const int tolerance = compress ? 8 : 0;
+			for (int c = 0; c < 4; ++c)
+				QT_CHECK_CLOSE(int(rgba[c]), int(average[c]), tolerance);
+
+			mapped.Close();
+			std::remove(file.c_str());
+		}
+	}
+	QT_CHECK(error.str().empty());
+
+	std::remove(source.c_str());
+}
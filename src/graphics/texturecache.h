@@ -0,0 +1,59 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _TEXTURECACHE_H
+#define _TEXTURECACHE_H
+
+#include <iosfwd>
+#include <string>
+
+struct TextureInfo;
+
+/// Textures converted once into dds files with full mip chains, block
+/// compressed if compressible, so that later loads skip image decoding
+/// and mipmap generation. Cache files are named by the hash of the source
+/// file contents and the options affecting the converted image.
+class TextureCache
+{
+public:
+	/// cache directory, caching is disabled if empty
+	void SetPath(const std::string & value) { path = value; }
+
+	const std::string & GetPath() const { return path; }
+
+	/// Cache file of the source image loaded with info, empty if
+	/// caching is disabled or the source is not cacheable.
+	std::string GetFile(const std::string & source, const TextureInfo & info) const;
+
+	/// Write rgba image and its mip chain to a cache file, dxt1 or dxt5 if compress
+	/// is set, bgr for opaque images and bgra otherwise. Writes to a temporary file first, a file written
+	/// concurrently by another thread for the same source is not an error.
+	static bool Write(
+		const std::string & file,
+		const unsigned char * rgba,
+		unsigned width,
+		unsigned height,
+		bool compress,
+		std::ostream & error);
+
+private:
+	std::string path;
+};
+
+#endif // _TEXTURECACHE_H
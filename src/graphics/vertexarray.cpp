@@ -177,6 +177,35 @@ void VertexArray::Add(
 	}
 }
 
+void VertexArray::SetToQuads(unsigned count, float * & verts, float * & tcos)
+{
+	faces.resize(count * 6);
+	for (unsigned i = 0; i < count; ++i)
+	{
+		unsigned * f = &faces[i * 6];
+		const unsigned n = i * 4;
+		f[0] = n; f[1] = n + 1; f[2] = n + 2;
+		f[3] = n; f[4] = n + 2; f[5] = n + 3;
+	}
+
+	vertices.resize(count * 12);
+	texcoords.resize(count * 8);
+	colors.clear();
+	normals.clear();
+	format = VertexFormat::PT32;
+
+	verts = vertices.data();
+	tcos = texcoords.data();
+}
+
+void VertexArray::SetToQuads(unsigned count, float * & verts, float * & tcos, unsigned char * & cols)
+{
+	SetToQuads(count, verts, tcos);
+	colors.resize(count * 16);
+	format = VertexFormat::PTC324;
+	cols = colors.data();
+}
+
 void VertexArray::SetToBillboard(float x1, float y1, float x2, float y2)
 {
 	unsigned int bfaces[6];
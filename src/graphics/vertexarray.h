@@ -77,6 +77,16 @@ public:
 
 	void SetTo2DRing(float r0, float r1, float a0, float a1, unsigned n);
 
+	/// Set to count quads (PT32), faces 0 1 2, 0 2 3 per quad. Returns pointers
+	/// to the vertices and texcoords to be filled in, 4 per quad. Reuses the
+	/// allocated storage.
+	void SetToQuads(unsigned count, float * & verts, float * & tcos);
+
+	/// Set to count quads with colors (PTC324), faces 0 1 2, 0 2 3 per quad.
+	/// Returns pointers to the vertices, texcoords and colors to be filled in,
+	/// 4 per quad. Reuses the allocated storage.
+	void SetToQuads(unsigned count, float * & verts, float * & tcos, unsigned char * & cols);
+
 	/// build the vertex array given the faces defined by the verts, normals, and texcoords passed in
 
 	struct Float3
@@ -0,0 +1,407 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "jobsystem.h"
+#include "profiler.h"
+#include "unittest.h"
+
+#include <algorithm>
+#include <cassert>
+
+// pool and queue of the current thread, worker threads only
+static thread_local const JobSystem * current_system = 0;
+static thread_local unsigned current_queue = 0;
+
+JobSystem::JobSystem() :
+	queued(0),
+	quit(false)
+{
+	queues.emplace_back(new Queue());
+}
+
+JobSystem::~JobSystem()
+{
+	Deinit();
+}
+
+void JobSystem::Init(unsigned thread_count)
+{
+	Deinit();
+
+	thread_count = std::max(thread_count, 1u);
+	quit = false;
+	while (queues.size() < thread_count)
+		queues.emplace_back(new Queue());
+
+	for (unsigned i = 1; i < thread_count; ++i)
+		workers.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+}
+
+void JobSystem::Deinit()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		quit = true;
+	}
+	sleep_cv.notify_all();
+
+	for (auto & worker : workers)
+		worker.join();
+	workers.clear();
+
+	assert(queued.load() == 0);
+	queues.resize(1);
+}
+
+void JobSystem::Submit(const Function & job, Counter & counter)
+{
+	counter.value.fetch_add(1);
+
+	Queue & queue = *queues[GetQueueIndex()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(Job{job, &counter});
+	}
+	queued.fetch_add(1);
+
+	if (!workers.empty())
+	{
+		// take the lock to not slip between a worker's check and its wait
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+		}
+		sleep_cv.notify_one();
+	}
+}
+
+void JobSystem::Wait(Counter & counter)
+{
+	const unsigned index = GetQueueIndex();
+	while (!counter.Done())
+	{
+		if (!RunJob(index))
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::ParallelFor(int begin, int end, int grain, const std::function<void (int, int)> & func)
+{
+	if (begin >= end)
+		return;
+
+	grain = std::max(grain, 1);
+	if (end - begin <= grain || queues.size() == 1)
+	{
+		func(begin, end);
+		return;
+	}
+
+	// keep the first chunk for the calling thread
+	Counter counter;
+	for (int chunk = begin + grain; chunk < end; chunk += grain)
+	{
+		const int chunk_end = std::min(chunk + grain, end);
+		Submit([&func, chunk, chunk_end] { func(chunk, chunk_end); }, counter);
+	}
+	func(begin, begin + grain);
+	Wait(counter);
+}
+
+unsigned JobSystem::GetQueueIndex() const
+{
+	return (current_system == this) ? current_queue : 0;
+}
+
+bool JobSystem::Pop(unsigned index, Job & job)
+{
+	Queue & queue = *queues[index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.jobs.empty())
+		return false;
+
+	job = std::move(queue.jobs.back());
+	queue.jobs.pop_back();
+	return true;
+}
+
+bool JobSystem::Steal(unsigned index, Job & job)
+{
+	const unsigned count = unsigned(queues.size());
+	for (unsigned i = 1; i < count; ++i)
+	{
+		Queue & queue = *queues[(index + i) % count];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty())
+			continue;
+
+		job = std::move(queue.jobs.front());
+		queue.jobs.pop_front();
+		return true;
+	}
+	return false;
+}
+
+bool JobSystem::RunJob(unsigned index)
+{
+	Job job;
+	if (!Pop(index, job) && !Steal(index, job))
+		return false;
+
+	queued.fetch_sub(1);
+	{
+		PROFILE_ZONE("job");
+		job.function();
+	}
+	job.counter->value.fetch_sub(1);
+	return true;
+}
+
+void JobSystem::WorkerLoop(unsigned index)
+{
+	current_system = this;
+	current_queue = index;
+	Profiler::SetThreadName("worker " + std::to_string(index));
+
+	while (true)
+	{
+		if (RunJob(index))
+			continue;
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		sleep_cv.wait(lock, [this] { return quit || queued.load() > 0; });
+		if (quit)
+			break;
+	}
+
+	current_system = 0;
+	current_queue = 0;
+}
+
+JobThread::JobThread() :
+	busy(false),
+	quit(false)
+{
+	// ctor
+}
+
+JobThread::~JobThread()
+{
+	Deinit();
+}
+
+void JobThread::Init(const std::string & name)
+{
+	Deinit();
+
+	quit = false;
+	thread = std::thread(&JobThread::Loop, this, name);
+}
+
+void JobThread::Deinit()
+{
+	if (!thread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	cv.notify_all();
+	thread.join();
+}
+
+void JobThread::Run(const JobSystem::Function & new_job)
+{
+	assert(thread.joinable());
+	assert(Done());
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = new_job;
+		busy.store(true);
+	}
+	cv.notify_all();
+}
+
+void JobThread::Wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	cv.wait(lock, [this] { return !busy.load(); });
+}
+
+void JobThread::Loop(const std::string & name)
+{
+	Profiler::SetThreadName(name);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		// a job queued before quit still runs
+		cv.wait(lock, [this] { return quit || busy.load(); });
+		if (!busy.load())
+			break;
+
+		JobSystem::Function function;
+		std::swap(function, job);
+		lock.unlock();
+		{
+			PROFILE_ZONE("job");
+			function();
+		}
+		lock.lock();
+		busy.store(false, std::memory_order_release);
+		cv.notify_all();
+	}
+}
+
+TaskGraph::TaskId TaskGraph::Add(const JobSystem::Function & task)
+{
+	tasks.emplace_back();
+	tasks.back().function = task;
+	return TaskId(tasks.size() - 1);
+}
+
+void TaskGraph::AddDependency(TaskId task, TaskId dependency)
+{
+	assert(task < tasks.size() && dependency < tasks.size());
+	assert(task != dependency);
+	tasks[dependency].successors.push_back(task);
+	tasks[task].dependencies++;
+}
+
+void TaskGraph::Run(JobSystem & jobs)
+{
+	for (auto & task : tasks)
+		task.remaining.store(task.dependencies);
+
+	// successors are submitted before their last dependency completes,
+	// so the counter only reaches zero when the whole graph is done
+	JobSystem::Counter counter;
+	for (TaskId id = 0; id < tasks.size(); ++id)
+	{
+		if (tasks[id].dependencies == 0)
+			Submit(id, jobs, counter);
+	}
+	jobs.Wait(counter);
+}
+
+void TaskGraph::Clear()
+{
+	tasks.clear();
+}
+
+void TaskGraph::Submit(TaskId id, JobSystem & jobs, JobSystem::Counter & counter)
+{
+	jobs.Submit([this, id, &jobs, &counter]
+	{
+		Task & task = tasks[id];
+		task.function();
+		for (TaskId successor : task.successors)
+		{
+			if (tasks[successor].remaining.fetch_sub(1) == 1)
+				Submit(successor, jobs, counter);
+		}
+	}, counter);
+}
+
+QT_TEST(jobsystem_test)
+{
+	JobSystem jobs;
+	jobs.Init(4);
+	QT_CHECK_EQUAL(jobs.GetThreadCount(), 4u);
+
+	// every index visited exactly once
+	std::vector<int> visits(1000, 0);
+	jobs.ParallelFor(0, int(visits.size()), 7, [&visits](int begin, int end)
+	{
+		for (int i = begin; i < end; ++i)
+			visits[i]++;
+	});
+	QT_CHECK_EQUAL(int(std::count(visits.begin(), visits.end(), 1)), 1000);
+
+	// nested jobs
+	std::atomic<int> sum(0);
+	JobSystem::Counter counter;
+	for (int i = 0; i < 10; ++i)
+	{
+		jobs.Submit([&jobs, &sum, &counter]
+		{
+			for (int j = 0; j < 10; ++j)
+				jobs.Submit([&sum] { sum++; }, counter);
+		}, counter);
+	}
+	jobs.Wait(counter);
+	QT_CHECK_EQUAL(sum.load(), 100);
+
+	// diamond graph a -> (b, c) -> d, run twice
+	std::atomic<int> step(0);
+	int a = -1, b = -1, c = -1, d = -1;
+	TaskGraph graph;
+	TaskGraph::TaskId ta = graph.Add([&] { a = step++; });
+	TaskGraph::TaskId tb = graph.Add([&] { b = step++; });
+	TaskGraph::TaskId tc = graph.Add([&] { c = step++; });
+	TaskGraph::TaskId td = graph.Add([&] { d = step++; });
+	graph.AddDependency(tb, ta);
+	graph.AddDependency(tc, ta);
+	graph.AddDependency(td, tb);
+	graph.AddDependency(td, tc);
+	for (int n = 0; n < 2; ++n)
+	{
+		step = 0;
+		graph.Run(jobs);
+		QT_CHECK_EQUAL(a, 0);
+		QT_CHECK(b > a && c > a);
+		QT_CHECK_EQUAL(d, 3);
+	}
+
+	// single thread runs everything on the caller
+	jobs.Init(1);
+	QT_CHECK_EQUAL(jobs.GetThreadCount(), 1u);
+	step = 0;
+	graph.Run(jobs);
+	QT_CHECK_EQUAL(d, 3);
+
+	// job thread runs jobs in turn, they may use the pool
+	jobs.Init(4);
+	JobThread thread;
+	QT_CHECK(!thread.Running());
+	thread.Init("job thread test");
+	QT_CHECK(thread.Running() && thread.Done());
+	std::vector<int> batch(100, 0);
+	for (int n = 1; n <= 3; ++n)
+	{
+		thread.Run([&jobs, &batch]
+		{
+			jobs.ParallelFor(0, int(batch.size()), 10, [&batch](int begin, int end)
+			{
+				for (int i = begin; i < end; ++i)
+					batch[i]++;
+			});
+		});
+		while (!thread.Done())
+			std::this_thread::yield();
+		QT_CHECK_EQUAL(int(std::count(batch.begin(), batch.end(), n)), 100);
+	}
+	thread.Run([&sum] { sum = 0; });
+	thread.Wait();
+	QT_CHECK_EQUAL(sum.load(), 0);
+	thread.Run([&sum] { sum = 1; });
+	thread.Deinit();
+	QT_CHECK(!thread.Running() && thread.Done());
+	QT_CHECK_EQUAL(sum.load(), 1);
+}
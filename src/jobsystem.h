@@ -0,0 +1,181 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _JOBSYSTEM_H
+#define _JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Fixed pool of worker threads with a work-stealing job queue per thread.
+/// Workers pop their own queue from the back and steal from the front of
+/// the others. A thread waiting for jobs to finish executes queued jobs too,
+/// with a single thread all jobs run on the waiting thread.
+class JobSystem
+{
+public:
+	typedef std::function<void ()> Function;
+
+	/// Number of unfinished jobs submitted with it.
+	class Counter
+	{
+	public:
+		Counter() : value(0) {}
+		bool Done() const { return value.load() == 0; }
+
+	private:
+		friend class JobSystem;
+		std::atomic<int> value;
+	};
+
+	JobSystem();
+
+	~JobSystem();
+
+	/// Start thread_count - 1 worker threads, the thread calling Wait is the last one.
+	void Init(unsigned thread_count);
+
+	/// Join the worker threads, submitted jobs have to be waited for first.
+	void Deinit();
+
+	unsigned GetThreadCount() const { return unsigned(queues.size()); }
+
+	/// Queue a job, counter is incremented now and decremented once the job is done.
+	/// Jobs may submit further jobs.
+	void Submit(const Function & job, Counter & counter);
+
+	/// Execute queued jobs until the counter drops to zero.
+	void Wait(Counter & counter);
+
+	/// Call func(chunk_begin, chunk_end) for chunks of at most grain size
+	/// covering [begin, end) and wait for all of them.
+	void ParallelFor(int begin, int end, int grain, const std::function<void (int, int)> & func);
+
+private:
+	struct Job
+	{
+		Function function;
+		Counter * counter;
+	};
+
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	std::vector<std::unique_ptr<Queue> > queues;
+	std::vector<std::thread> workers;
+	std::mutex sleep_mutex;
+	std::condition_variable sleep_cv;
+	std::atomic<int> queued;
+	bool quit;
+
+	/// Queue of the calling thread, 0 for threads outside of the pool.
+	unsigned GetQueueIndex() const;
+
+	bool Pop(unsigned index, Job & job);
+
+	bool Steal(unsigned index, Job & job);
+
+	/// Run one job from own or other queues, returns false if none found.
+	bool RunJob(unsigned index);
+
+	void WorkerLoop(unsigned index);
+};
+
+/// Thread of its own running one job at a time. For long running work like
+/// a batch of simulation ticks, which threads waiting on the pool must not
+/// pick up. Jobs it submits to a JobSystem go to the queue of outside threads.
+class JobThread
+{
+public:
+	JobThread();
+
+	~JobThread();
+
+	/// Start the thread, name is shown in profiler traces.
+	void Init(const std::string & name);
+
+	/// Wait for the running job and join the thread.
+	void Deinit();
+
+	bool Running() const { return thread.joinable(); }
+
+	/// Start job, the previous job has to be done.
+	void Run(const JobSystem::Function & job);
+
+	/// True if no job is running. Once true, the job's writes are visible
+	/// to the calling thread.
+	bool Done() const { return !busy.load(std::memory_order_acquire); }
+
+	/// Block until the running job is done.
+	void Wait();
+
+private:
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cv;
+	JobSystem::Function job;
+	std::atomic<bool> busy;
+	bool quit;
+
+	void Loop(const std::string & name);
+};
+
+/// Set of tasks with dependencies, built once and run every frame.
+class TaskGraph
+{
+public:
+	typedef unsigned TaskId;
+
+	TaskId Add(const JobSystem::Function & task);
+
+	/// Task will not start before dependency has finished.
+	void AddDependency(TaskId task, TaskId dependency);
+
+	/// Run all tasks and wait for them, dependencies have to be acyclic.
+	void Run(JobSystem & jobs);
+
+	void Clear();
+
+	unsigned GetTaskCount() const { return unsigned(tasks.size()); }
+
+private:
+	struct Task
+	{
+		JobSystem::Function function;
+		std::vector<TaskId> successors;
+		int dependencies = 0;
+		std::atomic<int> remaining;
+	};
+
+	std::deque<Task> tasks;
+
+	void Submit(TaskId id, JobSystem & jobs, JobSystem::Counter & counter);
+};
+
+#endif // _JOBSYSTEM_H
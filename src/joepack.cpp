@@ -18,15 +18,19 @@
 /************************************************************************/
 
 #include "joepack.h"
+#include "mappedfile.h"
 #include "endian_utility.h"
 #include "unittest.h"
 
 #include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
 #include <fstream>
-#include <cassert>
+#include <thread>
+#include <vector>
 
 using std::string;
-using std::ios_base;
 
 struct JoePack::Impl
 {
@@ -38,137 +42,88 @@ struct JoePack::Impl
 	};
 	const std::string versionstr;
 	std::unordered_map<std::string, FatEntry> fat;
-	std::unordered_map<std::string, FatEntry>::iterator curfa;
-	std::ifstream f;
+	MappedFile file;
 
 	Impl();
 	bool Load(const string & fn);
 	void Close();
-	void fclose();
-	bool fopen(const string & fn);
-	int fread(void * buffer, const unsigned size, const unsigned count);
+	bool GetFile(const string & fn, const char * & data, unsigned & size) const;
 };
 
+// read little endian unsigned at pos, false if past end
+static bool ReadUnsigned(const MappedFile & file, size_t & pos, unsigned & value)
+{
+	if (file.GetSize() < pos + sizeof(unsigned))
+		return false;
+	std::memcpy(&value, file.GetData() + pos, sizeof(unsigned));
+	value = ENDIAN_SWAP_32(value);
+	pos += sizeof(unsigned);
+	return true;
+}
+
 JoePack::Impl::Impl() : versionstr("JPK01.00")
 {
-	curfa = fat.end();
+	// ctor
 }
 
 bool JoePack::Impl::Load(const string & fn)
 {
 	Close();
-	f.clear();
-	f.open(fn.c_str(), ios_base::binary);
-	if (f)
-	{
-		//load header
-		char * versioncstr = new char[versionstr.length() + 1];
-		f.read(versioncstr, versionstr.length());
-		versioncstr[versionstr.length()] = '\0';
-		string fversionstr = versioncstr;
-		delete [] versioncstr;
-		if (fversionstr != versionstr)
-		{
-			//write out an error?
-			return false;
-		}
-
-		unsigned int numobjs = 0;
-		assert(sizeof(unsigned int) == 4);
-		f.read((char*)(&numobjs), sizeof(unsigned int));
-		numobjs = ENDIAN_SWAP_32(numobjs);
-
-		//DPRINT(numobjs << " objects");
-
-		unsigned int maxstrlen = 0;
-		f.read((char*)(&maxstrlen), sizeof(unsigned int));
-		maxstrlen = ENDIAN_SWAP_32(maxstrlen);
-
-		//DPRINT(maxstrlen << " max string length");
+	if (!file.Open(fn))
+		return false;
 
-		char * fnch = new char[maxstrlen+1];
+	//load header
+	static_assert(sizeof(unsigned int) == 4, "Pack format relies on unsigned int being 4 bytes");
+	const char * data = file.GetData();
+	const size_t size = file.GetSize();
+	size_t pos = versionstr.length();
+	unsigned int numobjs = 0;
+	unsigned int maxstrlen = 0;
+	if (size < pos || versionstr.compare(0, pos, data, pos) != 0 ||
+		!ReadUnsigned(file, pos, numobjs) ||
+		!ReadUnsigned(file, pos, maxstrlen))
+	{
+		Close();
+		return false;
+	}
 
-		//load FAT
-		fat.reserve(numobjs);
-		for (unsigned int i = 0; i < numobjs; i++)
+	//load FAT, file names are zero padded to maxstrlen
+	fat.reserve(numobjs);
+	for (unsigned int i = 0; i < numobjs; i++)
+	{
+		FatEntry fa;
+		if (!ReadUnsigned(file, pos, fa.offset) ||
+			!ReadUnsigned(file, pos, fa.length) ||
+			size < pos + maxstrlen ||
+			size < size_t(fa.offset) + fa.length)
 		{
-			FatEntry fa;
-			f.read((char*)(&(fa.offset)), sizeof(unsigned int));
-			fa.offset = ENDIAN_SWAP_32(fa.offset);
-			f.read((char*)(&(fa.length)), sizeof(unsigned int));
-			fa.length = ENDIAN_SWAP_32(fa.length);
-			f.read(fnch, maxstrlen);
-			fnch[maxstrlen] = '\0';
-			string filename = fnch;
-			fat[filename] = fa;
-
-			//DPRINT(filename << ": offest " << fa.offset << " length " << fa.length);
+			Close();
+			return false;
 		}
-
-		delete [] fnch;
-		return true;
-	}
-	else
-	{
-		//write an error?
-		return false;
+		const char * fnch = data + pos;
+		string filename(fnch, std::find(fnch, fnch + maxstrlen, '\0'));
+		fat[filename] = fa;
+		pos += maxstrlen;
 	}
+
+	return true;
 }
 
 void JoePack::Impl::Close()
 {
-	if (f.is_open()) f.close();
+	file.Close();
 	fat.clear();
-	curfa = fat.end();
-}
-
-void JoePack::Impl::fclose()
-{
-	curfa = fat.end();
 }
 
-bool JoePack::Impl::fopen(const string & fn)
+bool JoePack::Impl::GetFile(const string & fn, const char * & data, unsigned & size) const
 {
-	curfa = fat.find(fn);
-	if (curfa == fat.end())
-	{
+	auto fa = fat.find(fn);
+	if (fa == fat.end())
 		return false;
-	}
-	else
-	{
-		f.seekg(curfa->second.offset);
-		return true;
-	}
-}
-
-int JoePack::Impl::fread(void * buffer, const unsigned size, const unsigned count)
-{
-	if (curfa != fat.end())
-	{
-		unsigned int abspos = f.tellg();
-		assert(abspos >= curfa->second.offset);
-		unsigned int relpos = abspos - curfa->second.offset;
-		assert(curfa->second.length >= relpos);
-		unsigned int fileleft = curfa->second.length - relpos;
-		unsigned int requestedread = size*count;
-
-		assert(size != 0);
-
-		if (requestedread > fileleft)
-		{
-			//overflow
-			requestedread = fileleft/size;
-		}
 
-		//DPRINT("JOEPACK fread: " << abspos << "," << relpos << "," << fileleft << "," << requestedread);
-		f.read((char *)buffer, requestedread);
-		return f.gcount()/size;
-	}
-	else
-	{
-		//write error?
-		return 0;
-	}
+	data = file.GetData() + fa->second.offset;
+	size = fa->second.length;
+	return true;
 }
 
 JoePack::JoePack()
@@ -194,40 +149,96 @@ void JoePack::Close()
 	impl->Close();
 }
 
-void JoePack::fclose() const
+bool JoePack::GetFile(const std::string & fn, const char * & data, unsigned & size) const
 {
-	impl->fclose();
+	if (fn.find(packpath, 0) < fn.length())
+		return impl->GetFile(fn.substr(packpath.length() + 1), data, size);
+
+	return impl->GetFile(fn, data, size);
 }
 
-bool JoePack::fopen(const string & fn) const
+// write pack with files named by their contents
+static void WritePack(const string & path, const std::vector<string> & files, unsigned extra_length = 0)
 {
-	string newfn;
-	if (fn.find(packpath, 0) < fn.length())
+	const unsigned maxstrlen = 16;
+	std::ofstream f(path.c_str(), std::ios_base::binary);
+	auto write = [&f](unsigned value)
 	{
-		newfn = fn.substr(packpath.length()+1);
-	}
-	else
+		value = ENDIAN_SWAP_32(value);
+		f.write((const char *)&value, sizeof(value));
+	};
+	f << "JPK01.00";
+	write(files.size());
+	write(maxstrlen);
+	unsigned offset = 16 + files.size() * (8 + maxstrlen);
+	for (const auto & file : files)
 	{
-		newfn = fn;
+		char name[maxstrlen] = {};
+		file.copy(name, maxstrlen - 1);
+		write(offset);
+		write(file.length() + extra_length);
+		f.write(name, maxstrlen);
+		offset += file.length();
 	}
-	return impl->fopen(newfn);
-}
-
-int JoePack::fread(void * buffer, const unsigned size, const unsigned count) const
-{
-	return impl->fread(buffer, size, count);
+	for (const auto & file : files)
+		f << file;
 }
 
 QT_TEST(joepack_test)
 {
+	{
+		JoePack p;
+		QT_CHECK(p.Load("data/test/test1.jpk"));
+		const char * data = 0;
+		unsigned size = 0;
+		QT_CHECK(p.GetFile("testlist.txt", data, size));
+		QT_CHECK_EQUAL(size, 16);
+		QT_CHECK_EQUAL(string(data, size), "This is\na test.\n");
+	}
+
+	const string path = "joepack_test.jpk";
+	const std::vector<string> files = {"a.joe", "body.joe", "wheel.joe"};
+	WritePack(path, files);
+
 	JoePack p;
-	QT_CHECK(p.Load("data/test/test1.jpk"));
-	QT_CHECK(p.fopen("testlist.txt"));
-	char buf[1000];
-	unsigned int chars = p.fread(buf, 1, 999);
-	QT_CHECK_EQUAL(chars, 16);
-	buf[chars] = '\0';
-	string comparisonstr = "This is\na test.\n";
-	string filestr = buf;
-	QT_CHECK_EQUAL(buf,comparisonstr);
+	QT_CHECK(p.Load(path));
+	QT_CHECK_EQUAL(p.GetPath(), path);
+
+	// files open at the same time from several threads
+	std::vector<int> matches(4, 0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&p, &files, &matches, t]
+		{
+			for (int n = 0; n < 100; ++n)
+			{
+				for (const auto & file : files)
+				{
+					const char * data = 0;
+					unsigned size = 0;
+					if (p.GetFile(file, data, size) && string(data, size) == file)
+						matches[t]++;
+				}
+			}
+		});
+	}
+	for (auto & thread : threads)
+		thread.join();
+	for (int t = 0; t < 4; ++t)
+		QT_CHECK_EQUAL(matches[t], 100 * 3);
+
+	// pack path prefix, missing file
+	const char * data = 0;
+	unsigned size = 0;
+	QT_CHECK(p.GetFile(path + "/wheel.joe", data, size));
+	QT_CHECK_EQUAL(string(data, size), "wheel.joe");
+	QT_CHECK(!p.GetFile("missing.joe", data, size));
+
+	// truncated pack
+	WritePack(path, files, 100);
+	QT_CHECK(!p.Load(path));
+	QT_CHECK(!p.GetFile("a.joe", data, size));
+	p.Close();
+	std::remove(path.c_str());
 }
@@ -22,6 +22,8 @@
 
 #include <string>
 
+/// Archive of files, memory mapped when loaded. Files are accessed through
+/// read only views into the mapping, GetFile may be called concurrently.
 class JoePack
 {
 public:
@@ -29,17 +31,19 @@ public:
 
 	~JoePack();
 
+	JoePack(const JoePack & other) = delete;
+
+	JoePack & operator=(const JoePack & other) = delete;
+
 	const std::string & GetPath() const {return packpath;}
 
 	bool Load(const std::string & fn);
 
 	void Close();
 
-	bool fopen(const std::string & fn) const;
-
-	void fclose() const;
-
-	int fread(void * buffer, const unsigned size, const unsigned count) const;
+	/// Get view of file fn in the pack, valid until the pack is closed.
+	/// fn may be prefixed by the pack path, returns false if not found.
+	bool GetFile(const std::string & fn, const char * & data, unsigned & size) const;
 
 private:
 	std::string packpath;
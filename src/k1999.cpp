@@ -28,8 +28,12 @@
 
 #include "k1999.h"
 #include "roadstrip.h"
+#include "datahash.h"
+#include "unittest.h"
 
 #include <cassert>
+#include <cmath>
+#include <sstream>
 
 #define SecurityR   100.0 // Security radius
 #define SideDistExt 2.0 // Security distance wrt outside
@@ -346,3 +350,119 @@ void K1999::UpdateRoadStrip(RoadStrip & road)
 	tyRight.clear();
 	tLane.clear();
 }
+
+unsigned long long K1999::GetHash() const
+{
+	// bump version to invalidate race lines if the algorithm changes
+	const double params[] = {1, SecurityR, SideDistExt, SideDistInt, Iterations, double(Divs)};
+	unsigned long long hash = DataHash(params, sizeof(params));
+	hash = DataHash(txLeft.data(), txLeft.size() * sizeof(double), hash);
+	hash = DataHash(tyLeft.data(), tyLeft.size() * sizeof(double), hash);
+	hash = DataHash(txRight.data(), txRight.size() * sizeof(double), hash);
+	hash = DataHash(tyRight.data(), tyRight.size() * sizeof(double), hash);
+	return hash;
+}
+
+void K1999::WriteRaceLine(std::ostream & out) const
+{
+	const unsigned long long hash = GetHash();
+	const unsigned int count = Divs;
+	out.write((const char *)&hash, sizeof(hash));
+	out.write((const char *)&count, sizeof(count));
+	out.write((const char *)tLane.data(), count * sizeof(double));
+	out.write((const char *)tRInverse.data(), count * sizeof(double));
+}
+
+bool K1999::ReadRaceLine(std::istream & in)
+{
+	unsigned long long hash = 0;
+	unsigned int count = 0;
+	if (!in.read((char *)&hash, sizeof(hash)) || !in.read((char *)&count, sizeof(count)))
+		return false;
+
+	if (hash != GetHash() || count != (unsigned int)Divs)
+	{
+		in.seekg(2 * count * sizeof(double), std::ios::cur);
+		return false;
+	}
+
+	std::vector<double> lane(count), rinverse(count);
+	if (!in.read((char *)lane.data(), count * sizeof(double)) ||
+		!in.read((char *)rinverse.data(), count * sizeof(double)))
+		return false;
+
+	tLane.swap(lane);
+	tRInverse.swap(rinverse);
+	for (int i = 0; i < Divs; ++i)
+		UpdateTxTy(i);
+	return true;
+}
+
+// closed oval road with a varying radius, 10m wide
+static void GetTestRoad(RoadStrip & road, bool reverse)
+{
+	const int count = 256;
+	std::stringstream s;
+	s << count << "\n";
+	for (int i = 0; i < count; ++i)
+	{
+		for (int x = 0; x < 4; ++x)
+		{
+			const double a = 2 * M_PI * (i + 1 - x / 3.0) / count;
+			const double r = 100 + 30 * std::cos(2 * a);
+			for (int y = 0; y < 4; ++y)
+			{
+				const double w = r - 5 + y * 10 / 3.0;
+				s << w * std::sin(a) << " 0 " << w * std::cos(a) << "\n";
+			}
+		}
+	}
+	std::ostringstream error;
+	road.ReadFrom(s, reverse, error);
+}
+
+QT_TEST(k1999_test)
+{
+	RoadStrip road;
+	GetTestRoad(road, false);
+	QT_CHECK(road.GetClosed());
+
+	K1999 k1999;
+	k1999.LoadData(road);
+	const unsigned long long hash = k1999.GetHash();
+	k1999.CalcRaceLine();
+
+	std::stringstream cache;
+	k1999.WriteRaceLine(cache);
+	k1999.UpdateRoadStrip(road);
+
+	// cached race line matches the calculated one
+	RoadStrip cached_road;
+	GetTestRoad(cached_road, false);
+	k1999.LoadData(cached_road);
+	QT_CHECK_EQUAL(k1999.GetHash(), hash);
+	QT_CHECK(k1999.ReadRaceLine(cache));
+	k1999.UpdateRoadStrip(cached_road);
+
+	bool equal = true;
+	bool centered = true;
+	for (size_t i = 0; i < road.GetPatches().size(); ++i)
+	{
+		const RoadPatch & p = road.GetPatches()[i];
+		const RoadPatch & c = cached_road.GetPatches()[i];
+		equal = equal && p.GetRacingLine() == c.GetRacingLine() && p.GetTrackRadius() == c.GetTrackRadius();
+		centered = centered && p.GetRacingLine() == (p.GetPoint(3, 0) + p.GetPoint(3, 3)) * 0.5;
+	}
+	QT_CHECK(equal);
+	QT_CHECK(!centered);
+
+	// records of different road data are skipped
+	RoadStrip reversed_road;
+	GetTestRoad(reversed_road, true);
+	k1999.LoadData(reversed_road);
+	QT_CHECK(k1999.GetHash() != hash);
+	cache.clear();
+	cache.seekg(0);
+	QT_CHECK(!k1999.ReadRaceLine(cache));
+	QT_CHECK(cache.peek() == EOF);
+}
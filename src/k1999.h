@@ -63,6 +63,16 @@ public:
 	void LoadData(const RoadStrip & road);
 	void CalcRaceLine();
 	void UpdateRoadStrip(RoadStrip & road);
+
+	// hash of the loaded road data and algorithm parameters
+	unsigned long long GetHash() const;
+
+	// binary race line record of the loaded road, call after CalcRaceLine
+	void WriteRaceLine(std::ostream & out) const;
+
+	// read the next race line record, fails if it has been calculated for
+	// different road data, skips the record in that case
+	bool ReadRaceLine(std::istream & in);
 };
 
 #endif //_K1999_H
@@ -0,0 +1,178 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "mappedfile.h"
+#include "unittest.h"
+
+#include <cstdio>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() :
+	data(0),
+	size(0),
+	open(false),
+	writable(false)
+#ifdef _WIN32
+	, mapping(0)
+#endif
+{
+	// ctor
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string & path, bool copy_on_write)
+{
+	Close();
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	// empty files can not be mapped
+	size = file_size.QuadPart;
+	if (size > 0)
+	{
+		mapping = CreateFileMappingA(file, NULL, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+		if (mapping)
+			data = (const char *)MapViewOfFile(mapping, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+	}
+	CloseHandle(file);
+
+	if (size > 0 && !data)
+	{
+		Close();
+		return false;
+	}
+	open = true;
+	writable = copy_on_write;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle(mapping);
+	data = 0;
+	mapping = 0;
+	size = 0;
+	open = false;
+	writable = false;
+}
+
+#else
+
+bool MappedFile::Open(const std::string & path, bool copy_on_write)
+{
+	Close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		::close(fd);
+		return false;
+	}
+
+	// empty files can not be mapped, the mapping stays valid after closing fd
+	size = st.st_size;
+	if (size > 0)
+	{
+		const int prot = copy_on_write ? (PROT_READ | PROT_WRITE) : PROT_READ;
+		void * ptr = mmap(0, size, prot, MAP_PRIVATE, fd, 0);
+		if (ptr != MAP_FAILED)
+			data = (const char *)ptr;
+	}
+	::close(fd);
+
+	if (size > 0 && !data)
+	{
+		size = 0;
+		return false;
+	}
+	open = true;
+	writable = copy_on_write;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data)
+		munmap((void *)data, size);
+	data = 0;
+	size = 0;
+	open = false;
+	writable = false;
+}
+
+#endif
+
+QT_TEST(mappedfile_test)
+{
+	const std::string path = "mappedfile_test.bin";
+	std::ofstream(path.c_str(), std::ios::binary) << "abcd";
+
+	MappedFile file;
+	QT_CHECK(!file.Open("mappedfile_test.missing"));
+	QT_CHECK(file.Open(path));
+	QT_CHECK_EQUAL(file.GetSize(), 4);
+	QT_CHECK(file.GetWritableData() == 0);
+	QT_CHECK_EQUAL(std::string(file.GetData(), 4), "abcd");
+
+	// copy on write changes stay in memory
+	QT_CHECK(file.Open(path, true));
+	QT_CHECK(file.GetWritableData() != 0);
+	file.GetWritableData()[0] = 'x';
+	QT_CHECK_EQUAL(std::string(file.GetData(), 4), "xbcd");
+
+	MappedFile other;
+	QT_CHECK(other.Open(path));
+	QT_CHECK_EQUAL(std::string(other.GetData(), 4), "abcd");
+	other.Close();
+	file.Close();
+
+	std::remove(path.c_str());
+}
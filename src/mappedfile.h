@@ -0,0 +1,66 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _MAPPEDFILE_H
+#define _MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+/// Read only memory mapping of a whole file. The mapped data can be read
+/// concurrently from any thread, pages are loaded on first access. A copy on
+/// write mapping can be modified, modified pages are private to the process
+/// and never written back to the file.
+class MappedFile
+{
+public:
+	MappedFile();
+
+	~MappedFile();
+
+	MappedFile(const MappedFile & other) = delete;
+
+	MappedFile & operator=(const MappedFile & other) = delete;
+
+	/// Map file at path, closes the previous mapping.
+	bool Open(const std::string & path, bool copy_on_write = false);
+
+	void Close();
+
+	bool IsOpen() const { return open; }
+
+	/// Mapped file contents, null if the file is empty or not open.
+	const char * GetData() const { return data; }
+
+	/// Modifiable mapped file contents, null unless mapped copy on write.
+	char * GetWritableData() { return writable ? const_cast<char *>(data) : 0; }
+
+	size_t GetSize() const { return size; }
+
+private:
+	const char * data;
+	size_t size;
+	bool open;
+	bool writable;
+#ifdef _WIN32
+	void * mapping;
+#endif
+};
+
+#endif // _MAPPEDFILE_H
@@ -0,0 +1,124 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _MICROBENCH_H
+#define _MICROBENCH_H
+
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+/// Micro benchmarks registered like unit tests, run with -microbench.
+namespace microbench
+{
+	class Benchmark
+	{
+	public:
+		Benchmark(const char * name);
+
+		virtual ~Benchmark() {}
+
+		virtual void run(std::ostream & out) = 0;
+
+		const char * getName() const { return mName; }
+
+	private:
+		const char * mName;
+	};
+
+	class BenchmarkManager
+	{
+	public:
+		static BenchmarkManager & instance()
+		{
+			static BenchmarkManager self;
+			return self;
+		}
+
+		void addBenchmark(Benchmark * benchmark)
+		{
+			mBenchmarks.push_back(benchmark);
+		}
+
+		void runBenchmarks(std::ostream & out)
+		{
+			out << "[-------------- RUNNING BENCHMARKS --------------]" << std::endl;
+			for (auto benchmark : mBenchmarks)
+			{
+				out << benchmark->getName() << ":" << std::endl;
+				benchmark->run(out);
+			}
+			out << "[-------------- BENCHMARKS FINISHED -------------]" << std::endl;
+		}
+
+	private:
+		std::vector<Benchmark*> mBenchmarks;
+	};
+
+	inline Benchmark::Benchmark(const char * name) : mName(name)
+	{
+		BenchmarkManager::instance().addBenchmark(this);
+	}
+
+	/// Keep the compiler from optimizing away a result.
+	template <typename T>
+	inline void keep(const T & value)
+	{
+		static volatile char sink;
+		sink ^= *reinterpret_cast<const volatile char *>(&value);
+	}
+
+	/// Call func in rounds until min_seconds have passed, return nanoseconds per call.
+	template <typename Func>
+	inline double measure(Func func, double min_seconds = 0.25)
+	{
+		typedef std::chrono::steady_clock Clock;
+		const auto start = Clock::now();
+		const auto min_duration = std::chrono::duration<double>(min_seconds);
+		unsigned long long calls = 0;
+		unsigned long long round = 1;
+		while (Clock::now() - start < min_duration)
+		{
+			for (unsigned long long i = 0; i < round; ++i)
+				func();
+			calls += round;
+			round *= 2;
+		}
+		const std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+		return calls ? elapsed.count() / calls : 0.0;
+	}
+}
+
+/// Macro to define a benchmark, out is the report stream.
+#define MB_BENCHMARK(benchName)\
+	class benchName##Benchmark : public microbench::Benchmark\
+	{\
+	public:\
+		benchName##Benchmark()\
+		: Benchmark(#benchName)\
+		{\
+		}\
+		void run(std::ostream & out);\
+	}benchName##Instance;\
+	void benchName##Benchmark::run(std::ostream & out)
+
+/// Macro that runs all benchmarks.
+#define MB_RUN_BENCHMARKS(stream) microbench::BenchmarkManager::instance().runBenchmarks(stream)
+
+#endif // _MICROBENCH_H
@@ -21,8 +21,11 @@
 #include "content/contentmanager.h"
 #include "graphics/texture.h"
 #include "minmax.h"
+#include "microbench.h"
 #include "unittest.h"
 
+#include <cmath>
+
 template <typename T>
 static inline T Lerp(T x, T y, T s)
 {
@@ -30,6 +33,7 @@ static inline T Lerp(T x, T y, T s)
 }
 
 ParticleSystem::ParticleSystem() :
+	count(0),
 	max_particles(512),
 	texture_tiles(9),
 	cur_texture_tile(0),
@@ -39,7 +43,36 @@ ParticleSystem::ParticleSystem() :
 	size_range(0.5,1),
 	direction(0,1,0)
 {
-	// ctor
+	particles.Resize(max_particles);
+	visible.reserve(max_particles);
+	distance_from_cam.reserve(max_particles);
+}
+
+void ParticleSystem::Particles::Resize(unsigned size)
+{
+	for (int k = 0; k < 3; ++k)
+	{
+		start_position[k].resize(size);
+		velocity[k].resize(size);
+		camera_position[k].resize(size);
+	}
+	transparency.resize(size);
+	longevity.resize(size);
+	time.resize(size);
+	tid.resize(size);
+}
+
+void ParticleSystem::Particles::Move(unsigned from, unsigned to)
+{
+	for (int k = 0; k < 3; ++k)
+	{
+		start_position[k][to] = start_position[k][from];
+		velocity[k][to] = velocity[k][from];
+	}
+	transparency[to] = transparency[from];
+	longevity[to] = longevity[from];
+	time[to] = time[from];
+	tid[to] = tid[from];
 }
 
 void ParticleSystem::Load(
@@ -63,23 +96,19 @@ void ParticleSystem::Load(
 void ParticleSystem::Update(float dt)
 {
 	//  update particles
-	for (auto & p : particles)
+	float * time = particles.time.data();
+	for (unsigned i = 0; i < count; ++i)
 	{
-		p.time += dt;
+		time[i] += dt;
 	}
 
-	// remove expired particles
-	for (size_t i = 0; i < particles.size(); i++)
+	// remove expired particles, replace them by the last one
+	for (unsigned i = 0; i < count;)
 	{
-		if (particles[i].time > particles[i].longevity)
-		{
-			//only bother to swap if it's not already at the end
-			size_t last = particles.size() - 1;
-			if (i != last)
-				particles[i] = particles[last];
-
-			particles.pop_back();
-		}
+		if (particles.time[i] > particles.longevity[i])
+			particles.Move(--count, i);
+		else
+			++i;
 	}
 }
 
@@ -88,8 +117,8 @@ void ParticleSystem::UpdateGraphics(
 	const Vec3 & campos,
 	float znear,
 	float zfar,
-	float /*fovy*/,
-	float /*fovz*/)
+	float fovy,
+	float aspect)
 {
 	if (max_particles == 0)
 		return;
@@ -97,39 +126,77 @@ void ParticleSystem::UpdateGraphics(
 	node.GetTransform().SetTranslation(campos);
 	node.GetTransform().SetRotation(-camdir);
 
+	// camera rotation, columns are the rotated axes
+	float m[9];
+	camdir.GetMatrix3(m);
+
 	// get particle position in camera space
-	distance_from_cam.clear();
-	for (auto & p : particles)
+	const float * sp[3] = {particles.start_position[0].data(), particles.start_position[1].data(), particles.start_position[2].data()};
+	const float * sv[3] = {particles.velocity[0].data(), particles.velocity[1].data(), particles.velocity[2].data()};
+	float * cp[3] = {particles.camera_position[0].data(), particles.camera_position[1].data(), particles.camera_position[2].data()};
+	const float * time = particles.time.data();
+	for (unsigned i = 0; i < count; ++i)
 	{
-		Vec3 pos = p.start_position;
-		pos = pos + p.direction * p.time * p.speed - campos;
-		camdir.RotateVector(pos);
+		const float x = sp[0][i] + sv[0][i] * time[i] - campos[0];
+		const float y = sp[1][i] + sv[1][i] * time[i] - campos[1];
+		const float z = sp[2][i] + sv[2][i] * time[i] - campos[2];
+		cp[0][i] = m[0] * x + m[3] * y + m[6] * z;
+		cp[1][i] = m[1] * x + m[4] * y + m[7] * z;
+		cp[2][i] = m[2] * x + m[5] * y + m[8] * z;
+	}
 
+	// frustum side planes through the camera position, a particle is outside
+	// if |x| * cos - distance * sin > radius, disabled by cos = -1, sin = 0
+	float cosx = -1, sinx = 0, cosy = -1, siny = 0;
+	if (fovy > 0)
+	{
+		const float ty = std::tan(fovy * float(M_PI / 360));
+		const float tx = ty * aspect;
+		cosy = 1 / std::sqrt(1 + ty * ty);
+		siny = ty * cosy;
+		cosx = 1 / std::sqrt(1 + tx * tx);
+		sinx = tx * cosx;
+	}
+
+	// cull particles by their bounding sphere
+	visible.clear();
+	distance_from_cam.clear();
+	for (unsigned i = 0; i < count; ++i)
+	{
 		// signed distance along z-axis in camera space
-		distance_from_cam.push_back(-pos[2]);
+		const float distance = -cp[2][i];
+		const float sizescale = 0.2f * (time[i] / particles.longevity[i]) + 0.4f;
+		const float radius = sizescale * 5 / 3.0f;
+		if (distance + radius < znear || distance - radius > zfar ||
+			std::abs(cp[0][i]) * cosx - distance * sinx > radius ||
+			std::abs(cp[1][i]) * cosy - distance * siny > radius)
+			continue;
 
-		// store camera space position
-		p.position = pos;
+		visible.push_back(i);
+		distance_from_cam.push_back(distance);
 	}
 
-	// sort particles by distance to camera
+	// sort particles by distance to camera, draw back to front
+	const unsigned num = visible.size();
+	if (num > 1)
+		radix.sort(distance_from_cam);
 
 	// update vertex data
-	varray.Clear();
-	for (size_t i = 0; i < particles.size(); ++i)
+	float * verts;
+	float * uvs;
+	unsigned char * cols;
+	varray.SetToQuads(num, verts, uvs, cols);
+	for (unsigned n = 0; n < num; ++n)
 	{
-		// cull particles outside of [znear, zfar]
-		// todo: cull particles outside of view frustum
-		if (distance_from_cam[i] < znear || distance_from_cam[i] > zfar)
-			continue;
+		const unsigned i = visible[(num > 1) ? radix.getRanks()[num - 1 - n] : 0];
+		const float age = time[i] / particles.longevity[i];
 
-		Particle & p = particles[i];
-		Vec3 pos = p.position;
-
-		float trans = p.transparency * std::pow((1.0f - p.time / p.longevity), 4.0f);
+		float fade = 1.0f - age;
+		fade = fade * fade;
+		float trans = particles.transparency[i] * fade * fade;
 		trans = Clamp(trans, 0.0f, 1.0f);
 
-		float sizescale = 0.2f * (p.time / p.longevity) + 0.4f;
+		float sizescale = 0.2f * age + 0.4f;
 /*
 		// scale the alpha by the closeness to the camera. if we get too close, don't draw
 		// this prevents major slowdown when there are a lot of particles right next to the camera
@@ -139,45 +206,40 @@ void ParticleSystem::UpdateGraphics(
 		trans = Lerp(0.f, trans, (camdist - camdist_off) / (camdist_full - camdist_off));
 */
 		// assume 9 tiles in texture atlas
-		int vi = p.tid / 3;
-		int ui = p.tid - vi * 3;
+		int vi = particles.tid[i] / 3;
+		int ui = particles.tid[i] - vi * 3;
 		float u1 = ui * 1 / 3.0f;
 		float v1 = vi * 1 / 3.0f;
 		float u2 = u1 + 1 / 3.0f;
 		float v2 = v1 + 1 / 3.0f;
-		float x1 = -sizescale;
-		float y1 = -sizescale * 2 / 3.0f;
-		float x2 = sizescale;
-		float y2 = sizescale * 4 / 3.0f;
+		float x1 = cp[0][i] - sizescale;
+		float y1 = cp[1][i] - sizescale * 2 / 3.0f;
+		float x2 = cp[0][i] + sizescale;
+		float y2 = cp[1][i] + sizescale * 4 / 3.0f;
+		float z = cp[2][i];
 		unsigned char alpha = trans * 255;
 
-		const unsigned int faces[6] = {
-			0, 2, 1,
-			0, 3, 2,
-		};
-		const float uvs[8] = {
-			u1, v1,
-			u2, v1,
-			u2, v2,
-			u1, v2,
-		};
-		const float verts[12] = {
-			pos[0] + x1, pos[1] + y1, pos[2],
-			pos[0] + x2, pos[1] + y1, pos[2],
-			pos[0] + x2, pos[1] + y2, pos[2],
-			pos[0] + x1, pos[1] + y2, pos[2],
-		};
-		const unsigned char cols[16] = {
-			255, 255, 255, alpha,
-			255, 255, 255, alpha,
-			255, 255, 255, alpha,
-			255, 255, 255, alpha,
-		};
-
-		varray.Add(faces, 6, verts, 12, uvs, 8, 0, 0, cols, 16);
+		verts[0] = x1; verts[1] = y1; verts[2] = z;
+		verts[3] = x2; verts[4] = y1; verts[5] = z;
+		verts[6] = x2; verts[7] = y2; verts[8] = z;
+		verts[9] = x1; verts[10] = y2; verts[11] = z;
+		verts += 12;
+
+		uvs[0] = u1; uvs[1] = v1;
+		uvs[2] = u2; uvs[3] = v1;
+		uvs[4] = u2; uvs[5] = v2;
+		uvs[6] = u1; uvs[7] = v2;
+		uvs += 8;
+
+		for (int k = 0; k < 16; k += 4)
+		{
+			cols[k] = cols[k + 1] = cols[k + 2] = 255;
+			cols[k + 3] = alpha;
+		}
+		cols += 16;
 	}
 
-	GetDrawList(node).get(draw).SetDrawEnable(varray.GetNumIndices() > 0);
+	GetDrawList(node).get(draw).SetDrawEnable(num > 0);
 }
 
 void ParticleSystem::AddParticle(
@@ -187,26 +249,25 @@ void ParticleSystem::AddParticle(
 	if (max_particles == 0)
 		return;
 
-	while (particles.size() >= max_particles)
-		particles.pop_back();
-
-	particles.push_back(Particle());
-	Particle & p = particles.back();
-	p.start_position = position;
-	p.direction = direction;
-	p.transparency = transparency_range.first + newspeed * (transparency_range.second - transparency_range.first);
-	p.speed = speed_range.first + newspeed * (speed_range.second - speed_range.first);
-	p.size = size_range.first + newspeed * (size_range.second - size_range.first);
-	p.longevity = longevity_range.first + newspeed * (longevity_range.second - longevity_range.first);
-	p.time = 0;
-	p.tid = cur_texture_tile;
+	// replace the last particle if there is no space left
+	const unsigned i = (count < max_particles) ? count++ : count - 1;
+	const float speed = speed_range.first + newspeed * (speed_range.second - speed_range.first);
+	for (int k = 0; k < 3; ++k)
+	{
+		particles.start_position[k][i] = position[k];
+		particles.velocity[k][i] = direction[k] * speed;
+	}
+	particles.transparency[i] = transparency_range.first + newspeed * (transparency_range.second - transparency_range.first);
+	particles.longevity[i] = longevity_range.first + newspeed * (longevity_range.second - longevity_range.first);
+	particles.time[i] = 0;
+	particles.tid[i] = cur_texture_tile;
 
 	cur_texture_tile = (cur_texture_tile + 1) % texture_tiles;
 }
 
 void ParticleSystem::Clear()
 {
-	particles.clear();
+	count = 0;
 }
 
 void ParticleSystem::SetParameters(
@@ -222,8 +283,11 @@ void ParticleSystem::SetParameters(
 	Vec3 newdir)
 {
 	max_particles = maxparticles < 0 ? 0 : (maxparticles > 1024 ? 1024 : maxparticles);
-	particles.reserve(max_particles);
+	particles.Resize(max_particles);
+	visible.reserve(max_particles);
 	distance_from_cam.reserve(max_particles);
+	if (count > max_particles)
+		count = max_particles;
 
 	transparency_range.first = transmin;
 	transparency_range.second = transmax;
@@ -256,4 +320,60 @@ QT_TEST(particle_test)
 	QT_CHECK_EQUAL(s.NumParticles(),1);
 	s.Update(0.50);
 	QT_CHECK_EQUAL(s.NumParticles(),0);
+
+	// particles outside of the view frustum are culled, visible ones sorted back to front
+	s.SetParameters(8,1.0,1.0,10.0,10.0,0.0,0.0,1.0,1.0,Vec3(0,1,0));
+	s.AddParticle(Vec3(0,0,-10),0);
+	s.AddParticle(Vec3(0,0,-20),0);
+	s.AddParticle(Vec3(0,0,5),0);
+	s.AddParticle(Vec3(100,0,-10),0);
+	s.AddParticle(Vec3(0,-1,-5),0);
+	s.UpdateGraphics(Quat(), Vec3(0,0,0), 0.1, 100, 45, 1.5);
+	QT_CHECK_EQUAL(s.NumParticles(),5);
+	QT_CHECK_EQUAL(s.NumVisible(),3);
+
+	const VertexArray * va = s.GetNode().GetDrawList().particle.begin()->GetVertArray();
+	const float * verts = 0;
+	unsigned vcount = 0;
+	va->GetVertices(verts, vcount);
+	QT_CHECK_EQUAL(vcount, 3 * 12);
+	QT_CHECK_EQUAL(va->GetNumIndices(), 3 * 6);
+	QT_CHECK_EQUAL(verts[2], -20);
+	QT_CHECK_EQUAL(verts[14], -10);
+	QT_CHECK_EQUAL(verts[26], -5);
+
+	// camera space positions match the camera rotation
+	Quat camdir;
+	camdir.Rotate(0.5, 0.6, 0.0, 0.8);
+	Vec3 campos(1, 2, 3);
+	s.Clear();
+	s.AddParticle(Vec3(3,2,-7),0);
+	s.UpdateGraphics(camdir, campos, 0.1, 100);
+	QT_CHECK_EQUAL(s.NumVisible(),1);
+
+	Vec3 pos = Vec3(3,2,-7) - campos;
+	camdir.RotateVector(pos);
+	va->GetVertices(verts, vcount);
+	QT_CHECK_CLOSE((verts[0] + verts[3]) * 0.5f, pos[0], 1E-4);
+	QT_CHECK_CLOSE(verts[2], pos[2], 1E-4);
+}
+
+MB_BENCHMARK(particle_benchmark)
+{
+	std::ostringstream error;
+	ParticleSystem s;
+	ContentManager c(error);
+	s.SetParameters(1024,0.4,0.9,1,4,0.3,0.6,0.02,0.06,Vec3(0,0,1));
+	s.Load(std::string(), std::string(), 0, c);
+
+	// smoke cloud in front of the camera, half of it in view
+	for (int i = 0; i < 1024; ++i)
+		s.AddParticle(Vec3(float(i % 32) - 16, float(i / 32) - 16, -10.0f - (i * 7919 % 101) * 0.1f), (i % 10) * 0.1f);
+	s.Update(0.5);
+
+	Quat camdir;
+	camdir.Rotate(0.4, 0, 1, 0);
+	auto update = [&] { s.UpdateGraphics(camdir, Vec3(0, 0, 0), 0.1f, 1000.0f, 45.0f, 1.6f); };
+	out << "1024 particles update graphics: " << microbench::measure(update) << " ns" << std::endl;
+	out << "visible particles: " << s.NumVisible() << std::endl;
 }
@@ -24,6 +24,7 @@
 #include "graphics/vertexarray.h"
 #include "mathvector.h"
 #include "quaternion.h"
+#include "radix.h"
 
 #include <memory>
 #include <string>
@@ -54,12 +55,15 @@ public:
 	void Update(float dt);
 
 	/// Partcles graphics update based on last physics state.
+	/// Visible particles are sorted back to front. fovy is the vertical field
+	/// of view in degrees, aspect the viewport width / height ratio, particles
+	/// are only culled against the near and far planes if fovy is zero.
 	/// Call once per frame.
 	void UpdateGraphics(
 		const Quat & camdir,
 		const Vec3 & campos,
 		float znear, float zfar,
-		float fovy = 0, float fovz = 0);
+		float fovy = 0, float aspect = 1);
 
 	void Clear();
 
@@ -75,29 +79,42 @@ public:
 		float sizemax,
 		Vec3 newdir);
 
-	unsigned NumParticles() { return particles.size(); }
+	unsigned NumParticles() const { return count; }
+
+	/// Number of particles drawn by the last graphics update.
+	unsigned NumVisible() const { return visible.size(); }
 
 	SceneNode & GetNode() { return node; }
 
 private:
-	struct Particle
+	/// Particle state, stored as arrays of max_particles elements.
+	/// Positions are in world space, camera space positions are only valid
+	/// during a graphics update.
+	struct Particles
 	{
-		Vec3 start_position; ///< start position in world space
-		Vec3 direction;		///< direction in world space
-		Vec3 position;		///< position in camera space
-		float transparency; ///< transparency factor
-		float speed;		///< initial velocity along direction
-		float size;			///< initial size
-		float longevity;	///< particle age limit
-		float time;			///< particle age, time since the particle was created
-		int tid;			///< particle texture atlas tile id 0-8
+		std::vector<float> start_position[3];	///< start position
+		std::vector<float> velocity[3];		///< direction times initial speed
+		std::vector<float> camera_position[3];	///< position in camera space
+		std::vector<float> transparency;		///< transparency factor
+		std::vector<float> longevity;		///< particle age limit
+		std::vector<float> time;			///< particle age, time since the particle was created
+		std::vector<unsigned char> tid;		///< particle texture atlas tile id 0-8
+
+		void Resize(unsigned size);
+
+		void Move(unsigned from, unsigned to);
 	};
-	std::vector<Particle> particles;
-	std::vector<float> distance_from_cam;
+	Particles particles;
+	unsigned count;
 	unsigned max_particles;
 	unsigned texture_tiles;
 	unsigned cur_texture_tile;
 
+	// visible particles and their distance to the camera, sorted by radix
+	std::vector<unsigned> visible;
+	std::vector<float> distance_from_cam;
+	Radix radix;
+
 	std::pair<float,float> transparency_range;
 	std::pair<float,float> longevity_range;
 	std::pair<float,float> speed_range;
@@ -103,6 +103,8 @@ void PathManager::Init(std::ostream & info_output, std::ostream & error_output)
 	MakeDir(GetTrackRecordsPath());
 	MakeDir(GetReplayPath());
 	MakeDir(GetScreenshotPath());
+	MakeDir(GetTextureCachePath());
+	MakeDir(settings_path+"/trackcache");
 	MakeDir(GetTemporaryFolder());
 
 	// Print diagnostic info.
@@ -325,6 +327,16 @@ std::string PathManager::GetScreenshotPath() const
 	return settings_path+"/screenshots";
 }
 
+std::string PathManager::GetTextureCachePath() const
+{
+	return settings_path+"/texturecache";
+}
+
+std::string PathManager::GetTrackCachePath(const std::string & trackname) const
+{
+	return settings_path+"/trackcache/"+trackname;
+}
+
 std::string PathManager::GetStaticReflectionMap() const
 {
 	return GetDataPath()+"/textures/weather/cubereflection-nosun.png";
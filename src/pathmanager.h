@@ -59,6 +59,8 @@ public:
 	std::string GetDefaultCarControlsFile() const;
 	std::string GetReplayPath() const;
 	std::string GetScreenshotPath() const;
+	std::string GetTextureCachePath() const;
+	std::string GetTrackCachePath(const std::string & trackname) const;
 	std::string GetStaticReflectionMap() const;
 	std::string GetStaticAmbientMap() const;
 	std::string GetShaderPath() const;
@@ -184,8 +184,7 @@ static btScalar ComputeFrictionFactor(const PTree & cfg, const btVector3 & size)
 	return cf;
 }
 
-#if defined(VDRIFTP)
-static bool LoadTire(const PTree & cfg_wheel, const PTree & cfg, CarTire & tire, std::ostream & error_output)
+static bool LoadTire(const PTree & cfg_wheel, const PTree & cfg, CarTire3 & tire, std::ostream & error_output)
 {
 	btVector3 tire_size;
 	if (!cfg_wheel.get("tire.size", tire_size, error_output)) return false;
@@ -215,8 +214,8 @@ static bool LoadTire(const PTree & cfg_wheel, const PTree & cfg, CarTire & tire,
 	tire.init();
 	return true;
 }
-#elif defined(VDRIFTN)
-static bool LoadTire(const PTree & cfg_wheel, const PTree & cfg, CarTire & tire, std::ostream & error_output)
+
+static bool LoadTire(const PTree & cfg_wheel, const PTree & cfg, CarTire2 & tire, std::ostream & error_output)
 {
 	if (!cfg.get("tread", tire.tread, error_output)) return false;
 
@@ -226,7 +225,7 @@ static bool LoadTire(const PTree & cfg_wheel, const PTree & cfg, CarTire & tire,
 	tire.roll_resistance_quad = roll_resistance[1];
 
 	if (!cfg.get("FZ0", tire.nominal_load, error_output)) return false;
-	for (int i = 0; i < CarTire::CNUM; ++i)
+	for (int i = 0; i < CarTire2::CNUM; ++i)
 	{
 		if (!cfg.get(tire.coeffname[i], tire.coefficients[i], error_output))
 			return false;
@@ -239,29 +238,29 @@ static bool LoadTire(const PTree & cfg_wheel, const PTree & cfg, CarTire & tire,
 	std::string facing;
 	if (cfg_wheel.get("tire.facing", facing))
 		side_factor = (facing != "left") ? 1 : -1;
-	tire.coefficients[CarTire::PEY3] *= side_factor;
-	tire.coefficients[CarTire::PEY4] *= side_factor;
-	tire.coefficients[CarTire::PVY1] *= side_factor;
-	tire.coefficients[CarTire::PVY2] *= side_factor;
-	tire.coefficients[CarTire::PHY1] *= side_factor;
-	tire.coefficients[CarTire::PHY2] *= side_factor;
-	tire.coefficients[CarTire::PHY3] *= side_factor;
-	tire.coefficients[CarTire::RBY3] *= side_factor;
-	tire.coefficients[CarTire::RHX1] *= side_factor;
-	tire.coefficients[CarTire::RHY1] *= side_factor;
-	tire.coefficients[CarTire::RVY5] *= side_factor;
+	tire.coefficients[CarTire2::PEY3] *= side_factor;
+	tire.coefficients[CarTire2::PEY4] *= side_factor;
+	tire.coefficients[CarTire2::PVY1] *= side_factor;
+	tire.coefficients[CarTire2::PVY2] *= side_factor;
+	tire.coefficients[CarTire2::PHY1] *= side_factor;
+	tire.coefficients[CarTire2::PHY2] *= side_factor;
+	tire.coefficients[CarTire2::PHY3] *= side_factor;
+	tire.coefficients[CarTire2::RBY3] *= side_factor;
+	tire.coefficients[CarTire2::RHX1] *= side_factor;
+	tire.coefficients[CarTire2::RHY1] *= side_factor;
+	tire.coefficients[CarTire2::RVY5] *= side_factor;
 
 	btScalar size_factor = 1;
 	btVector3 size;
 	if (cfg_wheel.get("tire.size", size))
 		size_factor = ComputeFrictionFactor(cfg, size);
-	tire.coefficients[CarTire::PDX1] *= size_factor;
-	tire.coefficients[CarTire::PDY1] *= size_factor;
+	tire.coefficients[CarTire2::PDX1] *= size_factor;
+	tire.coefficients[CarTire2::PDY1] *= size_factor;
 
 	return true;
 }
-#else
-static bool LoadTire(const PTree & cfg_wheel, const PTree & cfg, CarTire & tire, std::ostream & error_output)
+
+static bool LoadTire(const PTree & cfg_wheel, const PTree & cfg, CarTire1 & tire, std::ostream & error_output)
 {
 	if (!cfg.get("tread", tire.tread, error_output)) return false;
 
@@ -327,7 +326,19 @@ static bool LoadTire(const PTree & cfg_wheel, const PTree & cfg, CarTire & tire,
 
 	return true;
 }
-#endif
+
+static bool LoadTire(const PTree & cfg_wheel, const PTree & cfg, int i, CarTireSet & tires, std::ostream & error_output)
+{
+	switch (tires.GetModel())
+	{
+	case CarTireSet::PACEJKA2002:
+		return LoadTire(cfg_wheel, cfg, tires.GetTire2(i), error_output);
+	case CarTireSet::PHYSICAL:
+		return LoadTire(cfg_wheel, cfg, tires.GetTire3(i), error_output);
+	default:
+		return LoadTire(cfg_wheel, cfg, tires.GetTire1(i), error_output);
+	}
+}
 
 static bool LoadWheel(const PTree & cfg, CarWheel & wheel, std::ostream & error_output)
 {
@@ -586,6 +597,16 @@ bool CarDynamics::Load(
 		return false;
 	}
 
+	// tire model, optional
+	CarTireSet::ModelEnum tire_model = CarTireSet::PACEJKA89;
+	std::string tire_model_name;
+	if (cfg.get("tire-model", tire_model_name) && !CarTireSet::GetModel(tire_model_name, tire_model))
+	{
+		error << "Unknown tire model: " << tire_model_name << std::endl;
+		return false;
+	}
+	tire.SetModel(tire_model);
+
 	int i = 0;
 	for (const auto & node : *cfg_wheels)
 	{
@@ -596,14 +617,10 @@ bool CarDynamics::Load(
 		std::shared_ptr<PTree> cfg_tire;
 		if ((cartire.empty() || cartire == "default") &&
 			!cfg_wheel.get("tire.type", tirestr, error)) return false;
-		#if defined(VDRIFTP)
-		tirestr += "p";
-		#elif defined(VDRIFTN)
-		tirestr += "n";
-		#endif
+		tirestr += CarTireSet::GetFileSuffix(tire_model);
 		content.load(cfg_tire, cardir, tirestr);
-		if (!LoadTire(cfg_wheel, *cfg_tire, tire[i], error)) return false;
-		tire[i].initSlipLUT(tire_slip_lut[i]);
+		if (!LoadTire(cfg_wheel, *cfg_tire, i, tire, error)) return false;
+		tire.initSlipLUT(i, tire_slip_lut[i]);
 
 		const PTree * cfg_brake;
 		if (!cfg_wheel.get("brake", cfg_brake, error)) return false;
@@ -660,7 +677,7 @@ bool CarDynamics::Load(
 	body->setContactProcessingThreshold(0.0);
 	body->setCollisionFlags(body->getCollisionFlags() | btCollisionObject::CF_CUSTOM_MATERIAL_CALLBACK);
 	world.addRigidBody(body);
-	world.addAction(this);
+	world.addParallelAction(this);
 	this->world = &world;
 
 	// position is the center of a 2 x 4 x 1 meter box on track surface
@@ -685,11 +702,23 @@ bool CarDynamics::Load(
 	// use max Mz of the 2 front wheels assuming even weight distribution
 	// and a fudge factor of 8 to get feedback into -1, 1 range
 	const float max_wheel_load = gravity / (4 * body->getInvMass());
-	feedback_scale = 1 / (8 * 2 * tire[0].getMaxMz(max_wheel_load, 0));
+	feedback_scale = 1 / (8 * 2 * tire.getMaxMz(0, max_wheel_load, 0));
 
 	return true;
 }
 
+bool CarDynamics::InitTireLUT(std::ostream & error)
+{
+	// loads beyond three times the static wheel load are extrapolated
+	const btScalar static_wheel_load = gravity / (WHEEL_COUNT * body->getInvMass());
+	return tire.initForceLUT(3 * static_wheel_load, error);
+}
+
+const CarTireSet & CarDynamics::GetTires() const
+{
+	return tire;
+}
+
 void CarDynamics::SetPosition(const btVector3 & position)
 {
 	body->translate(position - body->getCenterOfMassPosition());
@@ -1228,10 +1257,38 @@ void CarDynamics::updateAction(btCollisionWorld * /*collisionWorld*/, btScalar d
 	UpdateWheelTransform();
 }
 
+void CarDynamics::getQueryAabb(btVector3 & aabbMin, btVector3 & aabbMax) const
+{
+	// updateAction resets the body to transform before casting the wheel rays
+	btVector3 raydir = -transform.getBasis().getColumn(Direction::UP);
+	btScalar raylen = 4;
+	aabbMin = aabbMax = transform.getOrigin();
+	for (int i = 0; i < WHEEL_COUNT; ++i)
+	{
+		btVector3 raystart = transform.getOrigin() + wheel_position[i] - raydir * wheel[i].GetRadius();
+		btVector3 rayend = raystart + raydir * raylen;
+		aabbMin.setMin(raystart);
+		aabbMin.setMin(rayend);
+		aabbMax.setMax(raystart);
+		aabbMax.setMax(rayend);
+	}
+
+	// margin for rounding differences
+	btVector3 margin(0.1, 0.1, 0.1);
+	aabbMin -= margin;
+	aabbMax += margin;
+}
+
 void CarDynamics::UpdateWheelContacts()
 {
 	btVector3 raydir = GetDownVector();
 	btScalar raylen = 4;
+
+	// cast the rays of all attached wheels in one batch
+	DynamicsWorld::RayQuery rays[WHEEL_COUNT];
+	CollisionContact contacts[WHEEL_COUNT];
+	int wheels[WHEEL_COUNT];
+	int count = 0;
 	for (int i = 0; i < WHEEL_COUNT; ++i)
 	{
 		btVector3 raystart = body->getCenterOfMassPosition() + wheel_position[i] - raydir * wheel[i].GetRadius();
@@ -1242,9 +1299,21 @@ void CarDynamics::UpdateWheelContacts()
 		}
 		else
 		{
-			world->castRay(raystart, raydir, raylen, body, wheel_contact[i]);
+			rays[count].position = raystart;
+			rays[count].direction = raydir;
+			rays[count].length = raylen;
+			rays[count].caster = body;
+			contacts[count] = wheel_contact[i];
+			wheels[count] = i;
+			count++;
 		}
 	}
+
+	if (count > 0)
+		world->castRays(rays, count, contacts);
+
+	for (int n = 0; n < count; ++n)
+		wheel_contact[wheels[n]] = contacts[n];
 }
 
 void CarDynamics::InitDriveline2(btScalar dt)
@@ -1371,8 +1440,9 @@ void CarDynamics::SetupWheelConstraints(const btMatrix3x3 wheel_orientation[WHEE
 		btVector3 x = (xw - z * coszxw).normalized();
 		btVector3 y = (yw - z * coszyw).normalized();
 		btScalar camber = btScalar(M_PI_2) - btAcos(coszxw);
-		btScalar friction = tire[i].getTread() * wheel_contact[i].GetSurface().frictionTread +
-			(1 - tire[i].getTread()) * wheel_contact[i].GetSurface().frictionNonTread;
+		btScalar tread = tire.getTread(i);
+		btScalar friction = tread * wheel_contact[i].GetSurface().frictionTread +
+			(1 - tread) * wheel_contact[i].GetSurface().frictionNonTread;
 
 		auto & w = wheel_constraint[i];
 		w.body = body;
@@ -1421,7 +1491,7 @@ void CarDynamics::ApplyRollingResistance(int i)
 {
 	auto & shaft = wheel[i].GetShaft();
 	btScalar vr = wheel[i].GetAngularVelocity() * wheel[i].GetRadius();
-	btScalar cr = tire[i].getRollingResistance(vr, wheel_contact[i].GetSurface().rollResistanceCoefficient);
+	btScalar cr = tire.getRollingResistance(i, vr, wheel_contact[i].GetSurface().rollResistanceCoefficient);
 	btScalar suspension_impulse = wheel_constraint[i].constraint[2].impulse;
 	btScalar impulse_mag = cr * suspension_impulse * wheel[i].GetRadius();
 	btScalar impulse_limit = std::abs(shaft.ang_velocity) * shaft.inertia;
@@ -1431,14 +1501,32 @@ void CarDynamics::ApplyRollingResistance(int i)
 
 void CarDynamics::UpdateWheelConstraints(btScalar rdt, btScalar sdt)
 {
+	btScalar suspension_force[WHEEL_COUNT];
+	btScalar friction[WHEEL_COUNT];
+	btScalar camber[WHEEL_COUNT];
+	btScalar rot_velocity[WHEEL_COUNT];
+	btScalar lon_velocity[WHEEL_COUNT];
+	btScalar lat_velocity[WHEEL_COUNT];
 	for (int i = 0; i < WHEEL_COUNT; ++i)
 	{
-		auto & c = wheel_constraint[i];
-		auto & t = tire_state[i];
+		const auto & c = wheel_constraint[i];
 		btScalar v[3];
 		c.getContactVelocity(v);
-		btScalar suspension_force = c.constraint[2].impulse * rdt;
-		tire[i].ComputeState(suspension_force, c.friction, c.camber, v[2], v[0], v[1], t);
+		suspension_force[i] = c.constraint[2].impulse * rdt;
+		friction[i] = c.friction;
+		camber[i] = c.camber;
+		rot_velocity[i] = v[2];
+		lon_velocity[i] = v[0];
+		lat_velocity[i] = v[1];
+	}
+
+	tire.ComputeState(WHEEL_COUNT, suspension_force, friction, camber,
+		rot_velocity, lon_velocity, lat_velocity, tire_state);
+
+	for (int i = 0; i < WHEEL_COUNT; ++i)
+	{
+		auto & c = wheel_constraint[i];
+		const auto & t = tire_state[i];
 		c.constraint[0].upper_impulse_limit = Max(t.fx * sdt, btScalar(0));
 		c.constraint[0].lower_impulse_limit = Min(t.fx * sdt, btScalar(0));
 		c.constraint[0].impulse = 0;
@@ -1501,16 +1589,19 @@ void CarDynamics::UpdateDriveline(btScalar dt)
 	}
 
 	// update wheel and tire state
+	btScalar fz[WHEEL_COUNT];
+	btScalar friction[WHEEL_COUNT];
 	for (int i = 0; i < WHEEL_COUNT; ++i)
 	{
 		auto & c = wheel_constraint[i];
 		auto & t = tire_state[i];
 		c.getContactVelocity(wheel_velocity[i]);
-		btScalar fz = c.constraint[2].impulse * rdt;
-		tire_slip_lut[i].get(fz, t.ideal_slip, t.ideal_slip_angle);
-		tire[i].ComputeAligningTorque(fz, c.friction, t);
+		fz[i] = c.constraint[2].impulse * rdt;
+		friction[i] = c.friction;
+		tire_slip_lut[i].get(fz[i], t.ideal_slip, t.ideal_slip_angle);
 		wheel[i].Integrate(dt);
 	}
+	tire.ComputeAligningTorque(WHEEL_COUNT, fz, friction, tire_state);
 }
 
 void CarDynamics::UpdateTransmission(btScalar dt)
@@ -1705,8 +1796,8 @@ btScalar CarDynamics::CalculateGripBalance() const
 	btScalar m = 1 / body->getInvMass();
 	btScalar m1 = m * r2 / (r2 - r1);
 	btScalar m2 = m - m1;
-	btScalar f1 = tire[0].getMaxFy(m1 * (gravity * 0.5f), 0);
-	btScalar f2 = tire[2].getMaxFy(m2 * (gravity * 0.5f), 0);
+	btScalar f1 = tire.getMaxFy(0, m1 * (gravity * 0.5f), 0);
+	btScalar f2 = tire.getMaxFy(2, m2 * (gravity * 0.5f), 0);
 	btScalar t1 = f1 * r1;
 	btScalar t2 = f2 * r2;
 	return -t1 / (t2 - t1);
@@ -1733,8 +1824,8 @@ void CarDynamics::CalculateFrictionCoeffs(btScalar & mulon, btScalar & mulat) co
 	btScalar lat_friction = 0;
 	for (int i = 0; i < WHEEL_COUNT; i++)
 	{
-		lon_friction += tire[i].getMaxFx(tire_load);
-		lat_friction += tire[i].getMaxFy(tire_load, 0);
+		lon_friction += tire.getMaxFx(i, tire_load);
+		lat_friction += tire.getMaxFy(i, tire_load, 0);
 	}
 	mulon = lon_friction / mg;
 	mulat = lat_friction / mg;
@@ -1846,7 +1937,7 @@ void CarDynamics::Clear()
 		}
 		delete child;
 	}
-	world->removeAction(this);
+	world->removeParallelAction(this);
 	world->removeRigidBody(body);
 	world = 0;
 
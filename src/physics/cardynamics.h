@@ -35,10 +35,9 @@
 #include "wheelconstraint.h"
 #include "driveline.h"
 #include "motionstate.h"
+#include "parallelaction.h"
 #include "macros.h"
 
-#include "BulletDynamics/Dynamics/btActionInterface.h"
-
 struct btCollisionObjectWrapper;
 class btCollisionWorld;
 class btManifoldPoint;
@@ -48,7 +47,7 @@ class FractureBody;
 class ContentManager;
 class PTree;
 
-class CarDynamics : public btActionInterface
+class CarDynamics : public ParallelAction
 {
 public:
 	CarDynamics();
@@ -71,6 +70,13 @@ public:
 		ContentManager & content,
 		std::ostream & error);
 
+	// bake tire force lookup tables after Load, used instead of the analytic
+	// tire model if their error is within bounds, reports failure to error
+	bool InitTireLUT(std::ostream & error);
+
+	// tires of the car
+	const CarTireSet & GetTires() const;
+
 	// set body position
 	void SetPosition(const btVector3 & pos);
 
@@ -92,6 +98,9 @@ public:
 	void updateAction(btCollisionWorld * collisionWorld, btScalar dt) override;
 	void debugDraw(btIDebugDraw * debugDrawer) override;
 
+	// parallel action interface, wheel contact rays of the next update
+	void getQueryAabb(btVector3 & aabbMin, btVector3 & aabbMax) const override;
+
 	// graphics interpolated
 	btVector3 GetEnginePosition() const;
 	const btVector3 & GetPosition() const;
@@ -161,7 +170,7 @@ public:
 	// This is needed for ray casts in the AI implementation.
 	DynamicsWorld * getDynamicsWorld() const {return world;}
 
-	const btCollisionObject & getCollisionObject() const;
+	const btCollisionObject & getCollisionObject() const override;
 
 	btVector3 LocalToWorld(const btVector3 & local) const;
 
@@ -206,7 +215,7 @@ protected:
 	CarDifferential differential[DIFF_COUNT];
 	CarBrake brake[WHEEL_COUNT];
 	CarWheel wheel[WHEEL_COUNT];
-	CarTire tire[WHEEL_COUNT];
+	CarTireSet tire;
 	CarTireSlipLUT tire_slip_lut[WHEEL_COUNT];
 	CarTireState tire_state[WHEEL_COUNT];
 	CarSuspension suspension[WHEEL_COUNT];
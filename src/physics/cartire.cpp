@@ -0,0 +1,647 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#include "cartire.h"
+#include "minmax.h"
+#include "microbench.h"
+#include "unittest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <vector>
+
+static const char * model_names[] = {"pacejka89", "pacejka2002", "physical"};
+static const char * model_suffixes[] = {"", "n", "p"};
+
+template <class Tire>
+static void ComputeStates(
+	const Tire tire[],
+	int count,
+	const btScalar normal_force[],
+	const btScalar friction_coeff[],
+	const btScalar sin_camber[],
+	const btScalar rot_velocity[],
+	const btScalar lon_velocity[],
+	const btScalar lat_velocity[],
+	CarTireState s[])
+{
+	for (int i = 0; i < count; ++i)
+	{
+		tire[i].ComputeState(
+			normal_force[i], friction_coeff[i], sin_camber[i],
+			rot_velocity[i], lon_velocity[i], lat_velocity[i], s[i]);
+	}
+}
+
+template <class Tire>
+static void ComputeStates(
+	const Tire tire[],
+	const std::shared_ptr<const CarTireForceLUT> lut[],
+	int count,
+	const btScalar normal_force[],
+	const btScalar friction_coeff[],
+	const btScalar sin_camber[],
+	const btScalar rot_velocity[],
+	const btScalar lon_velocity[],
+	const btScalar lat_velocity[],
+	CarTireState s[])
+{
+	for (int i = 0; i < count; ++i)
+	{
+		tire[i].ComputeState(*lut[i],
+			normal_force[i], friction_coeff[i], sin_camber[i],
+			rot_velocity[i], lon_velocity[i], lat_velocity[i], s[i]);
+	}
+}
+
+template <class Tire>
+static void ComputeAligningTorques(
+	const Tire tire[],
+	int count,
+	const btScalar normal_force[],
+	const btScalar friction_coeff[],
+	CarTireState s[])
+{
+	for (int i = 0; i < count; ++i)
+	{
+		tire[i].ComputeAligningTorque(normal_force[i], friction_coeff[i], s[i]);
+	}
+}
+
+template <class Tire>
+static void ComputeAligningTorques(
+	const Tire tire[],
+	const std::shared_ptr<const CarTireForceLUT> lut[],
+	int count,
+	const btScalar normal_force[],
+	const btScalar friction_coeff[],
+	CarTireState s[])
+{
+	for (int i = 0; i < count; ++i)
+	{
+		tire[i].ComputeAligningTorque(*lut[i], normal_force[i], friction_coeff[i], s[i]);
+	}
+}
+
+// compare lookup table and analytic tire state over typical tire inputs
+template <class Tire>
+static void MeasureForceLUTError(
+	const Tire & tire,
+	const CarTireForceLUT & lut,
+	btScalar max_load,
+	btScalar & force_error,
+	btScalar & torque_error)
+{
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<btScalar> load(max_load * btScalar(0.1), max_load);
+	std::uniform_real_distribution<btScalar> camber(-0.1, 0.1);
+	std::uniform_real_distribution<btScalar> slip(-1, 1);
+	std::uniform_real_distribution<btScalar> slip_angle(-0.5, 0.5);
+	const btScalar velocity = 20;
+	btScalar max_force_delta = 0;
+	btScalar max_torque_delta = 0;
+	btScalar max_torque = 0;
+	for (int n = 0; n < 4096; ++n)
+	{
+		btScalar fz = load(rng);
+		btScalar sin_camber = camber(rng);
+		btScalar rot_velocity = velocity * (1 + slip(rng));
+		btScalar lat_velocity = velocity * std::tan(slip_angle(rng));
+
+		CarTireState a, b;
+		tire.ComputeState(fz, 1, sin_camber, rot_velocity, velocity, lat_velocity, a);
+		tire.ComputeAligningTorque(fz, 1, a);
+		tire.ComputeState(lut, fz, 1, sin_camber, rot_velocity, velocity, lat_velocity, b);
+		tire.ComputeAligningTorque(lut, fz, 1, b);
+
+		btScalar force_delta = Max(std::abs(a.fx - b.fx), std::abs(a.fy - b.fy)) / fz;
+		max_force_delta = Max(max_force_delta, force_delta);
+		max_torque_delta = Max(max_torque_delta, std::abs(a.mz - b.mz));
+		max_torque = Max(max_torque, std::abs(a.mz));
+	}
+	force_error = Max(force_error, max_force_delta);
+	torque_error = Max(torque_error, max_torque_delta / Max(max_torque, btScalar(1E-3)));
+}
+
+template <class Tire>
+static void InitForceLUT(
+	const Tire tire[],
+	btScalar max_load,
+	std::shared_ptr<const CarTireForceLUT> lut[],
+	btScalar & force_error,
+	btScalar & torque_error)
+{
+	for (int i = 0; i < WHEEL_COUNT; ++i)
+	{
+		auto t = std::make_shared<CarTireForceLUT>();
+		tire[i].initForceLUT(max_load, *t);
+
+		// wheels with identical tires share tables
+		lut[i] = t;
+		for (int j = 0; j < i; ++j)
+		{
+			if (*lut[j] == *t)
+			{
+				lut[i] = lut[j];
+				break;
+			}
+		}
+		if (lut[i] == t)
+			MeasureForceLUTError(tire[i], *t, max_load, force_error, torque_error);
+	}
+}
+
+bool CarTireSet::GetModel(const std::string & name, ModelEnum & model)
+{
+	for (int i = 0; i < MODEL_COUNT; ++i)
+	{
+		if (name == model_names[i])
+		{
+			model = ModelEnum(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+const char * CarTireSet::GetModelName(ModelEnum model)
+{
+	return model_names[model];
+}
+
+const char * CarTireSet::GetFileSuffix(ModelEnum model)
+{
+	return model_suffixes[model];
+}
+
+CarTireSet::CarTireSet() :
+	model(PACEJKA89),
+	reference(false),
+	tire1(new CarTire1[WHEEL_COUNT]),
+	force_lut_error(0),
+	torque_lut_error(0)
+{
+	// ctor
+}
+
+void CarTireSet::SetModel(ModelEnum value)
+{
+	model = value;
+	tire1.reset(model == PACEJKA89 ? new CarTire1[WHEEL_COUNT] : 0);
+	tire2.reset(model == PACEJKA2002 ? new CarTire2[WHEEL_COUNT] : 0);
+	tire3.reset(model == PHYSICAL ? new CarTire3[WHEEL_COUNT] : 0);
+	for (auto & lut : force_lut)
+		lut.reset();
+	force_lut_error = torque_lut_error = 0;
+}
+
+bool CarTireSet::initForceLUT(btScalar max_load, std::ostream & error_output)
+{
+	// error bounds of the tables, relative to load and peak aligning torque
+	const btScalar max_force_error = 0.02;
+	const btScalar max_torque_error = 0.05;
+
+	std::shared_ptr<const CarTireForceLUT> lut[WHEEL_COUNT];
+	btScalar force_error = 0;
+	btScalar torque_error = 0;
+	switch (model)
+	{
+	case PACEJKA89:
+		InitForceLUT(tire1.get(), max_load, lut, force_error, torque_error);
+		break;
+	case PACEJKA2002:
+		InitForceLUT(tire2.get(), max_load, lut, force_error, torque_error);
+		break;
+	default:
+		error_output << "Tire model " << GetModelName(model) << " has no force lookup tables" << std::endl;
+		return false;
+	}
+
+	if (force_error > max_force_error || torque_error > max_torque_error)
+	{
+		error_output << "Tire force lookup table error too large, force "
+			<< force_error * 100 << "% torque " << torque_error * 100 << "%" << std::endl;
+		return false;
+	}
+
+	std::copy(lut, lut + WHEEL_COUNT, force_lut);
+	force_lut_error = force_error;
+	torque_lut_error = torque_error;
+	return true;
+}
+
+unsigned CarTireSet::GetForceLUTSize() const
+{
+	unsigned size = 0;
+	for (int i = 0; i < WHEEL_COUNT; ++i)
+	{
+		if (force_lut[i] && std::find(force_lut, force_lut + i, force_lut[i]) == force_lut + i)
+			size += force_lut[i]->GetSize();
+	}
+	return size;
+}
+
+void CarTireSet::ComputeState(
+	int count,
+	const btScalar normal_force[],
+	const btScalar friction_coeff[],
+	const btScalar sin_camber[],
+	const btScalar rot_velocity[],
+	const btScalar lon_velocity[],
+	const btScalar lat_velocity[],
+	CarTireState s[]) const
+{
+	if (force_lut[0])
+	{
+		if (model == PACEJKA2002)
+			ComputeStates(tire2.get(), force_lut, count, normal_force, friction_coeff, sin_camber, rot_velocity, lon_velocity, lat_velocity, s);
+		else
+			ComputeStates(tire1.get(), force_lut, count, normal_force, friction_coeff, sin_camber, rot_velocity, lon_velocity, lat_velocity, s);
+		return;
+	}
+
+	switch (model)
+	{
+	case PACEJKA2002:
+		ComputeStates(tire2.get(), count, normal_force, friction_coeff, sin_camber, rot_velocity, lon_velocity, lat_velocity, s);
+		break;
+	case PHYSICAL:
+		ComputeStates(tire3.get(), count, normal_force, friction_coeff, sin_camber, rot_velocity, lon_velocity, lat_velocity, s);
+		break;
+	default:
+		if (reference)
+			ComputeStates(tire1.get(), count, normal_force, friction_coeff, sin_camber, rot_velocity, lon_velocity, lat_velocity, s);
+		else
+			CarTire1::ComputeStates(tire1.get(), count, normal_force, friction_coeff, sin_camber, rot_velocity, lon_velocity, lat_velocity, s);
+		break;
+	}
+}
+
+void CarTireSet::ComputeAligningTorque(
+	int count,
+	const btScalar normal_force[],
+	const btScalar friction_coeff[],
+	CarTireState s[]) const
+{
+	if (force_lut[0])
+	{
+		if (model == PACEJKA2002)
+			ComputeAligningTorques(tire2.get(), force_lut, count, normal_force, friction_coeff, s);
+		else
+			ComputeAligningTorques(tire1.get(), force_lut, count, normal_force, friction_coeff, s);
+		return;
+	}
+
+	switch (model)
+	{
+	case PACEJKA2002:
+		ComputeAligningTorques(tire2.get(), count, normal_force, friction_coeff, s);
+		break;
+	case PHYSICAL:
+		ComputeAligningTorques(tire3.get(), count, normal_force, friction_coeff, s);
+		break;
+	default:
+		if (reference)
+			ComputeAligningTorques(tire1.get(), count, normal_force, friction_coeff, s);
+		else
+			CarTire1::ComputeAligningTorques(tire1.get(), count, normal_force, friction_coeff, s);
+		break;
+	}
+}
+
+// pacejka '89 coefficients of a road tire
+static void InitTire(CarTire1 & tire)
+{
+	const btScalar a[] = {1.5, -40, 1600, 2600, 8.7, 0.014, -0.24, 1.0, -0.03, -0.0013, -0.15, -8.5, -0.29, 17.8, -2.4};
+	const btScalar b[] = {1.5, -80, 1950, 23.3, 390, 0.05, 0, 0.055, -0.024, 0.014, 0.26};
+	const btScalar c[] = {2.2, -3.9, -3.9, -1.26, -8.2, 0.025, 0, 0.044, -0.58, 0.18, 0.043, 0.048, -0.0035, -0.18, 0.14, -1.029, 0.27, -1.1};
+	const btScalar g[] = {2.4, 2.0, 9.0, 12.0};
+	std::copy(a, a + 15, tire.lateral);
+	std::copy(b, b + 11, tire.longitudinal);
+	std::copy(c, c + 18, tire.aligning);
+	std::copy(g, g + 4, tire.combining);
+}
+
+// magic formula 2002 coefficients of a 205/60R15 tire
+static void InitTire(CarTire2 & tire)
+{
+	const btScalar p[CarTire2::CNUM] = {
+		1.6411,
+		1.1739, -0.16395,
+		0.46403, 0.25022, 0.067842, -3.7604e-5,
+		22.303, 0.48896, 0.21253,
+		2.1e-4, 1.5e-4,
+		0, 0,
+		1.3507,
+		1.0489, -0.18033, -2.8821,
+		-0.8057, -0.6046, 0.09854, -6.697,
+		-21.92, 2.0012, -0.024778,
+		0.0026747, 8.9094e-5, 0.031415,
+		0.037318, -0.010049, -0.32931, -0.69553,
+		10.904, -1.8412, -0.52041, 0.039211, 0.41511,
+		1.2136,
+		0.093509, -0.009218, -0.057061, 0.73954,
+		-1.6, 0.4, 0, 0.17, -0.9,
+		0.0047326, 0.0026687, 0.11998, 0.059083,
+		0, 0,
+		0.0011, -0.003, -0.1, 0.02,
+		13.046, 9.718,
+		0.9995,
+		0,
+		10.622, 7.82, 0.002037,
+		1.0587,
+		0.02,
+		0.05, 0.03, -0.3, 100, 1.9, -10};
+	std::copy(p, p + CarTire2::CNUM, tire.coefficients);
+	tire.nominal_load = 4000;
+}
+
+static void InitTire(CarTire3 & tire)
+{
+	tire.init();
+}
+
+// random wheel inputs covering free rolling to locked and sliding wheels
+struct TireInputs
+{
+	std::vector<btScalar> normal_force;
+	std::vector<btScalar> friction_coeff;
+	std::vector<btScalar> sin_camber;
+	std::vector<btScalar> rot_velocity;
+	std::vector<btScalar> lon_velocity;
+	std::vector<btScalar> lat_velocity;
+
+	TireInputs(int count, unsigned seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<btScalar> load(500, 8000);
+		std::uniform_real_distribution<btScalar> friction(0.6, 1.1);
+		std::uniform_real_distribution<btScalar> camber(-0.05, 0.05);
+		std::uniform_real_distribution<btScalar> speed(1, 60);
+		std::uniform_real_distribution<btScalar> slip(-0.3, 0.3);
+		std::uniform_real_distribution<btScalar> slip_angle(-0.25, 0.25);
+		for (int i = 0; i < count; ++i)
+		{
+			btScalar v = speed(rng);
+			normal_force.push_back(load(rng));
+			friction_coeff.push_back(friction(rng));
+			sin_camber.push_back(camber(rng));
+			lon_velocity.push_back(v);
+			rot_velocity.push_back(v * (1 + slip(rng)));
+			lat_velocity.push_back(v * std::tan(slip_angle(rng)));
+		}
+	}
+};
+
+static CarTireSet CreateTireSet(CarTireSet::ModelEnum model)
+{
+	CarTireSet tires;
+	tires.SetModel(model);
+	for (int i = 0; i < WHEEL_COUNT; ++i)
+	{
+		switch (model)
+		{
+		case CarTireSet::PACEJKA2002:
+			InitTire(tires.GetTire2(i));
+			break;
+		case CarTireSet::PHYSICAL:
+			InitTire(tires.GetTire3(i));
+			break;
+		default:
+			InitTire(tires.GetTire1(i));
+			break;
+		}
+	}
+	return tires;
+}
+
+QT_TEST(cartire_test)
+{
+	CarTireSet::ModelEnum model = CarTireSet::PACEJKA89;
+	QT_CHECK(CarTireSet::GetModel("pacejka2002", model));
+	QT_CHECK_EQUAL(model, CarTireSet::PACEJKA2002);
+	QT_CHECK(!CarTireSet::GetModel("unknown", model));
+
+	// batched evaluation matches per tire evaluation
+	const TireInputs in(WHEEL_COUNT, 1);
+	for (int m = 0; m < CarTireSet::MODEL_COUNT; ++m)
+	{
+		const CarTireSet tires = CreateTireSet(CarTireSet::ModelEnum(m));
+		CarTireState s[WHEEL_COUNT];
+		tires.ComputeState(WHEEL_COUNT,
+			&in.normal_force[0], &in.friction_coeff[0], &in.sin_camber[0],
+			&in.rot_velocity[0], &in.lon_velocity[0], &in.lat_velocity[0], s);
+		tires.ComputeAligningTorque(WHEEL_COUNT, &in.normal_force[0], &in.friction_coeff[0], s);
+
+		CarTireSet single = CreateTireSet(CarTireSet::ModelEnum(m));
+		for (int i = 0; i < WHEEL_COUNT; ++i)
+		{
+			CarTireState e;
+			if (m == CarTireSet::PACEJKA89)
+			{
+				single.GetTire1(i).ComputeState(in.normal_force[i], in.friction_coeff[i], in.sin_camber[i],
+					in.rot_velocity[i], in.lon_velocity[i], in.lat_velocity[i], e);
+				single.GetTire1(i).ComputeAligningTorque(in.normal_force[i], in.friction_coeff[i], e);
+			}
+			else if (m == CarTireSet::PACEJKA2002)
+			{
+				single.GetTire2(i).ComputeState(in.normal_force[i], in.friction_coeff[i], in.sin_camber[i],
+					in.rot_velocity[i], in.lon_velocity[i], in.lat_velocity[i], e);
+			}
+			else
+			{
+				single.GetTire3(i).ComputeState(in.normal_force[i], in.friction_coeff[i], in.sin_camber[i],
+					in.rot_velocity[i], in.lon_velocity[i], in.lat_velocity[i], e);
+			}
+			QT_CHECK(std::isfinite(s[i].fx) && std::isfinite(s[i].fy) && std::isfinite(s[i].mz));
+			QT_CHECK_EQUAL(s[i].fx, e.fx);
+			QT_CHECK_EQUAL(s[i].fy, e.fy);
+			QT_CHECK_EQUAL(s[i].mz, e.mz);
+		}
+	}
+
+	// peak lateral force matches the force over slip angles, camber in rad for all models
+	for (int m = CarTireSet::PACEJKA89; m <= CarTireSet::PACEJKA2002; ++m)
+	{
+		const CarTireSet tires = CreateTireSet(CarTireSet::ModelEnum(m));
+		const btScalar camber[] = {-0.05, 0.05};
+		for (int i = 0; i < WHEEL_COUNT; ++i)
+		{
+			const btScalar load = 4000;
+			const btScalar velocity = 20;
+			const btScalar sin_camber = std::sin(camber[i % 2]);
+			btScalar max_fy = 0;
+			btScalar max_mz = 0;
+			for (btScalar slip_angle = -0.5; slip_angle < 0.5; slip_angle += btScalar(0.001))
+			{
+				CarTireState e;
+				const btScalar lat_velocity = velocity * std::tan(slip_angle);
+				tires.ComputeState(1, &load, &in.friction_coeff[0], &sin_camber,
+					&velocity, &velocity, &lat_velocity, &e);
+				tires.ComputeAligningTorque(1, &load, &in.friction_coeff[0], &e);
+				max_fy = Max(max_fy, e.fy);
+				max_mz = Max(max_mz, -e.mz);
+			}
+			max_fy /= in.friction_coeff[0];
+			max_mz /= in.friction_coeff[0];
+			QT_CHECK_CLOSE(tires.getMaxFy(i, load, camber[i % 2]), max_fy, max_fy * btScalar(0.002));
+			if (m == CarTireSet::PACEJKA89)
+				QT_CHECK_CLOSE(tires.getMaxMz(i, load, camber[i % 2]), max_mz, max_mz * btScalar(0.002));
+		}
+	}
+
+	// batched kernels match reference mode for any count, including unloaded tires
+	TireInputs many(1001, 2);
+	for (int i = 0; i < 1001; i += 97)
+		many.normal_force[i] = 0;
+	std::vector<CarTire1> tires1(1001);
+	for (auto & t : tires1)
+		InitTire(t);
+	std::vector<CarTireState> batch(1001), reference(1001);
+	CarTire1::ComputeStates(&tires1[0], 1001,
+		&many.normal_force[0], &many.friction_coeff[0], &many.sin_camber[0],
+		&many.rot_velocity[0], &many.lon_velocity[0], &many.lat_velocity[0], &batch[0]);
+	CarTire1::ComputeAligningTorques(&tires1[0], 1001, &many.normal_force[0], &many.friction_coeff[0], &batch[0]);
+	// identical unless the compiler contracts floating point operations
+	btScalar max_delta = 0;
+	for (int i = 0; i < 1001; ++i)
+	{
+		auto & e = reference[i];
+		tires1[i].ComputeState(many.normal_force[i], many.friction_coeff[i], many.sin_camber[i],
+			many.rot_velocity[i], many.lon_velocity[i], many.lat_velocity[i], e);
+		tires1[i].ComputeAligningTorque(many.normal_force[i], many.friction_coeff[i], e);
+		const auto & b = batch[i];
+		const btScalar scale = 1 / (many.normal_force[i] + 1);
+		max_delta = Max(max_delta, std::abs(b.camber - e.camber));
+		max_delta = Max(max_delta, std::abs(b.slip - e.slip));
+		max_delta = Max(max_delta, std::abs(b.slip_angle - e.slip_angle));
+		max_delta = Max(max_delta, std::abs(b.fx - e.fx) * scale);
+		max_delta = Max(max_delta, std::abs(b.fy - e.fy) * scale);
+		max_delta = Max(max_delta, std::abs(b.mz - e.mz) * scale);
+	}
+	QT_CHECK(max_delta < btScalar(1E-5));
+
+	CarTireSet reference_set = CreateTireSet(CarTireSet::PACEJKA89);
+	reference_set.SetReferenceMode(true);
+	QT_CHECK(reference_set.GetReferenceMode());
+
+	// force lookup tables within error bounds, physical model has none
+	std::ostringstream error;
+	for (int m = 0; m < CarTireSet::MODEL_COUNT; ++m)
+	{
+		CarTireSet tires = CreateTireSet(CarTireSet::ModelEnum(m));
+		const bool lut = tires.initForceLUT(8000, error);
+		QT_CHECK_EQUAL(lut, m != CarTireSet::PHYSICAL);
+		QT_CHECK_EQUAL(tires.GetForceLUT(), lut);
+		if (!lut)
+			continue;
+
+		// identical tires share tables
+		CarTireSet mixed = CreateTireSet(CarTireSet::ModelEnum(m));
+		if (m == CarTireSet::PACEJKA89)
+			mixed.GetTire1(3).lateral[2] *= btScalar(0.9);
+		else
+			mixed.GetTire2(3).coefficients[CarTire2::PDY1] *= btScalar(0.9);
+		QT_CHECK(mixed.initForceLUT(8000, error));
+		QT_CHECK(tires.GetForceLUTSize() > 0);
+		QT_CHECK_EQUAL(mixed.GetForceLUTSize(), 2 * tires.GetForceLUTSize());
+		QT_CHECK(tires.GetForceLUTError() < btScalar(0.02));
+		QT_CHECK(tires.GetTorqueLUTError() < btScalar(0.05));
+
+		CarTireState s[WHEEL_COUNT];
+		tires.ComputeState(WHEEL_COUNT,
+			&in.normal_force[0], &in.friction_coeff[0], &in.sin_camber[0],
+			&in.rot_velocity[0], &in.lon_velocity[0], &in.lat_velocity[0], s);
+		tires.ComputeAligningTorque(WHEEL_COUNT, &in.normal_force[0], &in.friction_coeff[0], s);
+		for (int i = 0; i < WHEEL_COUNT; ++i)
+		{
+			QT_CHECK(std::isfinite(s[i].fx) && std::isfinite(s[i].fy) && std::isfinite(s[i].mz));
+			QT_CHECK(std::abs(s[i].fx) < in.normal_force[i] * 2);
+			QT_CHECK(std::abs(s[i].fy) < in.normal_force[i] * 2);
+		}
+	}
+}
+
+MB_BENCHMARK(cartire_benchmark)
+{
+	const int count = 1024;
+	const TireInputs in(count, 1);
+	std::vector<CarTireState> s(count);
+	std::ostringstream error;
+	for (int n = 0; n < 2 * CarTireSet::MODEL_COUNT; ++n)
+	{
+		CarTireSet tires = CreateTireSet(CarTireSet::ModelEnum(n % CarTireSet::MODEL_COUNT));
+		const bool lut = n >= CarTireSet::MODEL_COUNT;
+		if (lut && !tires.initForceLUT(8000, error))
+			continue;
+
+		int offset = 0;
+		auto evaluate = [&]
+		{
+			tires.ComputeState(WHEEL_COUNT,
+				&in.normal_force[offset], &in.friction_coeff[offset], &in.sin_camber[offset],
+				&in.rot_velocity[offset], &in.lon_velocity[offset], &in.lat_velocity[offset], &s[offset]);
+			tires.ComputeAligningTorque(WHEEL_COUNT,
+				&in.normal_force[offset], &in.friction_coeff[offset], &s[offset]);
+			microbench::keep(s[offset].fx);
+			offset = (offset + WHEEL_COUNT) % count;
+		};
+		const double ns = microbench::measure(evaluate) / WHEEL_COUNT;
+		out << "tire evaluation " << CarTireSet::GetModelName(tires.GetModel());
+		if (lut)
+		{
+			out << " lut (error force " << tires.GetForceLUTError() * 100
+				<< "% torque " << tires.GetTorqueLUTError() * 100
+				<< "%, " << tires.GetForceLUTSize() / 1024 << " KB)";
+		}
+		out << ": " << ns << " ns" << std::endl;
+	}
+
+	CarTireSet reference = CreateTireSet(CarTireSet::PACEJKA89);
+	reference.SetReferenceMode(true);
+	int offset = 0;
+	auto evaluate_reference = [&]
+	{
+		reference.ComputeState(WHEEL_COUNT,
+			&in.normal_force[offset], &in.friction_coeff[offset], &in.sin_camber[offset],
+			&in.rot_velocity[offset], &in.lon_velocity[offset], &in.lat_velocity[offset], &s[offset]);
+		reference.ComputeAligningTorque(WHEEL_COUNT,
+			&in.normal_force[offset], &in.friction_coeff[offset], &s[offset]);
+		microbench::keep(s[offset].fx);
+		offset = (offset + WHEEL_COUNT) % count;
+	};
+	out << "tire evaluation pacejka89 reference: " << microbench::measure(evaluate_reference) / WHEEL_COUNT << " ns" << std::endl;
+
+	// all wheels of a 40 car grid in one batch
+	const int grid = 40 * WHEEL_COUNT;
+	std::vector<CarTire1> tires1(grid);
+	for (auto & t : tires1)
+		InitTire(t);
+	auto evaluate_grid = [&]
+	{
+		CarTire1::ComputeStates(&tires1[0], grid,
+			&in.normal_force[0], &in.friction_coeff[0], &in.sin_camber[0],
+			&in.rot_velocity[0], &in.lon_velocity[0], &in.lat_velocity[0], &s[0]);
+		CarTire1::ComputeAligningTorques(&tires1[0], grid, &in.normal_force[0], &in.friction_coeff[0], &s[0]);
+		microbench::keep(s[0].fx);
+	};
+	out << "tire evaluation pacejka89 batch of " << grid << ": " << microbench::measure(evaluate_grid) / grid << " ns" << std::endl;
+}
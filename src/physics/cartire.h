@@ -1,19 +1,193 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
 #ifndef _CARTIRE_H
 #define _CARTIRE_H
 
 #include "cartirebase.h"
+#include "physics/cartire1.h"
+#include "physics/cartire2.h"
+#include "physics/cartire3.h"
+#include "physics/cartirelut.h"
+#include "physics/carwheelposition.h"
 
-//#define VDRIFTP
-
-#if defined(VDRIFTP)
-	#include "physics/cartire3.h"
-	using CarTire = CarTire3;
-#elif defined(VDRIFTN)
-	#include "physics/cartire2.h"
-	using CarTire = CarTire2;
-#else
-	#include "physics/cartire1.h"
-	using CarTire = CarTire1;
-#endif
+#include <memory>
+#include <ostream>
+#include <string>
+
+/// Tires of a car, all using the tire model selected when the car is loaded.
+/// Only the tires of the selected model are stored.
+/// Per wheel queries dispatch on the model, the force kernels evaluate all
+/// wheels of the car with a single dispatch. Pacejka89 tires are evaluated
+/// by batched kernels. Pacejka models can optionally interpolate force lookup
+/// tables baked at load time.
+class CarTireSet
+{
+public:
+	enum ModelEnum
+	{
+		PACEJKA89 = 0,	///< CarTire1, default
+		PACEJKA2002,	///< CarTire2, tire files with "n" suffix
+		PHYSICAL,		///< CarTire3, tire files with "p" suffix
+		MODEL_COUNT
+	};
+
+	/// Look up model by its config name, returns false if unknown.
+	static bool GetModel(const std::string & name, ModelEnum & model);
+
+	/// Model config name.
+	static const char * GetModelName(ModelEnum model);
+
+	/// Suffix appended to the tire file name of the model.
+	static const char * GetFileSuffix(ModelEnum model);
+
+	CarTireSet();
+
+	/// Set tire model, discards tire parameters and force lookup tables.
+	void SetModel(ModelEnum value);
+
+	ModelEnum GetModel() const { return model; }
+
+	/// Evaluate tires one at a time with the per tire model code instead of the
+	/// batched kernels, to validate them. Results only differ if the compiler
+	/// contracts floating point operations.
+	void SetReferenceMode(bool value) { reference = value; }
+
+	bool GetReferenceMode() const { return reference; }
+
+	/// model specific tire parameters, used by the loader, only valid for the set model
+	CarTire1 & GetTire1(int i) { btAssert(tire1); return tire1[i]; }
+	CarTire2 & GetTire2(int i) { btAssert(tire2); return tire2[i]; }
+	CarTire3 & GetTire3(int i) { btAssert(tire3); return tire3[i]; }
+
+	/// get tire tread fraction
+	btScalar getTread(int i) const;
+
+	/// rolling resistance magnitude
+	btScalar getRollingResistance(int i, btScalar velocity, btScalar resistance_factor) const;
+
+	/// load is the normal force in N
+	btScalar getMaxFx(int i, btScalar load) const;
+
+	/// load is the normal force in N, camber is in rad
+	btScalar getMaxFy(int i, btScalar load, btScalar camber) const;
+
+	/// load is the normal force in N, camber is in rad
+	btScalar getMaxMz(int i, btScalar load, btScalar camber) const;
+
+	/// init peak force slip lut
+	void initSlipLUT(int i, CarTireSlipLUT & t) const;
+
+	/// Bake force lookup tables for loads up to max_load in N, larger loads scale
+	/// the forces linearly. The tables replace the analytic model if their error
+	/// measured against it is within bounds, otherwise returns false and reports
+	/// the reason to error_output.
+	bool initForceLUT(btScalar max_load, std::ostream & error_output);
+
+	/// true if force lookup tables are used
+	bool GetForceLUT() const { return bool(force_lut[0]); }
+
+	/// max force lookup table error, relative to tire load
+	btScalar GetForceLUTError() const { return force_lut_error; }
+
+	/// max aligning torque lookup table error, relative to peak torque
+	btScalar GetTorqueLUTError() const { return torque_lut_error; }
+
+	/// force lookup table memory in bytes, tables shared by wheels counted once
+	unsigned GetForceLUTSize() const;
+
+	/// Compute state of the first count tires, inputs are indexed by wheel.
+	/// See CarTire1::ComputeState for the parameters.
+	void ComputeState(
+		int count,
+		const btScalar normal_force[],
+		const btScalar friction_coeff[],
+		const btScalar sin_camber[],
+		const btScalar rot_velocity[],
+		const btScalar lon_velocity[],
+		const btScalar lat_velocity[],
+		CarTireState s[]) const;
+
+	/// Compute aligning torque of the first count tires from their state.
+	void ComputeAligningTorque(
+		int count,
+		const btScalar normal_force[],
+		const btScalar friction_coeff[],
+		CarTireState s[]) const;
+
+private:
+	ModelEnum model;
+	bool reference;
+	std::unique_ptr<CarTire1[]> tire1;
+	std::unique_ptr<CarTire2[]> tire2;
+	std::unique_ptr<CarTire3[]> tire3;
+	std::shared_ptr<const CarTireForceLUT> force_lut[WHEEL_COUNT];
+	btScalar force_lut_error;
+	btScalar torque_lut_error;
+
+	/// call func with the tire of wheel i
+	template <class Func>
+	auto Visit(int i, Func func) const -> decltype(func(tire1[i]));
+};
+
+template <class Func>
+inline auto CarTireSet::Visit(int i, Func func) const -> decltype(func(tire1[i]))
+{
+	switch (model)
+	{
+	case PACEJKA2002:
+		return func(tire2[i]);
+	case PHYSICAL:
+		return func(tire3[i]);
+	default:
+		return func(tire1[i]);
+	}
+}
+
+inline btScalar CarTireSet::getTread(int i) const
+{
+	return Visit(i, [](const auto & tire) { return tire.getTread(); });
+}
+
+inline btScalar CarTireSet::getRollingResistance(int i, btScalar velocity, btScalar resistance_factor) const
+{
+	return Visit(i, [=](const auto & tire) { return tire.getRollingResistance(velocity, resistance_factor); });
+}
+
+inline btScalar CarTireSet::getMaxFx(int i, btScalar load) const
+{
+	return Visit(i, [=](const auto & tire) { return tire.getMaxFx(load); });
+}
+
+inline btScalar CarTireSet::getMaxFy(int i, btScalar load, btScalar camber) const
+{
+	return Visit(i, [=](const auto & tire) { return tire.getMaxFy(load, camber); });
+}
+
+inline btScalar CarTireSet::getMaxMz(int i, btScalar load, btScalar camber) const
+{
+	return Visit(i, [=](const auto & tire) { return tire.getMaxMz(load, camber); });
+}
+
+inline void CarTireSet::initSlipLUT(int i, CarTireSlipLUT & t) const
+{
+	Visit(i, [&t](const auto & tire) { tire.initSlipLUT(t); });
+}
 
 #endif
@@ -19,6 +19,7 @@
 
 #include "cartire1.h"
 #include "cartirebase.h"
+#include "cartirelut.h"
 #include "fastmath.h"
 #include <cassert>
 
@@ -110,6 +111,233 @@ void CarTire1::ComputeAligningTorque(
 	s.mz = Mz;
 }
 
+void CarTire1::ComputeState(
+		const CarTireForceLUT & t,
+		btScalar normal_force,
+		btScalar friction_coeff,
+		btScalar sin_camber,
+		btScalar rot_velocity,
+		btScalar lon_velocity,
+		btScalar lat_velocity,
+		CarTireState & s) const
+{
+	if (normal_force * friction_coeff < btScalar(1E-6))
+	{
+		s.slip = s.slip_angle = 0;
+		s.fx = s.fy = s.mz = 0;
+		return;
+	}
+
+	btScalar camber = ComputeCamberAngle(sin_camber);
+
+	btScalar slip, slip_angle;
+	ComputeSlip(lon_velocity, lat_velocity, rot_velocity, slip, slip_angle);
+
+	// pure slip, tables are normalized by load
+	btScalar scale = normal_force * friction_coeff;
+	btScalar Fx0 = t.fx.Interpolate(slip, normal_force) * scale;
+	btScalar Fy0 = t.fy.Interpolate(slip_angle, normal_force, camber) * scale;
+
+	// combined slip
+	btScalar Gx = PacejkaGx(slip, slip_angle);
+	btScalar Gy = PacejkaGy(slip, slip_angle);
+
+	s.camber = camber;
+	s.slip = slip;
+	s.slip_angle = slip_angle;
+	s.fx = Gx * Fx0;
+	s.fy = Gy * Fy0;
+}
+
+void CarTire1::ComputeAligningTorque(
+		const CarTireForceLUT & t,
+		btScalar normal_force,
+		btScalar friction_coeff,
+		CarTireState & s) const
+{
+	if (normal_force * friction_coeff < btScalar(1E-6))
+	{
+		s.mz = 0;
+		return;
+	}
+	btScalar scale = normal_force * friction_coeff;
+	s.mz = t.mz.Interpolate(s.slip_angle, normal_force, s.camber) * scale;
+}
+
+// tires per block of the batched kernels, two avx vectors
+static const int block_size = 16;
+
+// magic formula D * sin(C * atan(B * S - E * (B * S - atan(B * S)))) over a block,
+// same expression as the Pacejka functions, free of calls and branches to be vectorized
+static void PacejkaBlock(
+	int count,
+	const btScalar B[],
+	const btScalar C[],
+	const btScalar D[],
+	const btScalar E[],
+	const btScalar S[],
+	btScalar F[])
+{
+	for (int i = 0; i < count; ++i)
+	{
+		F[i] = D[i] * Sin3Pi2(C[i] * Atan(B[i] * S[i] - E[i] * (B[i] * S[i] - Atan(B[i] * S[i]))));
+	}
+}
+
+static void ComputeStateBlock(
+	const CarTire1 tire[],
+	int count,
+	const btScalar normal_force[],
+	const btScalar friction_coeff[],
+	const btScalar sin_camber[],
+	const btScalar rot_velocity[],
+	const btScalar lon_velocity[],
+	const btScalar lat_velocity[],
+	CarTireState s[])
+{
+	btScalar camber[block_size], slip[block_size], slip_angle[block_size];
+	btScalar Bx[block_size], Cx[block_size], Dx[block_size], Ex[block_size], Shx[block_size], Sx[block_size], Fx[block_size];
+	btScalar By[block_size], Cy[block_size], Dy[block_size], Ey[block_size], Shy[block_size], Sy[block_size], Fy[block_size];
+	btScalar Svy[block_size], p0[block_size], p1[block_size], p2[block_size], p3[block_size];
+
+	// load and camber dependent factors, gathered from the tire parameters
+	for (int i = 0; i < count; ++i)
+	{
+		auto & a = tire[i].lateral;
+		auto & b = tire[i].longitudinal;
+		auto & p = tire[i].combining;
+		btScalar Fz = Min(normal_force[i] * btScalar(1E-3), btScalar(30));
+		camber[i] = ComputeCamberAngle(sin_camber[i]);
+		btScalar gamma = camber[i] * rad2deg;
+
+		Cx[i] = b[0];
+		Dx[i] = (b[1] * Fz + b[2]) * Fz;
+		Bx[i] = (b[3] * Fz + b[4]) * Fz * std::exp(-b[5] * Fz) / (Cx[i] * Dx[i]);
+		Ex[i] = (b[6] * Fz + b[7]) * Fz + b[8];
+		Shx[i] = b[9] * Fz + b[10];
+
+		Cy[i] = a[0];
+		Dy[i] = (a[1] * Fz + a[2]) * Fz;
+		By[i] = a[3] * Sin2Atan(Fz, a[4]) * (1 - a[5] * std::abs(gamma)) / (Cy[i] * Dy[i]);
+		Ey[i] = a[6] * Fz + a[7];
+		Shy[i] = a[8] * gamma + a[9] * Fz + a[10];
+		Svy[i] = ((a[11] * Fz + a[12]) * gamma + a[13]) * Fz + a[14];
+
+		p0[i] = p[0];
+		p1[i] = p[1];
+		p2[i] = p[2];
+		p3[i] = p[3];
+	}
+
+	// slip, composite slip
+	for (int i = 0; i < count; ++i)
+	{
+		ComputeSlip(lon_velocity[i], lat_velocity[i], rot_velocity[i], slip[i], slip_angle[i]);
+		Sx[i] = 100 * slip[i] + Shx[i];
+		Sy[i] = slip_angle[i] * rad2deg + Shy[i];
+	}
+
+	// pure slip
+	PacejkaBlock(count, Bx, Cx, Dx, Ex, Sx, Fx);
+	PacejkaBlock(count, By, Cy, Dy, Ey, Sy, Fy);
+
+	// combined slip, see PacejkaGx and PacejkaGy
+	for (int i = 0; i < count; ++i)
+	{
+		btScalar ax = p3[i] * slip[i];
+		btScalar bx = p2[i] * slip_angle[i];
+		btScalar cx = ax * ax + 1;
+		btScalar ay = p1[i] * slip_angle[i];
+		btScalar by = p0[i] * slip[i];
+		btScalar cy = ay * ay + 1;
+		Fx[i] = std::sqrt(cx / (cx + bx * bx)) * (Fx[i] * friction_coeff[i]);
+		Fy[i] = std::sqrt(cy / (cy + by * by)) * ((Fy[i] + Svy[i]) * friction_coeff[i]);
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		if (normal_force[i] * friction_coeff[i] < btScalar(1E-6))
+		{
+			s[i].slip = s[i].slip_angle = 0;
+			s[i].fx = s[i].fy = s[i].mz = 0;
+			continue;
+		}
+		s[i].camber = camber[i];
+		s[i].slip = slip[i];
+		s[i].slip_angle = slip_angle[i];
+		s[i].fx = Fx[i];
+		s[i].fy = Fy[i];
+	}
+}
+
+static void ComputeAligningTorqueBlock(
+	const CarTire1 tire[],
+	int count,
+	const btScalar normal_force[],
+	const btScalar friction_coeff[],
+	CarTireState s[])
+{
+	btScalar B[block_size], C[block_size], D[block_size], E[block_size], S[block_size], Sv[block_size], Mz[block_size];
+
+	// load and camber dependent factors, see PacejkaMz
+	for (int i = 0; i < count; ++i)
+	{
+		auto & c = tire[i].aligning;
+		btScalar Fz = Min(normal_force[i] * btScalar(1E-3), btScalar(30));
+		btScalar alpha = s[i].slip_angle * rad2deg;
+		btScalar gamma = s[i].camber * rad2deg;
+		C[i] = c[0];
+		D[i] = (c[1] * Fz + c[2]) * Fz;
+		B[i] = (c[3] * Fz + c[4]) * Fz * (1 - c[6] * std::abs(gamma)) * std::exp(-c[5] * Fz) / (C[i] * D[i]);
+		E[i] = (c[7] * Fz * Fz + c[8] * Fz + c[9]) * (1 - c[10] * std::abs(gamma));
+		S[i] = alpha + (c[11] * gamma + c[12] * Fz + c[13]);
+		Sv[i] = (c[14] * Fz * Fz + c[15] * Fz) * gamma + c[16] * Fz + c[17];
+	}
+
+	PacejkaBlock(count, B, C, D, E, S, Mz);
+
+	for (int i = 0; i < count; ++i)
+	{
+		if (normal_force[i] * friction_coeff[i] < btScalar(1E-6))
+			s[i].mz = 0;
+		else
+			s[i].mz = (Mz[i] + Sv[i]) * friction_coeff[i];
+	}
+}
+
+void CarTire1::ComputeStates(
+		const CarTire1 tire[],
+		int count,
+		const btScalar normal_force[],
+		const btScalar friction_coeff[],
+		const btScalar sin_camber[],
+		const btScalar rot_velocity[],
+		const btScalar lon_velocity[],
+		const btScalar lat_velocity[],
+		CarTireState s[])
+{
+	for (int i = 0; i < count; i += block_size)
+	{
+		ComputeStateBlock(tire + i, Min(count - i, block_size),
+			normal_force + i, friction_coeff + i, sin_camber + i,
+			rot_velocity + i, lon_velocity + i, lat_velocity + i, s + i);
+	}
+}
+
+void CarTire1::ComputeAligningTorques(
+		const CarTire1 tire[],
+		int count,
+		const btScalar normal_force[],
+		const btScalar friction_coeff[],
+		CarTireState s[])
+{
+	for (int i = 0; i < count; i += block_size)
+	{
+		ComputeAligningTorqueBlock(tire + i, Min(count - i, block_size),
+			normal_force + i, friction_coeff + i, s + i);
+	}
+}
+
 btScalar CarTire1::getRollingResistance(btScalar velocity, btScalar resistance_factor) const
 {
 	// surface influence on rolling resistance
@@ -142,7 +370,7 @@ btScalar CarTire1::getMaxFy(btScalar load, btScalar camber) const
 {
 	auto & a = lateral;
 	btScalar Fz = load * btScalar(1E-3);
-	btScalar gamma = camber;
+	btScalar gamma = camber * rad2deg;
 	btScalar D = (a[1] * Fz + a[2]) * Fz;
 	btScalar Sv = ((a[11] * Fz + a[12]) * gamma + a[13] ) * Fz + a[14];
 	return D + Sv;
@@ -170,7 +398,7 @@ btScalar CarTire1::getMaxMz(btScalar load, btScalar camber) const
 {
 	auto & c = aligning;
 	btScalar Fz = load * btScalar(1E-3);
-	btScalar gamma = camber;
+	btScalar gamma = camber * rad2deg;
 	btScalar D = (c[1] * Fz + c[2]) * Fz;
 	btScalar Sv = (c[14] * Fz * Fz + c[15] * Fz) * gamma + c[16] * Fz + c[17];
 	return -(D + Sv);
@@ -367,3 +595,31 @@ void CarTire1::initSlipLUT(CarTireSlipLUT & t) const
 		findIdealSlip(load, t.ideal_slip_lut[i]);
 	}
 }
+
+void CarTire1::initForceLUT(btScalar max_load, CarTireForceLUT & t) const
+{
+	const CarTireTableAxis load_axis = CarTireForceLUT::GetLoadAxis(max_load);
+	const CarTireTableAxis no_axis;
+	btScalar junk;
+
+	t.fx.Bake(1, CarTireForceLUT::GetSlipAxis(), load_axis, no_axis,
+		[this, &junk](btScalar slip, btScalar load, btScalar, btScalar out[])
+		{
+			btScalar Fz = Min(load * btScalar(1E-3), btScalar(30));
+			out[0] = PacejkaFx(slip, Fz, 1, junk) / load;
+		});
+
+	t.fy.Bake(1, CarTireForceLUT::GetSlipAngleAxis(), load_axis, CarTireForceLUT::GetCamberAxis(),
+		[this, &junk](btScalar slip_angle, btScalar load, btScalar camber, btScalar out[])
+		{
+			btScalar Fz = Min(load * btScalar(1E-3), btScalar(30));
+			out[0] = PacejkaFy(slip_angle * rad2deg, Fz, camber * rad2deg, 1, junk) / load;
+		});
+
+	t.mz.Bake(1, CarTireForceLUT::GetSlipAngleAxis(), load_axis, CarTireForceLUT::GetCamberAxis(),
+		[this, &junk](btScalar slip_angle, btScalar load, btScalar camber, btScalar out[])
+		{
+			btScalar Fz = Min(load * btScalar(1E-3), btScalar(30));
+			out[0] = PacejkaMz(slip_angle * rad2deg, Fz, camber * rad2deg, 1, junk) / load;
+		});
+}
@@ -24,6 +24,7 @@
 
 struct CarTireState;
 struct CarTireSlipLUT;
+struct CarTireForceLUT;
 
 class CarTire1
 {
@@ -49,6 +50,28 @@ public:
 		btScalar friction_coeff,
 		CarTireState & s) const;
 
+	/// ComputeState of count tires at once, tire[i] with the inputs at i. Tires are
+	/// evaluated in blocks of arrays the compiler can vectorize. Results are identical
+	/// to ComputeState unless the compiler contracts floating point operations.
+	static void ComputeStates(
+		const CarTire1 tire[],
+		int count,
+		const btScalar normal_force[],
+		const btScalar friction_coeff[],
+		const btScalar sin_camber[],
+		const btScalar rot_velocity[],
+		const btScalar lon_velocity[],
+		const btScalar lat_velocity[],
+		CarTireState s[]);
+
+	/// ComputeAligningTorque of count tires at once, see ComputeStates
+	static void ComputeAligningTorques(
+		const CarTire1 tire[],
+		int count,
+		const btScalar normal_force[],
+		const btScalar friction_coeff[],
+		CarTireState s[]);
+
 	/// get tire tread fraction
 	btScalar getTread() const { return tread; }
 
@@ -61,21 +84,42 @@ public:
 	/// longitudinal force derivative at zero slip
 	btScalar getMaxDx(btScalar load) const;
 
-	/// load is the normal force in newtons, camber is in degrees
+	/// load is the normal force in newtons, camber is in rad
 	btScalar getMaxFy(btScalar load, btScalar camber) const;
 
-	/// lateral force derivative at zero slip angle
+	/// lateral force derivative at zero slip angle, camber is in degrees
 	btScalar getMaxDy(btScalar load, btScalar camber) const;
 
-	/// horizontal and vertical fy function shift due to camber
+	/// horizontal and vertical fy function shift due to camber in degrees
 	void getCamberShift(btScalar load, btScalar camber, btScalar & sh, btScalar & sv) const;
 
-	/// load is the normal force in newtons, camber is in degrees
+	/// load is the normal force in newtons, camber is in rad
 	btScalar getMaxMz(btScalar load, btScalar camber) const;
 
 	/// init peak force slip lut
 	void initSlipLUT(CarTireSlipLUT & t) const;
 
+	/// bake force lookup tables for loads up to max_load in N
+	void initForceLUT(btScalar max_load, CarTireForceLUT & t) const;
+
+	/// ComputeState interpolating the force lookup tables
+	void ComputeState(
+		const CarTireForceLUT & t,
+		btScalar normal_force,
+		btScalar friction_coeff,
+		btScalar sin_camber,
+		btScalar rot_velocity,
+		btScalar lon_velocity,
+		btScalar lat_velocity,
+		CarTireState & s) const;
+
+	/// ComputeAligningTorque interpolating the force lookup tables
+	void ComputeAligningTorque(
+		const CarTireForceLUT & t,
+		btScalar normal_force,
+		btScalar friction_coeff,
+		CarTireState & s) const;
+
 	CarTire1();
 
 private:
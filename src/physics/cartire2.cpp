@@ -19,6 +19,7 @@
 
 #include "cartire2.h"
 #include "cartirebase.h"
+#include "cartirelut.h"
 #include "minmax.h"
 
 template <typename T>
@@ -90,6 +91,57 @@ void CarTire2::ComputeState(
 	s.mz = Mz0;
 }
 
+void CarTire2::ComputeState(
+	const CarTireForceLUT & t,
+	btScalar normal_load,
+	btScalar friction_coeff,
+	btScalar sin_camber,
+	btScalar rot_velocity,
+	btScalar lon_velocity,
+	btScalar lat_velocity,
+	CarTireState & s) const
+{
+	if (normal_load * friction_coeff  < btScalar(1E-6))
+	{
+		s.slip = s.slip_angle = 0;
+		s.fx = s.fy = s.mz = 0;
+		return;
+	}
+
+	btScalar camber = ComputeCamberAngle(sin_camber);
+
+	btScalar sigma, alpha;
+	ComputeSlip(lon_velocity, lat_velocity, rot_velocity, sigma, alpha);
+	alpha = -alpha; // fixup
+
+	// force parameters
+	const btScalar * p = coefficients;
+	btScalar Fz = Clamp(normal_load, btScalar(0), btScalar(max_load));
+	btScalar Fz0 = nominal_load;
+	btScalar dFz = (Fz - Fz0) / Fz0;
+
+	// pure slip, tables are normalized by load
+	btScalar scale = Fz * friction_coeff;
+	btScalar Fx0 = t.fx.Interpolate(sigma, Fz) * scale;
+	btScalar Fy0 = t.fy.Interpolate(alpha, Fz, camber) * scale;
+	btScalar Mz0 = t.mz.Interpolate(alpha, Fz, camber) * scale;
+
+	// combined slip factors Gx, Gy and the load independent part of Svy
+	btScalar g[3];
+	t.combined.Interpolate(sigma, alpha, 0, g);
+	btScalar Dy = PacejkaDy(Fz, dFz, camber);
+	btScalar Svy = Dy * (p[RVY1] + p[RVY2] * dFz + p[RVY3] * camber) * g[2];
+	btScalar Fx = g[0] * Fx0;
+	btScalar Fy = g[1] * Fy0 + Svy;
+
+	s.camber = camber;
+	s.slip = sigma;
+	s.slip_angle = alpha;
+	s.fx = Fx;
+	s.fy = Fy;
+	s.mz = Mz0;
+}
+
 btScalar CarTire2::getRollingResistance(btScalar velocity, btScalar resistance_factor) const
 {
 	// surface influence on rolling resistance
@@ -207,7 +259,7 @@ btScalar CarTire2::PacejkaFy(
 	btScalar E = (p[PEY1] + p[PEY2] * dFz) * (1 - (p[PEY3] + p[PEY4] * gamma) * sgn(A));
 
 	// peak factor
-	btScalar D = Fz * (p[PDY1] + p[PDY2] * dFz) * (1 - p[PDY3] * gamma * gamma);
+	btScalar D = PacejkaDy(Fz, dFz, gamma);
 
 	// shape factor
 	btScalar C = p[PCY1];
@@ -298,6 +350,15 @@ btScalar CarTire2::PacejkaGy(
 	return G;
 }
 
+btScalar CarTire2::PacejkaDy(
+	btScalar Fz,
+	btScalar dFz,
+	btScalar gamma) const
+{
+	const btScalar * p = coefficients;
+	return Fz * (p[PDY1] + p[PDY2] * dFz) * (1 - p[PDY3] * gamma * gamma);
+}
+
 btScalar CarTire2::PacejkaSvy(
 	btScalar sigma,
 	btScalar alpha,
@@ -373,3 +434,44 @@ void CarTire2::initSlipLUT(CarTireSlipLUT & t) const
 		findIdealSlip(load, t.ideal_slip_lut[i]);
 	}
 }
+
+void CarTire2::initForceLUT(btScalar max_load, CarTireForceLUT & t) const
+{
+	const btScalar * p = coefficients;
+	const btScalar Fz0 = nominal_load;
+	const CarTireTableAxis load_axis = CarTireForceLUT::GetLoadAxis(Min(max_load, btScalar(this->max_load)));
+	const CarTireTableAxis no_axis;
+
+	t.fx.Bake(1, CarTireForceLUT::GetSlipAxis(), load_axis, no_axis,
+		[this, Fz0](btScalar sigma, btScalar Fz, btScalar, btScalar out[])
+		{
+			btScalar dFz = (Fz - Fz0) / Fz0;
+			out[0] = PacejkaFx(sigma, Fz, dFz, 1) / Fz;
+		});
+
+	t.fy.Bake(1, CarTireForceLUT::GetSlipAngleAxis(), load_axis, CarTireForceLUT::GetCamberAxis(),
+		[this, Fz0](btScalar alpha, btScalar Fz, btScalar gamma, btScalar out[])
+		{
+			btScalar dFz = (Fz - Fz0) / Fz0;
+			btScalar Dy, BCy, Shf;
+			out[0] = PacejkaFy(alpha, gamma, Fz, dFz, 1, Dy, BCy, Shf) / Fz;
+		});
+
+	// aligning torque scales linearly with friction like Fy
+	t.mz.Bake(1, CarTireForceLUT::GetSlipAngleAxis(), load_axis, CarTireForceLUT::GetCamberAxis(),
+		[this, Fz0](btScalar alpha, btScalar Fz, btScalar gamma, btScalar out[])
+		{
+			btScalar dFz = (Fz - Fz0) / Fz0;
+			btScalar Dy, BCy, Shf;
+			btScalar Fy = PacejkaFy(alpha, gamma, Fz, dFz, 1, Dy, BCy, Shf);
+			out[0] = PacejkaMz(alpha, gamma, Fz, dFz, 1, Fy, BCy, Shf) / Fz;
+		});
+
+	t.combined.Bake(3, CarTireForceLUT::GetCombinedSlipAxis(), CarTireForceLUT::GetCombinedSlipAngleAxis(), no_axis,
+		[this, p](btScalar sigma, btScalar alpha, btScalar, btScalar out[])
+		{
+			out[0] = PacejkaGx(sigma, alpha);
+			out[1] = PacejkaGy(sigma, alpha);
+			out[2] = btCos(btAtan(p[RVY4] * alpha)) * btSin(p[RVY5] * btAtan(p[RVY6] * sigma));
+		});
+}
@@ -24,6 +24,7 @@
 
 struct CarTireState;
 struct CarTireSlipLUT;
+struct CarTireForceLUT;
 
 class CarTire2
 {
@@ -46,7 +47,7 @@ public:
 	void ComputeAligningTorque(
 		btScalar normal_load,
 		btScalar friction_coeff,
-		CarTireState & s)
+		CarTireState & s) const
 	{
 		// Already computed in ComputeState
 	}
@@ -69,6 +70,29 @@ public:
 	/// init peak force slip lut
 	void initSlipLUT(CarTireSlipLUT & t) const;
 
+	/// bake force lookup tables for loads up to max_load in N
+	void initForceLUT(btScalar max_load, CarTireForceLUT & t) const;
+
+	/// ComputeState interpolating the force lookup tables
+	void ComputeState(
+		const CarTireForceLUT & t,
+		btScalar normal_load,
+		btScalar friction_coeff,
+		btScalar sin_camber,
+		btScalar rot_velocity,
+		btScalar lon_velocity,
+		btScalar lat_velocity,
+		CarTireState & s) const;
+
+	void ComputeAligningTorque(
+		const CarTireForceLUT & t,
+		btScalar normal_load,
+		btScalar friction_coeff,
+		CarTireState & s) const
+	{
+		// Already computed in ComputeState
+	}
+
 	CarTire2();
 
 private:
@@ -111,6 +135,12 @@ private:
 		btScalar sigma,
 		btScalar alpha) const;
 
+	/// lateral peak factor
+	btScalar PacejkaDy(
+		btScalar Fz,
+		btScalar dFz,
+		btScalar gamma) const;
+
 	/// combined slip lateral offset
 	btScalar PacejkaSvy(
 		btScalar sigma,
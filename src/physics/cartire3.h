@@ -46,7 +46,7 @@ public:
 	void ComputeAligningTorque(
 		btScalar normal_load,
 		btScalar friction_coeff,
-		CarTireState & s)
+		CarTireState & s) const
 	{
 		// Already computed in ComputeState
 	}
@@ -59,10 +59,10 @@ public:
 	/// load is the normal force in newtons.
 	btScalar getMaxFx(btScalar load) const;
 
-	/// load is the normal force in newtons, camber is in degrees
+	/// load is the normal force in newtons, camber is in rad
 	btScalar getMaxFy(btScalar load, btScalar camber) const;
 
-	/// load is the normal force in newtons, camber is in degrees
+	/// load is the normal force in newtons, camber is in rad
 	btScalar getMaxMz(btScalar load, btScalar camber) const;
 
 	/// init peak force slip lut
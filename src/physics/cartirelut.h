@@ -0,0 +1,212 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _CARTIRELUT_H
+#define _CARTIRELUT_H
+
+#include "LinearMath/btScalar.h"
+
+#include <cmath>
+#include <vector>
+
+/// Lookup table axis. With k > 0 samples are spaced uniformly in u = x / (|x| + k),
+/// which puts most samples near zero and covers large slip values with few samples.
+/// With k = 0 samples are spaced uniformly in x. Values outside the range are clamped.
+class CarTireTableAxis
+{
+public:
+	CarTireTableAxis() {}
+
+	CarTireTableAxis(btScalar xmin, btScalar xmax, int count, btScalar k = 0) :
+		umin(ToU(xmin, k)),
+		rdelta((count - 1) / (ToU(xmax, k) - ToU(xmin, k))),
+		k(k),
+		count(count)
+	{
+		// ctor
+	}
+
+	int GetCount() const { return count; }
+
+	/// axis value of sample i
+	btScalar GetValue(int i) const
+	{
+		btScalar u = umin + i / rdelta;
+		return (k > 0) ? k * u / (1 - std::abs(u)) : u;
+	}
+
+	/// sample index i and blend factor t of the cell containing x
+	void GetCell(btScalar x, int & i, btScalar & t) const
+	{
+		btScalar f = (ToU(x, k) - umin) * rdelta;
+		f = (f > 0) ? f : 0;
+		f = (f < count - 1) ? f : count - 1;
+		i = int(f);
+		i = (i < count - 2) ? i : ((count > 1) ? count - 2 : 0);
+		t = f - i;
+	}
+
+private:
+	btScalar umin = 0;
+	btScalar rdelta = 0;
+	btScalar k = 0;
+	int count = 1;
+
+	static btScalar ToU(btScalar x, btScalar k)
+	{
+		return (k > 0) ? x / (std::abs(x) + k) : x;
+	}
+};
+
+/// Function with up to max_channels components sampled over a grid of up to
+/// three axes, evaluated by multilinear interpolation. Samples are stored as
+/// floats, channels interleaved.
+class CarTireTable
+{
+public:
+	static const int max_channels = 4;
+
+	/// Sample func(x0, x1, x2, btScalar out[channels]) at the grid points.
+	template <class Func>
+	void Bake(
+		int channels,
+		const CarTireTableAxis & a0,
+		const CarTireTableAxis & a1,
+		const CarTireTableAxis & a2,
+		Func func);
+
+	/// Write the interpolated channels at (x0, x1, x2) to out.
+	void Interpolate(btScalar x0, btScalar x1, btScalar x2, btScalar out[]) const;
+
+	/// First channel at (x0, x1, x2).
+	btScalar Interpolate(btScalar x0, btScalar x1 = 0, btScalar x2 = 0) const
+	{
+		btScalar out[max_channels];
+		Interpolate(x0, x1, x2, out);
+		return out[0];
+	}
+
+	bool Empty() const { return values.empty(); }
+
+	/// memory used by the samples in bytes
+	unsigned GetSize() const { return values.size() * sizeof(float); }
+
+	bool operator==(const CarTireTable & other) const
+	{
+		return channels == other.channels && values == other.values;
+	}
+
+private:
+	CarTireTableAxis axis[3];
+	int stride[3] = {0, 0, 0};
+	int channels = 0;
+	std::vector<float> values;
+};
+
+/// Force lookup tables of a tire baked from its analytic model at unit
+/// surface friction. Forces and torques are stored divided by the load,
+/// loads beyond the table range scale them linearly.
+struct CarTireForceLUT
+{
+	CarTireTable fx; ///< pure slip longitudinal force over slip ratio and load
+	CarTireTable fy; ///< pure slip lateral force over slip angle, load and camber
+	CarTireTable mz; ///< aligning torque over slip angle, load and camber
+	CarTireTable combined; ///< model specific combined slip factors over slip ratio and slip angle
+
+	static CarTireTableAxis GetSlipAxis() { return CarTireTableAxis(-20, 20, 64, btScalar(0.1)); }
+
+	static CarTireTableAxis GetSlipAngleAxis() { return CarTireTableAxis(-SIMD_HALF_PI, SIMD_HALF_PI, 64, btScalar(0.2)); }
+
+	static CarTireTableAxis GetCombinedSlipAxis() { return CarTireTableAxis(-20, 20, 32, btScalar(0.1)); }
+
+	static CarTireTableAxis GetCombinedSlipAngleAxis() { return CarTireTableAxis(-SIMD_HALF_PI, SIMD_HALF_PI, 32, btScalar(0.2)); }
+
+	static CarTireTableAxis GetLoadAxis(btScalar max_load) { return CarTireTableAxis(max_load * btScalar(0.1), max_load, 12); }
+
+	/// covers the camber angle range of ComputeCamberAngle
+	static CarTireTableAxis GetCamberAxis() { return CarTireTableAxis(btScalar(-0.31), btScalar(0.31), 7); }
+
+	unsigned GetSize() const { return fx.GetSize() + fy.GetSize() + mz.GetSize() + combined.GetSize(); }
+
+	bool operator==(const CarTireForceLUT & other) const
+	{
+		return fx == other.fx && fy == other.fy && mz == other.mz && combined == other.combined;
+	}
+};
+
+template <class Func>
+inline void CarTireTable::Bake(
+	int num_channels,
+	const CarTireTableAxis & a0,
+	const CarTireTableAxis & a1,
+	const CarTireTableAxis & a2,
+	Func func)
+{
+	btAssert(num_channels <= max_channels);
+	channels = num_channels;
+	axis[0] = a0;
+	axis[1] = a1;
+	axis[2] = a2;
+
+	// single sample axes get a zero stride, the interpolation reads the same sample twice
+	const int n0 = a0.GetCount(), n1 = a1.GetCount(), n2 = a2.GetCount();
+	stride[0] = (n0 > 1) ? channels : 0;
+	stride[1] = (n1 > 1) ? channels * n0 : 0;
+	stride[2] = (n2 > 1) ? channels * n0 * n1 : 0;
+
+	values.resize(channels * n0 * n1 * n2);
+	btScalar sample[max_channels];
+	float * v = &values[0];
+	for (int i2 = 0; i2 < n2; ++i2)
+	{
+		for (int i1 = 0; i1 < n1; ++i1)
+		{
+			for (int i0 = 0; i0 < n0; ++i0)
+			{
+				func(a0.GetValue(i0), a1.GetValue(i1), a2.GetValue(i2), sample);
+				for (int c = 0; c < channels; ++c)
+					*v++ = sample[c];
+			}
+		}
+	}
+}
+
+inline void CarTireTable::Interpolate(btScalar x0, btScalar x1, btScalar x2, btScalar out[]) const
+{
+	int i0, i1, i2;
+	btScalar t0, t1, t2;
+	axis[0].GetCell(x0, i0, t0);
+	axis[1].GetCell(x1, i1, t1);
+	axis[2].GetCell(x2, i2, t2);
+
+	const int s0 = stride[0], s1 = stride[1], s2 = stride[2];
+	const float * v = &values[i0 * s0 + i1 * s1 + i2 * s2];
+	for (int c = 0; c < channels; ++c, ++v)
+	{
+		btScalar a = v[0] + (v[s0] - v[0]) * t0;
+		btScalar b = v[s1] + (v[s1 + s0] - v[s1]) * t0;
+		btScalar c0 = a + (b - a) * t1;
+		a = v[s2] + (v[s2 + s0] - v[s2]) * t0;
+		b = v[s2 + s1] + (v[s2 + s1 + s0] - v[s2 + s1]) * t0;
+		btScalar c1 = a + (b - a) * t1;
+		out[c] = c0 + (c1 - c0) * t2;
+	}
+}
+
+#endif // _CARTIRELUT_H
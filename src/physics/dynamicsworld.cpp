@@ -18,12 +18,27 @@
 /************************************************************************/
 
 #include "dynamicsworld.h"
+#include "parallelaction.h"
+#include "jobsystem.h"
 #include "fracturebody.h"
 #include "collision_contact.h"
 #include "tobullet.h"
 #include "track.h"
+#include "unittest.h"
 
 #include "BulletCollision/CollisionShapes/btCollisionShape.h"
+#include "BulletCollision/CollisionShapes/btBoxShape.h"
+#include "BulletCollision/BroadphaseCollision/btDbvtBroadphase.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcher.h"
+#include "BulletCollision/CollisionDispatch/btDefaultCollisionConfiguration.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolver.h"
+#include "BulletDynamics/Dynamics/btRigidBody.h"
+#include "LinearMath/btAabbUtil2.h"
+#include "LinearMath/btQuickprof.h"
+
+#include <cstring>
+#include <memory>
+#include <vector>
 
 #define EXTBULLET
 
@@ -43,6 +58,15 @@ struct MyRayResultCallback : public btCollisionWorld::RayResultCallback
 		// ctor
 	}
 
+	MyRayResultCallback() :
+		m_shapePart(-1),
+		m_triangleId(-1),
+		m_shape(0),
+		m_exclude(0)
+	{
+		// ctor
+	}
+
 	btVector3 m_rayFromWorld;//used to calculate hitPointWorld from hitFraction
 	btVector3 m_rayToWorld;
 	btVector3 m_hitNormalWorld;
@@ -89,12 +113,14 @@ struct MyRayResultCallback : public btCollisionWorld::RayResultCallback
 
 DynamicsWorld::DynamicsWorld(
 	btDispatcher* dispatcher,
-	btBroadphaseInterface* broadphase,
+	btDbvtBroadphase* broadphase,
 	btConstraintSolver* constraintSolver,
 	btCollisionConfiguration* collisionConfig,
 	btScalar timeStep,
 	int maxSubSteps) :
 	btDiscreteDynamicsWorld(dispatcher, broadphase, constraintSolver, collisionConfig),
+	m_jobs(0),
+	m_dbvtBroadphase(broadphase),
 	track(0),
 	timeStep(timeStep),
 	maxSubSteps(maxSubSteps)
@@ -113,13 +139,16 @@ const RoadPatch * DynamicsWorld::GetSectorPatch(int i)
 	return track->GetSectorPatch(i);
 }
 
-bool DynamicsWorld::castRay(
-	const btVector3 & origin,
-	const btVector3 & direction,
-	const btScalar length,
-	const btCollisionObject * caster,
-	CollisionContact & contact) const
+// fill in contact from broadphase ray test result
+static bool SetContact(
+	const DynamicsWorld::RayQuery & query,
+	const MyRayResultCallback & ray,
+	const Track * track,
+	CollisionContact & contact)
 {
+	const btVector3 & origin = query.position;
+	const btVector3 & direction = query.direction;
+	const btScalar length = query.length;
 	btVector3 p = origin + direction * length;
 	btVector3 n = -direction;
 	btScalar d = length;
@@ -128,9 +157,6 @@ bool DynamicsWorld::castRay(
 	const TrackSurface * s = TrackSurface::None();
 	const btCollisionObject * c = 0;
 
-	MyRayResultCallback ray(origin, p, caster);
-	rayTest(origin, p, ray);
-
 	// track geometry collision
 	if (ray.hasHit())
 	{
@@ -183,6 +209,204 @@ bool DynamicsWorld::castRay(
 	return false;
 }
 
+bool DynamicsWorld::castRay(
+	const btVector3 & origin,
+	const btVector3 & direction,
+	const btScalar length,
+	const btCollisionObject * caster,
+	CollisionContact & contact) const
+{
+	RayQuery query;
+	query.position = origin;
+	query.direction = direction;
+	query.length = length;
+	query.caster = caster;
+
+	MyRayResultCallback ray(origin, origin + direction * length, caster);
+	rayTestPacket(&ray, 1);
+	return SetContact(query, ray, track, contact);
+}
+
+int DynamicsWorld::castRays(
+	const RayQuery * queries,
+	int count,
+	CollisionContact * contacts) const
+{
+	// packet callbacks, sized to the largest packet cast by this thread
+	static thread_local btAlignedObjectArray<MyRayResultCallback> rays;
+	rays.resize(btMin(count, int(max_ray_packet)));
+
+	int hits = 0;
+	for (int begin = 0; begin < count; begin += max_ray_packet)
+	{
+		const int size = btMin(count - begin, int(max_ray_packet));
+		for (int i = 0; i < size; ++i)
+		{
+			const RayQuery & q = queries[begin + i];
+			rays[i] = MyRayResultCallback(q.position, q.position + q.direction * q.length, q.caster);
+		}
+
+		rayTestPacket(&rays[0], size);
+
+		for (int i = 0; i < size; ++i)
+		{
+			if (SetContact(queries[begin + i], rays[i], track, contacts[begin + i]))
+				hits++;
+		}
+	}
+	return hits;
+}
+
+void DynamicsWorld::rayTestPacket(MyRayResultCallback * rays, int count) const
+{
+	// btDbvtBroadphase::rayTest shares its traversal stack between all callers,
+	// walk the broadphase trees here using a stack per thread instead,
+	// each stack entry carries the mask of rays overlapping the node
+	struct Entry
+	{
+		const btDbvtNode * node;
+		unsigned long long mask;
+	};
+	static thread_local btAlignedObjectArray<Entry> stack;
+
+	// per ray traversal data, sized to the packet
+	struct Ray
+	{
+		btTransform from;
+		btTransform to;
+		btVector3 dirInverse;
+		unsigned int signs[3];
+		btScalar lambdaMax;
+	};
+	static thread_local btAlignedObjectArray<Ray> packet;
+
+	btAssert(count > 0 && count <= max_ray_packet);
+	packet.resize(count);
+	for (int i = 0; i < count; ++i)
+	{
+		const btVector3 & rayFromWorld = rays[i].m_rayFromWorld;
+		const btVector3 & rayToWorld = rays[i].m_rayToWorld;
+		const btVector3 rayDir = (rayToWorld - rayFromWorld).normalized();
+		Ray & r = packet[i];
+		r.from = btTransform(btMatrix3x3::getIdentity(), rayFromWorld);
+		r.to = btTransform(btMatrix3x3::getIdentity(), rayToWorld);
+		r.dirInverse = btVector3(
+			rayDir[0] == 0 ? BT_LARGE_FLOAT : 1 / rayDir[0],
+			rayDir[1] == 0 ? BT_LARGE_FLOAT : 1 / rayDir[1],
+			rayDir[2] == 0 ? BT_LARGE_FLOAT : 1 / rayDir[2]);
+		r.signs[0] = r.dirInverse[0] < 0;
+		r.signs[1] = r.dirInverse[1] < 0;
+		r.signs[2] = r.dirInverse[2] < 0;
+		r.lambdaMax = rayDir.dot(rayToWorld - rayFromWorld);
+	}
+	const unsigned long long all = (count == 64) ? ~0ULL : (1ULL << count) - 1;
+
+	for (int s = 0; s < 2; ++s)
+	{
+		const btDbvtNode * root = m_dbvtBroadphase->m_sets[s].m_root;
+		if (!root)
+			continue;
+
+		stack.resize(0);
+		stack.push_back(Entry{root, all});
+		while (stack.size() > 0)
+		{
+			const Entry entry = stack[stack.size() - 1];
+			stack.pop_back();
+
+			const btDbvtNode * node = entry.node;
+			const btVector3 bounds[2] = {node->volume.Mins(), node->volume.Maxs()};
+			unsigned long long mask = 0;
+			for (int i = 0; i < count; ++i)
+			{
+				btScalar tmin = 1;
+				if (((entry.mask >> i) & 1) &&
+					btRayAabb2(rays[i].m_rayFromWorld, packet[i].dirInverse, packet[i].signs, bounds, tmin, 0, packet[i].lambdaMax))
+					mask |= 1ULL << i;
+			}
+			if (!mask)
+				continue;
+
+			if (node->isinternal())
+			{
+				stack.push_back(Entry{node->childs[0], mask});
+				stack.push_back(Entry{node->childs[1], mask});
+				continue;
+			}
+
+			btBroadphaseProxy * proxy = static_cast<btBroadphaseProxy*>(node->data);
+			btCollisionObject * object = static_cast<btCollisionObject*>(proxy->m_clientObject);
+			for (int i = 0; i < count; ++i)
+			{
+				if (((mask >> i) & 1) && rays[i].needsCollision(proxy))
+				{
+					rayTestSingle(
+						packet[i].from, packet[i].to,
+						object, object->getCollisionShape(), object->getWorldTransform(),
+						rays[i]);
+				}
+			}
+		}
+	}
+}
+
+void DynamicsWorld::updateActions(btScalar timeStep)
+{
+	BT_PROFILE("updateActions");
+
+	const int count = m_parallelActions.size();
+	if (!m_jobs || m_jobs->GetThreadCount() < 2 || count < 2 || count != m_actions.size())
+	{
+		for (int i = 0; i < m_actions.size(); ++i)
+			m_actions[i]->updateAction(this, timeStep);
+		return;
+	}
+
+	// Broadphase bounds stay fixed during action updates. An action query
+	// overlapping the bounds of another action's object might observe its
+	// update, both actions are coupled then and keep their serial order.
+	m_actionQueryMin.resize(count);
+	m_actionQueryMax.resize(count);
+	m_actionCoupled.resize(count);
+	for (int i = 0; i < count; ++i)
+	{
+		m_parallelActions[i]->getQueryAabb(m_actionQueryMin[i], m_actionQueryMax[i]);
+		m_actionCoupled[i] = false;
+	}
+	for (int i = 0; i < count; ++i)
+	{
+		const btBroadphaseProxy * pi = m_parallelActions[i]->getCollisionObject().getBroadphaseHandle();
+		for (int j = i + 1; j < count; ++j)
+		{
+			const btBroadphaseProxy * pj = m_parallelActions[j]->getCollisionObject().getBroadphaseHandle();
+			if ((pj && TestAabbAgainstAabb2(m_actionQueryMin[i], m_actionQueryMax[i], pj->m_aabbMin, pj->m_aabbMax)) ||
+				(pi && TestAabbAgainstAabb2(m_actionQueryMin[j], m_actionQueryMax[j], pi->m_aabbMin, pi->m_aabbMax)))
+			{
+				m_actionCoupled[i] = true;
+				m_actionCoupled[j] = true;
+			}
+		}
+	}
+
+	m_actionBatch.resize(0);
+	for (int i = 0; i < count; ++i)
+	{
+		if (!m_actionCoupled[i])
+			m_actionBatch.push_back(m_parallelActions[i]);
+	}
+	m_jobs->ParallelFor(0, m_actionBatch.size(), 1, [this, timeStep](int begin, int end)
+	{
+		for (int i = begin; i < end; ++i)
+			m_actionBatch[i]->updateAction(this, timeStep);
+	});
+
+	for (int i = 0; i < count; ++i)
+	{
+		if (m_actionCoupled[i])
+			m_parallelActions[i]->updateAction(this, timeStep);
+	}
+}
+
 void DynamicsWorld::update(btScalar dt)
 {
 	stepSimulation(dt, maxSubSteps, timeStep);
@@ -214,6 +438,24 @@ void DynamicsWorld::addCollisionObject(btCollisionObject* object)
 	btDiscreteDynamicsWorld::addCollisionObject(object);
 }
 
+void DynamicsWorld::addParallelAction(ParallelAction* action)
+{
+	m_parallelActions.push_back(action);
+	addAction(action);
+}
+
+void DynamicsWorld::removeParallelAction(ParallelAction* action)
+{
+	// same removal as m_actions to keep both in matching order
+	m_parallelActions.remove(action);
+	removeAction(action);
+}
+
+void DynamicsWorld::setJobSystem(JobSystem* jobs)
+{
+	m_jobs = jobs;
+}
+
 void DynamicsWorld::reset(const Track & t)
 {
 	reset();
@@ -285,3 +527,190 @@ void DynamicsWorld::fractureCallback()
 	}
 #endif
 }
+
+// car like action, casts a ray down from each bottom corner of its box and
+// pushes the box up there like a spring. It tilts the box back and forth
+// first, so that the rays of a car above it depend on the update order.
+class DynamicsWorldTestCar : public ParallelAction
+{
+public:
+	DynamicsWorldTestCar(btRigidBody & body) :
+		body(body),
+		tilt(0.01)
+	{
+		// ctor
+	}
+
+	const btCollisionObject & getCollisionObject() const override
+	{
+		return body;
+	}
+
+	void getQueryAabb(btVector3 & aabbMin, btVector3 & aabbMax) const override
+	{
+		aabbMin = aabbMax = body.getCenterOfMassPosition();
+		for (int i = 0; i < 4; ++i)
+		{
+			const btVector3 start = getCorner(i);
+			const btVector3 end = start + getDown() * raylen;
+			aabbMin.setMin(start);
+			aabbMin.setMin(end);
+			aabbMax.setMax(start);
+			aabbMax.setMax(end);
+		}
+
+		// margin for the tilt
+		const btVector3 margin(0.1, 0.1, 0.1);
+		aabbMin -= margin;
+		aabbMax += margin;
+	}
+
+	void updateAction(btCollisionWorld * world, btScalar dt) override
+	{
+		btTransform transform = body.getCenterOfMassTransform();
+		transform.setRotation(transform.getRotation() * btQuaternion(btVector3(1, 0, 0), tilt));
+		body.setCenterOfMassTransform(transform);
+		tilt = -tilt;
+
+		const DynamicsWorld & dynamics = static_cast<const DynamicsWorld &>(*world);
+		for (int i = 0; i < 4; ++i)
+		{
+			const btVector3 start = getCorner(i);
+			CollisionContact contact;
+			if (dynamics.castRay(start, getDown(), raylen, &body, contact) && contact.GetDepth() < restlen)
+			{
+				const btVector3 impulse = -getDown() * (restlen - contact.GetDepth()) * stiffness * dt;
+				body.applyImpulse(impulse, start - body.getCenterOfMassPosition());
+			}
+		}
+	}
+
+	void debugDraw(btIDebugDraw * /*debugDrawer*/) override
+	{
+		// nothing to draw
+	}
+
+	static constexpr btScalar raylen = 2;
+	static constexpr btScalar restlen = 1;
+	static constexpr btScalar stiffness = 40;
+
+private:
+	btRigidBody & body;
+	btScalar tilt;
+
+	btVector3 getDown() const
+	{
+		return -body.getCenterOfMassTransform().getBasis().getColumn(2);
+	}
+
+	btVector3 getCorner(int i) const
+	{
+		const btVector3 corner(i % 2 ? 1 : -1, i / 2 ? 2 : -2, -0.5);
+		return body.getCenterOfMassTransform() * corner;
+	}
+};
+
+constexpr btScalar DynamicsWorldTestCar::raylen;
+constexpr btScalar DynamicsWorldTestCar::restlen;
+constexpr btScalar DynamicsWorldTestCar::stiffness;
+
+struct DynamicsWorldTest : public DynamicsWorld
+{
+	using DynamicsWorld::DynamicsWorld;
+
+	// number of actions coupled by the last parallel update
+	int getCoupledActions() const
+	{
+		int count = 0;
+		for (int i = 0; i < m_actionCoupled.size(); ++i)
+			count += m_actionCoupled[i];
+		return count;
+	}
+};
+
+// Simulate cars on a ground box, four far apart and two pairs stacked on
+// top of each other. Returns the body transforms and the number of coupled actions.
+static int DynamicsWorldTestRun(JobSystem * jobs, std::vector<btScalar> & transforms)
+{
+	btDefaultCollisionConfiguration config;
+	btCollisionDispatcher dispatcher(&config);
+	btDbvtBroadphase broadphase;
+	btSequentialImpulseConstraintSolver solver;
+	DynamicsWorldTest world(&dispatcher, &broadphase, &solver, &config, 1 / 90.0);
+	world.setJobSystem(jobs);
+
+	btBoxShape ground_shape(btVector3(100, 100, 1));
+	btRigidBody ground(0, 0, &ground_shape);
+	ground.setWorldTransform(btTransform(btQuaternion::getIdentity(), btVector3(0, 0, -1)));
+	world.addRigidBody(&ground);
+
+	const btVector3 positions[] = {
+		btVector3(-30, 0, 1.5), btVector3(-10, 0, 1.5), btVector3(10, 0, 1.5), btVector3(30, 0, 1.5),
+		btVector3(-20, 30, 1.5), btVector3(-20, 30, 3.5), btVector3(20, 30, 1.5), btVector3(20, 30, 3.5)};
+	const int count = sizeof(positions) / sizeof(positions[0]);
+
+	btBoxShape shape(btVector3(1, 2, 0.5));
+	btVector3 inertia;
+	shape.calculateLocalInertia(1, inertia);
+	std::vector<std::unique_ptr<btRigidBody> > bodies;
+	std::vector<std::unique_ptr<DynamicsWorldTestCar> > cars;
+	for (int i = 0; i < count; ++i)
+	{
+		btRigidBody::btRigidBodyConstructionInfo info(1, 0, &shape, inertia);
+		info.m_startWorldTransform.setOrigin(positions[i]);
+		bodies.emplace_back(new btRigidBody(info));
+		bodies.back()->setActivationState(DISABLE_DEACTIVATION);
+		world.addRigidBody(bodies.back().get());
+		cars.emplace_back(new DynamicsWorldTestCar(*bodies.back()));
+		world.addParallelAction(cars.back().get());
+	}
+
+	for (int i = 0; i < 180; ++i)
+		world.update(1 / 90.0);
+
+	transforms.clear();
+	for (const auto & body : bodies)
+	{
+		const btTransform & t = body->getCenterOfMassTransform();
+		for (int j = 0; j < 3; ++j)
+		{
+			transforms.push_back(t.getBasis()[j].x());
+			transforms.push_back(t.getBasis()[j].y());
+			transforms.push_back(t.getBasis()[j].z());
+			transforms.push_back(t.getOrigin()[j]);
+		}
+	}
+
+	const int coupled = world.getCoupledActions();
+	for (const auto & car : cars)
+		world.removeParallelAction(car.get());
+	for (const auto & body : bodies)
+		world.removeRigidBody(body.get());
+	world.removeRigidBody(&ground);
+	return coupled;
+}
+
+QT_TEST(dynamicsworld_parallel_actions_test)
+{
+	std::vector<btScalar> serial_transforms, parallel_transforms;
+	QT_CHECK_EQUAL(DynamicsWorldTestRun(0, serial_transforms), 0);
+
+	// cars are supported by their rays, the upper ones by the lower ones
+	for (int i = 0; i < 8; ++i)
+		QT_CHECK(serial_transforms[i * 12 + 11] > 0.5f);
+	QT_CHECK(serial_transforms[5 * 12 + 11] > serial_transforms[4 * 12 + 11] + 1);
+	QT_CHECK(serial_transforms[7 * 12 + 11] > serial_transforms[6 * 12 + 11] + 1);
+
+	// job system output matches the serial update bit for bit, for any schedule
+	JobSystem jobs;
+	jobs.Init(4);
+	bool equal = true;
+	for (unsigned n = 0; n < 10; ++n)
+	{
+		QT_CHECK_EQUAL(DynamicsWorldTestRun(&jobs, parallel_transforms), 4);
+		equal = equal && parallel_transforms.size() == serial_transforms.size() &&
+			std::memcmp(parallel_transforms.data(), serial_transforms.data(),
+				serial_transforms.size() * sizeof(btScalar)) == 0;
+	}
+	QT_CHECK(equal);
+}
@@ -22,6 +22,10 @@
 
 #include "BulletDynamics/Dynamics/btDiscreteDynamicsWorld.h"
 
+struct btDbvtBroadphase;
+class JobSystem;
+class ParallelAction;
+struct MyRayResultCallback;
 class Track;
 class CollisionContact;
 class FractureBody;
@@ -32,7 +36,7 @@ class DynamicsWorld  : public btDiscreteDynamicsWorld
 public:
 	DynamicsWorld(
 		btDispatcher* dispatcher,
-		btBroadphaseInterface* broadphase,
+		btDbvtBroadphase* broadphase,
 		btConstraintSolver* constraintSolver,
 		btCollisionConfiguration* collisionConfig,
 		btScalar timeStep = 1/60.0,
@@ -42,6 +46,14 @@ public:
 
 	void addCollisionObject(btCollisionObject* object);
 
+	// register action which might be updated concurrently with other parallel actions
+	void addParallelAction(ParallelAction* action);
+
+	void removeParallelAction(ParallelAction* action);
+
+	// job system used to update parallel actions, null updates serially
+	void setJobSystem(JobSystem* jobs);
+
 	// reset collision world (unloads previous track)
 	void reset(const Track & t);
 
@@ -51,6 +63,7 @@ public:
 	const RoadPatch * GetSectorPatch(int i);
 
 	// cast ray into collision world, returns first hit, caster is excluded fom hits
+	// safe to call concurrently from parallel actions
 	bool castRay(
 		const btVector3 & position,
 		const btVector3 & direction,
@@ -58,6 +71,21 @@ public:
 		const btCollisionObject * caster,
 		CollisionContact & contact) const;
 
+	struct RayQuery
+	{
+		btVector3 position;
+		btVector3 direction;
+		btScalar length;
+		const btCollisionObject * caster;
+	};
+
+	// cast a batch of rays, contacts as returned by castRay for each query
+	// broadphase is traversed once per packet of rays, returns number of hits
+	int castRays(
+		const RayQuery * queries,
+		int count,
+		CollisionContact * contacts) const;
+
 	btScalar getTimeStep() const { return timeStep; };
 
 	void update(btScalar dt);
@@ -65,6 +93,14 @@ public:
 	void draw();
 
 protected:
+	JobSystem * m_jobs;
+	btAlignedObjectArray<ParallelAction*> m_parallelActions;
+	btAlignedObjectArray<btActionInterface*> m_actionBatch;
+	btAlignedObjectArray<btVector3> m_actionQueryMin;
+	btAlignedObjectArray<btVector3> m_actionQueryMax;
+	btAlignedObjectArray<bool> m_actionCoupled;
+	btDbvtBroadphase * m_dbvtBroadphase;
+
 	struct ActiveCon
 	{
 		ActiveCon() : body(0), id(-1) {}
@@ -79,6 +115,14 @@ protected:
 
 	void reset();
 
+	static const int max_ray_packet = 64;
+
+	// ray test packet against the broadphase trees without touching shared traversal state
+	void rayTestPacket(MyRayResultCallback * rays, int count) const;
+
+	// update independent parallel actions concurrently, then the coupled ones in order
+	void updateActions(btScalar timeStep) override;
+
 	void solveConstraints(btContactSolverInfo& solverInfo);
 
 	void fractureCallback();
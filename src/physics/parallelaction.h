@@ -0,0 +1,42 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef _PARALLEL_ACTION_H
+#define _PARALLEL_ACTION_H
+
+#include "BulletDynamics/Dynamics/btActionInterface.h"
+
+class btCollisionObject;
+
+// Action which DynamicsWorld may update concurrently with other actions.
+// updateAction is only allowed to modify the action's own collision object
+// and to query the world through DynamicsWorld::castRay. Actions whose
+// queries might see each other's collision objects are updated serially
+// in registration order, so results do not depend on the thread count.
+class ParallelAction : public btActionInterface
+{
+public:
+	// collision object modified by updateAction
+	virtual const btCollisionObject & getCollisionObject() const = 0;
+
+	// bounds of all world queries issued by the next updateAction
+	virtual void getQueryAabb(btVector3 & aabbMin, btVector3 & aabbMax) const = 0;
+};
+
+#endif // _PARALLEL_ACTION_H
@@ -0,0 +1,431 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+#include "profiler.h"
+#include "microbench.h"
+#include "unittest.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	struct ZoneEvent
+	{
+		Profiler::Clock::rep begin;
+		Profiler::Clock::rep end;
+		unsigned zone;
+	};
+
+	// single producer single consumer ring, written by the owning thread,
+	// read by the thread calling EndFrame
+	struct ThreadBuffer
+	{
+		std::atomic<unsigned> head;
+		std::atomic<unsigned> tail;
+		std::atomic<unsigned> dropped;
+		ZoneEvent events[Profiler::buffer_size];
+		std::string name;
+		unsigned id;
+
+		ThreadBuffer(unsigned id) : head(0), tail(0), dropped(0), id(id) {}
+	};
+
+	struct TraceEvent
+	{
+		Profiler::Clock::rep begin;
+		Profiler::Clock::rep end;
+		unsigned zone;
+		unsigned thread;
+	};
+
+	struct ZoneStats
+	{
+		double frame = 0; // us
+		double last = 0; // us
+		double avg = 0; // us per frame
+		double total = 0; // us
+	};
+
+	struct ProfilerState
+	{
+		// guards zone names and thread buffer list
+		std::mutex mutex;
+		std::vector<std::string> zone_names;
+		std::vector<std::unique_ptr<ThreadBuffer> > threads;
+
+		// owned by the thread calling EndFrame
+		ZoneStats zones[Profiler::max_zones];
+		std::vector<TraceEvent> trace;
+		unsigned max_trace_events = 0;
+		Profiler::Clock::time_point start;
+		Profiler::Clock::time_point frame_start;
+		double last_frame = 0; // us
+		double avg_frame = 0; // us
+		unsigned long long frames = 0;
+	};
+}
+
+std::atomic<bool> Profiler::enabled(false);
+
+// buffers are created by the first zone of a thread
+static thread_local ThreadBuffer * thread_buffer = 0;
+static thread_local std::string thread_name;
+
+static const double avg_smoothing = 0.05;
+
+static ProfilerState & GetState()
+{
+	static ProfilerState state;
+	return state;
+}
+
+static ThreadBuffer & GetThreadBuffer()
+{
+	if (!thread_buffer)
+	{
+		ProfilerState & state = GetState();
+		std::lock_guard<std::mutex> lock(state.mutex);
+		const unsigned id = unsigned(state.threads.size());
+		state.threads.emplace_back(new ThreadBuffer(id));
+		state.threads.back()->name = thread_name.empty() ? "thread " + std::to_string(id) : thread_name;
+		thread_buffer = state.threads.back().get();
+	}
+	return *thread_buffer;
+}
+
+static double ToMicroseconds(Profiler::Clock::rep ticks)
+{
+	return std::chrono::duration<double, std::micro>(Profiler::Clock::duration(ticks)).count();
+}
+
+static void WriteJsonString(std::ostream & out, const std::string & str)
+{
+	out << '"';
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if (c >= 0 && c < ' ')
+			out << ' ';
+		else
+			out << c;
+	}
+	out << '"';
+}
+
+unsigned Profiler::RegisterZone(const char * name)
+{
+	ProfilerState & state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	auto i = std::find(state.zone_names.begin(), state.zone_names.end(), name);
+	if (i != state.zone_names.end())
+		return unsigned(i - state.zone_names.begin());
+
+	// zones beyond max_zones are ignored
+	state.zone_names.push_back(name);
+	return unsigned(state.zone_names.size() - 1);
+}
+
+void Profiler::SetThreadName(const std::string & name)
+{
+	thread_name = name;
+	if (thread_buffer)
+	{
+		std::lock_guard<std::mutex> lock(GetState().mutex);
+		thread_buffer->name = name;
+	}
+}
+
+void Profiler::Enable(bool value, unsigned max_trace_events)
+{
+	ProfilerState & state = GetState();
+	if (value)
+	{
+		// discard zones recorded before
+		std::lock_guard<std::mutex> lock(state.mutex);
+		for (auto & buffer : state.threads)
+		{
+			buffer->tail.store(buffer->head.load(std::memory_order_acquire), std::memory_order_release);
+			buffer->dropped.store(0);
+		}
+		std::fill(state.zones, state.zones + max_zones, ZoneStats());
+		state.trace.clear();
+		state.trace.reserve(max_trace_events);
+		state.max_trace_events = max_trace_events;
+		state.start = state.frame_start = Clock::now();
+		state.last_frame = 0;
+		state.avg_frame = 0;
+		state.frames = 0;
+	}
+	enabled.store(value);
+}
+
+void Profiler::Record(unsigned zone, Clock::time_point begin, Clock::time_point end)
+{
+	ThreadBuffer & buffer = GetThreadBuffer();
+	const unsigned head = buffer.head.load(std::memory_order_relaxed);
+	if (head - buffer.tail.load(std::memory_order_acquire) >= buffer_size)
+	{
+		buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	ZoneEvent & event = buffer.events[head % buffer_size];
+	event.begin = begin.time_since_epoch().count();
+	event.end = end.time_since_epoch().count();
+	event.zone = zone;
+	buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::EndFrame()
+{
+	if (!Enabled())
+		return;
+
+	ProfilerState & state = GetState();
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		for (auto & buffer : state.threads)
+		{
+			const unsigned head = buffer->head.load(std::memory_order_acquire);
+			const unsigned tail = buffer->tail.load(std::memory_order_relaxed);
+			for (unsigned i = tail; i != head; ++i)
+			{
+				const ZoneEvent & event = buffer->events[i % buffer_size];
+				if (event.zone >= max_zones)
+					continue;
+
+				state.zones[event.zone].frame += ToMicroseconds(event.end - event.begin);
+				if (state.trace.size() < state.max_trace_events)
+					state.trace.push_back(TraceEvent{event.begin, event.end, event.zone, buffer->id});
+			}
+			buffer->tail.store(head, std::memory_order_release);
+		}
+	}
+
+	const Clock::time_point now = Clock::now();
+	const double frame = std::chrono::duration<double, std::micro>(now - state.frame_start).count();
+	const double smoothing = state.frames ? avg_smoothing : 1.0;
+	state.frame_start = now;
+	state.frames++;
+	state.last_frame = frame;
+	state.avg_frame += (frame - state.avg_frame) * smoothing;
+	for (auto & zone : state.zones)
+	{
+		zone.last = zone.frame;
+		zone.avg += (zone.frame - zone.avg) * smoothing;
+		zone.total += zone.frame;
+		zone.frame = 0;
+	}
+}
+
+double Profiler::GetFrameTime()
+{
+	return GetState().last_frame;
+}
+
+double Profiler::GetZoneTime(unsigned zone)
+{
+	return zone < max_zones ? GetState().zones[zone].last : 0;
+}
+
+// zone ids sorted by name
+static std::vector<unsigned> GetSortedZones(ProfilerState & state)
+{
+	std::lock_guard<std::mutex> lock(state.mutex);
+	std::vector<unsigned> ids;
+	for (unsigned i = 0; i < state.zone_names.size() && i < Profiler::max_zones; ++i)
+		ids.push_back(i);
+	std::sort(ids.begin(), ids.end(), [&state](unsigned a, unsigned b)
+	{
+		return state.zone_names[a] < state.zone_names[b];
+	});
+	return ids;
+}
+
+std::string Profiler::GetAvgSummary()
+{
+	if (!Enabled())
+		return std::string();
+
+	ProfilerState & state = GetState();
+	std::ostringstream oss;
+	oss.precision(4);
+	oss << "frame: " << state.avg_frame << " us";
+	for (unsigned id : GetSortedZones(state))
+	{
+		if (state.zones[id].total > 0)
+			oss << "\n" << state.zone_names[id] << ": " << state.zones[id].avg << " us";
+	}
+	return oss.str();
+}
+
+std::string Profiler::GetSummary()
+{
+	if (!Enabled())
+		return std::string();
+
+	ProfilerState & state = GetState();
+	const double elapsed = std::chrono::duration<double, std::micro>(state.frame_start - state.start).count();
+	std::ostringstream oss;
+	oss.precision(4);
+	oss << "frames: " << state.frames << ", " << elapsed * 1E-3 << " ms";
+	for (unsigned id : GetSortedZones(state))
+	{
+		const ZoneStats & zone = state.zones[id];
+		if (zone.total > 0)
+		{
+			oss << "\n" << state.zone_names[id] << ": ";
+			oss << (elapsed > 0 ? zone.total * 100 / elapsed : 0) << " % (";
+			oss << zone.total * 1E-3 << " ms)";
+		}
+	}
+	return oss.str();
+}
+
+unsigned Profiler::GetDroppedEvents()
+{
+	ProfilerState & state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	unsigned dropped = 0;
+	for (const auto & buffer : state.threads)
+		dropped += buffer->dropped.load(std::memory_order_relaxed);
+	return dropped;
+}
+
+unsigned Profiler::GetTraceEvents()
+{
+	return unsigned(GetState().trace.size());
+}
+
+bool Profiler::WriteTrace(std::ostream & out)
+{
+	ProfilerState & state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	const Clock::rep start = state.start.time_since_epoch().count();
+
+	out << "{\"traceEvents\":[\n";
+	bool first = true;
+	for (const auto & buffer : state.threads)
+	{
+		out << (first ? "" : ",\n");
+		out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->id << ",\"args\":{\"name\":";
+		WriteJsonString(out, buffer->name);
+		out << "}}";
+		first = false;
+	}
+
+	out.precision(3);
+	out << std::fixed;
+	for (const auto & event : state.trace)
+	{
+		out << (first ? "" : ",\n");
+		out << "{\"name\":";
+		WriteJsonString(out, state.zone_names[event.zone]);
+		out << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.thread;
+		out << ",\"ts\":" << ToMicroseconds(event.begin - start);
+		out << ",\"dur\":" << ToMicroseconds(event.end - event.begin) << "}";
+		first = false;
+	}
+	out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	return bool(out);
+}
+
+static void ProfileNested(int depth)
+{
+	PROFILE_ZONE("profiler_test_nested");
+	if (depth > 0)
+		ProfileNested(depth - 1);
+}
+
+QT_TEST(profiler_test)
+{
+	Profiler::Enable(false);
+	{
+		PROFILE_ZONE("profiler_test_disabled");
+	}
+	QT_CHECK_EQUAL(Profiler::RegisterZone("profiler_test_nested"), Profiler::RegisterZone("profiler_test_nested"));
+
+	Profiler::Enable(true, 100);
+	Profiler::SetThreadName("test main");
+	{
+		PROFILE_ZONE("profiler_test_outer");
+		ProfileNested(3);
+	}
+	std::thread worker([]
+	{
+		Profiler::SetThreadName("test worker");
+		ProfileNested(1);
+	});
+	worker.join();
+	Profiler::EndFrame();
+	QT_CHECK_EQUAL(Profiler::GetTraceEvents(), 7u);
+	const unsigned outer = Profiler::RegisterZone("profiler_test_outer");
+	QT_CHECK(Profiler::GetZoneTime(outer) > 0);
+	QT_CHECK(Profiler::GetFrameTime() >= Profiler::GetZoneTime(outer));
+	QT_CHECK_EQUAL(Profiler::GetDroppedEvents(), 0u);
+
+	const std::string summary = Profiler::GetAvgSummary();
+	QT_CHECK(summary.find("profiler_test_outer: ") != std::string::npos);
+	QT_CHECK(summary.find("profiler_test_nested: ") != std::string::npos);
+	QT_CHECK(summary.find("profiler_test_disabled") == std::string::npos);
+
+	std::ostringstream trace;
+	QT_CHECK(Profiler::WriteTrace(trace));
+	const std::string json = trace.str();
+	QT_CHECK_EQUAL(json.compare(0, 16, "{\"traceEvents\":["), 0);
+	QT_CHECK(json.find("\"args\":{\"name\":\"test main\"}") != std::string::npos);
+	QT_CHECK(json.find("\"args\":{\"name\":\"test worker\"}") != std::string::npos);
+	QT_CHECK(json.find("{\"name\":\"profiler_test_outer\",\"ph\":\"X\"") != std::string::npos);
+
+	// trace keeps at most max_trace_events, full thread buffers drop events
+	for (unsigned i = 0; i < Profiler::buffer_size + 10; ++i)
+	{
+		PROFILE_ZONE("profiler_test_overflow");
+	}
+	QT_CHECK_EQUAL(Profiler::GetDroppedEvents(), 10u);
+	Profiler::EndFrame();
+	QT_CHECK_EQUAL(Profiler::GetTraceEvents(), 100u);
+
+	Profiler::Enable(false);
+	QT_CHECK(Profiler::GetAvgSummary().empty());
+}
+
+MB_BENCHMARK(profiler_benchmark)
+{
+	const int zones = 1000;
+	auto record = [zones]
+	{
+		for (int i = 0; i < zones; ++i)
+		{
+			PROFILE_ZONE("profiler_benchmark");
+		}
+		Profiler::EndFrame();
+	};
+
+	Profiler::Enable(false);
+	out << "disabled zone: " << microbench::measure(record) / zones << " ns" << std::endl;
+	Profiler::Enable(true);
+	out << "enabled zone: " << microbench::measure(record) / zones << " ns" << std::endl;
+	Profiler::Enable(false);
+}
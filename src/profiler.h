@@ -0,0 +1,130 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <string>
+
+/// Frame profiler. Zones are timed by scope objects and identified by ids
+/// registered once per call site. Each thread writes its zones to its own
+/// lock-free ring buffer, EndFrame collects them into per zone statistics
+/// and optionally into a trace exported as Chrome trace event JSON.
+/// Disabled zones cost a flag test.
+///
+/// void Foo()
+/// {
+/// 	PROFILE_ZONE("foo");
+/// 	...
+/// }
+class Profiler
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	static const unsigned max_zones = 256;
+
+	/// Events per thread buffered between EndFrame calls, more are dropped.
+	static const unsigned buffer_size = 1 << 14;
+
+	/// Register zone, returns its id. Zones with the same name share the id.
+	static unsigned RegisterZone(const char * name);
+
+	/// Name of the calling thread in the trace.
+	static void SetThreadName(const std::string & name);
+
+	/// Start or stop collecting zones, resets the statistics when started.
+	/// Up to max_trace_events zone events are kept for WriteTrace.
+	static void Enable(bool value, unsigned max_trace_events = 0);
+
+	static bool Enabled();
+
+	/// Collect zones recorded by all threads since the last call.
+	/// Called by the main thread once per frame.
+	static void EndFrame();
+
+	/// Duration of the last frame in microseconds.
+	static double GetFrameTime();
+
+	/// Time spent in zone during the last frame in microseconds.
+	static double GetZoneTime(unsigned zone);
+
+	/// Zone times per frame, smoothed over recent frames.
+	static std::string GetAvgSummary();
+
+	/// Zone times since the profiler was enabled, relative to the elapsed time.
+	static std::string GetSummary();
+
+	/// Number of zone events lost to full thread buffers.
+	static unsigned GetDroppedEvents();
+
+	/// Number of zone events kept for the trace.
+	static unsigned GetTraceEvents();
+
+	/// Write kept zone events as Chrome trace event JSON, viewable in
+	/// chrome://tracing or Perfetto.
+	static bool WriteTrace(std::ostream & out);
+
+	/// Add zone event of the calling thread, used by ProfileScope.
+	static void Record(unsigned zone, Clock::time_point begin, Clock::time_point end);
+
+private:
+	static std::atomic<bool> enabled;
+};
+
+/// Times the enclosing scope as a zone.
+class ProfileScope
+{
+public:
+	explicit ProfileScope(unsigned zone) :
+		zone(zone),
+		active(Profiler::Enabled())
+	{
+		if (active)
+			begin = Profiler::Clock::now();
+	}
+
+	~ProfileScope()
+	{
+		if (active)
+			Profiler::Record(zone, begin, Profiler::Clock::now());
+	}
+
+private:
+	Profiler::Clock::time_point begin;
+	unsigned zone;
+	bool active;
+};
+
+inline bool Profiler::Enabled()
+{
+	return enabled.load(std::memory_order_relaxed);
+}
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+/// Time the rest of the enclosing scope as zone name, a string literal.
+#define PROFILE_ZONE(name)\
+	static const unsigned PROFILE_CONCAT(profile_zone_, __LINE__) = Profiler::RegisterZone(name);\
+	ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(PROFILE_CONCAT(profile_zone_, __LINE__))
+
+#endif // _PROFILER_H
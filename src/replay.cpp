@@ -18,17 +18,67 @@
 /************************************************************************/
 
 #include "replay.h"
+#include "replaycodec.h"
 #include "unittest.h"
 #include "cfg/ptree.h"
 #include "physics/carinput.h"
 #include "physics/cardynamics.h"
 #include "joeserialize.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
 #include <sstream>
-#include <fstream>
+
+// block header: payload size, first frame, end frame
+static const unsigned block_header_size = 12;
+
+// larger blocks are treated as corrupt
+static const unsigned max_block_size = 1 << 26;
+
+static void WriteUint32(char * out, unsigned value)
+{
+	for (int i = 0; i < 4; ++i)
+		out[i] = char((value >> (i * 8)) & 0xFF);
+}
+
+static unsigned ReadUint32(const char * data)
+{
+	unsigned value = 0;
+	for (int i = 0; i < 4; ++i)
+		value |= unsigned(static_cast<unsigned char>(data[i])) << (i * 8);
+	return value;
+}
+
+// input values as their bit patterns, to delta code them exactly
+static void GetInputBits(const std::vector<float> & inputs, std::vector<long long> & bits)
+{
+	bits.resize(inputs.size());
+	for (size_t i = 0; i < inputs.size(); ++i)
+	{
+		unsigned b;
+		std::memcpy(&b, &inputs[i], sizeof(b));
+		bits[i] = b;
+	}
+}
+
+static void SetInputBits(const std::vector<long long> & bits, std::vector<float> & inputs)
+{
+	inputs.resize(bits.size());
+	for (size_t i = 0; i < bits.size(); ++i)
+	{
+		const unsigned b = unsigned(bits[i]);
+		std::memcpy(&inputs[i], &b, sizeof(b));
+	}
+}
 
 Replay::Replay(float framerate) :
-	version_info("VDRIFTREPLAYV17", CarInput::INVALID, framerate),
+	version_info("VDRIFTREPLAYV18", CarInput::INVALID, framerate),
+	block_begin(0),
+	block_end(0),
+	cur_block(0),
 	replaymode(IDLE)
 {
 	// ctor
@@ -38,16 +88,20 @@ bool Replay::StartPlaying(const std::string & replayfilename, std::ostream & err
 {
 	Reset();
 
-	std::ifstream replaystream(replayfilename.c_str(), std::ios::binary);
-	if (!replaystream)
+	instream.open(replayfilename.c_str(), std::ios::binary);
+	if (!instream)
 	{
 		error_output << "Error loading replay file: " << replayfilename << std::endl;
 		return false;
 	}
 
-	if (!Load(replaystream, error_output))
+	if (!Load(instream, error_output) || !LoadBlockIndex(error_output))
+	{
+		Reset();
 		return false;
+	}
 
+	carstate.resize(carinfo.size());
 	for (auto & state : carstate)
 	{
 		state.Reset();
@@ -64,52 +118,123 @@ void Replay::Reset()
 	track.clear();
 	carinfo.clear();
 	carstate.clear();
+	blocks.clear();
+	if (outstream.is_open())
+		outstream.close();
+	if (instream.is_open())
+		instream.close();
+	outstream.clear();
+	instream.clear();
+	block_begin = 0;
+	block_end = 0;
+	cur_block = 0;
 }
 
 void Replay::StartRecording(
 	const std::vector<CarInfo> & ncarinfo,
 	const std::string & trackname,
-	std::ostream & /*error_log*/)
+	const std::string & ntempfilename,
+	std::ostream & error_log)
 {
 	Reset();
 
-	replaymode = RECORDING;
 	carinfo = ncarinfo;
 	track = trackname;
+	tempfilename = ntempfilename;
+
+	outstream.open(tempfilename.c_str(), std::ios::binary);
+	if (!outstream)
+	{
+		error_log << "Error creating replay file: " << tempfilename << std::endl;
+		Reset();
+		return;
+	}
+	Save(outstream);
 
 	carstate.resize(carinfo.size());
 	for (auto & state : carstate)
 	{
 		state.Reset();
 	}
+
+	replaymode = RECORDING;
 }
 
 void Replay::StopRecording(const std::string & replayfilename)
 {
-	replaymode = IDLE;
-	if (!replayfilename.empty())
+	if (!outstream.is_open())
+		return;
+
+	WriteBlock();
+	const bool written = outstream.good();
+	outstream.close();
+	Reset();
+
+	if (!replayfilename.empty() && written)
 	{
-		std::ofstream f(replayfilename.c_str(), std::ios::binary);
-		if (f)
-		{
-			Save(f);
-		}
+		std::remove(replayfilename.c_str());
+		std::rename(tempfilename.c_str(), replayfilename.c_str());
+	}
+	else
+	{
+		std::remove(tempfilename.c_str());
 	}
 }
 
-const std::vector<float> & Replay::PlayFrame(unsigned carid, CarDynamics & car)
+template <class Car>
+const std::vector<float> & Replay::PlayFrame(unsigned carid, Car & car)
 {
 	assert(carid < carstate.size());
 	assert(unsigned(version_info.inputs_supported) == CarInput::INVALID);
 
-	if (GetPlaying() && !carstate[carid].PlayFrame(car))
+	if (GetPlaying())
 	{
-		replaymode = IDLE;
+		// all cars have consumed the current block when the first car leaves it
+		if (carid == 0 && carstate[0].frame + 1 >= block_end &&
+			!ReadBlock(block_end == 0 ? 0 : cur_block + 1))
+		{
+			replaymode = IDLE;
+			return carstate[carid].inputbuffer;
+		}
+		carstate[carid].PlayFrame(car);
 	}
 	return carstate[carid].inputbuffer;
 }
 
-void Replay::RecordFrame(unsigned carid, const std::vector <float> & inputs, CarDynamics & car)
+bool Replay::Seek(unsigned frame, unsigned & keyframe)
+{
+	if (!instream.is_open() || frame >= GetFrameCount())
+		return false;
+
+	// first block ending after frame
+	const auto block = std::upper_bound(blocks.begin(), blocks.end(), frame,
+		[](unsigned f, const BlockInfo & b) { return f < b.end; });
+	const unsigned index = block - blocks.begin();
+	if ((index != cur_block || block_end == 0) && !ReadBlock(index))
+	{
+		replaymode = IDLE;
+		return false;
+	}
+
+	// last state frame at or before frame, blocks start with a state frame
+	const std::vector<StateFrame> & stateframes = carstate[0].stateframes;
+	const auto state = std::upper_bound(stateframes.begin(), stateframes.end(), frame,
+		[](unsigned f, const StateFrame & s) { return f < s.GetFrame(); });
+	if (state == stateframes.begin())
+		return false;
+
+	keyframe = (state - 1)->GetFrame();
+	for (auto & car : carstate)
+	{
+		car.Seek(keyframe);
+	}
+	replaymode = PLAYING;
+
+	return true;
+}
+
+template <class Car>
+void Replay::RecordFrame(unsigned carid, const std::vector <float> & inputs, Car & car)
 {
 	assert(carid < carstate.size());
 	assert(unsigned(version_info.inputs_supported)== CarInput::INVALID);
@@ -121,10 +246,106 @@ void Replay::RecordFrame(unsigned carid, const std::vector <float> & inputs, Car
 			replaymode = IDLE;
 
 		carstate[carid].RecordFrame(inputs, car);
+
+		// write the block once the last car has recorded its last frame
+		if (carid + 1 == carstate.size() && carstate[carid].frame - block_begin >= block_frames)
+			WriteBlock();
+	}
+}
+
+void Replay::WriteBlock()
+{
+	const unsigned end_frame = carstate.empty() ? block_begin : carstate.back().frame;
+	if (end_frame == block_begin)
+		return;
+
+	std::string block(block_header_size, 0);
+	for (const auto & state : carstate)
+	{
+		state.WriteBlock(block_begin, block);
+	}
+	WriteUint32(&block[0], block.size() - block_header_size);
+	WriteUint32(&block[4], block_begin);
+	WriteUint32(&block[8], end_frame);
+	outstream.write(block.data(), block.size());
+
+	for (auto & state : carstate)
+	{
+		state.ClearFrames();
+	}
+	block_begin = end_frame;
+}
+
+bool Replay::LoadBlockIndex(std::ostream & error_output)
+{
+	const std::streamoff first = instream.tellg();
+	instream.seekg(0, std::ios::end);
+	const std::streamoff size = instream.tellg();
+
+	// a truncated last block is dropped, the recording was interrupted
+	std::streamoff offset = first;
+	unsigned frame = 0;
+	char header[block_header_size];
+	while (size - offset >= block_header_size)
+	{
+		instream.seekg(offset);
+		if (!instream.read(header, block_header_size))
+			break;
+
+		BlockInfo block;
+		const unsigned block_size = ReadUint32(&header[0]);
+		block.begin = ReadUint32(&header[4]);
+		block.end = ReadUint32(&header[8]);
+		block.offset = offset;
+		if (block.begin != frame || block.end < block.begin || block_size > max_block_size)
+		{
+			error_output << "Error loading replay, corrupt block at frame " << frame << std::endl;
+			return false;
+		}
+
+		offset += block_header_size + block_size;
+		if (offset > size)
+			break;
+
+		blocks.push_back(block);
+		frame = block.end;
+	}
+	instream.clear();
+
+	return true;
+}
+
+bool Replay::ReadBlock(unsigned index)
+{
+	if (index >= blocks.size())
+		return false;
+
+	char header[block_header_size];
+	instream.seekg(blocks[index].offset);
+	if (!instream.read(header, block_header_size))
+		return false;
+
+	const unsigned size = ReadUint32(&header[0]);
+	std::string block(size, 0);
+	if (size > 0 && !instream.read(&block[0], size))
+		return false;
+
+	const char * data = block.data();
+	const char * data_end = data + block.size();
+	for (auto & state : carstate)
+	{
+		if (!state.ReadBlock(blocks[index].begin, data, data_end))
+			return false;
 	}
+
+	cur_block = index;
+	block_begin = blocks[index].begin;
+	block_end = blocks[index].end;
+	return data == data_end;
 }
 
-void Replay::CarState::RecordFrame(const std::vector <float> & inputs, CarDynamics & car)
+template <class Car>
+void Replay::CarState::RecordFrame(const std::vector <float> & inputs, Car & car)
 {
 	assert(inputbuffer.size() == CarInput::INVALID);
 
@@ -142,20 +363,19 @@ void Replay::CarState::RecordFrame(const std::vector <float> & inputs, CarDynami
 		inputframes.push_back(newinputframe);
 
 	// record every 30th state, input frame
-	if (frame % 30 == 0)
+	if (frame % state_interval == 0)
 	{
-		std::ostringstream statestream;
-		joeserialize::BinaryOutputSerializer serialize_output(statestream);
-		car.Serialize(serialize_output);
 		stateframes.push_back(StateFrame(frame));
-		stateframes.back().SetBinaryStateData(statestream.str());
+		replaycodec::StateWriter serialize_output(stateframes.back().GetState());
+		car.Serialize(serialize_output);
 		stateframes.back().SetInputSnapshot(inputs);
 	}
 
 	frame++;
 }
 
-bool Replay::CarState::PlayFrame(CarDynamics & car)
+template <class Car>
+void Replay::CarState::PlayFrame(Car & car)
 {
 	frame++;
 
@@ -177,8 +397,18 @@ bool Replay::CarState::PlayFrame(CarDynamics & car)
 			ProcessPlayStateFrame(stateframes[cur_stateframe], car);
 		cur_stateframe++;
 	}
+}
+
+void Replay::CarState::Seek(unsigned keyframe)
+{
+	// the frame counter wraps around for keyframe 0, PlayFrame increments it first
+	frame = keyframe - 1;
 
-	return (cur_stateframe != stateframes.size() || cur_inputframe != inputframes.size());
+	// the input frame at keyframe is played, the snapshot overrides it
+	cur_inputframe = std::lower_bound(inputframes.begin(), inputframes.end(), keyframe,
+		[](const InputFrame & i, unsigned f) { return i.GetFrame() < f; }) - inputframes.begin();
+	cur_stateframe = std::lower_bound(stateframes.begin(), stateframes.end(), keyframe,
+		[](const StateFrame & s, unsigned f) { return s.GetFrame() < f; }) - stateframes.begin();
 }
 
 void Replay::CarState::ProcessPlayInputFrame(const InputFrame & frame)
@@ -190,7 +420,8 @@ void Replay::CarState::ProcessPlayInputFrame(const InputFrame & frame)
 	}
 }
 
-void Replay::CarState::ProcessPlayStateFrame(const StateFrame & frame, CarDynamics & car)
+template <class Car>
+void Replay::CarState::ProcessPlayStateFrame(const StateFrame & frame, Car & car)
 {
 	// process input snapshot
 	for (unsigned i = 0; i < inputbuffer.size() && i < frame.GetInputSnapshot().size(); i++)
@@ -198,12 +429,116 @@ void Replay::CarState::ProcessPlayStateFrame(const StateFrame & frame, CarDynami
 		inputbuffer[i] = frame.GetInputSnapshot()[i];
 	}
 
-	// process binary car state
-	std::istringstream statestream(frame.GetBinaryStateData());
-	joeserialize::BinaryInputSerializer serialize_input(statestream);
+	// process quantized car state
+	replaycodec::StateReader serialize_input(frame.GetState());
 	car.Serialize(serialize_input);
 }
 
+// Frame numbers are stored as differences to the previous frame, input
+// values exactly. Input snapshots and states are stored as differences to
+// the first state frame of the block.
+void Replay::CarState::WriteBlock(unsigned first_frame, std::string & out) const
+{
+	using namespace replaycodec;
+
+	WriteVarint(out, inputframes.size());
+	unsigned prev_frame = first_frame;
+	for (const auto & inputframe : inputframes)
+	{
+		WriteVarint(out, inputframe.GetFrame() - prev_frame);
+		WriteVarint(out, inputframe.GetNumInputs());
+		for (unsigned i = 0; i < inputframe.GetNumInputs(); i++)
+		{
+			WriteVarint(out, inputframe.GetInput(i).first);
+			WriteFloat(out, inputframe.GetInput(i).second);
+		}
+		prev_frame = inputframe.GetFrame();
+	}
+
+	WriteVarint(out, stateframes.size());
+	prev_frame = first_frame;
+	const std::vector<long long> nobase;
+	std::vector<long long> key_inputs, inputs;
+	for (size_t n = 0; n < stateframes.size(); ++n)
+	{
+		const StateFrame & stateframe = stateframes[n];
+		WriteVarint(out, stateframe.GetFrame() - prev_frame);
+		GetInputBits(stateframe.GetInputSnapshot(), inputs);
+		WriteValues(out, inputs, n > 0 ? key_inputs : nobase);
+		WriteValues(out, stateframe.GetState(), n > 0 ? stateframes[0].GetState() : nobase);
+		if (n == 0)
+			key_inputs.swap(inputs);
+		prev_frame = stateframe.GetFrame();
+	}
+}
+
+bool Replay::CarState::ReadBlock(unsigned first_frame, const char * & data, const char * end)
+{
+	using namespace replaycodec;
+
+	ClearFrames();
+
+	unsigned long long count, value;
+	if (!ReadVarint(data, end, count) || count > unsigned(end - data))
+		return false;
+
+	inputframes.reserve(count);
+	unsigned long long prev_frame = first_frame;
+	for (unsigned long long n = 0; n < count; ++n)
+	{
+		unsigned long long num_inputs;
+		if (!ReadVarint(data, end, value) || !ReadVarint(data, end, num_inputs))
+			return false;
+
+		prev_frame += value;
+		inputframes.push_back(InputFrame(unsigned(prev_frame)));
+		for (unsigned long long i = 0; i < num_inputs; ++i)
+		{
+			unsigned long long index;
+			float input;
+			if (!ReadVarint(data, end, index) || index >= CarInput::INVALID || !ReadFloat(data, end, input))
+				return false;
+			inputframes.back().AddInput(int(index), input);
+		}
+	}
+
+	if (!ReadVarint(data, end, count) || count > unsigned(end - data))
+		return false;
+
+	stateframes.reserve(count);
+	prev_frame = first_frame;
+	const std::vector<long long> nobase;
+	std::vector<long long> key_inputs, inputs;
+	std::vector<float> snapshot;
+	for (unsigned long long n = 0; n < count; ++n)
+	{
+		if (!ReadVarint(data, end, value))
+			return false;
+
+		prev_frame += value;
+		stateframes.push_back(StateFrame(unsigned(prev_frame)));
+		StateFrame & stateframe = stateframes.back();
+		if (!ReadValues(data, end, inputs, n > 0 ? key_inputs : nobase) ||
+			!ReadValues(data, end, stateframe.GetState(), n > 0 ? stateframes[0].GetState() : nobase))
+			return false;
+
+		SetInputBits(inputs, snapshot);
+		stateframe.SetInputSnapshot(snapshot);
+		if (n == 0)
+			key_inputs.swap(inputs);
+	}
+
+	return true;
+}
+
+void Replay::CarState::ClearFrames()
+{
+	inputframes.clear();
+	stateframes.clear();
+	cur_inputframe = 0;
+	cur_stateframe = 0;
+}
+
 void Replay::Save(std::ostream & outstream)
 {
 	// write the file format version data manually
@@ -214,8 +549,6 @@ void Replay::Save(std::ostream & outstream)
 
 	joeserialize::BinaryOutputSerializer serialize_output(outstream);
 	Serialize(serialize_output);
-
-	Reset();
 }
 
 bool Replay::Load(std::istream & instream, std::ostream & error_output)
@@ -342,19 +675,19 @@ Replay::StateFrame::StateFrame(unsigned newframe) :
 	// ctor
 }
 
-void Replay::StateFrame::SetBinaryStateData(const std::string & value)
+std::vector<long long> & Replay::StateFrame::GetState()
 {
-	binary_state_data = value;
+	return state;
 }
 
-unsigned Replay::StateFrame::GetFrame() const
+const std::vector<long long> & Replay::StateFrame::GetState() const
 {
-	return frame;
+	return state;
 }
 
-const std::string & Replay::StateFrame::GetBinaryStateData() const
+unsigned Replay::StateFrame::GetFrame() const
 {
-	return binary_state_data;
+	return frame;
 }
 
 const std::vector<float> & Replay::StateFrame::GetInputSnapshot() const
@@ -376,20 +709,217 @@ void Replay::CarState::Reset()
 {
 	inputbuffer.clear();
 	inputbuffer.resize(CarInput::INVALID, 0);
-	cur_inputframe = 0;
-	cur_stateframe = 0;
+	ClearFrames();
 	frame = 0;
 }
 
-/* FIXME
+// the game records and plays car dynamics
+template const std::vector<float> & Replay::PlayFrame(unsigned carid, CarDynamics & car);
+template void Replay::RecordFrame(unsigned carid, const std::vector <float> & inputs, CarDynamics & car);
+
+// car state stand-in, replays only need a serializable car
+struct ReplayTestCar
+{
+	double position = 0;
+	float rpm = 0;
+	int gear = -1;
+
+	ReplayTestCar() {}
+
+	ReplayTestCar(unsigned frame, unsigned carid) :
+		position(frame * 0.37 + carid * 100),
+		rpm(1000.0f + frame),
+		gear(frame / 100)
+	{
+		// ctor
+	}
+
+	template <class Serializer>
+	bool Serialize(Serializer & s)
+	{
+		_SERIALIZE_(s, position);
+		_SERIALIZE_(s, rpm);
+		_SERIALIZE_(s, gear);
+		return true;
+	}
+};
+
+static std::vector<float> ReplayTestInputs(unsigned frame, unsigned carid)
+{
+	std::vector<float> inputs(CarInput::INVALID, 0);
+	inputs[CarInput::THROTTLE] = (frame / 7 % 10) * 0.1f;
+	inputs[CarInput::BRAKE] = (frame % 13 == 0) ? 1.0f : 0.0f;
+	inputs[CarInput::STEER_LEFT] = carid * 0.25f;
+	return inputs;
+}
+
+static std::vector<CarInfo> ReplayTestCarInfo()
+{
+	std::vector<CarInfo> carinfo(2);
+	for (auto & info : carinfo)
+	{
+		info.ailevel = 0;
+	}
+	carinfo[0].name = "XS";
+	carinfo[1].name = "360";
+	return carinfo;
+}
+
+// record frames 0 to frame_count - 1 of two cars
+static void ReplayTestRecord(unsigned frame_count, const std::string & filename)
+{
+	Replay replay(0.01f);
+	replay.StartRecording(ReplayTestCarInfo(), "testtrack", filename + ".tmp", std::cerr);
+	for (unsigned frame = 0; frame < frame_count; ++frame)
+	{
+		for (unsigned carid = 0; carid < 2; ++carid)
+		{
+			ReplayTestCar car(frame, carid);
+			replay.RecordFrame(carid, ReplayTestInputs(frame, carid), car);
+		}
+	}
+	replay.StopRecording(filename);
+}
+
+// play frame of both cars, check inputs and the state restored at state frames
+static bool ReplayTestPlay(Replay & replay, unsigned frame)
+{
+	bool ok = true;
+	for (unsigned carid = 0; carid < 2; ++carid)
+	{
+		ReplayTestCar car;
+		const std::vector<float> inputs = replay.PlayFrame(carid, car);
+		const ReplayTestCar expected(frame, carid);
+		ok = ok && replay.GetPlaying() && inputs == ReplayTestInputs(frame, carid);
+		if (frame % Replay::state_interval == 0)
+		{
+			ok = ok &&
+				std::abs(car.position - expected.position) <= replaycodec::resolution &&
+				std::abs(car.rpm - expected.rpm) <= replaycodec::resolution &&
+				car.gear == expected.gear;
+		}
+		else
+		{
+			ok = ok && car.gear == -1;
+		}
+	}
+	return ok;
+}
+
+QT_TEST(replay_record_test)
+{
+	// record more than two blocks, the last one partial
+	const unsigned frame_count = 2 * Replay::block_frames + 75;
+	const std::string filename = "replay_record_test.vdr";
+	ReplayTestRecord(frame_count, filename);
+
+	Replay replay(0.01f);
+	QT_CHECK(replay.StartPlaying(filename, std::cerr));
+	QT_CHECK_EQUAL(replay.GetTrack(), "testtrack");
+	QT_CHECK_EQUAL(replay.GetCarInfo().size(), 2u);
+	QT_CHECK_EQUAL(replay.GetCarInfo()[1].name, "360");
+	QT_CHECK_EQUAL(replay.GetFrameCount(), frame_count);
+
+	// playback starts with frame 1, and stops after the last recorded frame
+	unsigned mismatches = 0;
+	for (unsigned frame = 1; frame < frame_count; ++frame)
+	{
+		if (!ReplayTestPlay(replay, frame))
+			mismatches++;
+	}
+	QT_CHECK_EQUAL(mismatches, 0u);
+	QT_CHECK(replay.GetPlaying());
+
+	ReplayTestCar car;
+	replay.PlayFrame(0, car);
+	QT_CHECK(!replay.GetPlaying());
+
+	// a stopped recording without file name is discarded
+	Replay discarded(0.01f);
+	discarded.StartRecording(ReplayTestCarInfo(), "testtrack", filename + ".tmp", std::cerr);
+	discarded.StopRecording("");
+	QT_CHECK(!std::ifstream((filename + ".tmp").c_str()));
+
+	std::remove(filename.c_str());
+}
+
+// seek to frame, check the chosen keyframe and play up to frame
+static bool ReplayTestSeek(Replay & replay, unsigned frame, unsigned expected_keyframe)
+{
+	unsigned keyframe = ~0u;
+	if (!replay.Seek(frame, keyframe) || keyframe != expected_keyframe)
+		return false;
+
+	bool ok = true;
+	for (unsigned f = keyframe; f <= frame; ++f)
+	{
+		ok = ok && ReplayTestPlay(replay, f);
+	}
+	return ok;
+}
+
 QT_TEST(replay_test)
 {
-	// basic version validity check
+	const unsigned frame_count = 2 * Replay::block_frames + 75;
+	const std::string filename = "replay_test.vdr";
+	ReplayTestRecord(frame_count, filename);
+
+	Replay replay(0.01f);
+	QT_CHECK(replay.StartPlaying(filename, std::cerr));
+	QT_CHECK_EQUAL(replay.GetFrameCount(), frame_count);
+
+	// frame 0, the car frame counters wrap around before the keyframe
+	QT_CHECK(ReplayTestSeek(replay, 0, 0));
+	QT_CHECK(ReplayTestPlay(replay, 1));
+
+	// block boundaries, the last frame of a block and the first of the next
+	QT_CHECK(ReplayTestSeek(replay, Replay::block_frames - 1, Replay::block_frames - Replay::state_interval));
+	QT_CHECK(ReplayTestPlay(replay, Replay::block_frames));
+	QT_CHECK(ReplayTestSeek(replay, Replay::block_frames, Replay::block_frames));
+	QT_CHECK(ReplayTestSeek(replay, 2 * Replay::block_frames, 2 * Replay::block_frames));
+
+	// mid block frames, forward and backward across blocks
+	QT_CHECK(ReplayTestSeek(replay, 345, 330));
+	QT_CHECK(ReplayTestSeek(replay, 17, 0));
+	QT_CHECK(ReplayTestSeek(replay, 631, 630));
+
+	// last frame, playback stops after it
+	QT_CHECK(ReplayTestSeek(replay, frame_count - 1, 660));
+	ReplayTestCar car;
+	replay.PlayFrame(0, car);
+	QT_CHECK(!replay.GetPlaying());
+
+	// past the end
+	unsigned keyframe = 0;
+	QT_CHECK(!replay.Seek(frame_count, keyframe));
+	QT_CHECK(!replay.Seek(frame_count + 1000, keyframe));
+
+	// seeking a stopped replay plays it again
+	QT_CHECK(ReplayTestSeek(replay, 100, 90));
+	QT_CHECK(replay.GetPlaying());
+
+	// a truncated last block is dropped, the complete ones play
+	std::string data;
 	{
-		REPLAY replay(0.004);
-		std::ostringstream teststream;
-		replay.Save(teststream);
-		QT_CHECK(replay.Load(teststream, std::cerr));
+		std::ifstream file(filename.c_str(), std::ios::binary);
+		data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
 	}
+	std::ofstream(filename.c_str(), std::ios::binary).write(data.data(), data.size() - 10);
+
+	Replay truncated(0.01f);
+	QT_CHECK(truncated.StartPlaying(filename, std::cerr));
+	QT_CHECK_EQUAL(truncated.GetFrameCount(), 2 * Replay::block_frames);
+	QT_CHECK(!truncated.Seek(2 * Replay::block_frames, keyframe));
+	QT_CHECK(ReplayTestSeek(truncated, 2 * Replay::block_frames - 1, 2 * Replay::block_frames - Replay::state_interval));
+	QT_CHECK(ReplayTestSeek(truncated, 0, 0));
+	truncated.Reset();
+
+	// a file without replay header fails to load
+	std::ofstream(filename.c_str(), std::ios::binary).write(data.data(), 10);
+	std::ostringstream error;
+	QT_CHECK(!truncated.StartPlaying(filename, error));
+	QT_CHECK(!truncated.GetPlaying());
+
+	replay.Reset();
+	std::remove(filename.c_str());
 }
-*/
@@ -23,15 +23,26 @@
 #include "carinfo.h"
 #include "macros.h"
 
-#include <iosfwd>
+#include <fstream>
 #include <string>
 #include <vector>
 
 class CarDynamics;
 
+/// Replays are streamed to and from disk in blocks of frames, so memory use
+/// does not grow with the replay length. A block holds the input changes and
+/// every state_interval-th car state of all cars. The first state of a block
+/// is a keyframe, the following ones are stored as differences to it.
+/// PlayFrame and RecordFrame are instantiated for CarDynamics.
 class Replay
 {
 public:
+	/// frames between car state snapshots
+	static const unsigned state_interval = 30;
+
+	/// frames per block, a multiple of state_interval
+	static const unsigned block_frames = 300;
+
 	Replay(float framerate);
 
 	/// true on success
@@ -45,22 +56,34 @@ public:
 	/// true if the replay system is currently playing
 	bool GetPlaying() const;
 
+	/// frames are written to tempfilename while recording
 	void StartRecording(
 		const std::vector<CarInfo> & carinfo,
 		const std::string & trackname,
+		const std::string & tempfilename,
 		std::ostream & error_log);
 
-	/// if replayfilename is empty, do not save the data
+	/// move recording to replayfilename, if it is empty, discard the recording
 	void StopRecording(const std::string & replayfilename);
 
 	/// true if the replay system is currently recording
 	bool GetRecording() const;
 
 	/// set car state, return car inputs
-	const std::vector<float> & PlayFrame(unsigned carid, CarDynamics & car);
+	template <class Car>
+	const std::vector<float> & PlayFrame(unsigned carid, Car & car);
+
+	/// Prepare playback to restore the last state frame at or before frame,
+	/// returned as keyframe, with the next PlayFrame. The caller has to play
+	/// frame - keyframe + 1 frames to reach frame. False if frame is out of range.
+	bool Seek(unsigned frame, unsigned & keyframe);
+
+	/// number of frames of the replay being played
+	unsigned GetFrameCount() const;
 
 	/// record car inputs and state
-	void RecordFrame(unsigned carid, const std::vector <float> & inputs, CarDynamics & car);
+	template <class Car>
+	void RecordFrame(unsigned carid, const std::vector <float> & inputs, Car & car);
 
 	template <class Serializer>
 	bool Serialize(Serializer & s);
@@ -99,9 +122,6 @@ private:
 
 		InputFrame(unsigned newframe);
 
-		template <class Serializer>
-		bool Serialize(Serializer & s);
-
 		void AddInput(int index, float value);
 
 		unsigned GetNumInputs() const;
@@ -123,32 +143,29 @@ private:
 
 		StateFrame(unsigned newframe);
 
-		template <class Serializer>
-		bool Serialize(Serializer & s);
+		/// quantized car state, see replaycodec::StateWriter
+		std::vector<long long> & GetState();
 
-		void SetBinaryStateData(const std::string & value);
+		const std::vector<long long> & GetState() const;
 
 		unsigned GetFrame() const;
 
-		const std::string & GetBinaryStateData() const;
-
 		const std::vector<float> & GetInputSnapshot() const;
 
 		void SetInputSnapshot(const std::vector<float>& value);
 
 	private:
 		unsigned frame;
-		std::string binary_state_data;
+		std::vector<long long> state;
 		std::vector<float> input_snapshot;
 	};
 
 	struct CarState
 	{
-		/// serialized
+		/// frames of the current block
 		std::vector<InputFrame> inputframes;
 		std::vector<StateFrame> stateframes;
 
-		/// not serialized
 		std::vector<float> inputbuffer; // buffer for input delta frame decoding
 		unsigned cur_inputframe;
 		unsigned cur_stateframe;
@@ -160,35 +177,70 @@ private:
 		/// reset state
 		void Reset();
 
-		/// write state into outstream
-		template <class Serializer>
-		bool Serialize(Serializer & s);
+		/// append frames of the block starting at first_frame to out
+		void WriteBlock(unsigned first_frame, std::string & out) const;
+
+		/// replace frames by the block starting at first_frame, false on corrupt data
+		bool ReadBlock(unsigned first_frame, const char * & data, const char * end);
+
+		/// clear frames of the current block
+		void ClearFrames();
 
-		/// set car, update inputbuffer, false if we are out of frames
-		bool PlayFrame(CarDynamics & car);
+		/// set car, update inputbuffer
+		template <class Car>
+		void PlayFrame(Car & car);
+
+		/// next PlayFrame plays keyframe, which has to be a state frame of the current block
+		void Seek(unsigned keyframe);
 
 		/// get car state, save input delta frame
-		void RecordFrame(const std::vector<float> & inputs, CarDynamics & car);
+		template <class Car>
+		void RecordFrame(const std::vector<float> & inputs, Car & car);
 
 		void ProcessPlayInputFrame(const InputFrame & frame);
 
-		void ProcessPlayStateFrame(const StateFrame & frame, CarDynamics & car);
+		template <class Car>
+		void ProcessPlayStateFrame(const StateFrame & frame, Car & car);
 	};
 
-	/// serialized
+	/// serialized header
 	Version version_info;
 	std::string track;
 	std::vector<CarInfo> carinfo;
-	std::vector<CarState> carstate;
+
+	/// block location in the replay file
+	struct BlockInfo
+	{
+		unsigned begin;
+		unsigned end;
+		std::streamoff offset;
+	};
 
 	/// not serialized
+	std::vector<CarState> carstate;
+	std::vector<BlockInfo> blocks;
+	std::ofstream outstream;
+	std::ifstream instream;
+	std::string tempfilename;
+	unsigned block_begin;
+	unsigned block_end;
+	unsigned cur_block;
 	enum {IDLE, RECORDING, PLAYING} replaymode;
 
-	/// load all input and state frames to the stream
+	/// load the header from the stream
 	bool Load(std::istream & instream, std::ostream & error_output);
 
-	/// save all input and state frames to the stream and then clear them
+	/// save the header to the stream
 	void Save(std::ostream & outstream);
+
+	/// write recorded frames as a block and clear them
+	void WriteBlock();
+
+	/// scan the block headers following the replay header into blocks
+	bool LoadBlockIndex(std::ostream & error_output);
+
+	/// load block, false if it is corrupt
+	bool ReadBlock(unsigned index);
 };
 
 // implementation
@@ -203,6 +255,11 @@ inline bool Replay::GetRecording() const
 	return (replaymode == RECORDING);
 }
 
+inline unsigned Replay::GetFrameCount() const
+{
+	return blocks.empty() ? 0 : blocks.back().end;
+}
+
 inline const std::vector<CarInfo> & Replay::GetCarInfo() const
 {
 	return carinfo;
@@ -213,31 +270,6 @@ inline const std::string & Replay::GetTrack() const
 	return track;
 }
 
-template <class Serializer>
-inline bool Replay::CarState::Serialize(Serializer & s)
-{
-	_SERIALIZE_(s, inputframes);
-	_SERIALIZE_(s, stateframes);
-	return true;
-}
-
-template <class Serializer>
-inline bool Replay::StateFrame::Serialize(Serializer & s)
-{
-	_SERIALIZE_(s, frame);
-	_SERIALIZE_(s, binary_state_data);
-	_SERIALIZE_(s, input_snapshot);
-	return true;
-}
-
-template <class Serializer>
-inline bool Replay::InputFrame::Serialize(Serializer & s)
-{
-	_SERIALIZE_(s, frame);
-	_SERIALIZE_(s, inputs);
-	return true;
-}
-
 template <class Serializer>
 inline bool Replay::Version::Serialize(Serializer & s)
 {
@@ -251,7 +283,6 @@ inline bool Replay::Serialize(Serializer & s)
 {
 	_SERIALIZE_(s, track);
 	_SERIALIZE_(s, carinfo);
-	_SERIALIZE_(s, carstate);
 	return true;
 }
 
@@ -0,0 +1,343 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+#include "replaycodec.h"
+#include "macros.h"
+#include "unittest.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace replaycodec
+{
+
+static long long Quantize(double value)
+{
+	// non finite and out of range values are not expected in car state,
+	// store them as zero, see max_value
+	const double q = value / resolution;
+	if (!(std::abs(q) <= max_value))
+		return 0;
+	return std::llround(q);
+}
+
+static unsigned long long ZigZag(long long value)
+{
+	return (static_cast<unsigned long long>(value) << 1) ^ static_cast<unsigned long long>(value >> 63);
+}
+
+static long long UnZigZag(unsigned long long value)
+{
+	return static_cast<long long>(value >> 1) ^ -static_cast<long long>(value & 1);
+}
+
+bool StateWriter::Serialize(const std::string & /*name*/, int & i)
+{
+	values.push_back(i);
+	return true;
+}
+
+bool StateWriter::Serialize(const std::string & /*name*/, unsigned int & i)
+{
+	values.push_back(i);
+	return true;
+}
+
+bool StateWriter::Serialize(const std::string & /*name*/, float & i)
+{
+	values.push_back(Quantize(i));
+	return true;
+}
+
+bool StateWriter::Serialize(const std::string & /*name*/, double & i)
+{
+	values.push_back(Quantize(i));
+	return true;
+}
+
+bool StateWriter::Serialize(const std::string & /*name*/, std::string & i)
+{
+	values.push_back(i.length());
+	for (char c : i)
+		values.push_back(c);
+	return true;
+}
+
+bool StateReader::Serialize(const std::string & /*name*/, int & i)
+{
+	if (next >= values.size())
+		return false;
+	i = int(values[next++]);
+	return true;
+}
+
+bool StateReader::Serialize(const std::string & /*name*/, unsigned int & i)
+{
+	if (next >= values.size())
+		return false;
+	i = unsigned(values[next++]);
+	return true;
+}
+
+bool StateReader::Serialize(const std::string & /*name*/, float & i)
+{
+	if (next >= values.size())
+		return false;
+	i = float(values[next++] * resolution);
+	return true;
+}
+
+bool StateReader::Serialize(const std::string & /*name*/, double & i)
+{
+	if (next >= values.size())
+		return false;
+	i = values[next++] * resolution;
+	return true;
+}
+
+bool StateReader::Serialize(const std::string & /*name*/, std::string & i)
+{
+	if (next >= values.size() || values[next] < 0 || size_t(values[next]) > values.size() - next - 1)
+		return false;
+	const size_t length = size_t(values[next++]);
+	i.resize(length);
+	for (size_t n = 0; n < length; ++n)
+		i[n] = char(values[next++]);
+	return true;
+}
+
+void WriteVarint(std::string & out, unsigned long long value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back(char((value & 0x7F) | 0x80));
+		value >>= 7;
+	}
+	out.push_back(char(value));
+}
+
+bool ReadVarint(const char * & data, const char * end, unsigned long long & value)
+{
+	value = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		if (data == end)
+			return false;
+		const unsigned char b = *data++;
+		value |= static_cast<unsigned long long>(b & 0x7F) << shift;
+		if (!(b & 0x80))
+			return true;
+	}
+	return false;
+}
+
+void WriteFloat(std::string & out, float value)
+{
+	unsigned int bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	for (int i = 0; i < 4; ++i)
+		out.push_back(char((bits >> (i * 8)) & 0xFF));
+}
+
+bool ReadFloat(const char * & data, const char * end, float & value)
+{
+	if (end - data < 4)
+		return false;
+	unsigned int bits = 0;
+	for (int i = 0; i < 4; ++i)
+		bits |= static_cast<unsigned int>(static_cast<unsigned char>(data[i])) << (i * 8);
+	std::memcpy(&value, &bits, sizeof(value));
+	data += 4;
+	return true;
+}
+
+// Differences are zigzag coded and shifted left by one, the low bit flags a
+// run of zero differences with the run length in the remaining bits. Values
+// are limited to max_value, so differences fit into 62 bits and the shift
+// keeps all of their bits.
+void WriteValues(std::string & out, const std::vector<long long> & values, const std::vector<long long> & base)
+{
+	WriteVarint(out, values.size());
+	for (size_t i = 0; i < values.size();)
+	{
+		size_t run = 0;
+		while (i + run < values.size() && values[i + run] == (i + run < base.size() ? base[i + run] : 0))
+			run++;
+
+		if (run > 0)
+		{
+			WriteVarint(out, ((run - 1) << 1) | 1);
+			i += run;
+			continue;
+		}
+
+		assert(std::abs(values[i]) <= max_value);
+		const long long delta = values[i] - (i < base.size() ? base[i] : 0);
+		WriteVarint(out, ZigZag(delta) << 1);
+		i++;
+	}
+}
+
+bool ReadValues(const char * & data, const char * end, std::vector<long long> & values, const std::vector<long long> & base)
+{
+	unsigned long long count;
+	if (!ReadVarint(data, end, count) || count > static_cast<unsigned long long>(end - data) * 64)
+		return false;
+
+	values.resize(count);
+	for (size_t i = 0; i < count;)
+	{
+		unsigned long long code;
+		if (!ReadVarint(data, end, code))
+			return false;
+
+		if (code & 1)
+		{
+			const unsigned long long run = (code >> 1) + 1;
+			if (run > count - i)
+				return false;
+			for (size_t n = 0; n < run; ++n, ++i)
+				values[i] = (i < base.size() ? base[i] : 0);
+			continue;
+		}
+
+		values[i] = (i < base.size() ? base[i] : 0) + UnZigZag(code >> 1);
+		i++;
+	}
+	return true;
+}
+
+}
+
+struct ReplayCodecTestState
+{
+	int gear = 3;
+	unsigned count = 7;
+	bool flag = true;
+	float rpm = 6543.21f;
+	double position[3] = {-1234.56789, 0.001, 42.0};
+	std::string name = "test";
+
+	template <class Serializer>
+	bool Serialize(Serializer & s)
+	{
+		_SERIALIZE_(s, gear);
+		_SERIALIZE_(s, count);
+		_SERIALIZE_(s, flag);
+		_SERIALIZE_(s, rpm);
+		_SERIALIZE_(s, position[0]);
+		_SERIALIZE_(s, position[1]);
+		_SERIALIZE_(s, position[2]);
+		_SERIALIZE_(s, name);
+		return true;
+	}
+};
+
+QT_TEST(replaycodec_test)
+{
+	using namespace replaycodec;
+
+	// varints and floats
+	std::string buffer;
+	const unsigned long long numbers[] = {0, 1, 127, 128, 300, 1ull << 40, ~0ull};
+	for (auto n : numbers)
+		WriteVarint(buffer, n);
+	WriteFloat(buffer, -0.125f);
+	const char * data = buffer.data();
+	const char * end = data + buffer.size();
+	for (auto n : numbers)
+	{
+		unsigned long long value;
+		QT_CHECK(ReadVarint(data, end, value));
+		QT_CHECK_EQUAL(value, n);
+	}
+	float f;
+	QT_CHECK(ReadFloat(data, end, f));
+	QT_CHECK_EQUAL(f, -0.125f);
+	QT_CHECK(data == end);
+	QT_CHECK(!ReadFloat(data, end, f));
+
+	// state round trip, floating point values within resolution
+	ReplayCodecTestState a;
+	std::vector<long long> key;
+	StateWriter writer(key);
+	QT_CHECK(a.Serialize(writer));
+
+	ReplayCodecTestState b;
+	b.gear = 0; b.count = 0; b.flag = false; b.rpm = 0; b.name.clear();
+	b.position[0] = b.position[1] = b.position[2] = 0;
+	StateReader reader(key);
+	QT_CHECK(b.Serialize(reader));
+	QT_CHECK(reader.Done());
+	QT_CHECK_EQUAL(b.gear, 3);
+	QT_CHECK_EQUAL(b.count, 7u);
+	QT_CHECK(b.flag);
+	QT_CHECK_CLOSE(b.rpm, a.rpm, resolution);
+	QT_CHECK_CLOSE(b.position[0], a.position[0], resolution);
+	QT_CHECK_CLOSE(b.position[1], a.position[1], resolution);
+	QT_CHECK_EQUAL(b.name, "test");
+
+	// truncated state fails
+	std::vector<long long> truncated(key.begin(), key.begin() + 3);
+	StateReader short_reader(truncated);
+	QT_CHECK(!b.Serialize(short_reader));
+
+	// delta coding against a key state, unchanged values collapse into runs
+	a.rpm += 10;
+	a.position[0] += 0.5;
+	std::vector<long long> state;
+	StateWriter delta_writer(state);
+	QT_CHECK(a.Serialize(delta_writer));
+
+	std::string coded, coded_key;
+	WriteValues(coded_key, key, std::vector<long long>());
+	WriteValues(coded, state, key);
+	QT_CHECK(coded.size() < 16);
+	QT_CHECK(coded.size() < coded_key.size());
+
+	std::vector<long long> decoded;
+	data = coded.data();
+	QT_CHECK(ReadValues(data, coded.data() + coded.size(), decoded, key));
+	QT_CHECK(decoded == state);
+
+	decoded.clear();
+	data = coded_key.data();
+	QT_CHECK(ReadValues(data, coded_key.data() + coded_key.size(), decoded, std::vector<long long>()));
+	QT_CHECK(decoded == key);
+
+	// largest values and differences round trip, larger values are stored as zero
+	const std::vector<long long> limits = {max_value, -max_value, max_value, 0};
+	const std::vector<long long> limits_base = {-max_value, max_value, 0, max_value};
+	std::string coded_limits;
+	WriteValues(coded_limits, limits, limits_base);
+	data = coded_limits.data();
+	QT_CHECK(ReadValues(data, coded_limits.data() + coded_limits.size(), decoded, limits_base));
+	QT_CHECK(decoded == limits);
+
+	float huge = 1E30f;
+	std::vector<long long> huge_state;
+	StateWriter huge_writer(huge_state);
+	QT_CHECK(huge_writer.Serialize("huge", huge));
+	QT_CHECK_EQUAL(huge_state[0], 0);
+
+	// corrupt data fails
+	data = coded.data();
+	QT_CHECK(!ReadValues(data, coded.data() + coded.size() - 1, decoded, key));
+}
@@ -0,0 +1,95 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+#ifndef _REPLAYCODEC_H
+#define _REPLAYCODEC_H
+
+#include "joeserialize.h"
+
+#include <string>
+#include <vector>
+
+/// Compact coding of replay data. Serialized object state is flattened into
+/// integers, floating point values quantized. Value vectors are written as
+/// differences to a base vector, variable length coded with zero runs
+/// collapsed, so unchanged and slowly changing state takes a few bytes.
+namespace replaycodec
+{
+	/// resolution of quantized floating point state values
+	const double resolution = 1.0 / 65536;
+
+	/// largest magnitude of stored values, floating point state up to about 1.7E13
+	const long long max_value = (1LL << 60) - 1;
+
+	/// Stores the leaves of a serialized object. Floating point values in
+	/// units of resolution, integers, bools and string characters exactly.
+	class StateWriter : public joeserialize::SerializerOutput
+	{
+	public:
+		StateWriter(std::vector<long long> & values) : values(values) {}
+
+		using Serializer::Serialize;
+
+		virtual bool Serialize(const std::string & name, int & i);
+		virtual bool Serialize(const std::string & name, unsigned int & i);
+		virtual bool Serialize(const std::string & name, float & i);
+		virtual bool Serialize(const std::string & name, double & i);
+		virtual bool Serialize(const std::string & name, std::string & i);
+
+	private:
+		std::vector<long long> & values;
+	};
+
+	/// Restores leaves stored by StateWriter, fails if they run out.
+	class StateReader : public joeserialize::SerializerInput
+	{
+	public:
+		StateReader(const std::vector<long long> & values) : values(values), next(0) {}
+
+		using Serializer::Serialize;
+
+		virtual bool Serialize(const std::string & name, int & i);
+		virtual bool Serialize(const std::string & name, unsigned int & i);
+		virtual bool Serialize(const std::string & name, float & i);
+		virtual bool Serialize(const std::string & name, double & i);
+		virtual bool Serialize(const std::string & name, std::string & i);
+
+		/// true if all values have been read
+		bool Done() const { return next == values.size(); }
+
+	private:
+		const std::vector<long long> & values;
+		size_t next;
+	};
+
+	void WriteVarint(std::string & out, unsigned long long value);
+
+	bool ReadVarint(const char * & data, const char * end, unsigned long long & value);
+
+	/// little endian ieee bits, exact
+	void WriteFloat(std::string & out, float value);
+
+	bool ReadFloat(const char * & data, const char * end, float & value);
+
+	/// Write count and values as differences to base, missing base values are zero.
+	void WriteValues(std::string & out, const std::vector<long long> & values, const std::vector<long long> & base);
+
+	bool ReadValues(const char * & data, const char * end, std::vector<long long> & values, const std::vector<long long> & base);
+}
+
+#endif // _REPLAYCODEC_H
@@ -124,11 +124,24 @@ bool RoadStrip::Collide(
 		}
 	}
 
+	// short wheel rays only overlap a few patches
+	const unsigned capacity = 32;
+	unsigned buffer[capacity];
+	const unsigned * candidates = buffer;
+	const Aabb<float>::Ray ray(origin, direction, seglen);
+	const unsigned count = aabb_part.Query(ray, buffer, capacity);
+	if (count > capacity)
+	{
+		static thread_local std::vector<unsigned> candidate_list;
+		candidate_list.clear();
+		aabb_part.Query(ray, candidate_list);
+		candidates = candidate_list.data();
+	}
+
 	bool col = false;
-	std::vector<int> candidates;
-	aabb_part.Query(Aabb<float>::Ray(origin, direction, seglen), candidates);
-	for (int candidate : candidates)
+	for (unsigned i = 0; i < count; ++i)
 	{
+		const unsigned candidate = candidates[i];
 		Vec3 coltri, colnorm;
 		if (patches[candidate].Collide(origin, direction, seglen, coltri, colnorm))
 		{
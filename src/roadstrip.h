@@ -21,7 +21,7 @@
 #define _ROADSTRIP_H
 
 #include "roadpatch.h"
-#include "aabbtree.h"
+#include "aabbbvh.h"
 
 #include <iosfwd>
 #include <vector>
@@ -62,7 +62,7 @@ public:
 
 private:
 	std::vector<RoadPatch> patches;
-	AabbTreeNode <unsigned> aabb_part;
+	AabbBvh <unsigned> aabb_part;
 	bool closed;
 
 	void GenerateSpacePartitioning();
@@ -76,6 +76,7 @@ Settings::Settings() :
 	selected_replay("none"),
 	texture_size("large"),
 	texture_compress(true),
+	texture_cache(true),
 	button_ramp(5),
 	ff_device("/dev/input/event0"),
 	ff_gain(1.0),
@@ -108,6 +109,7 @@ Settings::Settings() :
 	hgateshifter(false),
 	ai_level(1.0),
 	vehicle_damage(false),
+	tire_lut(false),
 	particles(512),
 	skidmarks(1024),
 	sky_time(17),
@@ -136,6 +138,7 @@ void Settings::Serialize(bool write, Config & config)
 
 	config.get("game", section);
 	Param(config, write, section, "vehicle_damage", vehicle_damage);
+	Param(config, write, section, "tire_lut", tire_lut);
 	Param(config, write, section, "ai_level", ai_level);
 	Param(config, write, section, "track", track);
 	Param(config, write, section, "antilock", abs);
@@ -177,6 +180,7 @@ void Settings::Serialize(bool write, Config & config)
 	Param(config, write, section, "racingline", racingline);
 	Param(config, write, section, "texture_size", texture_size);
 	Param(config, write, section, "texture_compress", texture_compress);
+	Param(config, write, section, "texture_cache", texture_cache);
 	Param(config, write, section, "shadows", shadows);
 	Param(config, write, section, "shadow_distance", shadow_distance);
 	Param(config, write, section, "shadow_quality", shadow_quality);
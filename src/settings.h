@@ -238,6 +238,11 @@ public:
 		return texture_compress;
 	}
 
+	bool GetTextureCache() const
+	{
+		return texture_cache;
+	}
+
 	float GetButtonRamp() const
 	{
 		return button_ramp;
@@ -403,12 +408,22 @@ public:
 		return vehicle_damage;
 	}
 
+	bool GetTireLUT() const
+	{
+		return tire_lut;
+	}
+
 	void SetResolution(unsigned w, unsigned h)
 	{
 		resolution[0] = w;
 		resolution[1] = h;
 	}
 
+	void SetTrack(const std::string & value)
+	{
+		track = value;
+	}
+
 	void SetSelectedReplay ( const std::string & value )
 	{
 		selected_replay = value;
@@ -463,6 +478,7 @@ private:
 	std::string selected_replay;
 	std::string texture_size;
 	bool texture_compress;
+	bool texture_cache;
 	float button_ramp;
 	std::string ff_device;
 	float ff_gain;
@@ -495,6 +511,7 @@ private:
 	bool hgateshifter;
 	float ai_level;
 	bool vehicle_damage;
+	bool tire_lut;
 	int particles;
 	int skidmarks;
 	int sky_time;
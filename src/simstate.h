@@ -0,0 +1,78 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+#ifndef _SIMSTATE_H
+#define _SIMSTATE_H
+
+#include "mathvector.h"
+#include "quaternion.h"
+
+#include <vector>
+
+class Camera;
+
+/// Transforms of the simulated objects after a tick, as far as rendering needs them.
+struct SimState
+{
+	struct Body
+	{
+		Vec3 position;
+		Quat orientation;
+	};
+
+	std::vector<Body> bodies; ///< bodies of all cars
+	std::vector<unsigned> cars; ///< first body of each car
+
+	const Camera * camera = 0; ///< active camera, null if none
+	Vec3 camera_position;
+	Quat camera_orientation;
+	float camera_fov = 0; ///< 0 for the default field of view
+	Vec3 reflection_location; ///< center of the camera car
+
+	/// number of bodies of car i
+	unsigned GetBodyCount(unsigned i) const
+	{
+		return (i + 1 < cars.size() ? cars[i + 1] : bodies.size()) - cars[i];
+	}
+};
+
+/// States of the last two ticks of a batch of simulation ticks. Rendering
+/// interpolates between them so that motion is smooth at any frame rate.
+struct SimSnapshot
+{
+	SimState prev;
+	SimState cur;
+
+	/// true if prev and cur describe the same objects
+	bool Interpolatable() const
+	{
+		return prev.cars == cur.cars && prev.bodies.size() == cur.bodies.size();
+	}
+
+	static Vec3 Interpolate(const Vec3 & a, const Vec3 & b, float t)
+	{
+		return a + (b - a) * t;
+	}
+
+	static Quat Interpolate(const Quat & a, const Quat & b, float t)
+	{
+		return a.QuatSlerp(b, t);
+	}
+};
+
+#endif // _SIMSTATE_H
@@ -21,8 +21,12 @@
 #include "content/contentmanager.h"
 #include "graphics/texture.h"
 #include "conecull.h"
+#include "microbench.h"
+#include "unittest.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 
 static inline keyed_container<Drawable> & GetDrawList(SceneNode & node)
 {
@@ -43,24 +47,18 @@ void SkidMarks::Load(
 	TextureInfo texinfo;
 	texinfo.anisotropy = anisotropy;
 	content.load(texture, texpath, texname, texinfo);
-
-	draw = GetDrawList(node).insert(Drawable());
-	Drawable & drawref = GetDrawable(node, draw);
-	drawref.SetAlpha(0.5f);
-	drawref.SetDrawEnable(false);
-	drawref.SetVertArray(&varray);
-	drawref.SetTextures(texture->GetId());
-	drawref.SetDecal(true);
-	drawref.SetCull(false);
 }
 
 void SkidMarks::Clear()
 {
+	for (auto & c : chunks)
+		GetDrawList(node).erase(c.draw);
+	chunks.clear();
 	marks.clear();
 	emitters.clear();
 	max_marks = 0;
-	first_mark = 0;
 	next_mark = 0;
+	visible_chunks = 0;
 }
 
 void SkidMarks::Reset(int anum_emitters, int amax_marks)
@@ -70,6 +68,21 @@ void SkidMarks::Reset(int anum_emitters, int amax_marks)
 	marks.resize(amax_marks);
 	emitters.resize(anum_emitters);
 	max_marks = amax_marks;
+
+	// drawables reference the chunk vertex arrays, chunks are not resized until next reset
+	chunks.resize((amax_marks + chunk_size - 1) / chunk_size);
+	for (auto & c : chunks)
+	{
+		c.draw = GetDrawList(node).insert(Drawable());
+		Drawable & drawref = GetDrawable(node, c.draw);
+		drawref.SetAlpha(0.5f);
+		drawref.SetDrawEnable(false);
+		drawref.SetVertArray(&c.varray);
+		if (texture)
+			drawref.SetTextures(texture->GetId());
+		drawref.SetDecal(true);
+		drawref.SetCull(false);
+	}
 }
 
 inline float BoundingRadius(Vec3 corners[4], Vec3 center)
@@ -98,11 +111,12 @@ void SkidMarks::UpdateEmitter(int id, float intensity, Vec3 corner_left, Vec3 co
 		auto & m = marks[e.markid];
 		if (e.energy < min_emission_energy && m.radius < 1E-6f)
 		{
-			// reset mark
+			// reset mark, not drawn until it has a length
 			//dlog << "reset "<< id << " " << e.markid << " " << e.energy << std::endl;
 			m.corners[0] = corner_left;
 			m.corners[1] = corner_right;
 			m.fade = 1;
+			Touch(e.markid);
 			return;
 		}
 
@@ -114,6 +128,7 @@ void SkidMarks::UpdateEmitter(int id, float intensity, Vec3 corner_left, Vec3 co
 		Vec3 center1 = (m.corners[2] + m.corners[3]) * 0.5f;
 		m.center = (center0 + center1) * 0.5f;
 		m.radius = BoundingRadius(m.corners, m.center);
+		Touch(e.markid);
 
 		// check mark length
 		float cs = (center0 - center1).MagnitudeSquared();
@@ -148,16 +163,17 @@ void SkidMarks::UpdateEmitter(int id, float intensity, Vec3 corner_left, Vec3 co
 	//dlog << "start " << id << " " << e.markid << std::endl;
 }
 
+// write mark quad in SetToQuads vertex order, degenerate if mark has no length yet
 template <typename Mark>
-inline void ProccessMark(Cone & c, Mark & m, VertexArray & v)
+inline void WriteQuad(const Mark & m, float verts[12], float uvs[8])
 {
-	//dlog << "mark " << m.radius << std::endl;
-	if (m.radius <= 0 || c.cull(m.center, m.radius))
+	if (m.radius <= 0)
+	{
+		std::fill(verts, verts + 12, 0.0f);
+		std::fill(uvs, uvs + 8, 0.0f);
 		return;
-/*
-	unsigned char a1 = 255;//(1 - m.intensity[0]) * 255;
-	unsigned char a2 = 255;//(1 - m.intensity[1]) * 255;
-*/
+	}
+
 	float v0, v1;
 	if (m.fade > 0)
 	{
@@ -175,31 +191,52 @@ inline void ProccessMark(Cone & c, Mark & m, VertexArray & v)
 		v1 = 0.5f;
 	}
 
-	const unsigned int faces[6] = {
-		0, 1, 2,
-		2, 1, 3,
-	};
-	const float uvs[8] = {
-		0.0f, v0,
-		1.0f, v0,
-		0.0f, v1,
-		1.0f, v1,
-	};
-	const float verts[12] = {
-		m.corners[0][0], m.corners[0][1], m.corners[0][2],
-		m.corners[1][0], m.corners[1][1], m.corners[1][2],
-		m.corners[2][0], m.corners[2][1], m.corners[2][2],
-		m.corners[3][0], m.corners[3][1], m.corners[3][2],
-	};
-/*
-	const unsigned char cols[16] = {
-		255, 255, 255, a1,
-		255, 255, 255, a1,
-		255, 255, 255, a2,
-		255, 255, 255, a2,
-	};
-*/
-	v.Add(faces, 6, verts, 12, uvs, 8);//0, 0, cols, 16);
+	const int order[4] = {0, 1, 3, 2};
+	const float u[4] = {0.0f, 1.0f, 1.0f, 0.0f};
+	const float v[4] = {v0, v0, v1, v1};
+	for (int i = 0; i < 4; ++i)
+	{
+		const Vec3 & c = m.corners[order[i]];
+		verts[i * 3 + 0] = c[0];
+		verts[i * 3 + 1] = c[1];
+		verts[i * 3 + 2] = c[2];
+		uvs[i * 2 + 0] = u[i];
+		uvs[i * 2 + 1] = v[i];
+	}
+}
+
+void SkidMarks::UpdateChunk(int chunkid)
+{
+	Chunk & c = chunks[chunkid];
+	const int first = chunkid * chunk_size;
+	const int count = std::min(chunk_size, max_marks - first);
+
+	float * verts, * uvs;
+	c.varray.SetToQuads(count, verts, uvs);
+
+	Vec3 bmin(1E9f, 1E9f, 1E9f), bmax(-1E9f, -1E9f, -1E9f);
+	c.live_marks = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		Mark & m = marks[first + i];
+		if (m.dirty)
+		{
+			WriteQuad(m, verts + i * 12, uvs + i * 8);
+			m.dirty = false;
+		}
+		if (m.radius > 0)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				bmin[k] = std::min(bmin[k], m.center[k] - m.radius);
+				bmax[k] = std::max(bmax[k], m.center[k] + m.radius);
+			}
+			c.live_marks++;
+		}
+	}
+	c.center = (bmin + bmax) * 0.5f;
+	c.radius = (bmax - bmin).Magnitude() * 0.5f;
+	c.dirty = false;
 }
 
 void SkidMarks::UpdateGraphics(
@@ -208,28 +245,19 @@ void SkidMarks::UpdateGraphics(
 	float znear, float zfar,
 	float sinfovh)
 {
-	if (first_mark == next_mark)
-	{
-		GetDrawable(node, draw).SetDrawEnable(false);
-		return;
-	}
-
-	varray.Clear();
+	visible_chunks = 0;
 	Cone cone(campos, camdir.AxisY(), sinfovh);
-	if (first_mark < next_mark)
-	{
-		for (int i = first_mark; i < next_mark; ++i)
-			ProccessMark(cone, marks[i], varray);
-	}
-	else
+	for (int i = 0; i < int(chunks.size()); ++i)
 	{
-		for (int i = 0; i < next_mark; ++i)
-			ProccessMark(cone, marks[i], varray);
-		for (int i = first_mark; i < max_marks; ++i)
-			ProccessMark(cone, marks[i], varray);
+		Chunk & c = chunks[i];
+		if (c.dirty)
+			UpdateChunk(i);
+
+		// culled chunks are neither drawn nor uploaded
+		const bool visible = c.live_marks > 0 && !cone.cull(c.center, c.radius);
+		GetDrawable(node, c.draw).SetDrawEnable(visible);
+		visible_chunks += visible;
 	}
-	GetDrawable(node, draw).SetDrawEnable(varray.GetNumVertices() > 0);
-	//dlog << first_mark << " " << next_mark << " verts " << varray.GetNumVertices() << std::endl;
 }
 
 void SkidMarks::NewMark(Emitter & e, float energy)
@@ -238,10 +266,112 @@ void SkidMarks::NewMark(Emitter & e, float energy)
 	e.energy = energy;
 	marks[next_mark].radius = 0;
 	marks[next_mark].fade = 1;
+	Touch(next_mark);
 
-	// advance used marks range pointers
+	// advance ring pointer, oldest mark is overwritten next
 	next_mark++;
 	if (next_mark == max_marks) next_mark = 0;
-	if (next_mark == first_mark) first_mark++;
-	if (first_mark == max_marks) first_mark = 0;
+}
+
+void SkidMarks::Touch(int markid)
+{
+	marks[markid].dirty = true;
+	chunks[markid / chunk_size].dirty = true;
+}
+
+// skid marks along the y axis, one mark per step
+static void EmitMarks(SkidMarks & s, int emitters, int steps, int & step)
+{
+	for (int n = 0; n < steps; ++n, ++step)
+	{
+		for (int e = 0; e < emitters; ++e)
+		{
+			const float x = e * 4.0f, y = step * 0.25f;
+			s.UpdateEmitter(e, 10, Vec3(x - 1, y, 0), Vec3(x + 1, y, 0));
+		}
+	}
+}
+
+// vertex arrays of enabled chunks
+static std::vector<const VertexArray *> GetVisible(SceneNode & node)
+{
+	std::vector<const VertexArray *> result;
+	for (const auto & d : GetDrawList(node))
+	{
+		if (d.GetDrawEnable())
+			result.push_back(d.GetVertArray());
+	}
+	return result;
+}
+
+QT_TEST(skidmarks_test)
+{
+	SkidMarks s;
+	const Quat camdir; // looking along y
+	const float sinfovh = 0.5f;
+
+	s.Reset(1, 200);
+	s.UpdateGraphics(camdir, Vec3(0, -10, 0), 0.1f, 1000, sinfovh);
+	QT_CHECK_EQUAL(s.NumVisibleChunks(), 0);
+
+	// ring wraps, the newest mark has no length yet
+	int step = 0;
+	for (int frame = 0; frame < 100; ++frame)
+	{
+		EmitMarks(s, 1, 7, step);
+		s.UpdateGraphics(camdir, Vec3(0, -10, 0), 0.1f, 1000, sinfovh);
+	}
+	QT_CHECK_EQUAL(s.NumVisibleChunks(), 4);
+
+	int live = 0;
+	float ymin = 1E9f, ymax = -1E9f;
+	for (const VertexArray * va : GetVisible(s.GetNode()))
+	{
+		const float * v;
+		unsigned n;
+		va->GetVertices(v, n);
+		for (unsigned i = 0; i < n; i += 12)
+		{
+			if (v[i + 1] == 0 && v[i + 7] == 0)
+				continue;
+			// quad spans one step
+			QT_CHECK_CLOSE(v[i + 7] - v[i + 1], 0.25f, 1E-4f);
+			QT_CHECK_EQUAL(v[i + 0], -1.0f);
+			QT_CHECK_EQUAL(v[i + 3], 1.0f);
+			ymin = std::min(ymin, v[i + 1]);
+			ymax = std::max(ymax, v[i + 7]);
+			live++;
+		}
+	}
+	QT_CHECK_EQUAL(live, 199);
+	QT_CHECK_CLOSE(ymax, (step - 1) * 0.25f, 1E-3f);
+	QT_CHECK_CLOSE(ymin, (step - 200) * 0.25f, 1E-3f);
+
+	// marks beside the view cone are culled
+	s.UpdateGraphics(camdir, Vec3(1000, step * 0.25f, 0), 0.1f, 1000, sinfovh);
+	QT_CHECK_EQUAL(s.NumVisibleChunks(), 0);
+
+	// only chunks inside the view cone are drawn
+	s.UpdateGraphics(camdir, Vec3(20, (step - 100) * 0.25f, 0), 0.1f, 1000, sinfovh);
+	QT_CHECK(s.NumVisibleChunks() > 0 && s.NumVisibleChunks() < 4);
+
+	s.Clear();
+	QT_CHECK_EQUAL(GetDrawList(s.GetNode()).size(), 0);
+}
+
+MB_BENCHMARK(skidmarks_benchmark)
+{
+	const int emitters = 16;
+	SkidMarks s;
+	s.Reset(emitters, 16384);
+	int step = 0;
+	EmitMarks(s, emitters, 16384 / emitters, step);
+
+	const Quat camdir;
+	auto frame = [&]
+	{
+		EmitMarks(s, emitters, 1, step);
+		s.UpdateGraphics(camdir, Vec3(0, step * 0.25f - 50, 0), 0.1f, 1000, 0.5f);
+	};
+	out << "skid marks frame, 16 emitters, 16384 marks: " << microbench::measure(frame) << " ns" << std::endl;
 }
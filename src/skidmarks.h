@@ -32,9 +32,14 @@
 class ContentManager;
 class Texture;
 
+/// Skid marks stored in a fixed size ring of marks. The ring is split into
+/// chunks of chunk_size marks, each with its own vertex array and drawable.
+/// Only quads of changed marks are rewritten, culling is done per chunk.
 class SkidMarks
 {
 public:
+	static const int chunk_size = 64;
+
 	/// Load texture
 	void Load(
 		const std::string & texpath,
@@ -54,6 +59,9 @@ public:
 		float znear, float zfar,
 		float sinfovh);
 
+	/// number of chunks enabled for drawing by the last UpdateGraphics
+	int NumVisibleChunks() const { return visible_chunks; }
+
 	SceneNode & GetNode() { return node; }
 
 private:
@@ -61,29 +69,44 @@ private:
 	{
 		Vec3 corners[4];
 		Vec3 center;
-		float radius;
-		float fade;
+		float radius = 0;
+		float fade = 0;
+		bool dirty = false;
 	};
 	struct Emitter
 	{
 		float energy = 0;
 		int markid = -1;
 	};
+	struct Chunk
+	{
+		VertexArray varray;
+		SceneNode::DrawableHandle draw;
+		Vec3 center;
+		float radius = 0;
+		int live_marks = 0;
+		bool dirty = false;
+	};
 	std::vector<Mark> marks;
 	std::vector<Emitter> emitters;
+	std::vector<Chunk> chunks;
 
-	SceneNode::DrawableHandle draw;
 	std::shared_ptr<Texture> texture;
-	VertexArray varray;
 	SceneNode node;
 
-	int first_mark = 0;
 	int next_mark = 0;
 	int max_marks = 0;
+	int visible_chunks = 0;
 	float max_mark_length_sq = (0.2f * 0.2f);
 	float min_emission_energy = 5.0f;
 
 	void NewMark(Emitter & e, float energy = 0);
+
+	/// flag mark quad for rewrite
+	void Touch(int markid);
+
+	/// rewrite dirty mark quads, update bounds
+	void UpdateChunk(int chunkid);
 };
 
 #endif // _SKIDMARKS_H
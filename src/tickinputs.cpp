@@ -0,0 +1,131 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+#include "tickinputs.h"
+#include "unittest.h"
+
+#include <algorithm>
+
+TickInputs::TickInputs() :
+	inputs(GameInput::INVALID, 0.0f),
+	oneshot(GameInput::INVALID, false)
+{
+	// ctor
+}
+
+void TickInputs::Sample(const std::vector<float> & sample, const std::vector<bool> & sample_oneshot)
+{
+	assert(sample.size() == inputs.size());
+	assert(sample_oneshot.size() == inputs.size());
+
+	oneshot = sample_oneshot;
+	for (size_t i = 0; i < inputs.size(); ++i)
+	{
+		if (oneshot[i])
+			inputs[i] = std::max(inputs[i], sample[i]);
+		else
+			inputs[i] = sample[i];
+	}
+}
+
+void TickInputs::Take(TickInputs & other)
+{
+	Sample(other.inputs, other.oneshot);
+	other.Consume();
+}
+
+void TickInputs::Consume()
+{
+	for (size_t i = 0; i < inputs.size(); ++i)
+	{
+		if (oneshot[i])
+			inputs[i] = 0;
+	}
+}
+
+// run a frame of ticks, returns the number of ticks that saw the input
+static int RunTicks(TickInputs & latch, unsigned ticks, GameInput::Enum input, std::vector<float> & values)
+{
+	int count = 0;
+	for (unsigned i = 0; i < ticks; ++i)
+	{
+		values.push_back(latch.GetInput(input));
+		count += latch.GetInput(input) > 0;
+		latch.Consume();
+	}
+	return count;
+}
+
+QT_TEST(tickinputs_test)
+{
+	std::vector<bool> oneshot(GameInput::INVALID, false);
+	oneshot[CarInput::SHIFT_UP] = true;
+	oneshot[GameInput::VIEW_NEXT] = true;
+
+	std::vector<float> pressed(GameInput::INVALID, 0.0f);
+	pressed[CarInput::SHIFT_UP] = 1;
+	pressed[GameInput::VIEW_NEXT] = 1;
+	pressed[CarInput::THROTTLE] = 0.5f;
+
+	std::vector<float> released(GameInput::INVALID, 0.0f);
+	released[CarInput::THROTTLE] = 0.25f;
+
+	// two ticks in a frame, the impulse fires once, the axis holds its sample
+	{
+		TickInputs latch;
+		std::vector<float> throttle;
+		latch.Sample(pressed, oneshot);
+		QT_CHECK_EQUAL(RunTicks(latch, 2, GameInput::Enum(CarInput::SHIFT_UP), throttle), 1);
+		latch.Sample(pressed, oneshot);
+		QT_CHECK_EQUAL(RunTicks(latch, 2, GameInput::VIEW_NEXT, throttle), 1);
+		latch.Sample(released, oneshot);
+		QT_CHECK_EQUAL(RunTicks(latch, 2, GameInput::Enum(CarInput::THROTTLE), throttle), 2);
+		QT_CHECK_EQUAL(throttle.size(), 6u);
+		QT_CHECK_EQUAL(throttle[4], 0.25f);
+		QT_CHECK_EQUAL(throttle[5], 0.25f);
+	}
+
+	// no tick in the frame of the impulse, the next frame's first tick sees it
+	{
+		TickInputs latch;
+		std::vector<float> values;
+		latch.Sample(pressed, oneshot);
+		QT_CHECK_EQUAL(RunTicks(latch, 0, GameInput::Enum(CarInput::SHIFT_UP), values), 0);
+		latch.Sample(released, oneshot);
+		QT_CHECK_EQUAL(latch.GetInput(GameInput::Enum(CarInput::THROTTLE)), 0.25f);
+		QT_CHECK_EQUAL(RunTicks(latch, 2, GameInput::Enum(CarInput::SHIFT_UP), values), 1);
+		QT_CHECK_EQUAL(values.size(), 2u);
+		QT_CHECK_EQUAL(values[0], 1.0f);
+		latch.Sample(released, oneshot);
+		QT_CHECK_EQUAL(RunTicks(latch, 1, GameInput::Enum(CarInput::SHIFT_UP), values), 0);
+	}
+
+	// frames handed to a simulation that is busy for two frames
+	{
+		TickInputs frame_inputs, tick_inputs;
+		std::vector<float> values;
+		frame_inputs.Sample(pressed, oneshot);
+		frame_inputs.Sample(released, oneshot);
+		tick_inputs.Take(frame_inputs);
+		QT_CHECK_EQUAL(frame_inputs.GetInput(GameInput::VIEW_NEXT), 0);
+		QT_CHECK_EQUAL(tick_inputs.GetInput(GameInput::Enum(CarInput::THROTTLE)), 0.25f);
+		QT_CHECK_EQUAL(RunTicks(tick_inputs, 3, GameInput::VIEW_NEXT, values), 1);
+		tick_inputs.Take(frame_inputs);
+		QT_CHECK_EQUAL(RunTicks(tick_inputs, 3, GameInput::VIEW_NEXT, values), 0);
+	}
+}
@@ -0,0 +1,54 @@
+/************************************************************************/
+/*                                                                      */
+/* This file is part of VDrift.                                         */
+/*                                                                      */
+/* VDrift is free software: you can redistribute it and/or modify       */
+/* it under the terms of the GNU General Public License as published by */
+/* the Free Software Foundation, either version 3 of the License, or    */
+/* (at your option) any later version.                                  */
+/*                                                                      */
+/* VDrift is distributed in the hope that it will be useful,            */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of       */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the        */
+/* GNU General Public License for more details.                         */
+/*                                                                      */
+/* You should have received a copy of the GNU General Public License    */
+/* along with VDrift.  If not, see <http://www.gnu.org/licenses/>.      */
+/*                                                                      */
+/************************************************************************/
+#ifndef _TICKINPUTS_H
+#define _TICKINPUTS_H
+
+#include "gameinput.h"
+
+#include <cassert>
+#include <vector>
+
+/// Game inputs sampled once per frame and read by the simulation ticks of
+/// the frame. Axes and held buttons take the latest sample. One-shot inputs,
+/// button impulses, stay set until a tick consumes them, so they act once
+/// whether a frame runs several ticks or none.
+class TickInputs
+{
+public:
+	TickInputs();
+
+	/// Merge a frame's input sample, oneshot flags the one-shot inputs.
+	void Sample(const std::vector<float> & sample, const std::vector<bool> & oneshot);
+
+	/// Merge the inputs of another latch and consume them there.
+	void Take(TickInputs & other);
+
+	/// Clear the one-shot inputs, called after a tick read the inputs.
+	void Consume();
+
+	const std::vector<float> & GetInputs() const {return inputs;}
+
+	float GetInput(GameInput::Enum inputid) const {assert((unsigned)inputid < inputs.size()); return inputs[inputid];}
+
+private:
+	std::vector<float> inputs;
+	std::vector<bool> oneshot;
+};
+
+#endif // _TICKINPUTS_H
@@ -45,6 +45,7 @@ bool Track::DeferredLoad(
 	const std::string & trackdir,
 	const std::string & texturedir,
 	const std::string & sharedobjectpath,
+	const std::string & cachepath,
 	const int anisotropy,
 	const bool reverse,
 	const bool dynamicobjects,
@@ -61,6 +62,7 @@ bool Track::DeferredLoad(
 			info_output, error_output,
 			trackpath, trackdir,
 			texturedir,	sharedobjectpath,
+			cachepath,
 			anisotropy, reverse,
 			dynamicobjects,
 			dynamicshadows));
@@ -111,6 +113,7 @@ void Track::Clear()
 		delete mesh;
 	}
 	data.meshes.clear();
+	data.bvh_cache.Close();
 
 	data.static_node.Clear();
 	data.surfaces.clear();
@@ -21,6 +21,7 @@
 #define _TRACK_H
 
 #include "roadstrip.h"
+#include "bvhcache.h"
 #include "mathvector.h"
 #include "quaternion.h"
 #include "graphics/scenenode.h"
@@ -52,6 +53,7 @@ public:
 	/// Only begins loading the track.
     /// The track won't be loaded until more calls to ContinueDeferredLoad().
     /// Use Loaded() to see if loading is complete yet.
+    /// Data derived from the track is cached in cachepath, empty disables caching.
     /// Returns true if successful.
 	bool DeferredLoad(
 		ContentManager & content,
@@ -62,6 +64,7 @@ public:
 		const std::string & trackdir,
 		const std::string & effects_texturepath,
 		const std::string & sharedobjectpath,
+		const std::string & cachepath,
 		const int anisotropy,
 		const bool reverse,
 		const bool dynamicobjects,
@@ -176,6 +179,7 @@ private:
 		std::vector<btStridingMeshInterface*> meshes;
 		std::vector<btCollisionShape*> shapes;
 		std::vector<btCollisionObject*> objects;
+		BvhCache bvh_cache;
 
 		// dynamic track objects
 		SceneNode dynamic_node;
@@ -108,6 +108,7 @@ Track::Loader::Loader(
 	const std::string & trackdir,
 	const std::string & texturedir,
 	const std::string & sharedobjectpath,
+	const std::string & cachepath,
 	const int anisotropy,
 	const bool reverse,
 	const bool dynamic_objects,
@@ -121,6 +122,7 @@ Track::Loader::Loader(
 	trackdir(trackdir),
 	texturedir(texturedir),
 	sharedobjectpath(sharedobjectpath),
+	cachepath(cachepath),
 	anisotropy(anisotropy),
 	dynamic_objects(dynamic_objects),
 	dynamic_shadows(dynamic_shadows),
@@ -228,6 +230,9 @@ bool Track::Loader::ContinueLoad()
 		return true;
 	}
 
+	// upload prefetched textures
+	content.finish();
+
 	std::pair <bool, bool> loadstatus = ContinueObjectLoad();
 	if (loadstatus.first)
 	{
@@ -246,7 +251,15 @@ bool Track::Loader::ContinueLoad()
 		track_shape = 0;
 #endif
 		data.loaded = true;
+		content.finish(true);
 		Clear();
+
+		BvhCache & cache = data.bvh_cache;
+		if (cache.GetHits() + cache.GetMisses() > 0)
+		{
+			info_output << "Collision meshes: " << cache.GetHits() << " cached, " << cache.GetMisses() << " built" << std::endl;
+			cache.Write(error_output);
+		}
 	}
 
 	return true;
@@ -262,6 +275,9 @@ bool Track::Loader::BeginObjectLoad()
 	list = true;
 	packload = pack.Load(objectpath + "/objects.jpk");
 
+	if (!cachepath.empty())
+		data.bvh_cache.Open(cachepath + "/collision.bvh");
+
 	std::string objectlist = objectpath + "/list.txt";
 	objectfile.open(objectlist.c_str());
 	if (objectfile.good())
@@ -304,6 +320,9 @@ bool Track::Loader::Begin()
 			node_it = nodes->begin();
 			numobjects = nodes->size();
 			data.meshes.reserve(numobjects);
+
+			// decode textures in the background while the objects are loaded
+			PrefetchTextures();
 			return true;
 		}
 	}
@@ -343,7 +362,7 @@ bool Track::Loader::LoadShape(const PTree & cfg, const Model & model, Body & bod
 			surface = 0;
 		}
 
-		btBvhTriangleMeshShape * shape = new btBvhTriangleMeshShape(mesh, true);
+		btBvhTriangleMeshShape * shape = data.bvh_cache.CreateShape(mesh);
 		shape->setUserPointer((void*)&data.surfaces[surface]);
 		data.shapes.push_back(shape);
 		body.shape = shape;
@@ -379,53 +398,103 @@ bool Track::Loader::LoadShape(const PTree & cfg, const Model & model, Body & bod
 	return true;
 }
 
-Track::Loader::body_iterator Track::Loader::LoadBody(const PTree & cfg)
+// set relative path for models and textures, ugly hack
+// need to identify body references
+static void GetBodyName(const PTree & cfg, std::string & name, std::string & rel_path)
+{
+	rel_path.clear();
+	if (cfg.value() == "body" && cfg.parent())
+	{
+		name = cfg.parent()->value();
+	}
+	else
+	{
+		name = cfg.value();
+		size_t npos = name.rfind("/");
+		if (npos < name.length())
+		{
+			rel_path = name.substr(0, npos+1);
+		}
+	}
+}
+
+void Track::Loader::GetBodyTextures(
+	const PTree & cfg,
+	std::vector<std::string> & texture_names,
+	TextureInfo & texinfo) const
 {
-	Body body;
 	std::string texture_str;
-	std::string model_name;
 	int clampuv = 0;
 	bool mipmap = true;
-	bool alphablend = false;
-	bool doublesided = false;
-	bool isashadow = false;
-
 	cfg.get("texture", texture_str, error_output);
-	cfg.get("model", model_name, error_output);
 	cfg.get("clampuv", clampuv);
 	cfg.get("mipmap", mipmap);
-	cfg.get("alphablend", alphablend);
-	cfg.get("doublesided", doublesided);
-	cfg.get("isashadow", isashadow);
-	cfg.get("skybox", body.skybox);
-	cfg.get("nolighting", body.nolighting);
 
-	std::vector<std::string> texture_names(3);
+	texture_names.assign(3, std::string());
 	std::istringstream s(texture_str);
 	s >> texture_names;
 
-	// set relative path for models and textures, ugly hack
-	// need to identify body references
-	std::string name;
-	if (cfg.value() == "body" && cfg.parent())
+	std::string name, rel_path;
+	GetBodyName(cfg, name, rel_path);
+	for (auto & texture_name : texture_names)
 	{
-		name = cfg.parent()->value();
+		if (!texture_name.empty())
+			texture_name = rel_path + texture_name;
 	}
-	else
-	{
-		name = cfg.value();
-		size_t npos = name.rfind("/");
-		if (npos < name.length())
+
+	texinfo.mipmap = mipmap || anisotropy; //always mipmap if anisotropy is on
+	texinfo.anisotropy = anisotropy;
+	texinfo.repeatu = clampuv != 1 && clampuv != 2;
+	texinfo.repeatv = clampuv != 1 && clampuv != 3;
+}
+
+void Track::Loader::PrefetchTextures()
+{
+	std::vector<std::string> texture_names;
+	for (const auto & node : *nodes)
+	{
+		const PTree * cfg;
+		std::string texture_str;
+		bool isashadow = false;
+		if (!node.second.get("body", cfg) ||
+			!cfg->get("texture", texture_str) ||
+			(cfg->get("isashadow", isashadow) && isashadow && dynamic_shadows))
+			continue;
+
+		TextureInfo texinfo;
+		GetBodyTextures(*cfg, texture_names, texinfo);
+		for (int i = 0; i < 3; ++i)
 		{
-			std::string rel_path = name.substr(0, npos+1);
-			model_name = rel_path + model_name;
-			texture_names[0] = rel_path + texture_names[0];
-			if (!texture_names[1].empty())
-				texture_names[1] = rel_path + texture_names[1];
-			if (!texture_names[2].empty())
-				texture_names[2] = rel_path + texture_names[2];
+			// don't compress normal map
+			texinfo.compress = (i != 2);
+			if (!texture_names[i].empty())
+				content.loadAsync<Texture>(objectdir, texture_names[i], texinfo);
 		}
 	}
+}
+
+Track::Loader::body_iterator Track::Loader::LoadBody(const PTree & cfg)
+{
+	Body body;
+	std::string model_name;
+	bool alphablend = false;
+	bool doublesided = false;
+	bool isashadow = false;
+
+	cfg.get("model", model_name, error_output);
+	cfg.get("alphablend", alphablend);
+	cfg.get("doublesided", doublesided);
+	cfg.get("isashadow", isashadow);
+	cfg.get("skybox", body.skybox);
+	cfg.get("nolighting", body.nolighting);
+
+	std::vector<std::string> texture_names;
+	TextureInfo texinfo;
+	GetBodyTextures(cfg, texture_names, texinfo);
+
+	std::string name, rel_path;
+	GetBodyName(cfg, name, rel_path);
+	model_name = rel_path + model_name;
 
 	if (dynamic_shadows && isashadow)
 	{
@@ -452,11 +521,6 @@ Track::Loader::body_iterator Track::Loader::LoadBody(const PTree & cfg)
 
 	// load textures
 	std::shared_ptr<Texture> tex[3];
-	TextureInfo texinfo;
-	texinfo.mipmap = mipmap || anisotropy; //always mipmap if anisotropy is on
-	texinfo.anisotropy = anisotropy;
-	texinfo.repeatu = clampuv != 1 && clampuv != 2;
-	texinfo.repeatv = clampuv != 1 && clampuv != 3;
 	content.load(tex[0], objectdir, texture_names[0], texinfo);
 	if (!texture_names[1].empty())
 	{
@@ -773,7 +837,7 @@ bool Track::Loader::AddObject(const Object & object)
 		data.meshes.push_back(mesh);
 
 		assert(object.surface >= 0 && object.surface < (int)data.surfaces.size());
-		btBvhTriangleMeshShape * shape = new btBvhTriangleMeshShape(mesh, true);
+		btBvhTriangleMeshShape * shape = data.bvh_cache.CreateShape(mesh);
 		shape->setUserPointer((void*)&data.surfaces[object.surface]);
 		data.shapes.push_back(shape);
 
@@ -938,6 +1002,18 @@ bool Track::Loader::LoadRoads()
 
 bool Track::Loader::CreateRacingLines()
 {
+	// racing lines are cached per road, reversed roads have their own cache file
+	std::string cachefile;
+	std::ifstream cache_in;
+	std::ostringstream cache_out;
+	bool cache_valid = true;
+	if (!cachepath.empty())
+	{
+		cachefile = cachepath + (data.reverse ? "/racingline-reverse.bin" : "/racingline.bin");
+		cache_in.open(cachefile.c_str(), std::ios::binary);
+		cache_valid = cache_in.good();
+	}
+
 	K1999 k1999;
 	for (auto & road : data.roads)
 	{
@@ -945,11 +1021,25 @@ bool Track::Loader::CreateRacingLines()
 		if (road.GetClosed())
 		{
 			k1999.LoadData(road);
-			k1999.CalcRaceLine();
+			if (!k1999.ReadRaceLine(cache_in))
+			{
+				k1999.CalcRaceLine();
+				cache_valid = false;
+			}
+			k1999.WriteRaceLine(cache_out);
 			k1999.UpdateRoadStrip(road);
 			CreateRacingLine(road);
 		}
 	}
+
+	if (!cachefile.empty() && !cache_valid)
+	{
+		cache_in.close();
+		const std::string records = cache_out.str();
+		std::ofstream file(cachefile.c_str(), std::ios::binary);
+		if (!file.write(records.data(), records.size()))
+			error_output << "Failed to write racing line cache " << cachefile << std::endl;
+	}
 	return true;
 }
 
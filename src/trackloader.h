@@ -51,6 +51,7 @@ class btStridingMeshInterface;
 class btCompoundShape;
 class btCollisionShape;
 class PTree;
+struct TextureInfo;
 
 class Track::Loader
 {
@@ -65,6 +66,7 @@ public:
 		const std::string & trackdir,
 		const std::string & texturedir,
 		const std::string & sharedobjectpath,
+		const std::string & cachepath,
 		const int anisotropy,
 		const bool reverse,
 		const bool dynamic_shadows,
@@ -91,6 +93,7 @@ private:
 	const std::string & trackdir;
 	const std::string & texturedir;
 	const std::string & sharedobjectpath;
+	const std::string cachepath;
 	const int anisotropy;
 	const bool dynamic_objects;
 	const bool dynamic_shadows;
@@ -170,6 +173,14 @@ private:
 
 	body_iterator LoadBody(const PTree & cfg);
 
+	void GetBodyTextures(
+		const PTree & cfg,
+		std::vector<std::string> & texture_names,
+		TextureInfo & texinfo) const;
+
+	/// start asynchronous loads of the textures of all objects
+	void PrefetchTextures();
+
 	void AddBody(SceneNode & scene, const Body & body);
 
 	struct Object;